@@ -5,76 +5,276 @@
 */
 
 /* Register Usage Information:
-	Reg0 - Control register => bit0 to enable, bit [31:1] = unused
-    Reg1 - Status register  => processing done => bit0 is set
-	Reg2 - Output Data register
+	Reg0 - Control register => bit0 block valid, Reg16..Reg31 hold a block (cleared by HW when it is taken),
+	                           bit1 completion interrupt enable,
+	                           bit2 first block of a message, bit3 last block of a message,
+	                           bit [10:4] message bytes in the last block (0 to 64),
+	                           bit11 interrupt while the block registers are free,
+	                           bit12 DMA: hash the message described by Reg9..Reg11 (cleared by HW
+	                           once the digest is in memory; completes like a message from Reg16..),
+	                           bit [15:13] = unused, bit [31:16] job tag
+    Reg1 - Status register  => processing done => bit0 is set,
+	                           completion queue not empty (interrupt pending) => bit1 is set,
+	                           write 1 to bit1 to remove the oldest completion,
+	                           message in progress => bit2 is set,
+	                           block registers free => bit3 is set,
+	                           DMA running => bit4 is set,
+	                           bit [16+n] core n holds a message
+	Reg2 - Output Data register, digest of the oldest completion
 	.   
 	.
 	Reg6
-	Reg7 - Unused */
+	Reg7 - Performance counters => write: bit [1:0] selects the counter read back,
+	                               bit30 copies all counters into the read back snapshot,
+	                               bit31 clears the counters (after the copy, no cycle is lost);
+	                               read: the selected counter of the last snapshot.
+	                               0 busy cycles (status bit2 set), 1 idle cycles,
+	                               2 blocks hashed, padding blocks included,
+	                               3 stall cycles: a block waits for a core, or a digest for room
+	                               in the completion queue
+	Reg8 - Completion register => bit [15:0] tag of the oldest completion,
+	                              bit [31:16] number of completed jobs
+	Reg9  - DMA source address (word aligned)
+	Reg10 - DMA message length in bytes
+	Reg11 - DMA result address, H0..H4 are written there
+	Reg12 - Configuration register => bit [7:0] cores, bit [15:8] rounds per cycle (read only)
+	Reg13..Reg15 - Unused
+	Reg16 - Block register, message bytes 0..3 (byte 0 in bit [31:24])
+	.
+	.
+	Reg31 - Block register, message bytes 60..63
+
+	The 32 registers span 0x80 bytes, so the slave needs a 128 byte aligned base that overlaps
+	no other slave: 0x80009080 in the Platform Designer system, above the LED PIO at 0x80009040.
+
+	CORES cores hash independent messages at the same time (sha_core_array.sv): software keeps
+	up to CORES messages started and interleaves their blocks. Completions are queued, so
+	messages finishing close together are all seen. */
 	
- module avalon_sha_wrapper(
+ module avalon_sha_wrapper #(parameter int CORES = 1, parameter int ROUNDS_PER_CYCLE = 4) (
 	input logic clk, input logic reset_n,
 	input logic read, input logic write,
-	input logic [2:0]   address,
+	input logic [4:0]   address,
 	input logic [31:0]  writedata,
-	output logic [31:0] readdata
+	output logic [31:0] readdata,
+	output logic irq,
+	/* Avalon-MM master of the DMA */
+	output logic [31:0] m_address,
+	output logic m_read,
+	output logic m_write,
+	output logic [4:0] m_burstcount,
+	output logic [31:0] m_writedata,
+	input  logic [31:0] m_readdata,
+	input  logic m_readdatavalid,
+	input  logic m_waitrequest
 	);
 	
+	localparam QUEUE_DEPTH = CORES + 1; /* A digest per core, and the one the DMA writes back */
+
 	logic [31:0] control_register    = 0; /* Contains the enable bit set/reset */
-	logic [31:0] status_register     = 0; /* Contains the status bit - done/not done */
-	logic [31:0] data_register [4:0] = 0; /* Contains the output hash */
+	logic [31:0] status_register;         /* Contains the status bit - done/not done */
+	logic [31:0] data_register [4:0];     /* Contains the output hash */
+	logic [31:0] completion_register;     /* Contains the tag and count of completed jobs */
+	logic [31:0] block_register [15:0];   /* Contains the next message block */
+	logic [31:0] dma_register [2:0];      /* Contains the DMA descriptor */
+	logic [31:0] perf_counter [3:0];      /* Busy, idle, blocks, stall */
+	logic [31:0] perf_next [3:0];         /* ... including this cycle */
+	logic [31:0] perf_snapshot [3:0];     /* Contains the counters read back */
+	logic [1:0]  perf_select;             /* Counter read back */
+
+	logic q_done, q_busy, q_complete, block_taken, irq_pending;
+	logic [15:0] q_tag;
+	logic [31:0] q_output_reg [4:0];
+	logic [CORES-1:0] core_busy;
+	logic [4:0] blocks_loaded;
+	logic busy, block_valid, block_offered, q_stalled, stall;
+
+	/* Completion queue */
+	logic [15:0] queue_tag [QUEUE_DEPTH];
+	logic [31:0] queue_digest [QUEUE_DEPTH][4:0];
+	logic [4:0]  queue_head, queue_tail, queue_count;
+	logic [15:0] completed_jobs;
+	logic push, pop, queue_full;
 
-	logic q_done = 0 , start = 0;
-	integer i;
+	/* Block source of the cores: the block registers, or the DMA while it runs */
+	logic dma_active, dma_valid, dma_first, dma_last, dma_complete, dma_done;
+	logic [6:0]  dma_bytes;
+	logic [31:0] dma_block [15:0];
+	logic [31:0] dma_digest [4:0];
+
+	assign dma_active   = control_register[12];
+	assign dma_complete = dma_active && q_complete && (q_tag == control_register[31:16]);
+	assign queue_full   = (queue_count == QUEUE_DEPTH);
+	/* The DMA message is queued once its digest has been written back */
+	assign push         = dma_done || (q_complete && !dma_complete);
+	assign pop          = write && address == 5'd1 && writedata[1] && queue_count != 0;
+	assign irq_pending  = (queue_count != 0);
+	assign block_valid  = dma_active ? dma_valid : control_register[0];
 	
 	always_ff@(posedge clk) begin
 		if(reset_n == 1'b0)
 			begin
-				for(i = 0;i <= 4; i = i+1) begin: clear_register_set
-					data_register[i] <= 32'd0;
-				end
 				control_register <= 32'd0;
-				status_register  <= 32'd0;
+				queue_head       <= 'd0;
+				queue_tail       <= 'd0;
+				queue_count      <= 'd0;
+				completed_jobs   <= 'd0;
 			end
 		else
-			if(write)
-				case(address)
-					0: control_register <= writedata;
-					1: status_register  <= writedata;
-					2: data_register[0] <= writedata;
-					3: data_register[1] <= writedata;
-					4: data_register[2] <= writedata;
-					5: data_register[3] <= writedata;
-					6:	data_register[4] <= writedata;
-					7:	data_register[4] <= writedata; //unused
-				endcase
+			begin
+				if(block_taken && !dma_active) /* The block registers may be reused */
+					control_register[0] <= 1'b0;
+				if(dma_done)
+					control_register[12] <= 1'b0;
+				
+				if(write)
+					if(address[4])
+						block_register[address[3:0]] <= writedata;
+					else
+						case(address[3:0])
+							0: control_register <= writedata;
+							9, 10, 11: dma_register[address[3:0] - 9] <= writedata;
+						endcase
 				
+				/* Message completed: queue it, which raises the interrupt */
+				if(push)
+					begin
+						if(dma_done)
+							begin
+								queue_tag[queue_tail]    <= control_register[31:16];
+								queue_digest[queue_tail] <= dma_digest;
+							end
+						else
+							begin
+								queue_tag[queue_tail]    <= q_tag;
+								queue_digest[queue_tail] <= q_output_reg;
+							end
+						queue_tail     <= (queue_tail == QUEUE_DEPTH - 1) ? 'd0 : queue_tail + 1;
+						completed_jobs <= completed_jobs + 16'd1;
+					end
+				if(pop) // write 1 to clear
+					queue_head <= (queue_head == QUEUE_DEPTH - 1) ? 'd0 : queue_head + 1;
+				queue_count <= queue_count + push - pop;
+			end
 	end
+
+	assign data_register       = queue_digest[queue_head];
+	assign completion_register = {completed_jobs, queue_tag[queue_head]};
+
 	always_comb
 	begin
 		if(read)
-			case(address)
-				0: readdata = control_register;
-				1: readdata = status_register;
-				2: readdata = data_register[0];
-				3: readdata = data_register[1];
-				4: readdata = data_register[2];
-				5: readdata = data_register[3];
-				6:	readdata = data_register[4];
-				7: readdata = data_register[4];//unused
-			endcase
+			if(address[4])
+				readdata = block_register[address[3:0]];
+			else
+				case(address[3:0])
+					0: readdata = control_register;
+					1: readdata = status_register;
+					2: readdata = data_register[0];
+					3: readdata = data_register[1];
+					4: readdata = data_register[2];
+					5: readdata = data_register[3];
+					6:	readdata = data_register[4];
+					7: readdata = perf_snapshot[perf_select];
+					8: readdata = completion_register;
+					9, 10, 11: readdata = dma_register[address[3:0] - 9];
+					12: readdata = {16'd0, 8'(ROUNDS_PER_CYCLE), 8'(CORES)};
+					default: readdata = 0;
+				endcase
 		else
 			readdata = 0;
 	end
 	
-	assign start = (control_register[0] == 1) ? 1 : 0; // If BIT 0 is set, then start
-	assign status_register = (q_done == 1) ? 1 : 0; // If processing is done, set bit 0
+	assign busy            = q_busy | control_register[0] | dma_active;
+	assign status_register = {16'(core_busy), 11'd0, dma_active, !control_register[0],
+	                          busy, irq_pending, q_done & !dma_active};
+	assign irq = (irq_pending & control_register[1]) | // Completion interrupt, if enabled
+	             (!control_register[0] & control_register[11]); // Block registers free, if enabled
 	
-	state_machine_toplevel_framework inst_0(.clk(clk),
+	/* block_taken follows the cycle a block is taken in: a block offered the cycle before and
+	   no pulse now waited for a core */
+	assign stall = (block_offered && !block_taken) || q_stalled;
+
+	always_comb
+		begin : performance_count
+			perf_next[0] = perf_counter[0] + 32'(busy);
+			perf_next[1] = perf_counter[1] + 32'(!busy);
+			perf_next[2] = perf_counter[2] + 32'(blocks_loaded);
+			perf_next[3] = perf_counter[3] + 32'(stall);
+		end : performance_count
+
+	always_ff@(posedge clk)
+		begin : performance_counters
+			if(reset_n == 1'b0)
+				begin
+					for(int i = 0; i < 4; i++)
+						begin
+							perf_counter[i]  <= 32'd0;
+							perf_snapshot[i] <= 32'd0;
+						end
+					perf_select   <= 2'd0;
+					block_offered <= 1'b0;
+				end
+			else
+				begin
+					block_offered <= block_valid && !block_taken;
+					perf_counter  <= perf_next;
+
+					if(write && address == 5'd7)
+						begin
+							perf_select <= writedata[1:0];
+							if(writedata[30])
+								perf_snapshot <= perf_next;
+							if(writedata[31])
+								for(int i = 0; i < 4; i++)
+									perf_counter[i] <= 32'd0;
+						end
+				end
+		end : performance_counters
+
+	sha_dma_master dma(.clk(clk),
+		.reset_n(reset_n),
+		.start(dma_active),
+		.source_address(dma_register[0]),
+		.length(dma_register[1]),
+		.result_address(dma_register[2]),
+		.block_valid(dma_valid),
+		.block_first(dma_first),
+		.block_last(dma_last),
+		.block_bytes(dma_bytes),
+		.block_out(dma_block),
+		.block_taken(block_taken),
+		.complete(dma_complete),
+		.digest(q_output_reg),
+		.hash(dma_digest),
+		.done(dma_done),
+		.m_address(m_address),
+		.m_read(m_read),
+		.m_write(m_write),
+		.m_burstcount(m_burstcount),
+		.m_writedata(m_writedata),
+		.m_readdata(m_readdata),
+		.m_readdatavalid(m_readdatavalid),
+		.m_waitrequest(m_waitrequest));
+
+	/* A digest is only handed out when it can be queued; the DMA's goes first */
+	sha_core_array #(.CORES(CORES), .ROUNDS_PER_CYCLE(ROUNDS_PER_CYCLE)) inst_0(.clk(clk),
 		.reset_n(reset_n),
-	   .start(start),
+		.block_valid(block_valid),
+		.block_first(dma_active ? dma_first : control_register[2]),
+		.block_last(dma_active ? dma_last : control_register[3]),
+		.block_bytes(dma_active ? dma_bytes : control_register[10:4]),
+		.block_tag(control_register[31:16]),
+		.block_in(dma_active ? dma_block : block_register),
+		.block_taken(block_taken),
+		.blocks_loaded(blocks_loaded),
+		.q_stall(queue_full || dma_done),
+		.q_stalled(q_stalled),
+		.q_busy(q_busy),
 		.q_done(q_done),
-		.q_output_reg(data_register));
+		.q_complete(q_complete),
+		.q_tag(q_tag),
+		.q_output_reg(q_output_reg),
+		.core_busy(core_busy));
 
 endmodule
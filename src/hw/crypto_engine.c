@@ -0,0 +1,509 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_engine.c
+* Author          : Jishnu Murali Thampan
+* Description     : Interrupt driven driver of the Avalon SHA-1 accelerator.
+* 		              The queues are only touched with the accelerator
+* 		              interrupt masked; the handler itself runs masked.
+* 		              Up to one message per core is on the accelerator;
+* 		              their blocks are written in turn from the block-free
+* 		              interrupt while the ones before are compressed. A
+* 		              message for the DMA waits until it can have the
+* 		              accelerator to itself.
+****************************************************************************/
+
+#include "crypto_engine.h"
+#ifndef CRYPTO_ENGINE_HOSTED
+#include "sys/alt_cache.h"
+#include "sys/alt_irq.h"
+#endif
+
+#define JOB_FREE (0)    /**< @brief Represents an unused job slot */
+#define JOB_QUEUED (1)  /**< @brief Represents a job waiting to be started */
+#define JOB_RUNNING (2) /**< @brief Represents the job on the accelerator */
+#define JOB_DONE (3)    /**< @brief Represents a job not yet collected */
+#define CRYPTO_TAG_MASK (0xFFFF) /**< @brief Represents the job tag field */
+#define CRYPTO_PERF_BUSY (0)     /**< @brief Represents the busy counter */
+#define CRYPTO_PERF_IDLE (1)     /**< @brief Represents the idle counter */
+#define CRYPTO_PERF_BLOCKS (2)   /**< @brief Represents the block counter */
+#define CRYPTO_PERF_STALL (3)    /**< @brief Represents the stall counter */
+#define CRYPTO_POLLED                                                          \
+  (CRYPTO_ENGINE_QUEUE_DEPTH) /**< @brief Represents the tag of the message \
+                                 of crypto_engine_hash() */
+
+/**
+ * Reads an accelerator register
+ * @param[in] engine Driver state
+ * @param[in] reg    Register address
+ * @return Register value
+ */
+static uint32_t crypto_engine_read(const crypto_engine *engine,
+                                   uint32_t reg) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  return engine->bus->read(engine->bus->context, reg);
+#else
+  return *(engine->base + reg);
+#endif
+}
+/**
+ * Writes an accelerator register
+ * @param[in] engine Driver state
+ * @param[in] reg    Register address
+ * @param[in] value  Value to be written
+ * @return void
+ */
+static void crypto_engine_write(const crypto_engine *engine, uint32_t reg,
+                                uint32_t value) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  engine->bus->write(engine->bus->context, reg, value);
+#else
+  *(engine->base + reg) = value;
+#endif
+}
+/**
+ * Returns the address the DMA reaches a buffer at
+ * @param[in] engine  Driver state
+ * @param[in] pointer Buffer
+ * @return Bus address
+ */
+static uint32_t crypto_engine_dma_address(const crypto_engine *engine,
+                                          const void *pointer) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  return engine->bus->dma_address(engine->bus->context, pointer);
+#else
+  (void)engine;
+  return (uint32_t)(uintptr_t)pointer;
+#endif
+}
+/**
+ * Makes a buffer coherent with what the DMA sees: writes back lines the CPU
+ * dirtied before the DMA reads it, drops stale lines after the DMA wrote it
+ * @param[in] pointer Buffer
+ * @param[in] length  Number of bytes
+ * @return void
+ */
+static void crypto_engine_dma_sync(const void *pointer, size_t length) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  (void)pointer;
+  (void)length;
+#else
+  alt_dcache_flush((void *)pointer, length);
+#endif
+}
+/**
+ * Drops the cached lines of a buffer only the DMA writes, without writing
+ * them back, so the CPU reads what the DMA stored
+ * @param[in] pointer Buffer, whole cache lines
+ * @param[in] length  Number of bytes
+ * @return void
+ */
+static void crypto_engine_dma_invalidate(const void *pointer, size_t length) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  (void)pointer;
+  (void)length;
+#else
+  alt_dcache_flush_no_writeback((void *)pointer, length);
+#endif
+}
+/**
+ * Masks the accelerator interrupt around a queue update
+ * @param[in] engine Driver state
+ * @return State to be passed to crypto_engine_unlock()
+ */
+static int crypto_engine_lock(const crypto_engine *engine) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  return engine->bus->irq_mask(engine->bus->context, 1);
+#else
+  (void)engine;
+  return (int)alt_irq_disable_all();
+#endif
+}
+/**
+ * Restores the interrupt mask saved by crypto_engine_lock()
+ * @param[in] engine Driver state
+ * @param[in] state  Saved mask
+ * @return void
+ */
+static void crypto_engine_unlock(const crypto_engine *engine, int state) {
+#ifdef CRYPTO_ENGINE_HOSTED
+  engine->bus->irq_mask(engine->bus->context, state);
+#else
+  (void)engine;
+  alt_irq_enable_all((alt_irq_context)state);
+#endif
+}
+/**
+ * Writes the next block of a message to the block registers and hands it
+ * over. Only the words holding message bytes are written, the HW pads the
+ * last block itself.
+ * @param[in]     engine  Driver state
+ * @param[in,out] job     Message; its offset advances past the block
+ * @param[in]     tag     Job tag reported on completion
+ * @param[in]     control Interrupt enable bits to be kept
+ * @return 1 if this was the last block, 0 otherwise
+ */
+static int crypto_engine_write_block(const crypto_engine *engine,
+                                     crypto_engine_job *job, uint32_t tag,
+                                     uint32_t control) {
+  const uint8_t *block = job->data + job->offset;
+  size_t remaining = job->length - job->offset;
+  int last = (remaining <= MESSAGE_SIZE);
+  size_t bytes = (last) ? (remaining) : (MESSAGE_SIZE);
+
+  for (size_t i = 0; 4 * i < bytes; i++) {
+    uint32_t word = 0;
+    for (size_t b = 0; b < 4; b++) {
+      word = (word << 8) | ((4 * i + b < bytes) ? (block[4 * i + b]) : (0));
+    }
+    crypto_engine_write(engine, CRYPTO_BLOCK_REG_0 + i, word);
+  }
+
+  control |= (tag << CRYPTO_CTRL_TAG_SHIFT) | (1 << CRYPTO_CTRL_REG_BIT_0);
+  if (job->offset == 0)
+    control |= (1 << CRYPTO_CTRL_REG_BIT_2);
+  if (last)
+    control |= (1 << CRYPTO_CTRL_REG_BIT_3) |
+               ((uint32_t)bytes << CRYPTO_CTRL_BYTES_SHIFT);
+  crypto_engine_write(engine, CRYPTO_CTRL_REG, control);
+  job->offset += bytes;
+  return last;
+}
+/**
+ * Hands a job to the DMA; the digest is written into the slot's result
+ * line, which shares no cache line with anything the CPU writes. Called
+ * with the interrupt masked.
+ * @param[in,out] engine Driver state
+ * @param[in]     handle Job
+ * @return void
+ */
+static void crypto_engine_start_dma(crypto_engine *engine, int handle) {
+  crypto_engine_job *job = &engine->job[handle];
+
+  job->offset = job->length; // CPU writes to the slot before the flushes
+  crypto_engine_dma_sync(job->data, job->length);
+  crypto_engine_dma_invalidate(engine->dma_result[handle],
+                               sizeof(engine->dma_result[handle]));
+  crypto_engine_write(engine, CRYPTO_DMA_REG_SOURCE,
+                      crypto_engine_dma_address(engine, job->data));
+  crypto_engine_write(engine, CRYPTO_DMA_REG_LENGTH, (uint32_t)job->length);
+  crypto_engine_write(
+      engine, CRYPTO_DMA_REG_RESULT,
+      crypto_engine_dma_address(engine, engine->dma_result[handle]));
+  crypto_engine_write(engine, CRYPTO_CTRL_REG,
+                      ((uint32_t)handle << CRYPTO_CTRL_TAG_SHIFT) |
+                          (1 << CRYPTO_CTRL_REG_BIT_12) |
+                          (1 << CRYPTO_CTRL_REG_BIT_1));
+}
+/**
+ * Picks the job whose block goes to the accelerator next: the oldest queued
+ * one while a core is free (a DMA job waits for all cores), otherwise the
+ * running ones in turn
+ * @param[in] engine Driver state
+ * @return Handle of the job or -1 if there is nothing to feed
+ */
+static int crypto_engine_pick(const crypto_engine *engine) {
+  if (engine->exclusive)
+    return -1;
+  if (engine->submit_head != engine->submit_tail) {
+    int handle =
+        engine->submitted[engine->submit_head % CRYPTO_ENGINE_QUEUE_DEPTH];
+    if ((engine->job[handle].dma) ? (engine->active == 0)
+                                  : (engine->active < engine->cores))
+      return handle;
+  }
+  for (int i = 1; i <= CRYPTO_ENGINE_QUEUE_DEPTH; i++) {
+    int handle = (engine->cursor + i) % CRYPTO_ENGINE_QUEUE_DEPTH;
+    const crypto_engine_job *job = &engine->job[handle];
+    if (job->state == JOB_RUNNING && !job->dma && job->offset < job->length)
+      return handle;
+  }
+  return -1;
+}
+/**
+ * Writes the next block to the free block registers, starting a queued job
+ * if that is the one picked. The block-free interrupt stays enabled until
+ * it finds nothing left to feed. Called with the interrupt masked.
+ * @param[in,out] engine Driver state
+ * @return 1 if a block was written or a DMA job started, 0 otherwise
+ */
+static int crypto_engine_feed(crypto_engine *engine) {
+  int handle = crypto_engine_pick(engine);
+  crypto_engine_job *job;
+
+  if (handle < 0)
+    return 0;
+  job = &engine->job[handle];
+  if (job->state == JOB_QUEUED) {
+    engine->submit_head++;
+    engine->active++;
+    job->state = JOB_RUNNING;
+    job->offset = 0;
+    if (job->dma) {
+      engine->exclusive = 1;
+      crypto_engine_start_dma(engine, handle);
+      return 1;
+    }
+  }
+  crypto_engine_write_block(engine, job, (uint32_t)handle,
+                            (1 << CRYPTO_CTRL_REG_BIT_1) |
+                                (1 << CRYPTO_CTRL_REG_BIT_11));
+  engine->cursor = handle;
+  return 1;
+}
+/**
+ * Feeds the accelerator if there is work and the block registers are free;
+ * otherwise the block-free interrupt will. Called with the interrupt masked.
+ * @param[in,out] engine Driver state
+ * @return void
+ */
+static void crypto_engine_kick(crypto_engine *engine) {
+  if (crypto_engine_pick(engine) >= 0 &&
+      (crypto_engine_read(engine, CRYPTO_STATUS_REG) &
+       (1 << CRYPTO_STATUS_REG_BIT_3)))
+    crypto_engine_feed(engine);
+}
+#ifdef CRYPTO_ENGINE_HOSTED
+/**
+ * Prepares the driver and enables the completion interrupt
+ * @param[out] engine Driver state
+ * @param[in]  bus    Register access of the hosted accelerator
+ * @return void
+ */
+void crypto_engine_init(crypto_engine *engine, const crypto_engine_bus *bus) {
+  engine->bus = bus;
+#else
+/**
+ * Prepares the driver and enables the completion interrupt. The caller
+ * registers crypto_engine_isr() with the engine as its context.
+ * @param[out] engine Driver state
+ * @param[in]  base   Register base address
+ * @return void
+ */
+void crypto_engine_init(crypto_engine *engine, volatile uint32_t *base) {
+  engine->base = base;
+#endif
+  for (int i = 0; i < CRYPTO_ENGINE_QUEUE_DEPTH; i++) {
+    engine->job[i].state = JOB_FREE;
+  }
+  engine->submit_head = engine->submit_tail = 0;
+  engine->complete_head = engine->complete_tail = 0;
+  engine->active = 0;
+  engine->cursor = 0;
+  engine->exclusive = 0;
+  engine->dma = 0;
+  engine->cores = (int)(crypto_engine_read(engine, CRYPTO_CONFIG_REG) &
+                        CRYPTO_CONFIG_CORES_MASK);
+  if (engine->cores == 0) // bitstream without the configuration register
+    engine->cores = 1;
+
+  while (crypto_engine_read(engine, CRYPTO_STATUS_REG) &
+         (1 << CRYPTO_STATUS_REG_BIT_1)) // drop stale completions
+    crypto_engine_write(engine, CRYPTO_STATUS_REG,
+                        (1 << CRYPTO_STATUS_REG_BIT_1));
+  crypto_engine_write(engine, CRYPTO_CTRL_REG, (1 << CRYPTO_CTRL_REG_BIT_1));
+}
+/**
+ * Queues a hash job. It starts at once if a core and the block registers
+ * are free, otherwise from the interrupt handler.
+ * @param[in,out] engine Driver state
+ * @param[in]     data   Message; must stay valid until the job completes
+ * @param[in]     length Number of bytes in data
+ * @return Handle of the job or -1 if all slots are in use
+ */
+crypto_engine_handle crypto_engine_submit(crypto_engine *engine,
+                                          const void *data, size_t length) {
+  int state = crypto_engine_lock(engine);
+  int handle = -1;
+
+  for (int i = 0; i < CRYPTO_ENGINE_QUEUE_DEPTH; i++) {
+    if (engine->job[i].state == JOB_FREE) {
+      handle = i;
+      break;
+    }
+  }
+  if (handle >= 0) {
+    engine->job[handle].state = JOB_QUEUED;
+    engine->job[handle].data = (const uint8_t *)data;
+    engine->job[handle].length = length;
+    engine->job[handle].dma =
+        engine->dma && ((uintptr_t)data % sizeof(uint32_t)) == 0;
+    engine->submitted[engine->submit_tail++ % CRYPTO_ENGINE_QUEUE_DEPTH] =
+        (uint8_t)handle;
+    crypto_engine_kick(engine);
+  }
+
+  crypto_engine_unlock(engine, state);
+  return handle;
+}
+/**
+ * Takes the oldest finished job off the completion queue and frees its slot
+ * @param[in,out] engine     Driver state
+ * @param[out]    final_hash Digest of the job
+ * @return Handle of the job or -1 if none has finished
+ */
+crypto_engine_handle crypto_engine_next_completion(crypto_engine *engine,
+                                                   uint32_t final_hash[]) {
+  int state = crypto_engine_lock(engine);
+  int handle = -1;
+
+  if (engine->complete_head != engine->complete_tail) {
+    handle =
+        engine->completed[engine->complete_head++ % CRYPTO_ENGINE_QUEUE_DEPTH];
+    for (int i = 0; i < FINAL_HASH_SIZE; i++) {
+      final_hash[i] = engine->job[handle].final_hash[i];
+    }
+    engine->job[handle].state = JOB_FREE;
+  }
+
+  crypto_engine_unlock(engine, state);
+  return handle;
+}
+/**
+ * Returns the number of jobs submitted and not yet collected
+ * @param[in] engine Driver state
+ * @return Number of jobs
+ */
+int crypto_engine_outstanding(crypto_engine *engine) {
+  int state = crypto_engine_lock(engine);
+  int count = 0;
+
+  for (int i = 0; i < CRYPTO_ENGINE_QUEUE_DEPTH; i++) {
+    count += (engine->job[i].state != JOB_FREE);
+  }
+
+  crypto_engine_unlock(engine, state);
+  return count;
+}
+/**
+ * Selects how jobs submitted from now on reach the accelerator: word
+ * aligned messages through the DMA, or all of them through the block
+ * registers. The bitstream must have the DMA master connected.
+ * @param[in,out] engine Driver state
+ * @param[in]     enable 1 to use the DMA, 0 otherwise
+ * @return void
+ */
+void crypto_engine_set_dma(crypto_engine *engine, int enable) {
+  int state = crypto_engine_lock(engine);
+  engine->dma = enable;
+  crypto_engine_unlock(engine, state);
+}
+/**
+ * Interrupt handler. Collects every queued completion: the digest of the
+ * finished job goes to the completion queue. Then, with the block registers
+ * free, it writes the next block or starts the next job.
+ * @param[in] context Driver state (crypto_engine *)
+ * @return void
+ */
+void crypto_engine_isr(void *context) {
+  crypto_engine *engine = (crypto_engine *)context;
+  uint32_t status = crypto_engine_read(engine, CRYPTO_STATUS_REG);
+
+  while (status & (1 << CRYPTO_STATUS_REG_BIT_1)) {
+    int handle = (int)(crypto_engine_read(engine, CRYPTO_COMPLETION_REG) &
+                       CRYPTO_TAG_MASK);
+    if (handle < CRYPTO_ENGINE_QUEUE_DEPTH &&
+        engine->job[handle].state == JOB_RUNNING) {
+      crypto_engine_job *job = &engine->job[handle];
+      if (job->dma) { /* Written to the result line by the DMA */
+        const uint32_t *result = engine->dma_result[handle];
+        crypto_engine_dma_invalidate(result,
+                                     sizeof(engine->dma_result[handle]));
+        for (int i = 0; i < FINAL_HASH_SIZE; i++) {
+          job->final_hash[i] = result[i];
+        }
+        engine->exclusive = 0;
+      } else {
+        job->final_hash[4] = crypto_engine_read(engine, CRYPTO_DATA_REG_0);
+        job->final_hash[3] = crypto_engine_read(engine, CRYPTO_DATA_REG_1);
+        job->final_hash[2] = crypto_engine_read(engine, CRYPTO_DATA_REG_2);
+        job->final_hash[1] = crypto_engine_read(engine, CRYPTO_DATA_REG_3);
+        job->final_hash[0] = crypto_engine_read(engine, CRYPTO_DATA_REG_4);
+      }
+      job->state = JOB_DONE;
+      engine->completed[engine->complete_tail++ % CRYPTO_ENGINE_QUEUE_DEPTH] =
+          (uint8_t)handle;
+      engine->active--;
+    }
+    crypto_engine_write(engine, CRYPTO_STATUS_REG,
+                        (1 << CRYPTO_STATUS_REG_BIT_1)); // next completion
+    status = crypto_engine_read(engine, CRYPTO_STATUS_REG);
+  }
+
+  if ((status & (1 << CRYPTO_STATUS_REG_BIT_3)) && !engine->exclusive &&
+      !crypto_engine_feed(engine)) // nothing to feed: stop asking
+    crypto_engine_write(engine, CRYPTO_CTRL_REG, (1 << CRYPTO_CTRL_REG_BIT_1));
+}
+/**
+ * Hashes a buffer without interrupts: writes it block by block, polling for
+ * free block registers, then polls for the digest. No job may be running;
+ * jobs submitted meanwhile start afterwards.
+ * @param[in,out] engine     Driver state
+ * @param[in]     data       Message
+ * @param[in]     length     Number of bytes in data
+ * @param[out]    final_hash Digest
+ * @return 0 on success, -1 if queued jobs are using the accelerator
+ */
+int crypto_engine_hash(crypto_engine *engine, const void *data, size_t length,
+                       uint32_t final_hash[]) {
+  crypto_engine_job job = {(const uint8_t *)data, length, 0,
+                           {0},
+                           JOB_RUNNING, 0};
+  int state = crypto_engine_lock(engine);
+  int last = 0;
+
+  if (engine->active > 0 || engine->exclusive) {
+    crypto_engine_unlock(engine, state);
+    return -1;
+  }
+  engine->exclusive = 1;
+  crypto_engine_write(engine, CRYPTO_CTRL_REG, 0); // no interrupts meanwhile
+  crypto_engine_unlock(engine, state);
+
+  while (!last) {
+    while ((crypto_engine_read(engine, CRYPTO_STATUS_REG) &
+            (1 << CRYPTO_STATUS_REG_BIT_3)) == 0)
+      ;
+    last = crypto_engine_write_block(engine, &job, CRYPTO_POLLED, 0);
+  }
+  while ((crypto_engine_read(engine, CRYPTO_STATUS_REG) &
+          (1 << CRYPTO_STATUS_REG_BIT_1)) == 0)
+    ;
+
+  final_hash[4] = crypto_engine_read(engine, CRYPTO_DATA_REG_0);
+  final_hash[3] = crypto_engine_read(engine, CRYPTO_DATA_REG_1);
+  final_hash[2] = crypto_engine_read(engine, CRYPTO_DATA_REG_2);
+  final_hash[1] = crypto_engine_read(engine, CRYPTO_DATA_REG_3);
+  final_hash[0] = crypto_engine_read(engine, CRYPTO_DATA_REG_4);
+  crypto_engine_write(engine, CRYPTO_STATUS_REG,
+                      (1 << CRYPTO_STATUS_REG_BIT_1)); // acknowledge
+
+  state = crypto_engine_lock(engine);
+  engine->exclusive = 0;
+  crypto_engine_write(engine, CRYPTO_CTRL_REG, (1 << CRYPTO_CTRL_REG_BIT_1));
+  crypto_engine_kick(engine);
+  crypto_engine_unlock(engine, state);
+  return 0;
+}
+/**
+ * Samples the performance counters: all four are copied at the same cycle,
+ * then read back. Clearing them in the same write starts the next interval
+ * without losing a cycle.
+ * @param[in]  engine Driver state
+ * @param[out] perf   Counters since they were last cleared
+ * @param[in]  clear  1 to clear the counters, 0 to keep them running
+ * @return void
+ */
+void crypto_engine_perf_sample(crypto_engine *engine, crypto_engine_perf *perf,
+                               int clear) {
+  crypto_engine_write(engine, CRYPTO_PERF_REG,
+                      (1u << CRYPTO_PERF_REG_BIT_30) |
+                          ((clear) ? (1u << CRYPTO_PERF_REG_BIT_31) : (0)) |
+                          CRYPTO_PERF_BUSY);
+  perf->busy = crypto_engine_read(engine, CRYPTO_PERF_REG);
+  crypto_engine_write(engine, CRYPTO_PERF_REG, CRYPTO_PERF_IDLE);
+  perf->idle = crypto_engine_read(engine, CRYPTO_PERF_REG);
+  crypto_engine_write(engine, CRYPTO_PERF_REG, CRYPTO_PERF_BLOCKS);
+  perf->blocks = crypto_engine_read(engine, CRYPTO_PERF_REG);
+  crypto_engine_write(engine, CRYPTO_PERF_REG, CRYPTO_PERF_STALL);
+  perf->stall = crypto_engine_read(engine, CRYPTO_PERF_REG);
+}
@@ -0,0 +1,203 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_engine.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interrupt driven driver of the Avalon SHA-1 accelerator.
+* 		            Jobs are submitted to a queue and get a handle; the
+* 		            interrupt handler starts queued jobs while a core is
+* 		            free, feeds the running ones block by block in turn and
+* 		            posts finished ones to a completion queue, so the CPU
+* 		            is free while the accelerator runs. With DMA enabled
+* 		            the accelerator reads word aligned messages from
+* 		            memory itself and writes the digest back; the CPU only
+* 		            writes a descriptor. The digest goes to a buffer of
+* 		            its own cache line that the CPU never writes, so no
+* 		            write back of a dirty line can overwrite it.
+*
+* Register map    : 0 Control    bit0 block valid (cleared by HW once the
+* 		                         block registers are taken)
+* 		                         bit1 completion interrupt enable
+* 		                         bit2 first block, bit3 last block
+* 		                         [10:4] message bytes in the last block
+* 		                         bit11 interrupt while blocks are free
+* 		                         bit12 DMA the message of regs 9..11
+* 		                         (cleared by HW once the digest is written)
+* 		                         [31:16] job tag
+* 		            1 Status     bit0 done, bit1 completion queued (write 1
+* 		                         to remove the oldest), bit2 busy,
+* 		                         bit3 block free, bit4 DMA running,
+* 		                         [16+n] core n holds a message
+* 		            2..6 Data    digest of the oldest completion,
+* 		                         reg 2 = H4 ... reg 6 = H0
+* 		            7 Perf       write [1:0] counter to read back,
+* 		                         bit30 snapshot, bit31 clear; read the
+* 		                         selected counter of the snapshot
+* 		            8 Completion [15:0] tag of the oldest completion
+* 		                         [31:16] number of finished jobs
+* 		            9 Source     DMA: word aligned message address
+* 		            10 Length    DMA: message bytes
+* 		            11 Result    DMA: address of H0..H4 (uint32_t[5])
+* 		            12 Config    [7:0] cores, [15:8] rounds per cycle
+* 		            16..31 Block message bytes 0..63, big-endian words;
+* 		                         the HW pads the last block itself
+*
+* Hosted build    : With CRYPTO_ENGINE_HOSTED defined the registers are
+* 		            reached through a crypto_engine_bus instead of a raw
+* 		            pointer, e.g. the register model in
+* 		            crypto_engine_model.h, so the driver runs on Linux.
+* 		            The bus also maps buffers to the addresses the DMA
+* 		            uses.
+****************************************************************************/
+
+#ifndef CRYPTO_ENGINE_HPP
+#define CRYPTO_ENGINE_HPP
+
+#include "sha-1.h"
+
+#define CRYPTO_CTRL_REG (0)   /**< @brief Represents the control register */
+#define CRYPTO_STATUS_REG (1) /**< @brief Represents the status register */
+#define CRYPTO_DATA_REG_0 (2) /**< @brief Represents data register 0 (H4) */
+#define CRYPTO_DATA_REG_1 (3) /**< @brief Represents data register 1 (H3) */
+#define CRYPTO_DATA_REG_2 (4) /**< @brief Represents data register 2 (H2) */
+#define CRYPTO_DATA_REG_3 (5) /**< @brief Represents data register 3 (H1) */
+#define CRYPTO_DATA_REG_4 (6) /**< @brief Represents data register 4 (H0) */
+#define CRYPTO_PERF_REG                                                        \
+  (7) /**< @brief Represents the performance counter register */
+#define CRYPTO_COMPLETION_REG                                                  \
+  (8) /**< @brief Represents the completion register */
+#define CRYPTO_DMA_REG_SOURCE                                                  \
+  (9) /**< @brief Represents the DMA source address register */
+#define CRYPTO_DMA_REG_LENGTH                                                  \
+  (10) /**< @brief Represents the DMA length register */
+#define CRYPTO_DMA_REG_RESULT                                                  \
+  (11) /**< @brief Represents the DMA result address register */
+#define CRYPTO_CONFIG_REG                                                      \
+  (12) /**< @brief Represents the configuration register */
+#define CRYPTO_BLOCK_REG_0                                                     \
+  (16) /**< @brief Represents the first of 16 block registers */
+
+#define CRYPTO_CTRL_REG_BIT_0                                                  \
+  (0) /**< @brief Represents that the block registers hold a block */
+#define CRYPTO_CTRL_REG_BIT_1                                                  \
+  (1) /**< @brief Represents the completion interrupt enable bit */
+#define CRYPTO_CTRL_REG_BIT_2                                                  \
+  (2) /**< @brief Represents the first block of a message */
+#define CRYPTO_CTRL_REG_BIT_3                                                  \
+  (3) /**< @brief Represents the last block of a message */
+#define CRYPTO_CTRL_REG_BIT_11                                                 \
+  (11) /**< @brief Represents the block-free interrupt enable bit */
+#define CRYPTO_CTRL_REG_BIT_12                                                 \
+  (12) /**< @brief Represents the DMA start bit */
+#define CRYPTO_CTRL_BYTES_SHIFT                                                \
+  (4) /**< @brief Represents the position of the last block's byte count */
+#define CRYPTO_CTRL_TAG_SHIFT                                                  \
+  (16) /**< @brief Represents the position of the job tag */
+#define CRYPTO_STATUS_REG_BIT_0                                                \
+  (0) /**< @brief Represents that output is ready from the HW */
+#define CRYPTO_STATUS_REG_BIT_1                                                \
+  (1) /**< @brief Represents a pending completion interrupt */
+#define CRYPTO_STATUS_REG_BIT_2                                                \
+  (2) /**< @brief Represents that a message is in progress */
+#define CRYPTO_STATUS_REG_BIT_3                                                \
+  (3) /**< @brief Represents that the block registers can be written */
+#define CRYPTO_STATUS_REG_BIT_4                                                \
+  (4) /**< @brief Represents that the DMA is running */
+#define CRYPTO_STATUS_CORE_SHIFT                                               \
+  (16) /**< @brief Represents the position of the per core busy bits */
+#define CRYPTO_PERF_REG_BIT_30                                                 \
+  (30) /**< @brief Represents the counter snapshot bit */
+#define CRYPTO_PERF_REG_BIT_31                                                 \
+  (31) /**< @brief Represents the counter clear bit */
+#define CRYPTO_CONFIG_CORES_MASK                                               \
+  (0xFF) /**< @brief Represents the core count in the configuration reg */
+
+#define CRYPTO_ENGINE_QUEUE_DEPTH                                              \
+  (16) /**< @brief Represents the number of jobs that can be outstanding */
+#define CRYPTO_ENGINE_CACHE_LINE                                               \
+  (32) /**< @brief Represents the largest Nios II data cache line [bytes] */
+
+typedef int crypto_engine_handle; /**< @brief Identifies a submitted job */
+
+/**
+ * Performance counters of the accelerator, in accelerator clock cycles
+ */
+typedef struct crypto_engine_perf {
+  uint32_t busy;   /**< @brief Cycles with a message in progress */
+  uint32_t idle;   /**< @brief Cycles without */
+  uint32_t blocks; /**< @brief Blocks hashed, padding blocks included */
+  uint32_t stall;  /**< @brief Cycles a block or digest had to wait */
+} crypto_engine_perf;
+
+#ifdef CRYPTO_ENGINE_HOSTED
+/**
+ * Register access of a hosted accelerator (model or RTL simulation)
+ */
+typedef struct crypto_engine_bus {
+  uint32_t (*read)(void *context, uint32_t reg); /**< @brief Loads a reg */
+  void (*write)(void *context, uint32_t reg,
+                uint32_t value);            /**< @brief Stores a reg */
+  int (*irq_mask)(void *context, int mask); /**< @brief Returns old mask */
+  uint32_t (*dma_address)(void *context,
+                          const void *pointer); /**< @brief Bus address */
+  void *context; /**< @brief Passed to the above */
+} crypto_engine_bus;
+#endif
+
+/**
+ * One job slot; the handle of a job is the index of its slot
+ */
+typedef struct crypto_engine_job {
+  const uint8_t *data;                  /**< @brief Message, kept until done */
+  size_t length;                        /**< @brief Number of bytes in data */
+  size_t offset;                        /**< @brief Bytes handed to the HW */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Digest once complete */
+  int state;                            /**< @brief Free/queued/running/done */
+  int dma;                              /**< @brief Read by the DMA */
+} crypto_engine_job;
+
+/**
+ * Driver state of one accelerator
+ */
+typedef struct crypto_engine {
+#ifdef CRYPTO_ENGINE_HOSTED
+  const crypto_engine_bus *bus; /**< @brief Register access */
+#else
+  volatile uint32_t *base; /**< @brief Register base address */
+#endif
+  crypto_engine_job job[CRYPTO_ENGINE_QUEUE_DEPTH]; /**< @brief Job slots */
+  uint32_t dma_result[CRYPTO_ENGINE_QUEUE_DEPTH]
+                     [CRYPTO_ENGINE_CACHE_LINE / sizeof(uint32_t)]
+      __attribute__((aligned(CRYPTO_ENGINE_CACHE_LINE))); /**< @brief H0..H4
+                                written by the DMA, a cache line per slot */
+
+  uint8_t submitted[CRYPTO_ENGINE_QUEUE_DEPTH]; /**< @brief Handles to start */
+  uint8_t completed[CRYPTO_ENGINE_QUEUE_DEPTH]; /**< @brief Handles finished */
+  uint32_t submit_head;   /**< @brief Next entry to start */
+  uint32_t submit_tail;   /**< @brief Next free submit entry */
+  uint32_t complete_head; /**< @brief Next entry to hand out */
+  uint32_t complete_tail; /**< @brief Next free completion entry */
+  int cores;              /**< @brief Messages the HW hashes at once */
+  int active;             /**< @brief Jobs started and not yet finished */
+  int cursor;             /**< @brief Job slot fed last */
+  int exclusive;          /**< @brief A DMA or polled job owns the HW */
+  int dma;                /**< @brief Aligned jobs are read by the DMA */
+} crypto_engine;
+
+#ifdef CRYPTO_ENGINE_HOSTED
+void crypto_engine_init(crypto_engine *engine, const crypto_engine_bus *bus);
+#else
+void crypto_engine_init(crypto_engine *engine, volatile uint32_t *base);
+#endif
+crypto_engine_handle crypto_engine_submit(crypto_engine *engine,
+                                          const void *data, size_t length);
+crypto_engine_handle crypto_engine_next_completion(crypto_engine *engine,
+                                                   uint32_t final_hash[]);
+int crypto_engine_outstanding(crypto_engine *engine);
+void crypto_engine_set_dma(crypto_engine *engine, int enable);
+void crypto_engine_isr(void *context);
+int crypto_engine_hash(crypto_engine *engine, const void *data, size_t length,
+                       uint32_t final_hash[]);
+void crypto_engine_perf_sample(crypto_engine *engine, crypto_engine_perf *perf,
+                               int clear);
+
+#endif /* CRYPTO_ENGINE_HPP */
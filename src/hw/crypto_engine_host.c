@@ -0,0 +1,236 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_engine_host.c
+* Author          : Jishnu Murali Thampan
+* Description     : Runs the interrupt driven accelerator flow of
+* 		              hello_world_small.c on Linux against the register
+* 		              model: keeps the job queue full of messages of random
+* 		              length, does other work while they are hashed and
+* 		              checks every digest against the software SHA-1. The
+* 		              messages go through the block registers, then through
+* 		              the DMA, then through the polled path; the bytes per
+* 		              cycle of each are reported, with the accelerator's
+* 		              performance counters. Last, batches of short
+* 		              messages show how the throughput scales with the
+* 		              number of cores.
+*
+* Build           : gcc -DCRYPTO_ENGINE_HOSTED -I../sw crypto_engine_host.c
+* 		              crypto_engine.c crypto_engine_model.c ../sw/sha-1.c
+* 		              ../sw/sha-1-x86.c
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "crypto_engine_model.h"
+
+#define HOST_JOBS (256) /**< @brief Represents the jobs run by default */
+#define HOST_MAX_LENGTH                                                        \
+  (1024) /**< @brief Represents the longest message submitted */
+#define HOST_WORK_CYCLES                                                       \
+  (10) /**< @brief Represents one slice of the CPU's other work */
+#define HOST_SHORT_LENGTH                                                      \
+  (32) /**< @brief Represents the length of the short messages */
+#define HOST_SCALING_BLOCK_CYCLES                                              \
+  (80) /**< @brief Represents the core of the scaling run: one round per \
+            cycle, the smallest one to replicate */
+
+/**
+ * Checks if the computed hash matches with the expected hash
+ * @param[in] expectedHash Expected digest
+ * @param[in] actualHash   Digest read back from the accelerator
+ * @return 1 if they match, 0 otherwise
+ */
+static int isMatched(const uint32_t *expectedHash,
+                     const uint32_t *actualHash) {
+  int count = 0;
+  for (; count < FINAL_HASH_SIZE; count++) {
+    if (actualHash[count] != expectedHash[count]) {
+      break;
+    }
+  }
+  return (count == FINAL_HASH_SIZE) ? (1) : (0);
+}
+
+/**
+ * Number of blocks the hardware compresses for a message
+ * @param[in] length Message length in bytes
+ * @return Blocks, padding included
+ */
+static uint64_t blocks_of(size_t length) { return (length + 8) / 64 + 1; }
+
+/**
+ * Samples and clears the performance counters and prints them
+ * @param[in,out] engine Driver state
+ * @param[in]     blocks Blocks the messages since the last sample take
+ * @return 1 if the block counter disagrees, 0 otherwise
+ */
+static int report_perf(crypto_engine *engine, uint64_t blocks) {
+  crypto_engine_perf perf;
+
+  crypto_engine_perf_sample(engine, &perf, 1);
+  printf("           counters: busy=%u idle=%u blocks=%u stall=%u, busy "
+         "cycles per block=%.1f\n",
+         perf.busy, perf.idle, perf.blocks, perf.stall,
+         (perf.blocks > 0) ? ((double)perf.busy / perf.blocks) : (0.0));
+  if (perf.blocks != blocks) {
+    printf("ERR: %u blocks counted, %llu expected\n", perf.blocks,
+           (unsigned long long)blocks);
+    return 1;
+  }
+  return 0;
+}
+/**
+ * Runs all messages through the job queue, keeping it full and doing other
+ * work while they are hashed
+ * @param[in,out] model   Model
+ * @param[in,out] engine  Driver state
+ * @param[in]     message Messages, HOST_MAX_LENGTH bytes apart
+ * @param[in]     length  Their lengths
+ * @param[in]     jobs    Number of messages
+ * @param[out]    work    Cycles the CPU was free for
+ * @return Number of mismatching digests
+ */
+static int run_queue(crypto_engine_model *model, crypto_engine *engine,
+                     uint8_t (*message)[HOST_MAX_LENGTH], const size_t *length,
+                     int jobs, uint64_t *work) {
+  int job_of[CRYPTO_ENGINE_QUEUE_DEPTH];
+  int submitted = 0, completed = 0, failed = 0;
+
+  *work = 0;
+  while (completed < jobs) {
+    uint32_t expectedHash[FINAL_HASH_SIZE];
+    uint32_t final_hash[FINAL_HASH_SIZE];
+    crypto_engine_handle handle;
+
+    /* Keep the queue full, then get on with other work */
+    while (submitted < jobs &&
+           (handle = crypto_engine_submit(engine, message[submitted],
+                                          length[submitted])) >= 0)
+      job_of[handle] = submitted++;
+    crypto_engine_model_advance(model, HOST_WORK_CYCLES);
+    *work += HOST_WORK_CYCLES;
+
+    while ((handle = crypto_engine_next_completion(engine, final_hash)) >=
+           0) {
+      const int j = job_of[handle];
+      sha1_hash(message[j], length[j], expectedHash);
+      failed += !isMatched(expectedHash, final_hash);
+      completed++;
+    }
+  }
+  return failed;
+}
+
+/**
+ * Hashes the messages truncated to HOST_SHORT_LENGTH bytes on an array of
+ * cores and prints the messages per 1000 cycles
+ * @param[in] message Messages, HOST_MAX_LENGTH bytes apart
+ * @param[in] jobs    Number of messages
+ * @param[in] cores   Cores of the array
+ * @return Number of mismatching digests
+ */
+static int run_short(uint8_t (*message)[HOST_MAX_LENGTH], int jobs,
+                     uint32_t cores) {
+  size_t *length = malloc((size_t)jobs * sizeof(size_t));
+  crypto_engine_model model;
+  crypto_engine engine;
+  uint64_t work;
+  int failed;
+
+  if (length == NULL) {
+    printf("ERR: Out of memory\n");
+    return jobs;
+  }
+  for (int j = 0; j < jobs; j++)
+    length[j] = HOST_SHORT_LENGTH;
+  crypto_engine_model_init(&model, HOST_SCALING_BLOCK_CYCLES, cores);
+  crypto_engine_init(&engine, crypto_engine_model_bus(&model));
+  crypto_engine_model_attach_isr(&model, crypto_engine_isr, &engine);
+
+  failed = run_queue(&model, &engine, message, length, jobs, &work);
+  printf("%2u cores: %.1f messages per 1000 cycles\n", cores,
+         1000.0 * jobs / model.cycle);
+  free(length);
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  const int jobs = (argc > 1) ? (atoi(argv[1])) : (HOST_JOBS);
+  const uint32_t cores = (argc > 2) ? ((uint32_t)atoi(argv[2])) : (1);
+  crypto_engine_model model;
+  crypto_engine engine;
+  crypto_engine_perf perf;
+  uint8_t(*message)[HOST_MAX_LENGTH] = malloc((size_t)jobs * HOST_MAX_LENGTH);
+  size_t *length = malloc((size_t)jobs * sizeof(size_t));
+  uint64_t work, blocks = 0, bytes = 0, start;
+  int failed = 0;
+
+  if (message == NULL || length == NULL) {
+    printf("ERR: Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  srand(1);
+  for (int j = 0; j < jobs; j++) {
+    length[j] = (size_t)rand() % (HOST_MAX_LENGTH + 1);
+    for (size_t i = 0; i < length[j]; i++)
+      message[j][i] = (uint8_t)rand();
+    blocks += blocks_of(length[j]);
+    bytes += length[j];
+  }
+
+  crypto_engine_model_init(&model, 0, cores);
+  crypto_engine_init(&engine, crypto_engine_model_bus(&model));
+  crypto_engine_model_attach_isr(&model, crypto_engine_isr, &engine);
+  printf("Hardware model: %u cores, %d messages, %llu bytes, %llu blocks\n",
+         cores, jobs, (unsigned long long)bytes, (unsigned long long)blocks);
+
+  /* Block registers, fed from the block-free interrupt */
+  crypto_engine_perf_sample(&engine, &perf, 1);
+  start = model.cycle;
+  failed += run_queue(&model, &engine, message, length, jobs, &work);
+  printf("Registers: cycles per block=%.1f, bytes/cycle=%.2f, CPU free for "
+         "%llu of %llu cycles\n",
+         (double)(model.cycle - start) / blocks,
+         (double)bytes / (model.cycle - start), (unsigned long long)work,
+         (unsigned long long)(model.cycle - start));
+  failed += report_perf(&engine, blocks);
+
+  /* DMA: one descriptor per message */
+  crypto_engine_set_dma(&engine, 1);
+  start = model.cycle;
+  failed += run_queue(&model, &engine, message, length, jobs, &work);
+  printf("DMA:       cycles per block=%.1f, bytes/cycle=%.2f, CPU free for "
+         "%llu of %llu cycles\n",
+         (double)(model.cycle - start) / blocks,
+         (double)bytes / (model.cycle - start), (unsigned long long)work,
+         (unsigned long long)(model.cycle - start));
+  failed += report_perf(&engine, blocks);
+  crypto_engine_set_dma(&engine, 0);
+
+  /* Same messages through the polled path */
+  start = model.cycle;
+  for (int j = 0; j < jobs; j++) {
+    uint32_t expectedHash[FINAL_HASH_SIZE];
+    uint32_t final_hash[FINAL_HASH_SIZE];
+
+    sha1_hash(message[j], length[j], expectedHash);
+    if (crypto_engine_hash(&engine, message[j], length[j], final_hash) < 0 ||
+        !isMatched(expectedHash, final_hash))
+      failed++;
+  }
+  printf("Polled:    cycles per block=%.1f, bytes/cycle=%.2f\n",
+         (double)(model.cycle - start) / blocks,
+         (double)bytes / (model.cycle - start));
+  failed += report_perf(&engine, blocks);
+
+  /* Independent short messages on 1..N cores */
+  printf("%d byte messages, %d cycles per block:\n", HOST_SHORT_LENGTH,
+         HOST_SCALING_BLOCK_CYCLES);
+  for (uint32_t n = 1; n <= CRYPTO_MODEL_MAX_CORES; n *= 2)
+    failed += run_short(message, jobs, n);
+  printf("%d mismatches\n", failed);
+
+  free(message);
+  free(length);
+  return (failed == 0) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
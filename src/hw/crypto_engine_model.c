@@ -0,0 +1,513 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_engine_model.c
+* Author          : Jishnu Murali Thampan
+* Description     : Software model of the avalon_sha_wrapper register map.
+* 		              The clock advances with every register access and
+* 		              with crypto_engine_model_advance(). A block handed
+* 		              over goes to the core of its message, or to a free
+* 		              one if it starts a message; it is taken when that
+* 		              core's staging register is free and compressed once
+* 		              the core is, like in the RTL. Digests come from the
+* 		              software SHA-1 and are queued until the CPU removes
+* 		              them. A DMA descriptor is scheduled in one go: each
+* 		              block is burst read once the one before has been
+* 		              taken, and the digest is written back before it is
+* 		              queued. The performance counters add up the time
+* 		              between events; blocks count when they are scheduled
+* 		              and blocks of the DMA never stall.
+****************************************************************************/
+
+#include "crypto_engine_model.h"
+
+#define MODEL_BYTES_MASK                                                       \
+  (0x7F) /**< @brief Represents the byte count field of the control reg */
+#define MODEL_TAG_MASK (0xFFFF) /**< @brief Represents the job tag field */
+#define MODEL_PERF_BUSY (0)     /**< @brief Represents the busy counter */
+#define MODEL_PERF_IDLE (1)     /**< @brief Represents the idle counter */
+#define MODEL_PERF_BLOCKS (2)   /**< @brief Represents the block counter */
+#define MODEL_PERF_STALL (3)    /**< @brief Represents the stall counter */
+#define MODEL_PERF_SELECT_MASK                                                 \
+  (3) /**< @brief Represents the counter select field of the perf reg */
+#define MODEL_MAX_IRQ_CALLS                                                    \
+  (16) /**< @brief Represents the handler calls per event before the line is \
+            treated as stuck */
+
+static void model_run_until(crypto_engine_model *model, uint64_t target);
+
+/**
+ * Returns the larger of two cycles
+ * @param[in] a Cycle
+ * @param[in] b Cycle
+ * @return Later cycle
+ */
+static uint64_t model_max(uint64_t a, uint64_t b) {
+  return (a > b) ? (a) : (b);
+}
+/**
+ * Returns the level of the interrupt line
+ * @param[in] model Model
+ * @return 1 if raised
+ */
+static int model_irq_line(const crypto_engine_model *model) {
+  return (model->queue_count > 0 &&
+          (model->control & (1 << CRYPTO_CTRL_REG_BIT_1))) ||
+         ((model->control & (1 << CRYPTO_CTRL_REG_BIT_0)) == 0 &&
+          (model->control & (1 << CRYPTO_CTRL_REG_BIT_11)));
+}
+/**
+ * Calls the interrupt handler while the (level) interrupt line is high and
+ * the CPU has it unmasked. The handler runs masked, like on the Nios, and
+ * is entered isr_cycles after the call.
+ * @param[in,out] model Model
+ * @return void
+ */
+static void model_deliver_irq(crypto_engine_model *model) {
+  for (int i = 0; i < MODEL_MAX_IRQ_CALLS; i++) {
+    if (model->isr == NULL || model->irq_masked || !model_irq_line(model))
+      return;
+    model->irq_masked = 1;
+    model_run_until(model, model->cycle + model->isr_cycles); /* Entry */
+    model->isr(model->isr_context);
+    model->irq_masked = 0;
+  }
+}
+/**
+ * Moves the clock forward, counting the cycles in between as busy or idle,
+ * and as stalled while a block waits for a core or a digest for room in the
+ * completion queue
+ * @param[in,out] model Model
+ * @param[in]     cycle New cycle, not before the current one
+ * @return void
+ */
+static void model_clock(crypto_engine_model *model, uint64_t cycle) {
+  uint64_t wait = cycle; /* First cycle something waits from */
+  int busy = (model->control & ((1 << CRYPTO_CTRL_REG_BIT_0) |
+                                (1 << CRYPTO_CTRL_REG_BIT_12))) != 0;
+
+  if (cycle <= model->cycle)
+    return;
+  for (uint32_t c = 0; c < model->cores; c++) {
+    const crypto_engine_model_core *core = &model->core[c];
+    busy |= core->owned;
+    if (core->complete_pending && model->queue_count == model->cores + 1 &&
+        core->complete_at < wait)
+      wait = core->complete_at;
+  }
+  if ((model->control & (1 << CRYPTO_CTRL_REG_BIT_0)) &&
+      (model->control & (1 << CRYPTO_CTRL_REG_BIT_12)) == 0 &&
+      model->block_ready + 1 < wait) // past the cycle it could be taken in
+    wait = model->block_ready + 1;
+  wait = model_max(wait, model->cycle);
+
+  model->perf[MODEL_PERF_STALL] += (uint32_t)(cycle - wait);
+  model->perf[(busy) ? (MODEL_PERF_BUSY) : (MODEL_PERF_IDLE)] +=
+      (uint32_t)(cycle - model->cycle);
+  model->cycle = cycle;
+}
+/**
+ * Returns the core a block goes to: a free one, round-robin, if it starts a
+ * message, otherwise the one holding the message with its tag
+ * @param[in] model Model
+ * @param[in] first The block starts a message
+ * @param[in] tag   Job tag of the block
+ * @return Core or -1 if the block has to wait
+ */
+static int model_route(const crypto_engine_model *model, int first,
+                       uint32_t tag) {
+  for (uint32_t k = 0; k < model->cores; k++) {
+    uint32_t c = (model->next_core + k) % model->cores;
+    if ((first) ? (!model->core[c].owned)
+                : (model->core[c].owned && model->core[c].tag == tag))
+      return (int)c;
+  }
+  return -1;
+}
+/**
+ * Schedules a block offered to a core: it is taken once the staging
+ * register is free and compressed once the core is
+ * @param[in,out] core  Core
+ * @param[in]     ready Cycle the block is offered
+ * @param[in]     block_cycles Core cycles per block
+ * @param[out]    load  Cycle the core starts on it
+ * @return Cycle the block is taken
+ */
+static uint64_t model_schedule(crypto_engine_model_core *core, uint64_t ready,
+                               uint32_t block_cycles, uint64_t *load) {
+  uint64_t take = model_max(ready, core->stage_free);
+  *load = model_max(take + 1, core->core_free);
+  core->stage_free = *load;
+  core->core_free = *load + block_cycles;
+  return take;
+}
+/**
+ * Schedules the block of its own the length goes into when it does not fit
+ * into the last one
+ * @param[in,out] core         Core
+ * @param[in]     block_cycles Core cycles per block
+ * @return Cycle the core starts on it
+ */
+static uint64_t model_schedule_pad(crypto_engine_model_core *core,
+                                   uint32_t block_cycles) {
+  uint64_t load = core->core_free;
+  core->stage_free = load;
+  core->core_free = load + block_cycles;
+  return load;
+}
+/**
+ * Makes a core the owner of a new message
+ * @param[in,out] model Model
+ * @param[in]     c     Core
+ * @return Core
+ */
+static crypto_engine_model_core *model_claim(crypto_engine_model *model,
+                                             int c) {
+  crypto_engine_model_core *core = &model->core[c];
+
+  core->owned = 1;
+  core->tag = model->control >> CRYPTO_CTRL_TAG_SHIFT;
+  core->dma = 0;
+  model->next_core = (uint32_t)(c + 1) % model->cores;
+  model->done = 0;
+  return core;
+}
+/**
+ * A core takes the block in the block registers: hashes its bytes and works
+ * out when its message completes if it is the last one
+ * @param[in,out] model Model
+ * @param[in]     c     Core
+ * @param[in]     take  Cycle the block is taken
+ * @return void
+ */
+static void model_take(crypto_engine_model *model, int c, uint64_t take) {
+  const uint32_t control = model->control;
+  const int last = (control & (1 << CRYPTO_CTRL_REG_BIT_3)) != 0;
+  const uint32_t bytes =
+      (last) ? ((control >> CRYPTO_CTRL_BYTES_SHIFT) & MODEL_BYTES_MASK)
+             : (MESSAGE_SIZE);
+  crypto_engine_model_core *core = &model->core[c];
+  uint8_t message[MESSAGE_SIZE];
+  uint64_t load;
+
+  model_schedule(core, take, model->block_cycles, &load);
+  model->control &= ~(uint32_t)(1 << CRYPTO_CTRL_REG_BIT_0);
+  model->perf[MODEL_PERF_BLOCKS]++;
+
+  if (control & (1 << CRYPTO_CTRL_REG_BIT_2)) {
+    model_claim(model, c);
+    sha1_init(&core->message);
+  }
+  for (uint32_t i = 0; i < bytes && i < MESSAGE_SIZE; i++) {
+    message[i] = (uint8_t)(model->block[i / 4] >> (24 - 8 * (i % 4)));
+  }
+  sha1_update(&core->message, message, bytes);
+  if (!last)
+    return;
+
+  if (bytes > 55) {
+    load = model_schedule_pad(core, model->block_cycles);
+    model->perf[MODEL_PERF_BLOCKS]++;
+  }
+  sha1_final(&core->message, core->final_hash);
+  core->complete_at = load + model->block_cycles + 2;
+  core->complete_pending = 1;
+}
+/**
+ * Returns the host buffer behind a bus address
+ * @param[in] model   Model
+ * @param[in] address Bus address handed out by model_dma_address()
+ * @return Host pointer
+ */
+static const uint8_t *model_host(const crypto_engine_model *model,
+                                 uint32_t address) {
+  return model->window[(address >> CRYPTO_MODEL_WINDOW_SHIFT) %
+                       CRYPTO_MODEL_WINDOWS] +
+         (address & ((1u << CRYPTO_MODEL_WINDOW_SHIFT) - 1));
+}
+/**
+ * Starts the DMA on the descriptor in registers 9..11: the message is read
+ * and hashed now, the completion is scheduled for when the bursts, the
+ * compression and the write back of the digest would be done
+ * @param[in,out] model Model
+ * @return void
+ */
+static void model_start_dma(crypto_engine_model *model) {
+  const uint8_t *source = model_host(model, model->dma[0]);
+  int c = model_route(model, 1, 0);
+  crypto_engine_model_core *core =
+      model_claim(model, (c >= 0) ? (c) : ((int)model->next_core));
+  uint32_t remaining = model->dma[1];
+  uint64_t ready = model->cycle + 1, load = 0;
+  uint32_t bytes;
+
+  sha1_hash(source, remaining, core->final_hash);
+  model->dma_result = (uint32_t *)model_host(model, model->dma[2]);
+  do {
+    bytes = (remaining > MESSAGE_SIZE) ? (MESSAGE_SIZE) : (remaining);
+    if (bytes > 0) /* One burst of the words holding message bytes */
+      ready += CRYPTO_MODEL_MEMORY_LATENCY + (bytes + 3) / 4;
+    ready = model_schedule(core, ready, model->block_cycles, &load) + 1;
+    model->perf[MODEL_PERF_BLOCKS]++;
+    remaining -= bytes;
+  } while (remaining > 0);
+  if (bytes > 55) {
+    load = model_schedule_pad(core, model->block_cycles);
+    model->perf[MODEL_PERF_BLOCKS]++;
+  }
+
+  core->dma = 1;
+  core->complete_at = load + model->block_cycles + 2 +
+                      FINAL_HASH_SIZE * CRYPTO_MODEL_MEMORY_WRITE_CYCLES;
+  core->complete_pending = 1;
+}
+/**
+ * Queues the digest of a finished message, as the wrapper does when the
+ * array hands it out; a DMA digest is written back first
+ * @param[in,out] model Model
+ * @param[in]     c     Core
+ * @return void
+ */
+static void model_complete(crypto_engine_model *model, int c) {
+  crypto_engine_model_core *core = &model->core[c];
+  uint32_t tail = (model->queue_head + model->queue_count) % (model->cores + 1);
+
+  if (core->dma) {
+    for (int i = 0; i < FINAL_HASH_SIZE; i++) {
+      model->dma_result[i] = core->final_hash[i];
+    }
+    model->control &= ~(uint32_t)(1 << CRYPTO_CTRL_REG_BIT_12);
+  }
+  model->queue_tag[tail] = core->tag;
+  for (int i = 0; i < FINAL_HASH_SIZE; i++) {
+    model->queue_hash[tail][i] = core->final_hash[i];
+  }
+  model->queue_count++;
+  model->completed++;
+  core->complete_pending = 0;
+  core->owned = 0;
+  model->done = 1;
+}
+/**
+ * Runs the clock up to a cycle, applying the events due on the way: blocks
+ * taken by their core and digests queued
+ * @param[in,out] model  Model
+ * @param[in]     target Cycle to run to
+ * @return void
+ */
+static void model_run_until(crypto_engine_model *model, uint64_t target) {
+  for (;;) {
+    uint64_t next = UINT64_MAX;
+    int take = -1, complete = -1;
+
+    if (model->control & (1 << CRYPTO_CTRL_REG_BIT_0)) {
+      int c = model_route(model, (model->control >> CRYPTO_CTRL_REG_BIT_2) & 1,
+                          model->control >> CRYPTO_CTRL_TAG_SHIFT);
+      if (c >= 0) { /* GO is cleared the cycle after the take */
+        next = model_max(model->block_ready, model->core[c].stage_free) + 1;
+        take = c;
+      }
+    }
+    if (model->queue_count < model->cores + 1) {
+      for (uint32_t c = 0; c < model->cores; c++) {
+        if (model->core[c].complete_pending &&
+            model->core[c].complete_at < next) {
+          next = model->core[c].complete_at;
+          complete = (int)c;
+          take = -1;
+        }
+      }
+    }
+    if (next > target || (take < 0 && complete < 0))
+      break;
+
+    next = model_max(next, model->cycle);
+    model_clock(model, next);
+    if (take >= 0)
+      model_take(model, take, next - 1);
+    else
+      model_complete(model, complete);
+    model_deliver_irq(model);
+  }
+  model_clock(model, target);
+}
+/**
+ * Bus read of a register
+ * @param[in] context Model
+ * @param[in] reg     Register address
+ * @return Register value
+ */
+static uint32_t model_read(void *context, uint32_t reg) {
+  crypto_engine_model *model = (crypto_engine_model *)context;
+  const uint32_t *head = model->queue_hash[model->queue_head];
+  uint32_t status, owned = 0;
+
+  model_run_until(model, model->cycle + CRYPTO_MODEL_BUS_CYCLES);
+  if (reg >= CRYPTO_BLOCK_REG_0 && reg < CRYPTO_BLOCK_REG_0 + 16)
+    return model->block[reg - CRYPTO_BLOCK_REG_0];
+  switch (reg) {
+  case CRYPTO_CTRL_REG:
+    return model->control;
+  case CRYPTO_STATUS_REG:
+    for (uint32_t c = 0; c < model->cores; c++) {
+      owned |= (uint32_t)model->core[c].owned << c;
+    }
+    status = (owned << CRYPTO_STATUS_CORE_SHIFT) |
+             (model->control & (1 << CRYPTO_CTRL_REG_BIT_12)
+                  ? (1u << CRYPTO_STATUS_REG_BIT_4)
+                  : (0));
+    if ((model->control & (1 << CRYPTO_CTRL_REG_BIT_0)) == 0)
+      status |= (1 << CRYPTO_STATUS_REG_BIT_3);
+    if (owned || (model->control & ((1 << CRYPTO_CTRL_REG_BIT_0) |
+                                    (1 << CRYPTO_CTRL_REG_BIT_12))))
+      status |= (1 << CRYPTO_STATUS_REG_BIT_2);
+    else if (model->done)
+      status |= (1 << CRYPTO_STATUS_REG_BIT_0);
+    if (model->queue_count > 0)
+      status |= (1 << CRYPTO_STATUS_REG_BIT_1);
+    return status;
+  case CRYPTO_DATA_REG_0:
+  case CRYPTO_DATA_REG_1:
+  case CRYPTO_DATA_REG_2:
+  case CRYPTO_DATA_REG_3:
+  case CRYPTO_DATA_REG_4:
+    return head[FINAL_HASH_SIZE - 1 - (reg - CRYPTO_DATA_REG_0)];
+  case CRYPTO_PERF_REG:
+    return model->snapshot[model->perf_select];
+  case CRYPTO_COMPLETION_REG:
+    return (model->completed << 16) |
+           (model->queue_tag[model->queue_head] & MODEL_TAG_MASK);
+  case CRYPTO_DMA_REG_SOURCE:
+  case CRYPTO_DMA_REG_LENGTH:
+  case CRYPTO_DMA_REG_RESULT:
+    return model->dma[reg - CRYPTO_DMA_REG_SOURCE];
+  case CRYPTO_CONFIG_REG:
+    return model->cores | ((80 / model->block_cycles) << 8);
+  default:
+    return 0;
+  }
+}
+/**
+ * Bus write of a register
+ * @param[in] context Model
+ * @param[in] reg     Register address
+ * @param[in] value   Value to be written
+ * @return void
+ */
+static void model_write(void *context, uint32_t reg, uint32_t value) {
+  crypto_engine_model *model = (crypto_engine_model *)context;
+
+  model_run_until(model, model->cycle + CRYPTO_MODEL_BUS_CYCLES);
+  if (reg >= CRYPTO_BLOCK_REG_0 && reg < CRYPTO_BLOCK_REG_0 + 16) {
+    model->block[reg - CRYPTO_BLOCK_REG_0] = value;
+  } else if (reg >= CRYPTO_DMA_REG_SOURCE && reg <= CRYPTO_DMA_REG_RESULT) {
+    model->dma[reg - CRYPTO_DMA_REG_SOURCE] = value;
+  } else if (reg == CRYPTO_CTRL_REG) {
+    int dma = (model->control & (1 << CRYPTO_CTRL_REG_BIT_12)) == 0 &&
+              (value & (1 << CRYPTO_CTRL_REG_BIT_12)) != 0;
+    model->control = value;
+    model->block_ready = model->cycle + 1;
+    if (dma)
+      model_start_dma(model);
+  } else if (reg == CRYPTO_PERF_REG) {
+    model->perf_select = value & MODEL_PERF_SELECT_MASK;
+    if (value & (1u << CRYPTO_PERF_REG_BIT_30)) {
+      for (int i = 0; i < CRYPTO_MODEL_PERF_COUNTERS; i++) {
+        model->snapshot[i] = model->perf[i];
+      }
+    }
+    if (value & (1u << CRYPTO_PERF_REG_BIT_31)) {
+      for (int i = 0; i < CRYPTO_MODEL_PERF_COUNTERS; i++) {
+        model->perf[i] = 0;
+      }
+    }
+  } else if (reg == CRYPTO_STATUS_REG) {
+    if ((value & (1 << CRYPTO_STATUS_REG_BIT_1)) && model->queue_count > 0) {
+      model->queue_head = (model->queue_head + 1) % (model->cores + 1);
+      model->queue_count--;
+    }
+  }
+  model_run_until(model, model->cycle); /* Events the write made due */
+  model_deliver_irq(model);
+}
+/**
+ * CPU interrupt mask of the model
+ * @param[in] context Model
+ * @param[in] mask    1 to mask the interrupt, 0 to unmask it
+ * @return Previous mask
+ */
+static int model_irq_mask(void *context, int mask) {
+  crypto_engine_model *model = (crypto_engine_model *)context;
+  int previous = model->irq_masked;
+
+  model->irq_masked = mask;
+  model_deliver_irq(model);
+  return previous;
+}
+/**
+ * Maps a host buffer to a bus address the DMA can be given. Each buffer
+ * gets a window of its own, up to CRYPTO_MODEL_WINDOWS of them; the oldest
+ * is reused after that.
+ * @param[in] context Model
+ * @param[in] pointer Host buffer
+ * @return Bus address
+ */
+static uint32_t model_dma_address(void *context, const void *pointer) {
+  crypto_engine_model *model = (crypto_engine_model *)context;
+  uint32_t window = model->next_window++ % CRYPTO_MODEL_WINDOWS;
+
+  model->window[window] = (const uint8_t *)pointer;
+  return window << CRYPTO_MODEL_WINDOW_SHIFT;
+}
+/**
+ * Resets the model
+ * @param[out] model        Model
+ * @param[in]  block_cycles Core cycles per block, 0 for
+ *                          CRYPTO_MODEL_BLOCK_CYCLES
+ * @param[in]  cores        Cores of the array, 1 to CRYPTO_MODEL_MAX_CORES
+ * @return void
+ */
+void crypto_engine_model_init(crypto_engine_model *model,
+                              uint32_t block_cycles, uint32_t cores) {
+  *model = (crypto_engine_model){0};
+  model->block_cycles =
+      (block_cycles > 0) ? (block_cycles) : (CRYPTO_MODEL_BLOCK_CYCLES);
+  model->cores = (cores < 1) ? (1)
+                 : (cores > CRYPTO_MODEL_MAX_CORES) ? (CRYPTO_MODEL_MAX_CORES)
+                                                    : (cores);
+  model->bus.read = model_read;
+  model->bus.write = model_write;
+  model->bus.irq_mask = model_irq_mask;
+  model->bus.dma_address = model_dma_address;
+  model->bus.context = model;
+}
+/**
+ * Returns the register access the driver is initialised with
+ * @param[in] model Model
+ * @return Bus
+ */
+const crypto_engine_bus *crypto_engine_model_bus(crypto_engine_model *model) {
+  return &model->bus;
+}
+/**
+ * Connects the interrupt line to a handler
+ * @param[in,out] model   Model
+ * @param[in]     isr     Interrupt handler
+ * @param[in]     context Passed to the handler
+ * @return void
+ */
+void crypto_engine_model_attach_isr(crypto_engine_model *model,
+                                    void (*isr)(void *context),
+                                    void *context) {
+  model->isr = isr;
+  model->isr_context = context;
+}
+/**
+ * Lets the CPU do other work for a number of cycles; events due in that
+ * time raise their interrupt on the way
+ * @param[in,out] model  Model
+ * @param[in]     cycles Cycles to advance
+ * @return void
+ */
+void crypto_engine_model_advance(crypto_engine_model *model, uint64_t cycles) {
+  model_run_until(model, model->cycle + cycles);
+}
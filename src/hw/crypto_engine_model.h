@@ -0,0 +1,98 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_engine_model.h
+* Author          : Jishnu Murali Thampan
+* Description     : Cycle-approximate software model of the register map of
+* 		            avalon_sha_wrapper.sv, including its interrupt. Lets
+* 		            the driver in crypto_engine.c run on Linux without a
+* 		            board or an RTL simulator. The DMA reads the host
+* 		            buffers the driver hands it, through a table that maps
+* 		            them to 32 bit bus addresses.
+****************************************************************************/
+
+#ifndef CRYPTO_ENGINE_MODEL_HPP
+#define CRYPTO_ENGINE_MODEL_HPP
+
+#include "crypto_engine.h"
+
+#define CRYPTO_MODEL_ROUNDS_PER_CYCLE                                          \
+  (4) /**< @brief Represents the ROUNDS_PER_CYCLE the core is built with */
+#define CRYPTO_MODEL_BLOCK_CYCLES                                              \
+  (80 / CRYPTO_MODEL_ROUNDS_PER_CYCLE) /**< @brief Represents the cycles the \
+                                          core spends on one block */
+#define CRYPTO_MODEL_MAX_CORES                                                 \
+  (16) /**< @brief Represents the largest CORES of the wrapper */
+#define CRYPTO_MODEL_BUS_CYCLES                                                \
+  (2) /**< @brief Represents the cost of one register access */
+#define CRYPTO_MODEL_MEMORY_LATENCY                                            \
+  (6) /**< @brief Represents the cycles from a burst read to its first word */
+#define CRYPTO_MODEL_MEMORY_WRITE_CYCLES                                       \
+  (2) /**< @brief Represents the cost of one DMA write */
+#define CRYPTO_MODEL_WINDOWS                                                   \
+  (64) /**< @brief Represents the host buffers the DMA can reach at a time */
+#define CRYPTO_MODEL_WINDOW_SHIFT                                              \
+  (24) /**< @brief Represents the bus address bits of one window */
+#define CRYPTO_MODEL_PERF_COUNTERS                                             \
+  (4) /**< @brief Represents the counters behind the perf register */
+
+/**
+ * One core of the array with the framework around it
+ */
+typedef struct crypto_engine_model_core {
+  uint64_t stage_free;                  /**< @brief Staging register frees */
+  uint64_t core_free;                   /**< @brief Core takes a block */
+  int owned;                            /**< @brief Holds a message */
+  uint32_t tag;                         /**< @brief Tag of that message */
+  sha1_ctx message;                     /**< @brief Its bytes so far */
+  int complete_pending;                 /**< @brief complete_at is due */
+  uint64_t complete_at;                 /**< @brief Digest is ready */
+  int dma;                              /**< @brief Message of the DMA */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Digest */
+} crypto_engine_model_core;
+
+/**
+ * Model state: the wrapper registers, the cores and the simulated clock
+ */
+typedef struct crypto_engine_model {
+  uint32_t control;      /**< @brief Register 0 */
+  uint32_t dma[3];       /**< @brief Registers 9..11 */
+  uint32_t block[16];    /**< @brief Registers 16..31 */
+  uint32_t completed;    /**< @brief Jobs finished */
+  int irq_masked;        /**< @brief CPU interrupt mask */
+  uint64_t cycle;        /**< @brief Simulated clock */
+  uint32_t block_cycles; /**< @brief Core cycles per block */
+  uint32_t cores;        /**< @brief Cores in the array */
+  uint32_t next_core;    /**< @brief Round-robin start */
+  int done;              /**< @brief A message has finished */
+  uint64_t block_ready;  /**< @brief Block registers written */
+  uint32_t isr_cycles;   /**< @brief Interrupt entry cost, 0 by default */
+
+  uint32_t perf[CRYPTO_MODEL_PERF_COUNTERS];     /**< @brief Busy, idle, ... */
+  uint32_t snapshot[CRYPTO_MODEL_PERF_COUNTERS]; /**< @brief Read back */
+  uint32_t perf_select;                          /**< @brief Counter read */
+
+  crypto_engine_model_core core[CRYPTO_MODEL_MAX_CORES]; /**< @brief Cores */
+
+  uint32_t queue_tag[CRYPTO_MODEL_MAX_CORES + 1]; /**< @brief Completion tags */
+  uint32_t queue_hash[CRYPTO_MODEL_MAX_CORES + 1]
+                     [FINAL_HASH_SIZE]; /**< @brief Completion digests */
+  uint32_t queue_head;                  /**< @brief Oldest completion */
+  uint32_t queue_count;                 /**< @brief Completions queued */
+
+  uint32_t *dma_result;                        /**< @brief DMA destination */
+  const uint8_t *window[CRYPTO_MODEL_WINDOWS]; /**< @brief Bus to host */
+  uint32_t next_window;                        /**< @brief Next to reuse */
+  void (*isr)(void *context);                  /**< @brief Interrupt handler */
+  void *isr_context;                           /**< @brief Passed to isr */
+  crypto_engine_bus bus;                       /**< @brief Register access */
+} crypto_engine_model;
+
+void crypto_engine_model_init(crypto_engine_model *model,
+                              uint32_t block_cycles, uint32_t cores);
+const crypto_engine_bus *crypto_engine_model_bus(crypto_engine_model *model);
+void crypto_engine_model_attach_isr(crypto_engine_model *model,
+                                    void (*isr)(void *context),
+                                    void *context);
+void crypto_engine_model_advance(crypto_engine_model *model, uint64_t cycles);
+
+#endif /* CRYPTO_ENGINE_MODEL_HPP */
@@ -0,0 +1,425 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_engine_verilator.cpp
+* Author          : Jishnu Murali Thampan
+* Description     : Runs the driver of hello_world_small.c on Linux against
+* 		              the RTL of avalon_sha_wrapper.sv, compiled with
+* 		              Verilator. Each register access of the driver becomes
+* 		              an Avalon transfer on the simulated slave, the irq
+* 		              output calls the interrupt handler, and the DMA master
+* 		              reads and writes the host buffers through a memory
+* 		              model with burst latency and wait states.
+* 		              It runs the flow of main() in hello_world_small.c,
+* 		              "abc" through the scheduler and checked against the
+* 		              known digest, then hashes messages around the padding
+* 		              boundaries one at a time, through the polled path and
+* 		              through the DMA. Every digest is checked against the
+* 		              software SHA-1, and the simulated cycles per hash and
+* 		              per block are reported. The exit status is non-zero
+* 		              on a mismatch, or when +cores=N is given and the
+* 		              model reports another number of cores.
+*
+* Build           : The driver is C, Verilator compiles C++, so the C parts
+* 		              are built first:
+* 		              gcc -c -O2 -DCRYPTO_ENGINE_HOSTED -I../sw
+* 		                crypto_engine.c crypto_scheduler.c ../sw/sha-1.c
+* 		                ../sw/sha-1-x86.c
+* 		              then one model per core count, e.g. 1 and 4:
+* 		              for n in 1 4; do
+* 		                verilator --cc --exe --build -j 0 -Wno-fatal
+* 		                  -GCORES=$n
+* 		                  --Mdir obj_cores$n
+* 		                  -CFLAGS "-DCRYPTO_ENGINE_HOSTED -I$PWD/../sw"
+* 		                  -CFLAGS -I$PWD --top-module avalon_sha_wrapper
+* 		                  state_machine_toplevel_framework.sv sha1_core.sv
+* 		                  sha_core_array.sv sha_dma_master.sv
+* 		                  avalon_sha_wrapper.sv
+* 		                  crypto_engine_verilator.cpp
+* 		                  -LDFLAGS "$PWD/crypto_engine.o
+* 		                  $PWD/crypto_scheduler.o $PWD/sha-1.o
+* 		                  $PWD/sha-1-x86.o" &&
+* 		                ./obj_cores$n/Vavalon_sha_wrapper +cores=$n || break
+* 		              done
+* Status          : Not yet built against Verilator or run; no cycles per
+* 		              hash have been recorded for CORES=1 or CORES=4. Only
+* 		              the C++ has been compiled, against stub headers.
+****************************************************************************/
+
+#include "Vavalon_sha_wrapper.h"
+#include "verilated.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "sha-1-constexpr.hpp"
+
+extern "C" {
+#include "crypto_engine.h"
+#include "crypto_scheduler.h"
+}
+
+#define HARNESS_RESET_CYCLES                                                   \
+  (4) /**< @brief Represents the cycles reset_n is held low */
+#define HARNESS_BUS_CYCLES                                                     \
+  (2) /**< @brief Represents one register access of the Nios data master, \
+           the transfer and the cycle after it */
+#define HARNESS_IDLE_CYCLES                                                    \
+  (10) /**< @brief Represents one poll of the completion queue */
+#define HARNESS_READ_LATENCY                                                   \
+  (6) /**< @brief Represents the cycles from a burst read to its first word */
+#define HARNESS_WAIT_STATES                                                    \
+  (1) /**< @brief Represents the waitrequest cycles of each command */
+#define HARNESS_SOFTWARE_BLOCK_CYCLES                                          \
+  (600) /**< @brief Represents the Nios II/f cycles of a software block */
+#define HARNESS_MAX_IRQ_CALLS                                                  \
+  (16) /**< @brief Represents the handler calls before the line is treated \
+            as stuck */
+#define HARNESS_WINDOWS                                                        \
+  (64) /**< @brief Represents the host buffers the DMA can reach at a time */
+#define HARNESS_WINDOW_SHIFT                                                   \
+  (24) /**< @brief Represents the bus address bits of one window */
+#define HARNESS_MAX_LENGTH                                                     \
+  (1024) /**< @brief Represents the longest message of the sweep */
+
+/**
+ * Simulation state: the RTL, the clock, the CPU interrupt mask and the
+ * memory the DMA master sees
+ */
+typedef struct harness {
+  Vavalon_sha_wrapper *top;                   /**< @brief Verilated RTL */
+  uint64_t cycle;                             /**< @brief Clock cycles run */
+  uint32_t readdata;                          /**< @brief Last read */
+  int irq_masked;                             /**< @brief CPU interrupt mask */
+  void (*isr)(void *context);                 /**< @brief Interrupt handler */
+  void *isr_context;                          /**< @brief Passed to isr */
+  const uint8_t *window[HARNESS_WINDOWS];     /**< @brief Bus to host */
+  uint32_t next_window;                       /**< @brief Next to reuse */
+  uint32_t burst_address;                     /**< @brief Next burst word */
+  int beats;                                  /**< @brief Burst words left */
+  int delay;                                  /**< @brief Cycles to the word */
+  int wait_count;                             /**< @brief Waitrequest cycles */
+  crypto_engine_bus bus;                      /**< @brief Register access */
+} harness;
+
+/**
+ * Returns the host bytes behind a bus address of the DMA
+ * @param[in] h       Harness
+ * @param[in] address Bus address handed out by harness_dma_address()
+ * @return Host pointer
+ */
+static uint8_t *harness_host(const harness *h, uint32_t address) {
+  return (uint8_t *)h->window[(address >> HARNESS_WINDOW_SHIFT) %
+                              HARNESS_WINDOWS] +
+         (address & ((1u << HARNESS_WINDOW_SHIFT) - 1));
+}
+/**
+ * Runs one clock cycle. The memory model answers the DMA master like the
+ * one of tb_sha_dma.sv: little-endian words, one burst in flight.
+ * @param[in,out] h Harness
+ * @return void
+ */
+static void harness_cycle(harness *h) {
+  Vavalon_sha_wrapper *top = h->top;
+  int valid = 0;
+  uint32_t word = 0;
+
+  top->clk = 0;
+  top->m_waitrequest =
+      (top->m_read || top->m_write) &&
+      (h->wait_count < HARNESS_WAIT_STATES || h->beats > 0);
+  top->eval();
+  h->readdata = top->readdata; // sampled at the end of the cycle
+
+  if ((top->m_read || top->m_write) && top->m_waitrequest) {
+    h->wait_count++;
+  } else if (top->m_read) {
+    h->wait_count = 0;
+    h->beats = top->m_burstcount;
+    h->delay = HARNESS_READ_LATENCY;
+    h->burst_address = top->m_address;
+  } else if (top->m_write) {
+    h->wait_count = 0;
+    word = top->m_writedata;
+    memcpy(harness_host(h, top->m_address), &word, sizeof(word));
+  }
+  if (h->beats > 0) {
+    if (h->delay > 1) {
+      h->delay--;
+    } else {
+      memcpy(&word, harness_host(h, h->burst_address), sizeof(word));
+      valid = 1;
+      h->burst_address += 4;
+      h->beats--;
+    }
+  }
+
+  top->clk = 1;
+  top->eval();
+  top->m_readdata = word;
+  top->m_readdatavalid = (uint8_t)valid;
+  top->eval();
+  h->cycle++;
+}
+/**
+ * Calls the interrupt handler while irq is high and the CPU has it
+ * unmasked; the handler runs masked, like on the Nios
+ * @param[in,out] h Harness
+ * @return void
+ */
+static void harness_deliver_irq(harness *h) {
+  for (int i = 0; i < HARNESS_MAX_IRQ_CALLS; i++) {
+    if (h->isr == NULL || h->irq_masked || !h->top->irq)
+      return;
+    h->irq_masked = 1;
+    h->isr(h->isr_context);
+    h->irq_masked = 0;
+  }
+}
+/**
+ * Lets the CPU do other work for a number of cycles
+ * @param[in,out] h      Harness
+ * @param[in]     cycles Cycles to run
+ * @return void
+ */
+static void harness_advance(harness *h, uint64_t cycles) {
+  for (uint64_t i = 0; i < cycles; i++) {
+    harness_cycle(h);
+    harness_deliver_irq(h);
+  }
+}
+/**
+ * Avalon read of a register
+ * @param[in] context Harness
+ * @param[in] reg     Register address
+ * @return Register value
+ */
+static uint32_t harness_read(void *context, uint32_t reg) {
+  harness *h = (harness *)context;
+  uint32_t value;
+
+  h->top->address = (uint8_t)reg;
+  h->top->read = 1;
+  harness_cycle(h);
+  value = h->readdata;
+  h->top->read = 0;
+  harness_advance(h, HARNESS_BUS_CYCLES - 1);
+  return value;
+}
+/**
+ * Avalon write of a register
+ * @param[in] context Harness
+ * @param[in] reg     Register address
+ * @param[in] value   Value to be written
+ * @return void
+ */
+static void harness_write(void *context, uint32_t reg, uint32_t value) {
+  harness *h = (harness *)context;
+
+  h->top->address = (uint8_t)reg;
+  h->top->writedata = value;
+  h->top->write = 1;
+  harness_cycle(h);
+  h->top->write = 0;
+  harness_advance(h, HARNESS_BUS_CYCLES - 1);
+}
+/**
+ * CPU interrupt mask
+ * @param[in] context Harness
+ * @param[in] mask    1 to mask the interrupt, 0 to unmask it
+ * @return Previous mask
+ */
+static int harness_irq_mask(void *context, int mask) {
+  harness *h = (harness *)context;
+  int previous = h->irq_masked;
+
+  h->irq_masked = mask;
+  harness_deliver_irq(h);
+  return previous;
+}
+/**
+ * Maps a host buffer to a bus address of the DMA, a window per buffer
+ * @param[in] context Harness
+ * @param[in] pointer Host buffer
+ * @return Bus address
+ */
+static uint32_t harness_dma_address(void *context, const void *pointer) {
+  harness *h = (harness *)context;
+  uint32_t window = h->next_window++ % HARNESS_WINDOWS;
+
+  h->window[window] = (const uint8_t *)pointer;
+  return window << HARNESS_WINDOW_SHIFT;
+}
+/**
+ * Scheduler clock: the simulated cycle
+ * @param[in] context Harness
+ * @return Cycles
+ */
+static uint64_t harness_now(void *context) {
+  return ((harness *)context)->cycle;
+}
+/**
+ * Scheduler wait: one poll of the completion queue
+ * @param[in,out] context Harness
+ * @return void
+ */
+static void harness_idle(void *context) {
+  harness_advance((harness *)context, HARNESS_IDLE_CYCLES);
+}
+/**
+ * Software backend of the scheduler, charged at Nios II/f speed
+ * @param[in,out] context    Harness
+ * @param[in]     data       Message
+ * @param[in]     length     Number of bytes in data
+ * @param[out]    final_hash Digest
+ * @return void
+ */
+static void harness_software(void *context, const void *data, size_t length,
+                             uint32_t final_hash[]) {
+  sha1_hash(data, length, final_hash);
+  harness_advance((harness *)context,
+                  ((length + 8) / 64 + 1) * HARNESS_SOFTWARE_BLOCK_CYCLES);
+}
+/**
+ * Checks if the computed hash matches with the expected hash
+ * @param[in] expectedHash Expected digest
+ * @param[in] actualHash   Digest read back from the RTL
+ * @return 1 if they match, 0 otherwise
+ */
+static int isMatched(const uint32_t *expectedHash, const uint32_t *actualHash) {
+  int count = 0;
+  for (; count < FINAL_HASH_SIZE; count++) {
+    if (actualHash[count] != expectedHash[count]) {
+      break;
+    }
+  }
+  return (count == FINAL_HASH_SIZE) ? (1) : (0);
+}
+/**
+ * Hashes messages around the padding boundaries one at a time and prints
+ * the cycles per hash and per block
+ * @param[in,out] h       Harness
+ * @param[in,out] engine  Driver state
+ * @param[in]     message HARNESS_MAX_LENGTH bytes, word aligned
+ * @param[in]     name    Path being measured
+ * @param[in]     polled  1 for crypto_engine_hash(), 0 for the job queue
+ * @return Number of mismatching digests
+ */
+static int run_sweep(harness *h, crypto_engine *engine, const uint8_t *message,
+                     const char *name, int polled) {
+  static const size_t lengths[] = {0,  3,   55,  56,  63,  64,
+                                   65, 119, 120, 128, 512, HARNESS_MAX_LENGTH};
+  const size_t count = sizeof(lengths) / sizeof(lengths[0]);
+  uint64_t cycles = 0, blocks = 0;
+  crypto_engine_perf perf;
+  int failed = 0;
+
+  crypto_engine_perf_sample(engine, &perf, 1);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t expectedHash[FINAL_HASH_SIZE], final_hash[FINAL_HASH_SIZE];
+    const uint64_t start = h->cycle;
+    int ok;
+
+    if (polled) {
+      ok = crypto_engine_hash(engine, message, lengths[i], final_hash) == 0;
+    } else {
+      crypto_engine_handle handle =
+          crypto_engine_submit(engine, message, lengths[i]);
+      ok = handle >= 0;
+      while (ok && crypto_engine_next_completion(engine, final_hash) != handle)
+        harness_advance(h, HARNESS_IDLE_CYCLES);
+    }
+    cycles += h->cycle - start;
+    blocks += (lengths[i] + 8) / 64 + 1;
+
+    sha1_hash(message, lengths[i], expectedHash);
+    if (!ok || !isMatched(expectedHash, final_hash)) {
+      printf("ERR: %s, %zu bytes: wrong digest\n", name, lengths[i]);
+      failed++;
+    }
+  }
+  crypto_engine_perf_sample(engine, &perf, 0);
+  printf("%-9s %zu hashes: %.1f cycles per hash, %.1f cycles per block "
+         "(busy %u, stall %u cycles, %u blocks)\n",
+         name, count, (double)cycles / count, (double)cycles / blocks,
+         perf.busy, perf.stall, perf.blocks);
+  if (perf.blocks != blocks) {
+    printf("ERR: %s: %u blocks counted, %llu expected\n", name, perf.blocks,
+           (unsigned long long)blocks);
+    failed++;
+  }
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  static constexpr sha1::digest expected = sha1::hash("abc");
+  static uint32_t buffer[HARNESS_MAX_LENGTH / sizeof(uint32_t)];
+  static crypto_engine engine;
+  static crypto_scheduler scheduler;
+  static harness h;
+  const crypto_scheduler_platform platform = {harness_now, harness_idle,
+                                              harness_software, &h};
+  const uint8_t *message = (const uint8_t *)buffer;
+  uint32_t final_hash[FINAL_HASH_SIZE] = {0};
+  const char *cores_arg;
+  uint64_t start;
+  unsigned cores;
+  int failed = 0, backend;
+
+  Verilated::commandArgs(argc, argv);
+  h.top = new Vavalon_sha_wrapper;
+  h.bus.read = harness_read;
+  h.bus.write = harness_write;
+  h.bus.irq_mask = harness_irq_mask;
+  h.bus.dma_address = harness_dma_address;
+  h.bus.context = &h;
+
+  h.top->reset_n = 0;
+  for (int i = 0; i < HARNESS_RESET_CYCLES; i++)
+    harness_cycle(&h);
+  h.top->reset_n = 1;
+  harness_cycle(&h);
+
+  srand(1);
+  for (size_t i = 0; i < sizeof(buffer) / sizeof(buffer[0]); i++)
+    buffer[i] = (uint32_t)rand();
+
+  printf("Hello from the RTL!\n");
+  crypto_engine_init(&engine, &h.bus);
+  h.isr = crypto_engine_isr;
+  h.isr_context = &engine;
+  cores = harness_read(&h, CRYPTO_CONFIG_REG) & CRYPTO_CONFIG_CORES_MASK;
+  printf("Accelerator: %u cores, %u rounds per cycle\n", cores,
+         (harness_read(&h, CRYPTO_CONFIG_REG) >> 8) & 0xFF);
+  /* A sweep over CORES passes the count each model was elaborated with */
+  cores_arg = Verilated::commandArgsPlusMatch("cores=");
+  if (cores_arg[0] != '\0' &&
+      strtoul(cores_arg + strlen("+cores="), NULL, 0) != cores) {
+    printf("ERR: model reports %u cores, expected %s\n", cores,
+           cores_arg + strlen("+cores="));
+    failed++;
+  }
+
+  /* hello_world_small.c: calibrate, hash "abc", verify */
+  crypto_scheduler_init(&scheduler, &engine, &platform);
+  start = h.cycle;
+  backend = crypto_scheduler_hash(&scheduler, "abc", 3, final_hash);
+  printf("%s: \"abc\" in %llu cycles\n",
+         (backend == CRYPTO_BACKEND_ACCELERATOR) ? ("Hardware") : ("Software"),
+         (unsigned long long)(h.cycle - start));
+  print_final_hash(final_hash);
+  if (backend < 0 || !isMatched(expected.word, final_hash)) {
+    printf("ERR: \"abc\": wrong digest\n");
+    failed++;
+  }
+
+  failed += run_sweep(&h, &engine, message, "Registers", 0);
+  failed += run_sweep(&h, &engine, message, "Polled", 1);
+  crypto_engine_set_dma(&engine, 1);
+  failed += run_sweep(&h, &engine, message, "DMA", 0);
+  crypto_engine_set_dma(&engine, 0);
+
+  printf("%d mismatches after %llu cycles\n", failed,
+         (unsigned long long)h.cycle);
+  h.top->final();
+  delete h.top;
+  return (failed == 0) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
@@ -0,0 +1,348 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_scheduler.c
+* Author          : Jishnu Murali Thampan
+* Description     : HW/SW co-scheduler. The CPU is the software backend and
+* 		              also feeds the accelerator, so a batch runs as one
+* 		              loop: collect finished jobs, give the longest waiting
+* 		              messages to the accelerator while it beats the CPU on
+* 		              them, hash the shortest one on the CPU while the CPU
+* 		              beats the accelerator queue on it, otherwise wait.
+* 		              Both ends meet in the middle of the batch sorted by
+* 		              length.
+****************************************************************************/
+
+#include "crypto_scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CALIBRATION_SHORT                                                      \
+  (0) /**< @brief Represents the short message of the calibration */
+#define CALIBRATION_LONG                                                       \
+  (512) /**< @brief Represents the long message of the calibration */
+#define CALIBRATION_REPEAT                                                     \
+  (4) /**< @brief Represents the messages timed per length and backend */
+#define DEFAULT_SOFTWARE_SETUP                                                 \
+  (200) /**< @brief Represents the software setup without a clock */
+#define DEFAULT_SOFTWARE_PER_BYTE                                              \
+  (24 << CRYPTO_COST_SHIFT) /**< @brief Represents the software cost per \
+                                 byte without a clock */
+#define DEFAULT_ACCELERATOR_SETUP                                              \
+  (400) /**< @brief Represents the accelerator setup without a clock */
+#define DEFAULT_ACCELERATOR_PER_BYTE                                           \
+  (1 << CRYPTO_COST_SHIFT) /**< @brief Represents the accelerator cost per \
+                                byte without a clock */
+
+static uint32_t calibration[CALIBRATION_LONG / sizeof(uint32_t)];
+
+/**
+ * Reads the platform clock
+ * @param[in] scheduler Scheduler state
+ * @return Ticks
+ */
+static uint64_t crypto_scheduler_now(const crypto_scheduler *scheduler) {
+  const crypto_scheduler_platform *platform = scheduler->platform;
+  return (platform != NULL && platform->now != NULL)
+             ? (platform->now(platform->context))
+             : (0);
+}
+/**
+ * Lets the platform wait for the accelerator
+ * @param[in] scheduler Scheduler state
+ * @return void
+ */
+static void crypto_scheduler_idle(const crypto_scheduler *scheduler) {
+  const crypto_scheduler_platform *platform = scheduler->platform;
+  if (platform != NULL && platform->idle != NULL)
+    platform->idle(platform->context);
+}
+/**
+ * Hashes a message on the CPU
+ * @param[in]  scheduler  Scheduler state
+ * @param[in]  data       Message
+ * @param[in]  length     Number of bytes in data
+ * @param[out] final_hash Digest
+ * @return void
+ */
+static void crypto_scheduler_software(const crypto_scheduler *scheduler,
+                                      const void *data, size_t length,
+                                      uint32_t final_hash[]) {
+  const crypto_scheduler_platform *platform = scheduler->platform;
+  if (platform != NULL && platform->software != NULL)
+    platform->software(platform->context, data, length, final_hash);
+  else
+    sha1_hash(data, length, final_hash);
+}
+/**
+ * Orders batch entries by decreasing length, for qsort()
+ * @param[in] a Entry (crypto_hash_request **)
+ * @param[in] b Entry (crypto_hash_request **)
+ * @return <0 if a goes first, >0 if b does
+ */
+static int crypto_scheduler_longer(const void *a, const void *b) {
+  const size_t x = (*(crypto_hash_request *const *)a)->length;
+  const size_t y = (*(crypto_hash_request *const *)b)->length;
+  return (x < y) ? (1) : (x > y) ? (-1) : (0);
+}
+/**
+ * Times CALIBRATION_REPEAT messages on a backend. The accelerator gets them
+ * all at once, so its cost is the one of a full queue.
+ * @param[in,out] scheduler Scheduler state
+ * @param[in]     backend   CRYPTO_BACKEND_SOFTWARE or _ACCELERATOR
+ * @param[in]     length    Message length
+ * @return Ticks per message
+ */
+static uint64_t crypto_scheduler_time(crypto_scheduler *scheduler, int backend,
+                                      size_t length) {
+  uint32_t final_hash[FINAL_HASH_SIZE];
+  const uint64_t start = crypto_scheduler_now(scheduler);
+  int pending = 0;
+
+  for (int i = 0; i < CALIBRATION_REPEAT; i++) {
+    if (backend == CRYPTO_BACKEND_SOFTWARE)
+      crypto_scheduler_software(scheduler, calibration, length, final_hash);
+    else
+      pending += crypto_engine_submit(scheduler->engine, calibration,
+                                      length) >= 0;
+  }
+  while (pending > 0) {
+    if (crypto_engine_next_completion(scheduler->engine, final_hash) >= 0)
+      pending--;
+    else
+      crypto_scheduler_idle(scheduler);
+  }
+  return (crypto_scheduler_now(scheduler) - start) / CALIBRATION_REPEAT;
+}
+/**
+ * Sets up the scheduler and calibrates the cost models
+ * @param[out] scheduler Scheduler state
+ * @param[in]  engine    Initialised accelerator driver, NULL if there is
+ *                       none
+ * @param[in]  platform  Clock and software backend; NULL, or a NULL clock,
+ *                       keeps built-in Nios II costs
+ * @return void
+ */
+void crypto_scheduler_init(crypto_scheduler *scheduler, crypto_engine *engine,
+                           const crypto_scheduler_platform *platform) {
+  *scheduler = (crypto_scheduler){0};
+  scheduler->engine = engine;
+  scheduler->platform = platform;
+  scheduler->pinned = CRYPTO_BACKEND_AUTO;
+  scheduler->cost[CRYPTO_BACKEND_SOFTWARE].setup = DEFAULT_SOFTWARE_SETUP;
+  scheduler->cost[CRYPTO_BACKEND_SOFTWARE].per_byte =
+      DEFAULT_SOFTWARE_PER_BYTE;
+  scheduler->cost[CRYPTO_BACKEND_ACCELERATOR].setup =
+      DEFAULT_ACCELERATOR_SETUP;
+  scheduler->cost[CRYPTO_BACKEND_ACCELERATOR].per_byte =
+      DEFAULT_ACCELERATOR_PER_BYTE;
+  crypto_scheduler_calibrate(scheduler);
+}
+/**
+ * Measures the setup and per byte cost of each backend with a short and a
+ * long message. Nothing may be queued on the accelerator.
+ * @param[in,out] scheduler Scheduler state
+ * @return void
+ */
+void crypto_scheduler_calibrate(crypto_scheduler *scheduler) {
+  if (scheduler->platform == NULL || scheduler->platform->now == NULL)
+    return;
+  for (size_t i = 0; i < sizeof(calibration) / sizeof(calibration[0]); i++)
+    calibration[i] = 0x9E3779B9u * (uint32_t)(i + 1);
+
+  for (int backend = 0; backend < CRYPTO_BACKENDS; backend++) {
+    crypto_backend_cost *cost = &scheduler->cost[backend];
+    uint64_t short_ticks, long_ticks, per_byte = 0;
+
+    if (backend == CRYPTO_BACKEND_ACCELERATOR && scheduler->engine == NULL)
+      break;
+    short_ticks =
+        crypto_scheduler_time(scheduler, backend, CALIBRATION_SHORT);
+    long_ticks = crypto_scheduler_time(scheduler, backend, CALIBRATION_LONG);
+    if (long_ticks > short_ticks)
+      per_byte = ((long_ticks - short_ticks) << CRYPTO_COST_SHIFT) /
+                 (CALIBRATION_LONG - CALIBRATION_SHORT);
+    cost->per_byte = (uint32_t)per_byte;
+    per_byte = (per_byte * CALIBRATION_SHORT) >> CRYPTO_COST_SHIFT;
+    cost->setup =
+        (uint32_t)((short_ticks > per_byte) ? (short_ticks - per_byte) : (0));
+  }
+}
+/**
+ * Forces all messages onto one backend, e.g. to compare against the
+ * schedule
+ * @param[in,out] scheduler Scheduler state
+ * @param[in]     backend   Backend or CRYPTO_BACKEND_AUTO
+ * @return void
+ */
+void crypto_scheduler_pin(crypto_scheduler *scheduler, int backend) {
+  scheduler->pinned = backend;
+}
+/**
+ * Estimated ticks a backend spends on one message
+ * @param[in] scheduler Scheduler state
+ * @param[in] backend   CRYPTO_BACKEND_SOFTWARE or _ACCELERATOR
+ * @param[in] length    Message length
+ * @return Ticks
+ */
+uint64_t crypto_scheduler_cost(const crypto_scheduler *scheduler, int backend,
+                               size_t length) {
+  const crypto_backend_cost *cost = &scheduler->cost[backend];
+  return cost->setup + (((uint64_t)cost->per_byte * length) >>
+                        CRYPTO_COST_SHIFT);
+}
+/**
+ * Picks the backend estimated to finish a message first; the accelerator
+ * first has to get through the jobs already queued on it
+ * @param[in,out] scheduler Scheduler state
+ * @param[in]     length    Message length
+ * @return CRYPTO_BACKEND_SOFTWARE or _ACCELERATOR
+ */
+int crypto_scheduler_route(crypto_scheduler *scheduler, size_t length) {
+  if (scheduler->pinned != CRYPTO_BACKEND_AUTO)
+    return (scheduler->engine != NULL) ? (scheduler->pinned)
+                                       : (CRYPTO_BACKEND_SOFTWARE);
+  if (scheduler->engine == NULL)
+    return CRYPTO_BACKEND_SOFTWARE;
+  return (scheduler->backlog + crypto_scheduler_cost(
+                                   scheduler, CRYPTO_BACKEND_ACCELERATOR,
+                                   length) <
+          crypto_scheduler_cost(scheduler, CRYPTO_BACKEND_SOFTWARE, length))
+             ? (CRYPTO_BACKEND_ACCELERATOR)
+             : (CRYPTO_BACKEND_SOFTWARE);
+}
+/**
+ * Hashes one message on the backend estimated to finish it first
+ * @param[in,out] scheduler  Scheduler state
+ * @param[in]     data       Message
+ * @param[in]     length     Number of bytes in data
+ * @param[out]    final_hash Digest
+ * @return Backend used or -1 on error
+ */
+int crypto_scheduler_hash(crypto_scheduler *scheduler, const void *data,
+                          size_t length, uint32_t final_hash[]) {
+  crypto_hash_request request = {data, length, {0}, CRYPTO_BACKEND_AUTO};
+
+  if (crypto_scheduler_batch(scheduler, &request, 1) < 0)
+    return -1;
+  for (int i = 0; i < FINAL_HASH_SIZE; i++) {
+    final_hash[i] = request.final_hash[i];
+  }
+  return request.backend;
+}
+/**
+ * Hashes a batch of messages, split between the CPU and the accelerator so
+ * that the last of them finishes as early as the cost models allow. The
+ * messages must stay valid until the call returns.
+ * @param[in,out] scheduler Scheduler state
+ * @param[in,out] request   Messages; digests and backends are filled in
+ * @param[in]     count     Number of messages
+ * @return 0 on success, -1 on error
+ */
+int crypto_scheduler_batch(crypto_scheduler *scheduler,
+                           crypto_hash_request *request, size_t count) {
+  crypto_hash_request *single = request;
+  crypto_hash_request **order = &single;
+  crypto_hash_request *owner[CRYPTO_ENGINE_QUEUE_DEPTH] = {NULL};
+  size_t front = 0, back = count; /* [front, back) still to be hashed */
+  uint64_t remaining[CRYPTO_BACKENDS] = {0}; /* Each alone on [front, back) */
+  int pending = 0;
+
+  if (count > 1) {
+    order = malloc(count * sizeof(*order));
+    if (order == NULL) {
+      printf("ERR: Out of memory\n");
+      return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+      order[i] = &request[i];
+    }
+    qsort(order, count, sizeof(*order), crypto_scheduler_longer);
+  }
+  for (size_t i = 0; i < count; i++) {
+    for (int b = 0; b < CRYPTO_BACKENDS; b++) {
+      remaining[b] += crypto_scheduler_cost(scheduler, b, order[i]->length);
+    }
+  }
+
+  while (front < back || pending > 0) {
+    uint32_t final_hash[FINAL_HASH_SIZE];
+    crypto_engine_handle handle;
+    int progress = 0, declined = 0;
+
+    /* Finished accelerator jobs */
+    while (pending > 0 && (handle = crypto_engine_next_completion(
+                               scheduler->engine, final_hash)) >= 0) {
+      if (owner[handle] == NULL)
+        continue; // not submitted by the scheduler: dropped
+      for (int i = 0; i < FINAL_HASH_SIZE; i++) {
+        owner[handle]->final_hash[i] = final_hash[i];
+      }
+      owner[handle] = NULL;
+      scheduler->backlog -= scheduler->queued[handle];
+      pending--;
+      progress = 1;
+    }
+
+    /* Longest message to the accelerator if it gets through it before the
+       CPU would get through all that is left */
+    while (front < back && scheduler->engine != NULL &&
+           scheduler->pinned != CRYPTO_BACKEND_SOFTWARE) {
+      crypto_hash_request *next = order[front];
+      const uint64_t cost = crypto_scheduler_cost(
+          scheduler, CRYPTO_BACKEND_ACCELERATOR, next->length);
+
+      if (scheduler->pinned == CRYPTO_BACKEND_AUTO &&
+          scheduler->backlog + cost > remaining[CRYPTO_BACKEND_SOFTWARE]) {
+        declined = 1;
+        break;
+      }
+      handle = crypto_engine_submit(scheduler->engine, next->data,
+                                    next->length);
+      if (handle < 0)
+        break; // queue full
+      owner[handle] = next;
+      next->backend = CRYPTO_BACKEND_ACCELERATOR;
+      scheduler->queued[handle] = cost;
+      scheduler->backlog += cost;
+      scheduler->messages[CRYPTO_BACKEND_ACCELERATOR]++;
+      remaining[CRYPTO_BACKEND_SOFTWARE] -= crypto_scheduler_cost(
+          scheduler, CRYPTO_BACKEND_SOFTWARE, next->length);
+      remaining[CRYPTO_BACKEND_ACCELERATOR] -= cost;
+      front++;
+      pending++;
+      progress = 1;
+    }
+
+    /* Shortest message on the CPU if the jobs queued keep the accelerator
+       busy meanwhile; once it declines messages, if the CPU gets through
+       it before the accelerator gets through all that is left */
+    if (front < back &&
+        (scheduler->engine == NULL ||
+         scheduler->pinned == CRYPTO_BACKEND_SOFTWARE ||
+         (scheduler->pinned == CRYPTO_BACKEND_AUTO &&
+          (pending == 0 ||
+           crypto_scheduler_cost(scheduler, CRYPTO_BACKEND_SOFTWARE,
+                                 order[back - 1]->length) <=
+               scheduler->backlog +
+                   ((declined) ? (remaining[CRYPTO_BACKEND_ACCELERATOR])
+                               : (0)))))) {
+      crypto_hash_request *next = order[--back];
+      remaining[CRYPTO_BACKEND_SOFTWARE] -= crypto_scheduler_cost(
+          scheduler, CRYPTO_BACKEND_SOFTWARE, next->length);
+      remaining[CRYPTO_BACKEND_ACCELERATOR] -= crypto_scheduler_cost(
+          scheduler, CRYPTO_BACKEND_ACCELERATOR, next->length);
+      crypto_scheduler_software(scheduler, next->data, next->length,
+                                next->final_hash);
+      next->backend = CRYPTO_BACKEND_SOFTWARE;
+      scheduler->messages[CRYPTO_BACKEND_SOFTWARE]++;
+      progress = 1;
+    }
+
+    if (!progress)
+      crypto_scheduler_idle(scheduler);
+  }
+
+  if (order != &single)
+    free(order);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_scheduler.h
+* Author          : Jishnu Murali Thampan
+* Description     : Runtime choice between the software SHA-1 and the
+* 		            accelerator. Each backend has a cost model, a setup
+* 		            cost per message plus a cost per byte, measured at
+* 		            start-up with the platform clock. A message goes to
+* 		            the backend estimated to finish it first, counting
+* 		            the accelerator jobs already queued: short messages
+* 		            end up in software, long ones on the accelerator. A
+* 		            batch is split: the accelerator takes the longest
+* 		            messages while the CPU hashes the shortest ones, so
+* 		            both finish about together.
+*
+* Ownership       : The scheduler collects every completion of the engine;
+* 		            jobs may not be submitted to it directly meanwhile.
+****************************************************************************/
+
+#ifndef CRYPTO_SCHEDULER_HPP
+#define CRYPTO_SCHEDULER_HPP
+
+#include "crypto_engine.h"
+
+#define CRYPTO_BACKEND_AUTO                                                    \
+  (-1) /**< @brief Represents the choice of the cost model */
+#define CRYPTO_BACKEND_SOFTWARE                                                \
+  (0) /**< @brief Represents the software SHA-1 on the CPU */
+#define CRYPTO_BACKEND_ACCELERATOR                                             \
+  (1) /**< @brief Represents the accelerator behind crypto_engine */
+#define CRYPTO_BACKENDS (2) /**< @brief Represents the number of backends */
+#define CRYPTO_COST_SHIFT                                                      \
+  (8) /**< @brief Represents the fraction bits of the cost per byte */
+
+/**
+ * Platform services: the clock the costs are measured in and the software
+ * backend
+ */
+typedef struct crypto_scheduler_platform {
+  uint64_t (*now)(void *context); /**< @brief Clock, NULL for fixed costs */
+  void (*idle)(void *context);    /**< @brief Waiting, NULL to spin */
+  void (*software)(void *context, const void *data, size_t length,
+                   uint32_t final_hash[]); /**< @brief NULL for sha1_hash */
+  void *context;                           /**< @brief Passed to the above */
+} crypto_scheduler_platform;
+
+/**
+ * Cost model of a backend, in ticks of the platform clock
+ */
+typedef struct crypto_backend_cost {
+  uint32_t setup;    /**< @brief Ticks per message */
+  uint32_t per_byte; /**< @brief Ticks per byte << CRYPTO_COST_SHIFT */
+} crypto_backend_cost;
+
+/**
+ * One message of a batch
+ */
+typedef struct crypto_hash_request {
+  const void *data;                     /**< @brief Message */
+  size_t length;                        /**< @brief Number of bytes in data */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Digest */
+  int backend;                          /**< @brief Backend that hashed it */
+} crypto_hash_request;
+
+/**
+ * Scheduler state
+ */
+typedef struct crypto_scheduler {
+  crypto_engine *engine;                      /**< @brief NULL: software */
+  const crypto_scheduler_platform *platform;  /**< @brief Clock, software */
+  crypto_backend_cost cost[CRYPTO_BACKENDS];  /**< @brief Cost models */
+  int pinned;                                 /**< @brief Forced backend */
+  uint64_t queued[CRYPTO_ENGINE_QUEUE_DEPTH]; /**< @brief Cost per handle */
+  uint64_t backlog;                           /**< @brief Sum of queued */
+  uint32_t messages[CRYPTO_BACKENDS];         /**< @brief Hashed by each */
+} crypto_scheduler;
+
+void crypto_scheduler_init(crypto_scheduler *scheduler, crypto_engine *engine,
+                           const crypto_scheduler_platform *platform);
+void crypto_scheduler_calibrate(crypto_scheduler *scheduler);
+void crypto_scheduler_pin(crypto_scheduler *scheduler, int backend);
+uint64_t crypto_scheduler_cost(const crypto_scheduler *scheduler, int backend,
+                               size_t length);
+int crypto_scheduler_route(crypto_scheduler *scheduler, size_t length);
+int crypto_scheduler_hash(crypto_scheduler *scheduler, const void *data,
+                          size_t length, uint32_t final_hash[]);
+int crypto_scheduler_batch(crypto_scheduler *scheduler,
+                           crypto_hash_request *request, size_t count);
+
+#endif /* CRYPTO_SCHEDULER_HPP */
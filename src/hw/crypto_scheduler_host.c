@@ -0,0 +1,208 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : crypto_scheduler_host.c
+* Author          : Jishnu Murali Thampan
+* Description     : Runs the HW/SW co-scheduler on Linux. The accelerator is
+* 		              the register model; the software SHA-1 is charged to
+* 		              the model clock at a given number of CPU cycles per
+* 		              block, so both backends are timed on the same clock.
+* 		              For a slow, a medium and a fast CPU it prints the
+* 		              calibrated cost models, the backend chosen for single
+* 		              messages, and the time a batch of mixed lengths takes
+* 		              on the CPU alone, on the accelerator alone and split
+* 		              by the scheduler. Every digest is checked.
+*
+* Build           : gcc -DCRYPTO_ENGINE_HOSTED -I../sw crypto_scheduler_host.c
+* 		              crypto_scheduler.c crypto_engine.c
+* 		              crypto_engine_model.c ../sw/sha-1.c ../sw/sha-1-x86.c
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "crypto_engine_model.h"
+#include "crypto_scheduler.h"
+
+#define HOST_JOBS (256) /**< @brief Represents the messages of the batch */
+#define HOST_MAX_LENGTH                                                        \
+  (4096) /**< @brief Represents the longest message of the batch */
+#define HOST_IDLE_CYCLES                                                       \
+  (10) /**< @brief Represents one poll of the completion queue */
+#define HOST_ISR_CYCLES                                                        \
+  (100) /**< @brief Represents the interrupt entry and exit of the HAL */
+#define HOST_SOFTWARE_SETUP_CYCLES                                             \
+  (150) /**< @brief Represents the software init and final per message */
+
+static const uint32_t host_block_cycles[] = {
+    2400, /* Nios II/e class */
+    600,  /* Nios II/f class */
+    60,   /* Desktop core with SHA extensions */
+};
+
+/**
+ * Model and the CPU speed charged for the software SHA-1
+ */
+typedef struct host_platform {
+  crypto_engine_model model; /**< @brief Accelerator and clock */
+  uint32_t block_cycles;     /**< @brief CPU cycles per software block */
+} host_platform;
+
+/**
+ * Checks if the computed hash matches with the expected hash
+ * @param[in] expectedHash Expected digest
+ * @param[in] actualHash   Digest of the backend
+ * @return 1 if they match, 0 otherwise
+ */
+static int isMatched(const uint32_t *expectedHash,
+                     const uint32_t *actualHash) {
+  int count = 0;
+  for (; count < FINAL_HASH_SIZE; count++) {
+    if (actualHash[count] != expectedHash[count]) {
+      break;
+    }
+  }
+  return (count == FINAL_HASH_SIZE) ? (1) : (0);
+}
+/**
+ * Platform clock: the model cycle
+ * @param[in] context Host platform
+ * @return Cycles
+ */
+static uint64_t host_now(void *context) {
+  return ((host_platform *)context)->model.cycle;
+}
+/**
+ * Platform wait: one poll of the completion queue
+ * @param[in,out] context Host platform
+ * @return void
+ */
+static void host_idle(void *context) {
+  crypto_engine_model_advance(&((host_platform *)context)->model,
+                              HOST_IDLE_CYCLES);
+}
+/**
+ * Software backend: hashes on the host, then lets the modelled CPU spend
+ * its time on it while the accelerator keeps running
+ * @param[in,out] context    Host platform
+ * @param[in]     data       Message
+ * @param[in]     length     Number of bytes in data
+ * @param[out]    final_hash Digest
+ * @return void
+ */
+static void host_software(void *context, const void *data, size_t length,
+                          uint32_t final_hash[]) {
+  host_platform *host = (host_platform *)context;
+  const uint64_t blocks = (length + 8) / 64 + 1;
+
+  sha1_hash(data, length, final_hash);
+  crypto_engine_model_advance(&host->model, HOST_SOFTWARE_SETUP_CYCLES +
+                                                blocks * host->block_cycles);
+}
+/**
+ * Hashes the batch with one policy and checks the digests
+ * @param[in,out] host      Host platform
+ * @param[in,out] scheduler Scheduler state
+ * @param[in,out] request   Batch
+ * @param[in]     pin       Backend or CRYPTO_BACKEND_AUTO
+ * @param[out]    failed    Incremented per mismatching digest
+ * @return Cycles the batch took
+ */
+static uint64_t run_batch(host_platform *host, crypto_scheduler *scheduler,
+                          crypto_hash_request *request, int pin,
+                          int *failed) {
+  const uint64_t start = host->model.cycle;
+  uint64_t cycles;
+
+  crypto_scheduler_pin(scheduler, pin);
+  if (crypto_scheduler_batch(scheduler, request, HOST_JOBS) < 0)
+    (*failed)++;
+  cycles = host->model.cycle - start;
+  for (int j = 0; j < HOST_JOBS; j++) {
+    uint32_t expectedHash[FINAL_HASH_SIZE];
+    sha1_hash(request[j].data, request[j].length, expectedHash);
+    *failed += !isMatched(expectedHash, request[j].final_hash);
+  }
+  crypto_scheduler_pin(scheduler, CRYPTO_BACKEND_AUTO);
+  return cycles;
+}
+
+int main(int argc, char *argv[]) {
+  const uint32_t cores = (argc > 1) ? ((uint32_t)atoi(argv[1])) : (1);
+  static const char *const name[CRYPTO_BACKENDS] = {"software",
+                                                    "accelerator"};
+  static const size_t single[] = {3, 64, 256, 1024, 4096};
+  uint8_t(*message)[HOST_MAX_LENGTH] = malloc(HOST_JOBS * HOST_MAX_LENGTH);
+  crypto_hash_request *request = malloc(HOST_JOBS * sizeof(*request));
+  host_platform *host = malloc(sizeof(*host));
+  int failed = 0;
+
+  if (message == NULL || request == NULL || host == NULL) {
+    printf("ERR: Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  srand(1);
+  for (int j = 0; j < HOST_JOBS; j++) { /* Lengths spread over 1..4096 */
+    request[j].data = message[j];
+    request[j].length = (size_t)rand() % ((size_t)1 << (rand() % 13));
+    for (size_t i = 0; i < request[j].length; i++)
+      message[j][i] = (uint8_t)rand();
+  }
+
+  for (size_t s = 0; s < sizeof(host_block_cycles) / sizeof(uint32_t); s++) {
+    const crypto_scheduler_platform platform = {host_now, host_idle,
+                                                host_software, host};
+    crypto_scheduler scheduler;
+    crypto_engine engine;
+    uint64_t software, accelerator, scheduled;
+    uint32_t shared[CRYPTO_BACKENDS];
+
+    crypto_engine_model_init(&host->model, 0, cores);
+    host->model.isr_cycles = HOST_ISR_CYCLES;
+    host->block_cycles = host_block_cycles[s];
+    crypto_engine_init(&engine, crypto_engine_model_bus(&host->model));
+    crypto_engine_model_attach_isr(&host->model, crypto_engine_isr, &engine);
+    crypto_scheduler_init(&scheduler, &engine, &platform);
+
+    printf("CPU at %u cycles per block, %u accelerator cores:\n",
+           host->block_cycles, cores);
+    for (int b = 0; b < CRYPTO_BACKENDS; b++) {
+      printf("  %-11s setup=%u cycles, %.2f cycles/byte\n", name[b],
+             scheduler.cost[b].setup,
+             scheduler.cost[b].per_byte / (double)(1 << CRYPTO_COST_SHIFT));
+    }
+    printf("  single messages:");
+    for (size_t i = 0; i < sizeof(single) / sizeof(single[0]); i++) {
+      uint32_t final_hash[FINAL_HASH_SIZE], expectedHash[FINAL_HASH_SIZE];
+      const int backend =
+          crypto_scheduler_hash(&scheduler, message[0], single[i], final_hash);
+      sha1_hash(message[0], single[i], expectedHash);
+      failed += backend < 0 || !isMatched(expectedHash, final_hash);
+      printf(" %zu->%s", single[i], (backend == CRYPTO_BACKEND_SOFTWARE)
+                                        ? ("sw")
+                                        : ("hw"));
+    }
+    printf("\n");
+
+    software = run_batch(host, &scheduler, request, CRYPTO_BACKEND_SOFTWARE,
+                         &failed);
+    accelerator = run_batch(host, &scheduler, request,
+                            CRYPTO_BACKEND_ACCELERATOR, &failed);
+    shared[0] = scheduler.messages[0];
+    shared[1] = scheduler.messages[1];
+    scheduled =
+        run_batch(host, &scheduler, request, CRYPTO_BACKEND_AUTO, &failed);
+    printf("  batch of %d: software %llu, accelerator %llu, scheduled %llu "
+           "cycles (%u sw / %u hw messages, %.2fx the best backend)\n",
+           HOST_JOBS, (unsigned long long)software,
+           (unsigned long long)accelerator, (unsigned long long)scheduled,
+           scheduler.messages[0] - shared[0],
+           scheduler.messages[1] - shared[1],
+           (double)((software < accelerator) ? (software) : (accelerator)) /
+               scheduled);
+  }
+  printf("%d mismatches\n", failed);
+
+  free(message);
+  free(request);
+  free(host);
+  return (failed == 0) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
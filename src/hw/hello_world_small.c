@@ -82,31 +82,28 @@
    submitted by:
    Jishnu Murali Thampan - jishnu.mt@gmail.com
 */
+#include "crypto_scheduler.h"
 #include "sha-1.h"
+#include "sys/alt_irq.h"
 #include "sys/alt_stdio.h"
+#include "sys/alt_timestamp.h"
 #include "system.h"
 #include <sys/time.h>
 
-#define CRYPTO_ACCELERATOR_ENABLED /* Enables HW Accelerator */
-#define CRYPTO_CTRL_REG (0)        /* Represents the control register address  \
-                                      offset*/
-#define CRYPTO_STATUS_REG (1)      /* Represents the status register address   \
-                                      offset*/
-
-#define CRYPTO_DATA_REG_0 (2) /* Represents the data register-0 address        \
-                                 offset*/
-#define CRYPTO_DATA_REG_1 (3) /* Represents the data register-1 address        \
-                                 offset*/
-#define CRYPTO_DATA_REG_2 (4) /* Represents the data register-2 address        \
-                                 offset*/
-#define CRYPTO_DATA_REG_3 (5) /* Represents the data register-3 address        \
-                                 offset*/
-#define CRYPTO_DATA_REG_4 (6) /* Represents the data register-4 address        \
-                                 offset*/
-
-#define CRYPTO_CTRL_REG_BIT_0 (0) /* To start processing*/
-#define CRYPTO_STATUS_REG_BIT_0                                                \
-  (0) /* Represents that output is ready from the HW */
+#ifndef CRYPTO_ENGINE_BASE
+/* 32 registers span 0x80 bytes; the slave sits above the LED PIO */
+#define CRYPTO_ENGINE_BASE (0x80009080) /* Avalon slave of the accelerator */
+#endif
+#ifndef LED_PIO_BASE
+#define LED_PIO_BASE (0x80009040) /* PIO of the on-board LEDs */
+#endif
+#ifndef CRYPTO_ENGINE_IRQ
+#define CRYPTO_ENGINE_IRQ (0) /* Interrupt line of the accelerator */
+#endif
+#ifndef CRYPTO_ENGINE_IRQ_INTERRUPT_CONTROLLER_ID
+#define CRYPTO_ENGINE_IRQ_INTERRUPT_CONTROLLER_ID                              \
+  (0) /* Interrupt controller the line is wired to */
+#endif
 
 /* Function checks if the computed hash matches with the expected hash*/
 int isMatched(const uint32_t *expectedHash, const uint32_t *actualHash) {
@@ -119,71 +116,72 @@ int isMatched(const uint32_t *expectedHash, const uint32_t *actualHash) {
   return (count == FINAL_HASH_SIZE) ? (1) : (0);
 }
 
+/* Clock of the scheduler's cost models: the timestamp timer */
+static uint64_t timestamp_now(void *context) {
+  (void)context;
+  return (uint64_t)alt_timestamp();
+}
+
 int main() {
-  volatile unsigned int *led_ptr = (volatile unsigned int *)0x80009040;
+  volatile unsigned int *led_ptr = (volatile unsigned int *)LED_PIO_BASE;
   alt_putstr("Hello from Nios II!\n");
 
-  uint32_t expectedHash[FINAL_HASH_SIZE] = {};
-  expectedHash[0] = 2845392438;
-  expectedHash[1] = 1191608682;
-  expectedHash[2] = 3124634993;
-  expectedHash[3] = 2018558572;
-  expectedHash[4] = 2630932637;
+  /* SHA-1("abc"), asserted at compile time in sha-1-constexpr.hpp */
+  static const uint32_t expectedHash[FINAL_HASH_SIZE] = {
+      0xA9993E36, 0x4706816A, 0xBA3E2571, 0x7850C26C, 0x9CD0D89D};
 
   struct timeval start, end;
-
-#ifndef CRYPTO_ACCELERATOR_ENABLED /* Software computation */
-
+  static crypto_engine engine;
+  static crypto_scheduler scheduler;
+  static const char *const backend_name[CRYPTO_BACKENDS] = {"Software",
+                                                            "Hardware"};
+  crypto_scheduler_platform platform = {timestamp_now, NULL, NULL, NULL};
   uint32_t final_hash[FINAL_HASH_SIZE] = {0};
-  gettimeofday(&start, NULL);
-  generate_sha1_hash(final_hash); // Call the SHA-1 in software
-  gettimeofday(&end, NULL);
-
-  /* Print the results to the console */
-  printf("Software: Time taken[in uS]=%ld\n",
-         ((end.tv_sec * 1000000 + end.tv_usec) -
-          (start.tv_sec * 1000000 + start.tv_usec)));
-
-  /* Turn on the led if the output is correct */
-  if (isMatched(expectedHash, final_hash)) {
-    *led_ptr = 0xFF;
+  crypto_engine_perf perf;
+
+  crypto_engine_init(&engine, (volatile uint32_t *)CRYPTO_ENGINE_BASE);
+  alt_ic_isr_register(CRYPTO_ENGINE_IRQ_INTERRUPT_CONTROLLER_ID,
+                      CRYPTO_ENGINE_IRQ, crypto_engine_isr, &engine, NULL);
+
+  /* Without a timestamp timer the built-in costs are used */
+  if (alt_timestamp_start() < 0)
+    platform.now = NULL;
+  crypto_scheduler_init(&scheduler, &engine, &platform); // calibrates
+  for (int b = 0; b < CRYPTO_BACKENDS; b++) {
+    printf("%s: setup=%lu ticks, per byte=%lu/%d ticks\n", backend_name[b],
+           (unsigned long)scheduler.cost[b].setup,
+           (unsigned long)scheduler.cost[b].per_byte, 1 << CRYPTO_COST_SHIFT);
   }
-  /* Event loop never exits. */
-  while (1)
-    ;
-#endif
 
-#ifdef CRYPTO_ACCELERATOR_ENABLED /* HW computation */
-  volatile unsigned int *crypto_engine_ptr =
-      (volatile unsigned int *)0x80009000;
-  *(crypto_engine_ptr + CRYPTO_CTRL_REG) =
-      (1 << CRYPTO_CTRL_REG_BIT_0); // set bit 0 to start
-  gettimeofday(&start, NULL);       // start system timer
-  while (*(crypto_engine_ptr + CRYPTO_STATUS_REG) ==
-         (1 << CRYPTO_STATUS_REG_BIT_0))
-    ;
+  /* The scheduler picks the backend that finishes first */
+  crypto_engine_perf_sample(&engine, &perf, 1); // clear the HW counters
+  gettimeofday(&start, NULL); // start system timer
+  int backend = crypto_scheduler_hash(&scheduler, "abc", 3, final_hash);
   gettimeofday(&end, NULL); // end system timer
 
-  printf("Hardware: Time taken[in uS]=%ld\n",
-         ((end.tv_sec * 1000000 + end.tv_usec) -
-          (start.tv_sec * 1000000 + start.tv_usec)));
-
-  /* Get the output from HW data registers */
-  unsigned int sha_engine_output[FINAL_HASH_SIZE] = {};
-  sha_engine_output[4] = *(crypto_engine_ptr + CRYPTO_DATA_REG_0);
-  sha_engine_output[3] = *(crypto_engine_ptr + CRYPTO_DATA_REG_1);
-  sha_engine_output[2] = *(crypto_engine_ptr + CRYPTO_DATA_REG_2);
-  sha_engine_output[1] = *(crypto_engine_ptr + CRYPTO_DATA_REG_3);
-  sha_engine_output[0] = *(crypto_engine_ptr + CRYPTO_DATA_REG_4);
+  if (backend >= 0) {
+    printf("%s: Time taken[in uS]=%ld\n", backend_name[backend],
+           ((end.tv_sec * 1000000 + end.tv_usec) -
+            (start.tv_sec * 1000000 + start.tv_usec)));
+  }
+  crypto_engine_perf_sample(&engine, &perf, 0);
+  if (backend == CRYPTO_BACKEND_ACCELERATOR && perf.blocks > 0) {
+    /* Accelerator clock cycles, without the CPU's timer and poll loop */
+    printf("Hardware: busy=%lu idle=%lu stall=%lu cycles, blocks=%lu, "
+           "cycles/block=%lu\n",
+           (unsigned long)perf.busy, (unsigned long)perf.idle,
+           (unsigned long)perf.stall, (unsigned long)perf.blocks,
+           (unsigned long)(perf.busy / perf.blocks));
+  }
 
-  if (isMatched(expectedHash, sha_engine_output)) {
+  if (backend >= 0 && isMatched(expectedHash, final_hash)) {
     *led_ptr = 0xFF; /* Turn on the led if the output is correct */
   }
-  print_final_hash(sha_engine_output); /* Print the results to the console */
+  print_final_hash(final_hash); /* Print the results to the console */
 
+  /* Event loop never exits. */
   while (1)
     ;
 
-#endif
   return 0;
 }
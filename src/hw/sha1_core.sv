@@ -0,0 +1,194 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* SHA-1 compression core.
+	ROUNDS_PER_CYCLE rounds (1, 2, 4, 8 or 16) are unrolled into one clock, so a block takes
+	80/ROUNDS_PER_CYCLE cycles. The message schedule lives in a 16 word circular buffer:
+	round t reads and replaces W[t mod 16], no words are shifted.
+
+	The next block is accepted in the cycle of the last rounds of the current one (ready is
+	high then), so a block staged by the pre-processing stage follows without a bubble and
+	its chaining value is taken straight from the adders.
+
+	Critical path: e + K + W does not depend on the round's A, so behind rotate_left(A,5) every
+	round only adds f(B,C,D) and a three operand add. One clock spans ROUNDS_PER_CYCLE of
+	these rounds plus the chaining add when the next block of a message is loaded. */
+
+module sha1_core #(parameter int ROUNDS_PER_CYCLE = 4, parameter int TAG_WIDTH = 1) (
+	input  logic clk, input logic reset_n,
+	input  logic load,                   /* Starts a block, honoured while ready is high */
+	input  logic first,                  /* The block starts a message: chain from H0..H4 */
+	input  logic [31:0] block [15:0],    /* Message block, block[0] = W0 */
+	input  logic [TAG_WIDTH-1:0] tag_in, /* Carried along with the block */
+	output logic ready,                  /* A block can be loaded in this cycle */
+	output logic done,                   /* One cycle pulse: digest holds the new hash */
+	output logic [31:0] digest [4:0],    /* digest[0] = H0 ... digest[4] = H4 */
+	output logic [TAG_WIDTH-1:0] tag_out /* tag_in of the block digest belongs to */
+	);
+
+	localparam ROUNDS = 80;
+
+	initial assert (16 % ROUNDS_PER_CYCLE == 0)
+		else $error("ROUNDS_PER_CYCLE must divide 16");
+
+	/*SHA-1 constants*/
+	localparam logic [31:0] H0 = 32'h67452301;
+	localparam logic [31:0] H1 = 32'hefcdab89;
+	localparam logic [31:0] H2 = 32'h98badcfe;
+	localparam logic [31:0] H3 = 32'h10325476;
+	localparam logic [31:0] H4 = 32'hc3d2e1f0;
+
+	localparam logic [31:0] K0 = 32'h5a827999;
+	localparam logic [31:0] K1 = 32'h6ed9eba1;
+	localparam logic [31:0] K2 = 32'h8f1bbcdc;
+	localparam logic [31:0] K3 = 32'hca62c1d6;
+
+	logic [31:0] A, B, C, D, E;  /* Working variables */
+	logic [31:0] H [4:0];        /* Chaining value the current block started from */
+	logic [31:0] W [15:0];       /* Circular message schedule */
+	logic [6:0]  t;              /* First round of this cycle */
+	logic        busy;           /* A block is being compressed */
+	logic [TAG_WIDTH-1:0] tag;   /* tag_in of the current block */
+
+	logic [31:0] A_n, B_n, C_n, D_n, E_n; /* Working variables after this cycle's rounds */
+	logic [31:0] W_n [15:0];              /* Schedule after this cycle's rounds */
+	logic [31:0] final_hash [4:0];        /* Chaining value once the last rounds are done */
+	logic [31:0] chain [4:0];             /* Chaining value of a block loaded now */
+	logic        last;                    /* This cycle runs the last rounds */
+
+	/* Rotation by a constant: plain wiring */
+	function automatic logic [31:0] rotate_left(input logic [31:0] data, input int count);
+		return (data << count) | (data >> (32 - count));
+	endfunction
+
+	/* ROUNDS_PER_CYCLE rounds, unrolled */
+	always_comb
+		begin : rounds
+			logic [31:0] a, b, c, d, e, f, k, temp;
+			int unsigned idx;
+
+			a   = A;
+			b   = B;
+			c   = C;
+			d   = D;
+			e   = E;
+			W_n = W;
+
+			for(int r = 0; r < ROUNDS_PER_CYCLE; r++)
+			begin
+				idx = t + r;
+				if(idx >= 16)
+					W_n[idx & 15] = rotate_left(W_n[(idx - 3) & 15] ^ W_n[(idx - 8) & 15] ^
+					                            W_n[(idx - 14) & 15] ^ W_n[idx & 15], 1);
+
+				if(idx < 20)
+				begin
+					f = ((b & c) | ((~b) & d));
+					k = K0;
+				end
+				else if(idx < 40)
+				begin
+					f = (b ^ c ^ d);
+					k = K1;
+				end
+				else if(idx < 60)
+				begin
+					f = ((b & c) | (b & d) | (c & d));
+					k = K2;
+				end
+				else
+				begin
+					f = (b ^ c ^ d);
+					k = K3;
+				end
+
+				temp = rotate_left(a, 5) + f + (e + k + W_n[idx & 15]);
+				e = d;
+				d = c;
+				c = rotate_left(b, 30);
+				b = a;
+				a = temp;
+			end
+
+			A_n = a;
+			B_n = b;
+			C_n = c;
+			D_n = d;
+			E_n = e;
+		end : rounds
+
+	assign final_hash[0] = H[0] + A_n;
+	assign final_hash[1] = H[1] + B_n;
+	assign final_hash[2] = H[2] + C_n;
+	assign final_hash[3] = H[3] + D_n;
+	assign final_hash[4] = H[4] + E_n;
+
+	assign last  = busy && (t == ROUNDS - ROUNDS_PER_CYCLE);
+	assign ready = !busy || last;
+
+	/* A message starts from H0..H4; a following block from the hash of the one before */
+	always_comb
+		begin : chaining
+			if(first)
+				begin
+					chain[0] = H0;
+					chain[1] = H1;
+					chain[2] = H2;
+					chain[3] = H3;
+					chain[4] = H4;
+				end
+			else
+				for(int j = 0; j < 5; j++)
+					chain[j] = last ? final_hash[j] : digest[j];
+		end : chaining
+
+	always_ff@(posedge clk)
+		begin : compression
+			if(reset_n == 1'b0)
+				begin
+					busy <= 1'b0;
+					done <= 1'b0;
+					t    <= 'd0;
+				end
+			else
+				begin
+					done <= last;
+
+					if(busy)
+						begin
+							A <= A_n;
+							B <= B_n;
+							C <= C_n;
+							D <= D_n;
+							E <= E_n;
+							W <= W_n;
+							t <= t + ROUNDS_PER_CYCLE;
+
+							if(last)
+								begin
+									digest  <= final_hash;
+									tag_out <= tag;
+									busy    <= 1'b0;
+								end
+						end
+
+					if(load && ready) /* Overrides the update above */
+						begin
+							A    <= chain[0];
+							B    <= chain[1];
+							C    <= chain[2];
+							D    <= chain[3];
+							E    <= chain[4];
+							H    <= chain;
+							W    <= block;
+							tag  <= tag_in;
+							t    <= 'd0;
+							busy <= 1'b1;
+						end
+				end
+		end : compression
+
+endmodule
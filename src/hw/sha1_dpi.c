@@ -0,0 +1,42 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha1_dpi.c
+* Author          : Jishnu Murali Thampan
+* Description     : DPI-C reference model for tb_crypto_engine.sv: the
+* 		              testbench streams each message through the software
+* 		              SHA-1 byte by byte and compares the digest it reads
+* 		              from the accelerator against it.
+****************************************************************************/
+
+#include "sha-1.h"
+
+static sha1_ctx dpi_ctx;                         /**< @brief Open message */
+static uint32_t dpi_final_hash[FINAL_HASH_SIZE]; /**< @brief Last digest */
+
+/**
+ * Starts a message
+ * @return void
+ */
+void sha1_dpi_init(void) { sha1_init(&dpi_ctx); }
+/**
+ * Appends one byte to the message
+ * @param[in] data Byte
+ * @return void
+ */
+void sha1_dpi_update(int data) {
+  uint8_t byte = (uint8_t)data;
+  sha1_update(&dpi_ctx, &byte, 1);
+}
+/**
+ * Finishes the message
+ * @return void
+ */
+void sha1_dpi_final(void) { sha1_final(&dpi_ctx, dpi_final_hash); }
+/**
+ * Returns a word of the last digest
+ * @param[in] index 0 for H0 ... 4 for H4
+ * @return Digest word
+ */
+int sha1_dpi_word(int index) {
+  return (int)dpi_final_hash[index % FINAL_HASH_SIZE];
+}
@@ -0,0 +1,140 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* CORES copies of state_machine_toplevel_framework behind one block interface.
+	Arbitration: the first block of a message goes to a free core, round-robin from the core
+	after the one picked last; a core stays with its message until the digest has been handed
+	out, and the following blocks find it by their tag. So independent messages run on all
+	cores at once while the blocks of one message keep their order. A first block waits while
+	all cores hold a message; the blocks of the messages already running must not be queued
+	behind it.
+
+	Finished messages are handed out one per cycle (q_complete, combinational) from the lowest
+	core with a digest; q_stall holds them back, e.g. while the completion queue is full. The
+	framework keeps its digest until then, as a core only takes a new message afterwards. */
+
+module sha_core_array #(parameter int CORES = 1, parameter int ROUNDS_PER_CYCLE = 4) (
+	input  logic clk, input logic reset_n,
+	input  logic block_valid,            /* block_in holds a block to be taken */
+	input  logic block_first,            /* The block starts a message */
+	input  logic block_last,             /* The block ends the message */
+	input  logic [6:0] block_bytes,      /* Message bytes in a last block, 0 to 64 */
+	input  logic [15:0] block_tag,       /* Job tag; routes the blocks after the first */
+	input  logic [31:0] block_in [15:0], /* Message block, block_in[0] = bytes 0..3 */
+	output logic block_taken,            /* One cycle pulse: block_in may be rewritten */
+	output logic [4:0] blocks_loaded,    /* Blocks entering a core in this cycle */
+	input  logic q_stall,                /* Do not hand out a digest in this cycle */
+	output logic q_stalled,              /* A digest is held back by q_stall */
+	output logic q_busy,                 /* A message is being hashed */
+	output logic q_done,                 /* All messages are done */
+	output logic q_complete,             /* A message is handed out in this cycle */
+	output logic [15:0] q_tag,           /* block_tag of that message */
+	output logic [31:0] q_output_reg [4:0],
+	output logic [CORES-1:0] core_busy   /* The core holds a message */
+	);
+
+	initial assert (CORES >= 1 && CORES <= 16)
+		else $error("CORES must be 1 to 16");
+
+	logic [CORES-1:0] valid, taken, loaded, busy, done, complete, pending;
+	logic [15:0] tag [CORES-1:0];        /* Per core q_tag */
+	logic [31:0] digest [CORES-1:0][4:0]; /* Per core q_output_reg */
+	logic [15:0] owner [CORES-1:0];      /* Tag of the message a core holds */
+	logic [3:0]  next_core;              /* Round-robin start for first blocks */
+	logic [3:0]  target, emit;
+	logic        routed;
+
+	for(genvar c = 0; c < CORES; c++)
+	begin : cores
+		state_machine_toplevel_framework #(.ROUNDS_PER_CYCLE(ROUNDS_PER_CYCLE)) framework(.clk(clk),
+			.reset_n(reset_n),
+			.block_valid(valid[c]),
+			.block_first(block_first),
+			.block_last(block_last),
+			.block_bytes(block_bytes),
+			.block_tag(block_tag),
+			.block_in(block_in),
+			.block_taken(taken[c]),
+			.block_loaded(loaded[c]),
+			.q_busy(busy[c]),
+			.q_done(done[c]),
+			.q_complete(complete[c]),
+			.q_tag(tag[c]),
+			.q_output_reg(digest[c]));
+
+		/* Not offered again while the pulse of the core that took it is out */
+		assign valid[c] = block_valid && !block_taken && routed && (target == c);
+	end
+
+	/* Core the block in block_in goes to */
+	always_comb
+		begin : routing
+			routed = 1'b0;
+			target = 'd0;
+			for(int k = 0; k < CORES; k++)
+				begin
+					int c;
+					c = (int'(next_core) + k) % CORES;
+					if(!routed && (block_first ? !core_busy[c] : (core_busy[c] && owner[c] == block_tag)))
+						begin
+							routed = 1'b1;
+							target = 4'(c);
+						end
+				end
+		end : routing
+
+	/* Core whose digest is handed out */
+	always_comb
+		begin : hand_out
+			emit = 'd0;
+			for(int c = CORES - 1; c >= 0; c--)
+				if(pending[c])
+					emit = 4'(c);
+		end : hand_out
+
+	assign block_taken  = |taken;
+	assign q_complete   = |pending && !q_stall;
+	assign q_stalled    = |pending && q_stall;
+	assign q_tag        = tag[emit];
+	assign q_output_reg = digest[emit];
+	assign q_busy       = |busy || |core_busy;
+	assign q_done       = !(|core_busy) && |done;
+
+	always_comb
+		begin : load_count
+			blocks_loaded = 'd0;
+			for(int c = 0; c < CORES; c++)
+				blocks_loaded += 5'(loaded[c]);
+		end : load_count
+
+	always_ff@(posedge clk)
+		begin : ownership
+			if(reset_n == 1'b0)
+				begin
+					core_busy <= 'd0;
+					pending   <= 'd0;
+					next_core <= 'd0;
+				end
+			else
+				for(int c = 0; c < CORES; c++)
+					begin
+						if(taken[c] && block_first) /* block_in is unchanged during the pulse */
+							begin
+								core_busy[c] <= 1'b1;
+								owner[c]     <= block_tag;
+								next_core    <= 4'((c + 1) % CORES);
+							end
+						if(complete[c])
+							pending[c] <= 1'b1;
+						if(q_complete && emit == c)
+							begin
+								pending[c]   <= 1'b0;
+								core_busy[c] <= 1'b0;
+							end
+					end
+		end : ownership
+
+endmodule
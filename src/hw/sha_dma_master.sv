@@ -0,0 +1,141 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* Avalon-MM burst master that feeds a message from memory to the framework.
+	A descriptor (source address, length in bytes, result address) is latched on start. Every
+	64 byte block is read with one burst of up to 16 words, byte swapped into the block layout
+	(message byte 0 in bit [31:24]) and handed over on the same block_valid/block_taken
+	handshake the block registers use. The framework copies it into its staging register, so
+	the burst for the block after starts while the core is still compressing: three blocks are
+	in flight and the core does not wait for memory as long as a burst takes less than
+	80/ROUNDS_PER_CYCLE cycles. Once the message has completed, its digest is kept in hash,
+	H0..H4 are written to the result address as five little-endian words (a uint32_t[5] for
+	the CPU) and done pulses.
+
+	The source address must be word aligned; the last burst only reads the words that hold
+	message bytes. */
+
+module sha_dma_master(
+	input  logic clk, input logic reset_n,
+	input  logic start,                   /* Level: a descriptor is valid, latched when idle */
+	input  logic [31:0] source_address,   /* Message, word aligned */
+	input  logic [31:0] length,           /* Message bytes */
+	input  logic [31:0] result_address,   /* Five words: H0..H4 */
+	output logic block_valid,             /* block_out holds a block to be taken */
+	output logic block_first,             /* The block starts a message */
+	output logic block_last,              /* The block ends the message */
+	output logic [6:0] block_bytes,       /* Message bytes in a last block */
+	output logic [31:0] block_out [15:0], /* Message block, block_out[0] = bytes 0..3 */
+	input  logic block_taken,             /* One cycle pulse: block_out may be refilled */
+	input  logic complete,                /* The message is handed out in this cycle */
+	input  logic [31:0] digest [4:0],     /* Its digest, digest[0] = H4 */
+	output logic [31:0] hash [4:0],       /* digest, kept from complete on */
+	output logic done,                    /* One cycle pulse: the result has been written */
+	/* Avalon-MM master */
+	output logic [31:0] m_address,
+	output logic m_read,
+	output logic m_write,
+	output logic [4:0] m_burstcount,
+	output logic [31:0] m_writedata,
+	input  logic [31:0] m_readdata,
+	input  logic m_readdatavalid,
+	input  logic m_waitrequest
+	);
+
+	enum logic [2:0] {__IDLE, __READ, __RECEIVE, __HAND, __HASH, __WRITE, __FINISH} state;
+
+	logic [31:0] address;   /* Next block in memory */
+	logic [31:0] remaining; /* Message bytes not handed over yet */
+	logic [31:0] result;    /* Result address */
+	logic [4:0]  words;     /* Words in the burst of the current block */
+	logic [3:0]  count;     /* Words received / written so far */
+
+	/* Words holding message bytes, at most one block */
+	function automatic logic [4:0] burst_words(input logic [31:0] bytes);
+		return (bytes >= 64) ? 5'd16 : 5'((bytes + 3) >> 2);
+	endfunction
+
+	assign block_valid  = (state == __HAND);
+	assign block_last   = (remaining <= 64);
+	assign block_bytes  = block_last ? remaining[6:0] : 7'd64;
+
+	assign m_read       = (state == __READ);
+	assign m_write      = (state == __WRITE);
+	assign m_burstcount = (state == __READ) ? words : 5'd1;
+	assign m_address    = (state == __WRITE) ? result + {count, 2'b00} : address;
+	assign m_writedata  = hash[3'd4 - count[2:0]];
+
+	always_ff@(posedge clk)
+		begin : dma
+			if(reset_n == 1'b0)
+				begin
+					state <= __IDLE;
+					done  <= 1'b0;
+				end
+			else
+				begin
+					done <= 1'b0;
+
+					case(state)
+						__IDLE: if(start)
+							begin
+								address     <= source_address;
+								remaining   <= length;
+								result      <= result_address;
+								words       <= burst_words(length);
+								block_first <= 1'b1;
+								state       <= (length == 0) ? __HAND : __READ;
+							end
+
+						__READ: if(!m_waitrequest) /* Burst accepted */
+							begin
+								count <= 'd0;
+								state <= __RECEIVE;
+							end
+
+						__RECEIVE: if(m_readdatavalid)
+							begin
+								block_out[count] <= {m_readdata[7:0], m_readdata[15:8],
+								                     m_readdata[23:16], m_readdata[31:24]};
+								count <= count + 1;
+								if(5'(count) == words - 1)
+									state <= __HAND;
+							end
+
+						__HAND: if(block_taken) /* In the staging register: fetch the next */
+							begin
+								block_first <= 1'b0;
+								address     <= address + 32'd64;
+								remaining   <= remaining - 32'd64;
+								words       <= burst_words(remaining - 32'd64);
+								state       <= block_last ? __HASH : __READ;
+							end
+
+						__HASH: if(complete)
+							begin
+								hash  <= digest;
+								count <= 'd0;
+								state <= __WRITE;
+							end
+
+						__WRITE: if(!m_waitrequest)
+							begin
+								count <= count + 1;
+								if(count == 4)
+									begin
+										done  <= 1'b1;
+										state <= __FINISH;
+									end
+							end
+
+						__FINISH: state <= __IDLE; /* start drops with done */
+
+						default: state <= __IDLE;
+					endcase
+				end
+		end : dma
+
+endmodule
@@ -4,246 +4,188 @@
 
 package state_machine_definitions;
 
-	enum logic [1:0] {__RESET = 2'b00, __IDLE = 2'b01, __PROC = 2'b10, __DONE = 2'b11} state;
+	/* Only the type lives here: every framework instance declares its own state */
+	typedef enum logic [1:0] {__RESET = 2'b00, __IDLE = 2'b01, __PROC = 2'b10, __DONE = 2'b11} state_t;
 
 	// ...
 	
 endpackage
 
-module state_machine_toplevel_framework(
-	input logic clk, input logic reset_n, input logic start,
-	output logic q_done,
+/* Message path: software hands over one 64 byte block at a time (block_valid). The
+	pre-processing stage copies it into a staging register while the core compresses the
+	block before, so block_in is free again after block_taken. A last block carries the
+	number of message bytes in it; the stage appends the 1 bit and the message length
+	itself, adding a block of its own when they do not fit. The core chains H0..H4 from
+	block to block and q_complete reports the digest of a finished message with its tag. */
+
+module state_machine_toplevel_framework #(parameter int ROUNDS_PER_CYCLE = 4) (
+	input logic clk, input logic reset_n,
+	input logic block_valid,            /* block_in holds a block to be taken */
+	input logic block_first,            /* The block starts a message */
+	input logic block_last,             /* The block ends the message */
+	input logic [6:0] block_bytes,      /* Message bytes in a last block, 0 to 64 */
+	input logic [15:0] block_tag,       /* Job tag, reported with the digest */
+	input logic [31:0] block_in [15:0], /* Message block, block_in[0] = bytes 0..3 */
+	output logic block_taken,           /* One cycle pulse: block_in may be rewritten */
+	output logic block_loaded,          /* One cycle pulse: a block, or a padding block,
+	                                       enters the core */
+	output logic q_busy,                /* A message is being hashed */
+	output logic q_done,                /* q_output_reg holds the digest of the last message */
+	output logic q_complete,            /* One cycle pulse: a message has finished */
+	output logic [15:0] q_tag,          /* block_tag of the finished message */
 	output logic [31:0]q_output_reg [4:0]
 	);
 	
 	import state_machine_definitions::*;
 	
-	localparam LOOP_ITERATIONS = 120;
-	
-	localparam ITERATIONS = LOOP_ITERATIONS - 1;
-	localparam BITWIDTH   = $clog2(ITERATIONS);
-	
-	
-		/* ### start detection ... ################################################
-	
-						  _______________
-			__________|					  |___________
-			
-						 ^
-						 |
-						
-					  START
-	
-	*/
-	
-	logic [3:0] sync_reg = 4'b0000;
-	
-	/*Edge detection block*/
-	always_ff@(posedge clk)
-		begin : start_detection
-			if(reset_n == 1'b0)
-				sync_reg <= 4'b0000;
-			else
-				sync_reg <= {sync_reg[2:0],start};
-		end : start_detection
-			
-	logic sync_start;
-	assign sync_start = (sync_reg == 4'b0011) ? 1'b1 : 1'b0;
-	
-	logic [BITWIDTH-1:0] state_counter = 'd0;
-	
-	logic [1:0] ctrl = 2'd0;
-	
-	static int i = 0; /* For counting SHA-1 iterations*/
+	localparam OUTPUT_BITWIDTH = 512;
+	localparam LENGTH_BITWIDTH = 64;
 	
-	/*SHA-1 constants*/
-	logic [31:0] Hf0 = 32'h67452301;
-	logic [31:0] Hf1 = 32'hefcdab89;
-	logic [31:0] Hf2 = 32'h98badcfe;
-	logic [31:0] Hf3 = 32'h10325476;
-	logic [31:0] Hf4 = 32'hc3d2e1f0;
+	state_t state;                    /* State of the central state machine */
+	logic [31:0] state_counter = 'd0; /* Cycles spent on the current message */
 	
 	/* For Preprocessor Stage*/
-	localparam inputLength = 3;
-	logic[(inputLength * 8) - 1:0] input_message = "abc";
-	localparam OUTPUT_BITWIDTH = 512;
+	logic [LENGTH_BITWIDTH-1:0] message_length = 'd0; /* Message bits taken so far */
+	logic [LENGTH_BITWIDTH-1:0] total_length;         /* ... including block_in */
+	logic take;                                       /* block_in is taken this cycle */
 			
-	/* The output of the pre-processing stage is stored here*/
-	logic[OUTPUT_BITWIDTH:0] p_message32_16;
-		
-	/* For Conversion stage*/
+	/* The output of the pre-processing stage: block_in, padded if it is the last one */
 	logic[31:0] Word[0:15];
 
+	/* Staging register between pre-processing and the core: the next block is prepared
+	   while the core still compresses the current one */
+	logic [31:0] next_block [15:0];
+	logic next_valid = 1'b0, next_first, next_last;
+	logic [15:0] next_tag;
+
+	/* Padding that did not fit into the last block goes into a block of its own */
+	logic [31:0] pad_block [15:0];
+	logic pad_pending = 1'b0, pad_marker;
+	logic [15:0] pad_tag;
+
 	/* For compression stage */
-	logic [31:0] Wt;
-	logic [31:0] temp;
-	logic [31:0] f,k;
-	
-	/*SHA-1 constants*/
-	logic[31:0] H0 = 32'h67452301;
-	logic[31:0] H1 = 32'hefcdab89;
-	logic[31:0] H2 = 32'h98badcfe;
-	logic[31:0] H3 = 32'h10325476;
-	logic[31:0] H4 = 32'hc3d2e1f0;
-		
-	logic [31:0] K0 = 32'h5a827999;
-	logic [31:0] K1 = 32'h6ed9eba1;
-	logic [31:0] K2 = 32'h8f1bbcdc;
-	logic [31:0] K3 = 32'hca62c1d6;
-	
-	logic[31:0] Wtemp;
+	logic core_ready, core_done;
+	logic [31:0] core_digest [4:0];
+	logic [16:0] core_tag; /* {job tag, last block of the message} */
+
+	sha1_core #(.ROUNDS_PER_CYCLE(ROUNDS_PER_CYCLE), .TAG_WIDTH(17)) core(.clk(clk),
+		.reset_n(reset_n),
+		.load(next_valid),
+		.first(next_first),
+		.block(next_block),
+		.tag_in({next_tag, next_last}),
+		.ready(core_ready),
+		.done(core_done),
+		.digest(core_digest),
+		.tag_out(core_tag));
+
+	/* The staging register is free, or hands its block to the core at this edge */
+	assign take = block_valid && !block_taken && !pad_pending && (!next_valid || core_ready);
 
-	logic[31:0] W[15:0];
-	logic [31:0] A = 32'h67452301;
-	logic [31:0] B = 32'hefcdab89;
-	logic [31:0] C = 32'h98badcfe;
-	logic [31:0] D = 32'h10325476;
-	logic [31:0] E = 32'hc3d2e1f0;	
-	logic [OUTPUT_BITWIDTH-1:0] Message_Digest;
-	 
-	/* Function to perform rotation to the left*/
-	function logic [31:0] rotate_left(int count, logic [31:0] data);
-		for (int j = 0; j < count; j = j + 1) begin
-			data = { data[30:0],data[31] };
-    		end
-		return data;
-	endfunction
-	
-	/* States used for the SHA-processing*/
-	enum logic [1:0] {SHA_IDLE = 2'b00, SHA_PRE_PROCESSING = 2'b01, SHA_CORE = 2'b10, SHA_DONE = 2'b11} sha_state;
-	
-	logic trigger = 1'd0; /* The central control path state machine triggers this to initiate the hash computation*/
-	
-	/* State machine to perform different stages in SHA-1 computation*/
-	always_ff@(posedge clk)
-	 begin:exec_state_machine
-			if(reset_n == 0)
-				sha_state <= SHA_IDLE;
-				
-			case(sha_state)
-				SHA_IDLE: /* Represents the IDLE State */
-					begin
-						if(trigger == 1'd1) // this is set from the central state machine
-							sha_state <= SHA_PRE_PROCESSING;
-					end
-							
-				SHA_PRE_PROCESSING: /* Represents the SHA Pre-processing State */
-					begin
-						preProcessing();
-						sha_state <= SHA_CORE;
-					end
-				
-				SHA_CORE: /* Represents the SHA-Kernel*/
-					begin
-						if(SHA_Accelerator() == 1)
-							sha_state <= SHA_DONE;
-					end
-				
-				SHA_DONE: /* Represents the Final state where the hashes are acuumulated and output is available */
-					begin
-						sha_state <= SHA_IDLE;
-					end
-					
-				endcase
-	 end:exec_state_machine
-	
 	/* Function which performs SHA-Preprocessing*/
-	function void 	preProcessing();
-		p_message32_16[OUTPUT_BITWIDTH:OUTPUT_BITWIDTH-(inputLength * 8)] = input_message;
-		p_message32_16[OUTPUT_BITWIDTH-((inputLength * 8) + 1)] = 1'b1; //append 1 to the end of the msg
-		
-		for(int i  = (OUTPUT_BITWIDTH - ((inputLength * 8) + 2)); i > 63; i-- )
-		begin
-			p_message32_16[i] = 1'b0; // fill zeros
-		end
-		
-		p_message32_16[63:0] = inputLength * 8; // length of the array
-	
-		/* Conversion Stage*/
-		for(int i = 1; i < 17; i++) 
-		begin
-			Word[16-i] = p_message32_16[(i * 32)-1 -:32];
-		end
-		
-	endfunction
-	
-	/* Performs compression and intermediate hash accumulation
-	   Algorithm part- the c code is directly mapped here*/
-	function bit SHA_Accelerator();
-							
-      /* Compression stage*/							
-		if(i >= 0 && i < 16)
-		begin
-			Wt   = Word[i];
-			W[i] = Word[i];
-		end
-	
-		else if(i >= 16 && i < 80)
-		begin
-			Wtemp = rotate_left(1, (W[0]^W[2]^W[8]^W[13]));
-		
-			for(int j = 0; j < 16; j++)
-			begin
-				if(j < 15) 
-					W[j] = W[j+1];
-				else
-					W[j] = Wtemp;
+	always_comb
+		begin : preProcessing
+			total_length = (block_first ? 'd0 : message_length) +
+				(block_last ? LENGTH_BITWIDTH'({block_bytes, 3'b000}) : LENGTH_BITWIDTH'(OUTPUT_BITWIDTH));
+
+			for(int i = 0; i < 16; i++)
+				for(int b = 0; b < 4; b++)
+					if(!block_last || (4 * i + b) < block_bytes)
+						Word[i][31 - 8 * b -: 8] = block_in[i][31 - 8 * b -: 8];
+					else if((4 * i + b) == block_bytes)
+						Word[i][31 - 8 * b -: 8] = 8'h80; //append 1 to the end of the msg
+					else
+						Word[i][31 - 8 * b -: 8] = 8'h00; // fill zeros
+
+			if(block_last && block_bytes <= 55)
+				begin
+					Word[14] = total_length[63:32]; // length of the message
+					Word[15] = total_length[31:0];
+				end
+
+			for(int i = 0; i < 16; i++)
+				pad_block[i] = 32'd0;
+			pad_block[0]  = pad_marker ? 32'h80000000 : 32'd0;
+			pad_block[14] = message_length[63:32];
+			pad_block[15] = message_length[31:0];
+		end : preProcessing
+
+	/* Pre-processing stage, fills the staging register */
+	always_ff@(posedge clk)
+		begin : pre_processing_stage
+			if(reset_n == 1'b0)
+				begin
+					next_valid     <= 1'b0;
+					pad_pending    <= 1'b0;
+					block_taken    <= 1'b0;
+					message_length <= 'd0;
 				end
-		
-				Wt =  Wtemp;
-		   end
-			
-		
-		if(i >= 0 && i < 80)
-		begin
-			if(i >= 0 && i < 20)
-			begin
-				f = ((B & C) | ((~B) & D));
-				k =  K0;
-			end
-			else if(i >= 20 && i < 40)
-			begin
-				f = (B ^ C ^ D);
-				k    =  K1;    		
-			end
-			else if(i >= 40 && i < 60)
-			begin
-				f = ((B & C) | (B & D) | (C & D));
-				k    =  K2;    		
-			end
-			else if(i >= 60 && i < 80)
-			begin
-				f = (B ^ C ^ D);
-				k =  K3;
-			end
 			else
-			begin
-	
-			end
-			
-			temp = rotate_left(5, A) + f + E + k + Wt;
-			E = D;
-			D = C;
-			C = rotate_left(30, B);
-			B = A;
-			A = temp;
-			
-		end
+				begin
+					block_taken <= take;
 
-		Hf0 = H0 + A;
-		Hf1 = H1 + B;
-		Hf2 = H2 + C;
-		Hf3 = H3 + D;
-		Hf4 = H4 + E;
-		Message_Digest = (Hf0 << 128) | (Hf1 << 96) | (Hf2 << 64) | (Hf3 << 32) | Hf4;
-		i++;
-		
-		if(i== 80)
-			return 1;
-		else
-			return 0;
-			
-	endfunction
+					if(next_valid && core_ready) // handed over to the core
+						next_valid <= 1'b0;
+
+					if(pad_pending && (!next_valid || core_ready))
+						begin
+							next_block  <= pad_block;
+							next_first  <= 1'b0;
+							next_last   <= 1'b1;
+							next_tag    <= pad_tag;
+							next_valid  <= 1'b1;
+							pad_pending <= 1'b0;
+						end
+					else if(take)
+						begin
+							for(int i = 0; i < 16; i++)
+								next_block[i] <= Word[i];
+							next_first     <= block_first;
+							next_tag       <= block_tag;
+							next_valid     <= 1'b1;
+							message_length <= total_length;
+
+							if(block_last && block_bytes > 55) /* No room for the length */
+								begin
+									next_last   <= 1'b0;
+									pad_pending <= 1'b1;
+									pad_marker  <= (block_bytes == 64);
+									pad_tag     <= block_tag;
+								end
+							else
+								next_last <= block_last;
+						end
+				end
+		end : pre_processing_stage
+
+	/* Output registers: populated when the last block of a message leaves the core */
+	always_ff@(posedge clk)
+		begin : output_stage
+			if(reset_n == 1'b0)
+				begin
+					q_complete <= 1'b0;
+					q_done     <= 1'b0;
+				end
+			else
+				begin
+					q_complete <= 1'b0;
+
+					if(take && block_first)
+						q_done <= 1'b0; // Reset previous output if any
+
+					if(core_done && core_tag[0])
+						begin
+							q_output_reg[0] <= core_digest[4];
+							q_output_reg[1] <= core_digest[3];
+							q_output_reg[2] <= core_digest[2];
+							q_output_reg[3] <= core_digest[1];
+							q_output_reg[4] <= core_digest[0];
+							q_tag           <= core_tag[16:1];
+							q_complete      <= 1'b1;
+							q_done          <= 1'b1;
+						end
+				end
+		end : output_stage
 	
 	// ### 'Central state machine' ... ################################################
 		
@@ -251,84 +193,42 @@ module state_machine_toplevel_framework(
 		begin : state_machine
 			if(reset_n == 1'b0)
 				begin
-					ctrl          <= 2'd0;
 					state_counter <=  'd0;
 					state			  <= __RESET;
-					q_done <= 1'b0;
 				end
 			else
 				case(state)
 					__RESET: begin
-					
-						ctrl          <= 2'd0;
 						state_counter <=  'd0;
 						state 		  <= __IDLE;
-						q_done 		  <= 1'b0;
 					end 
 					__IDLE:  begin
-					
-						ctrl          <= 2'd0;
 						state_counter <=  'd0;
 						
-						if(sync_start)begin
+						if(take)
 							state  <= __PROC;
-							q_done <= 1'b0; // Reset previous output if any
-						end
 					end
 					__PROC:  begin
-
-						trigger <= 1'd1;/* Start processing here */
-						
-						if(state_counter < 10)
-							ctrl <= 2'b00;
-						else if(state_counter >= 10 && state_counter < 64)
-							ctrl <= 2'b01;
-						else if(state_counter >= 64 && state_counter < 110)
-							ctrl <= 2'b10;
-						else
-							ctrl <= 2'b11;				
-						
-						
-						if(sha_state == SHA_DONE)
-							begin
-								$display("Hash value of %s = %x",input_message,Message_Digest);
-								/* Populate the output registers*/
-								q_output_reg[0] <= Message_Digest[31:0];
-								q_output_reg[1] <= Message_Digest[63:32];
-								q_output_reg[2] <= Message_Digest[95:64];
-								q_output_reg[3] <= Message_Digest[127:96];
-								q_output_reg[4] <= Message_Digest[159:128];
-								state         = __DONE;
-								trigger <= 1'd0; /* End further processing*/
-							end	
-						
-						else if(state_counter == ITERATIONS)
-							begin
-								state_counter <= 'd0;
-								state         <= __DONE;
-							end
-						
-						else
-							begin
-								state_counter++;
-								state         <= __PROC;
-							end
+						state_counter <= state_counter + 1;
 						
+						/* Done once the last message has left the pipeline */
+						if(core_done && core_tag[0] && core_ready && !take && !next_valid && !pad_pending)
+							state <= __DONE;
 						end
 							
 					__DONE:  begin
-						ctrl          <= 0;
 						state_counter <= 0;
-						q_done <= 1'b1;
-						state 		  <= __IDLE;
+						state 		  <= take ? __PROC : __IDLE;
 					end
 					
 					default: begin
-						ctrl          <= 0;
 						state_counter <= 0;
 						state 		  <= __RESET;
 					end
 				endcase	
 		end : state_machine
 
-endmodule 
+	assign q_busy = (state == __PROC);
+	assign block_loaded = next_valid && core_ready;
+
+endmodule
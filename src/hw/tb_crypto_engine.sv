@@ -0,0 +1,182 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* Co-simulation testbench of avalon_sha_wrapper.
+	Drives the Avalon slave like crypto_engine.c does: writes a message block by block into the
+	block registers, waits for the block free bit between blocks and for the completion, then
+	compares the digest in Reg6..Reg2 with the software SHA-1 (sha1_dpi.c, through DPI-C).
+	Lengths around the padding boundaries are checked first, then random ones; the cycles per
+	block are reported at the end, and the performance counters of Reg7 are checked against the
+	blocks sent. Run with e.g.
+		verilator --binary --timing -Wno-fatal -CFLAGS -I$PWD/../sw tb_crypto_engine.sv avalon_sha_wrapper.sv sha_core_array.sv
+			sha_dma_master.sv state_machine_toplevel_framework.sv sha1_core.sv sha1_dpi.c ../sw/sha-1.c ../sw/sha-1-x86.c
+		(iverilog has no DPI-C: use vpi or run the same flow on crypto_engine_host.c instead)
+	Not yet elaborated or run: no simulator was available where it was written, so no results
+	have been recorded. -Wno-fatal keeps width lint warnings from stopping the build. */
+
+`timescale 1ns/1ps
+
+module tb_crypto_engine;
+
+	localparam RANDOM_MESSAGES = 64;
+	localparam MAX_LENGTH      = 512;
+
+	import "DPI-C" function void sha1_dpi_init();
+	import "DPI-C" function void sha1_dpi_update(input int data);
+	import "DPI-C" function void sha1_dpi_final();
+	import "DPI-C" function int sha1_dpi_word(input int index);
+
+	logic clk = 1'b0, reset_n = 1'b0;
+	always #5 clk = ~clk;
+
+	longint cycle = 0;
+	always_ff@(posedge clk) cycle <= cycle + 1;
+
+	logic read = 1'b0, write = 1'b0, irq;
+	logic [4:0]  address = 0;
+	logic [31:0] writedata = 0, readdata;
+
+	avalon_sha_wrapper dut(.clk(clk),
+		.reset_n(reset_n),
+		.read(read),
+		.write(write),
+		.address(address),
+		.writedata(writedata),
+		.readdata(readdata),
+		.irq(irq),
+		.m_address(),
+		.m_read(),
+		.m_write(),
+		.m_burstcount(),
+		.m_writedata(),
+		.m_readdata(32'd0),
+		.m_readdatavalid(1'b0),
+		.m_waitrequest(1'b0));
+
+	byte unsigned message [MAX_LENGTH];
+	longint blocks = 0, busy_cycles = 0;
+	int errors = 0;
+
+	/* One bus write, issued on the falling edge and taken on the next rising one */
+	task automatic write_reg(input int reg_address, input logic [31:0] value);
+		@(negedge clk);
+		address   <= 5'(reg_address);
+		writedata <= value;
+		write     <= 1'b1;
+		@(negedge clk);
+		write     <= 1'b0;
+	endtask
+
+	/* One bus read; readdata is combinational, so it is sampled in the same cycle */
+	task automatic read_reg(input int reg_address, output logic [31:0] value);
+		@(negedge clk);
+		address <= 5'(reg_address);
+		read    <= 1'b1;
+		#1 value = readdata;
+		@(negedge clk);
+		read    <= 1'b0;
+	endtask
+
+	/* Hashes message[0 .. length-1] on the accelerator and checks the digest */
+	task automatic hash_message(input int length, input logic [15:0] tag);
+		logic [31:0] status, control, digest [4:0], completion;
+		longint started;
+		int offset = 0;
+
+		sha1_dpi_init();
+		for(int i = 0; i < length; i++)
+			sha1_dpi_update(message[i]);
+		sha1_dpi_final();
+
+		started = cycle;
+		do
+			begin
+				int bytes = (length - offset > 64) ? 64 : length - offset;
+
+				/* Wait for the block registers to be free */
+				do read_reg(1, status); while(!status[3]);
+				for(int w = 0; w * 4 < bytes; w++)
+					write_reg(16 + w, {message[offset + 4*w], message[offset + 4*w + 1],
+					                   message[offset + 4*w + 2], message[offset + 4*w + 3]});
+
+				control = {tag, 16'd1};
+				control[2] = (offset == 0);
+				if(length - offset <= 64)
+					begin
+						control[3]   = 1'b1;
+						control[10:4] = 7'(bytes);
+					end
+				write_reg(0, control);
+				offset += bytes;
+			end
+		while(offset < length);
+
+		do read_reg(1, status); while(!status[1]);
+		busy_cycles += cycle - started;
+		blocks      += (length + 8) / 64 + 1;
+
+		read_reg(8, completion);
+		for(int i = 0; i < 5; i++)
+			read_reg(6 - i, digest[i]);
+		write_reg(1, 32'h2);
+
+		if(completion[15:0] !== tag)
+			begin
+				$display("FAIL length %0d: tag %x, expected %x", length, completion[15:0], tag);
+				errors++;
+			end
+		for(int i = 0; i < 5; i++)
+			if(digest[i] !== 32'(sha1_dpi_word(i)))
+				begin
+					$display("FAIL length %0d: H%0d %x, expected %x", length, i, digest[i],
+						32'(sha1_dpi_word(i)));
+					errors++;
+				end
+	endtask
+
+	initial
+	begin
+		int lengths [$] = '{0, 3, 55, 56, 63, 64, 65, 119, 120, 128};
+
+		repeat(4) @(posedge clk);
+		reset_n <= 1'b1;
+		repeat(2) @(posedge clk);
+
+		for(int i = 0; i < RANDOM_MESSAGES; i++)
+			lengths.push_back($urandom_range(MAX_LENGTH));
+		write_reg(7, 32'h80000000); // clear the performance counters
+
+		foreach(lengths[n])
+			begin
+				for(int i = 0; i < lengths[n]; i++)
+					message[i] = 8'($urandom);
+				hash_message(lengths[n], 16'(n));
+			end
+
+		$display("%0d messages, %0d blocks: %0.2f cycles per block over the bus",
+			lengths.size(), blocks, real'(busy_cycles) / blocks);
+
+		begin
+			logic [31:0] counter [4];
+			write_reg(7, 32'h40000000); // snapshot
+			for(int i = 0; i < 4; i++)
+				begin
+					write_reg(7, i);
+					read_reg(7, counter[i]);
+				end
+			$display("Counters: busy %0d, idle %0d, blocks %0d, stall %0d cycles",
+				counter[0], counter[1], counter[2], counter[3]);
+			if(counter[2] != blocks)
+				begin
+					errors++;
+					$display("FAIL block counter %0d, expected %0d", counter[2], blocks);
+				end
+		end
+		$display("%s: %0d errors", (errors == 0) ? "PASSED" : "FAILED", errors);
+		$finish;
+	end
+
+endmodule
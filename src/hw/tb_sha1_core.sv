@@ -0,0 +1,168 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* Testbench of sha1_core and state_machine_toplevel_framework.
+	Checks the digests of "abc" (one block) and of the two block FIPS 180 message, then streams
+	BLOCKS blocks back-to-back and reports the cycles per block, and the latency of the framework
+	for a one block message it pads itself. Run once per ROUNDS_PER_CYCLE (1, 2, 4, 8, 16), e.g.
+		verilator --binary --timing -Wno-fatal -GROUNDS_PER_CYCLE=4 tb_sha1_core.sv sha1_core.sv
+			state_machine_toplevel_framework.sv && obj_dir/Vtb_sha1_core
+		iverilog -g2012 -Ptb_sha1_core.ROUNDS_PER_CYCLE=4 tb_sha1_core.sv sha1_core.sv state_machine_toplevel_framework.sv
+	Not yet elaborated or run: no simulator was available where it was written, so no results
+	have been recorded. -Wno-fatal keeps width lint warnings from stopping the build. */
+
+`timescale 1ns/1ps
+
+module tb_sha1_core;
+
+	parameter int ROUNDS_PER_CYCLE = 4;
+	localparam BLOCKS = 64;
+
+	logic clk = 1'b0, reset_n = 1'b0;
+	always #5 clk = ~clk;
+
+	longint cycle = 0;
+	always_ff@(posedge clk) cycle <= cycle + 1;
+
+	/* Core under test */
+	logic load = 1'b0, first = 1'b1, ready, done;
+	logic [31:0] block [15:0];
+	logic [31:0] digest [4:0];
+
+	sha1_core #(.ROUNDS_PER_CYCLE(ROUNDS_PER_CYCLE)) dut(.clk(clk),
+		.reset_n(reset_n),
+		.load(load),
+		.first(first),
+		.block(block),
+		.tag_in(1'b0),
+		.ready(ready),
+		.done(done),
+		.digest(digest),
+		.tag_out());
+
+	/* Framework around it, padding "abc" itself */
+	logic block_valid = 1'b0, block_taken, q_busy, q_done, q_complete;
+	logic [15:0] q_tag;
+	logic [31:0] abc_raw [15:0];
+	logic [31:0] q_output_reg [4:0];
+
+	state_machine_toplevel_framework #(.ROUNDS_PER_CYCLE(ROUNDS_PER_CYCLE)) framework(.clk(clk),
+		.reset_n(reset_n),
+		.block_valid(block_valid),
+		.block_first(1'b1),
+		.block_last(1'b1),
+		.block_bytes(7'd3),
+		.block_tag(16'h00ab),
+		.block_in(abc_raw),
+		.block_taken(block_taken),
+		.q_busy(q_busy),
+		.q_done(q_done),
+		.q_complete(q_complete),
+		.q_tag(q_tag),
+		.q_output_reg(q_output_reg));
+
+	logic [31:0] abc_block [15:0];  /* "abc", padded */
+	logic [31:0] fips_block [1:0][15:0]; /* "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", padded */
+	int errors = 0;
+
+	/* Hands a block to the core; returns at the edge it is taken */
+	task automatic send(input logic [31:0] words [15:0], input logic is_first);
+		for(int i = 0; i < 16; i++)
+			block[i] <= words[i];
+		first <= is_first;
+		load  <= 1'b1;
+		do @(posedge clk); while(!ready);
+		load  <= 1'b0;
+	endtask
+
+	/* Waits for the done of the block taken last; skips the edge on which a block staged
+	   behind it may still see the done of its predecessor */
+	task automatic wait_done();
+		@(posedge clk);
+		while(!done) @(posedge clk);
+	endtask
+
+	task automatic check(input string name, input logic [159:0] expected, input logic [159:0] actual);
+		if(actual !== expected)
+			begin
+				$display("FAIL %s: %x, expected %x", name, actual, expected);
+				errors++;
+			end
+		else
+			$display("PASS %s: %x", name, actual);
+	endtask
+
+	initial
+	begin
+		longint started;
+
+		for(int i = 0; i < 16; i++)
+			begin
+				abc_block[i] = 32'd0;
+				abc_raw[i]   = 32'hffffffff; /* Past the message: must be padded away */
+			end
+		abc_raw[0]    = 32'h616263ff;
+		abc_block[0]  = 32'h61626380;
+		abc_block[15] = 32'h00000018;
+
+		for(int i = 0; i < 14; i++)
+			fips_block[0][i] = {8'h61 + 8'(i), 8'h62 + 8'(i), 8'h63 + 8'(i), 8'h64 + 8'(i)};
+		fips_block[0][14] = 32'h80000000;
+		fips_block[0][15] = 32'h00000000;
+		for(int i = 0; i < 16; i++)
+			fips_block[1][i] = 32'd0;
+		fips_block[1][15] = 32'h000001c0;
+
+		repeat(4) @(posedge clk);
+		reset_n <= 1'b1;
+		repeat(2) @(posedge clk);
+
+		/* Latency of a single block */
+		send(abc_block, 1'b1);
+		started = cycle;
+		wait_done();
+		$display("Single block latency: %0d cycles", cycle - started);
+		check("abc", 160'ha9993e364706816aba3e25717850c26c9cd0d89d,
+			{digest[0], digest[1], digest[2], digest[3], digest[4]});
+
+		/* Chaining: the second block is staged while the first compresses */
+		send(fips_block[0], 1'b1);
+		send(fips_block[1], 1'b0);
+		wait_done();
+		check("two blocks", 160'h84983e441c3bd26ebaae4aa1f95129e5e54670f1,
+			{digest[0], digest[1], digest[2], digest[3], digest[4]});
+
+		/* Back-to-back stream */
+		send(abc_block, 1'b1);
+		started = cycle;
+		for(int n = 1; n < BLOCKS; n++)
+			send(abc_block, 1'b0);
+		wait_done();
+		$display("Rounds per cycle: %0d, critical path: %0d chained rounds + chaining add",
+			ROUNDS_PER_CYCLE, ROUNDS_PER_CYCLE);
+		$display("Streamed %0d blocks: %0.2f cycles per block (previous core: 80 rounds + pre-processing and done states per block)",
+			BLOCKS, real'(cycle - started) / BLOCKS);
+
+		/* Framework: block valid to q_complete */
+		block_valid <= 1'b1;
+		started = cycle;
+		do @(posedge clk); while(!block_taken);
+		block_valid <= 1'b0;
+		while(!q_complete) @(posedge clk);
+		$display("Framework block valid to complete: %0d cycles", cycle - started);
+		check("framework", 160'ha9993e364706816aba3e25717850c26c9cd0d89d,
+			{q_output_reg[4], q_output_reg[3], q_output_reg[2], q_output_reg[1], q_output_reg[0]});
+		if(q_tag !== 16'h00ab)
+			begin
+				$display("FAIL framework tag: %x", q_tag);
+				errors++;
+			end
+
+		$display("%s: %0d errors", (errors == 0) ? "PASSED" : "FAILED", errors);
+		$finish;
+	end
+
+endmodule
@@ -0,0 +1,155 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* Throughput benchmark of the core array in avalon_sha_wrapper.
+	Hashes MESSAGES independent one block messages (0 to 55 bytes) the way crypto_engine.c does:
+	a new message is started while fewer than CORES are outstanding, completions are taken
+	from the completion queue as they come. The bus runs one access per cycle. Digests are
+	compared with the software SHA-1 (sha1_dpi.c, through DPI-C); the messages per 1000
+	cycles are reported. To see the scaling from 1 to N cores run e.g.
+		for n in 1 2 4 8; do
+			verilator --binary --timing -Wno-fatal -GCORES=$n -GROUNDS_PER_CYCLE=1 -CFLAGS -I$PWD/../sw tb_sha_array.sv
+				avalon_sha_wrapper.sv sha_core_array.sv sha_dma_master.sv
+				state_machine_toplevel_framework.sv sha1_core.sv sha1_dpi.c ../sw/sha-1.c
+				../sw/sha-1-x86.c && obj_dir/Vtb_sha_array
+		done
+	Not yet elaborated or run: no simulator was available where it was written, so no results
+	have been recorded. -Wno-fatal keeps width lint warnings from stopping the build. */
+
+`timescale 1ns/1ps
+
+module tb_sha_array;
+
+	parameter int CORES            = 4;
+	parameter int ROUNDS_PER_CYCLE = 1;
+	localparam MESSAGES            = 256;
+
+	import "DPI-C" function void sha1_dpi_init();
+	import "DPI-C" function void sha1_dpi_update(input int data);
+	import "DPI-C" function void sha1_dpi_final();
+	import "DPI-C" function int sha1_dpi_word(input int index);
+
+	logic clk = 1'b0, reset_n = 1'b0;
+	always #5 clk = ~clk;
+
+	longint cycle = 0;
+	always_ff@(posedge clk) cycle <= cycle + 1;
+
+	logic read = 1'b0, write = 1'b0, irq;
+	logic [4:0]  address = 0;
+	logic [31:0] writedata = 0, readdata;
+
+	avalon_sha_wrapper #(.CORES(CORES), .ROUNDS_PER_CYCLE(ROUNDS_PER_CYCLE)) dut(.clk(clk),
+		.reset_n(reset_n),
+		.read(read),
+		.write(write),
+		.address(address),
+		.writedata(writedata),
+		.readdata(readdata),
+		.irq(irq),
+		.m_address(),
+		.m_read(),
+		.m_write(),
+		.m_burstcount(),
+		.m_writedata(),
+		.m_readdata(32'd0),
+		.m_readdatavalid(1'b0),
+		.m_waitrequest(1'b0));
+
+	logic [31:0] message [MESSAGES][16];
+	int length [MESSAGES];
+	logic [31:0] expected [MESSAGES][5];
+	int errors = 0;
+
+	/* One bus write per cycle */
+	task automatic write_reg(input int reg_address, input logic [31:0] value);
+		@(negedge clk);
+		address   <= 5'(reg_address);
+		writedata <= value;
+		write     <= 1'b1;
+		@(posedge clk);
+		#1 write  <= 1'b0;
+	endtask
+
+	/* One bus read per cycle; readdata is combinational */
+	task automatic read_reg(input int reg_address, output logic [31:0] value);
+		@(negedge clk);
+		address <= 5'(reg_address);
+		read    <= 1'b1;
+		#1 value = readdata;
+		@(posedge clk);
+		#1 read <= 1'b0;
+	endtask
+
+	initial
+	begin
+		logic [31:0] status, completion, digest [5];
+		int submitted = 0, completed = 0, outstanding = 0;
+		longint started;
+
+		for(int n = 0; n < MESSAGES; n++)
+			begin
+				length[n] = $urandom_range(55);
+				sha1_dpi_init();
+				for(int i = 0; i < 16; i++)
+					message[n][i] = $urandom;
+				for(int i = 0; i < length[n]; i++)
+					sha1_dpi_update(message[n][i / 4][31 - 8 * (i % 4) -: 8]);
+				sha1_dpi_final();
+				for(int i = 0; i < 5; i++)
+					expected[n][i] = sha1_dpi_word(i);
+			end
+
+		repeat(4) @(posedge clk);
+		reset_n <= 1'b1;
+		repeat(2) @(posedge clk);
+
+		read_reg(12, status);
+		if(status[7:0] != CORES)
+			begin
+				$display("FAIL configuration register: %x", status);
+				errors++;
+			end
+
+		started = cycle;
+		while(completed < MESSAGES)
+			begin
+				read_reg(1, status);
+				if(status[1]) /* Take the oldest completion */
+					begin
+						read_reg(8, completion);
+						for(int i = 0; i < 5; i++)
+							read_reg(6 - i, digest[i]);
+						write_reg(1, 32'h2);
+						if(completion[15:0] >= MESSAGES ||
+						   {digest[0], digest[1], digest[2], digest[3], digest[4]} !==
+						   {expected[completion[15:0]][0], expected[completion[15:0]][1],
+						    expected[completion[15:0]][2], expected[completion[15:0]][3],
+						    expected[completion[15:0]][4]})
+							begin
+								$display("FAIL message %0d", completion[15:0]);
+								errors++;
+							end
+						completed++;
+						outstanding--;
+					end
+				else if(status[3] && submitted < MESSAGES && outstanding < CORES) /* Start one */
+					begin
+						for(int w = 0; w * 4 < length[submitted]; w++)
+							write_reg(16 + w, message[submitted][w]);
+						write_reg(0, {16'(submitted), 5'd0, 7'(length[submitted]), 4'b1101});
+						submitted++;
+						outstanding++;
+					end
+			end
+
+		$display("%0d cores, %0d rounds per cycle: %0d messages in %0d cycles, %0.1f messages per 1000 cycles",
+			CORES, ROUNDS_PER_CYCLE, MESSAGES, cycle - started, 1000.0 * MESSAGES / (cycle - started));
+		$display("%s: %0d errors", (errors == 0) ? "PASSED" : "FAILED", errors);
+		$finish;
+	end
+
+endmodule
@@ -0,0 +1,197 @@
+/* SHA-1 Accelerator - System verilog implementation
+   Date: 16-10-2026
+   submitted by:
+	Jishnu Murali Thampan
+*/
+
+/* Simulation harness of the DMA mode of avalon_sha_wrapper.
+	An Avalon-MM memory model with pipelined burst reads (READ_LATENCY cycles to the first word,
+	one word per cycle after it, WAIT_STATES cycles of waitrequest per command) holds the
+	messages. Each message is hashed through one descriptor; the digest the DMA writes back to
+	memory is compared with the software SHA-1 (sha1_dpi.c, through DPI-C) and the bytes per
+	cycle from descriptor write to completion are reported. Run with e.g.
+		verilator --binary --timing -Wno-fatal -CFLAGS -I$PWD/../sw tb_sha_dma.sv avalon_sha_wrapper.sv
+			sha_core_array.sv sha_dma_master.sv state_machine_toplevel_framework.sv sha1_core.sv sha1_dpi.c ../sw/sha-1.c ../sw/sha-1-x86.c
+	Not yet elaborated or run: no simulator was available where it was written, so no results
+	have been recorded. -Wno-fatal keeps width lint warnings from stopping the build. */
+
+`timescale 1ns/1ps
+
+module tb_sha_dma;
+
+	parameter int READ_LATENCY = 4;
+	parameter int WAIT_STATES  = 1;
+	localparam MEMORY_WORDS    = 16384;
+	localparam RESULT_ADDRESS  = 32'h0000ff00;
+	localparam MAX_LENGTH      = 16384;
+
+	import "DPI-C" function void sha1_dpi_init();
+	import "DPI-C" function void sha1_dpi_update(input int data);
+	import "DPI-C" function void sha1_dpi_final();
+	import "DPI-C" function int sha1_dpi_word(input int index);
+
+	logic clk = 1'b0, reset_n = 1'b0;
+	always #5 clk = ~clk;
+
+	longint cycle = 0;
+	always_ff@(posedge clk) cycle <= cycle + 1;
+
+	/* Slave port, driven like crypto_engine.c does */
+	logic read = 1'b0, write = 1'b0, irq;
+	logic [4:0]  address = 0;
+	logic [31:0] writedata = 0, readdata;
+
+	/* Master port */
+	logic [31:0] m_address, m_writedata, m_readdata;
+	logic [4:0]  m_burstcount;
+	logic m_read, m_write, m_readdatavalid = 1'b0, m_waitrequest;
+
+	avalon_sha_wrapper dut(.clk(clk),
+		.reset_n(reset_n),
+		.read(read),
+		.write(write),
+		.address(address),
+		.writedata(writedata),
+		.readdata(readdata),
+		.irq(irq),
+		.m_address(m_address),
+		.m_read(m_read),
+		.m_write(m_write),
+		.m_burstcount(m_burstcount),
+		.m_writedata(m_writedata),
+		.m_readdata(m_readdata),
+		.m_readdatavalid(m_readdatavalid),
+		.m_waitrequest(m_waitrequest));
+
+	/* Memory model: little-endian words, one burst in flight. Only this block writes memory
+	   and memory_busy, the random contents included, so neither has a second driver */
+	logic [31:0] memory [MEMORY_WORDS];
+	int wait_count = 0, beats = 0, delay = 0;
+	logic [31:0] burst_address;
+	longint memory_busy = 0;
+
+	assign m_waitrequest = (m_read || m_write) && (wait_count < WAIT_STATES || beats > 0);
+
+	always_ff@(posedge clk)
+		begin : memory_model
+			m_readdatavalid <= 1'b0;
+
+			if(reset_n == 1'b0)
+				for(int i = 0; i < MEMORY_WORDS; i++)
+					memory[i] <= $urandom;
+			else if((m_read || m_write) && m_waitrequest)
+				wait_count <= wait_count + 1;
+			else if(m_read)
+				begin
+					wait_count    <= 0;
+					beats         <= m_burstcount;
+					delay         <= READ_LATENCY;
+					burst_address <= m_address;
+				end
+			else if(m_write)
+				begin
+					wait_count <= 0;
+					memory[m_address[31:2]] <= m_writedata;
+				end
+
+			if(beats > 0)
+				begin
+					memory_busy <= memory_busy + 1;
+					if(delay > 1)
+						delay <= delay - 1;
+					else
+						begin
+							m_readdata      <= memory[burst_address[31:2]];
+							m_readdatavalid <= 1'b1;
+							burst_address   <= burst_address + 4;
+							beats           <= beats - 1;
+						end
+				end
+		end : memory_model
+
+	int errors = 0;
+	longint bytes_total = 0, cycles_total = 0;
+
+	task automatic write_reg(input int reg_address, input logic [31:0] value);
+		@(negedge clk);
+		address   <= 5'(reg_address);
+		writedata <= value;
+		write     <= 1'b1;
+		@(negedge clk);
+		write     <= 1'b0;
+	endtask
+
+	task automatic read_reg(input int reg_address, output logic [31:0] value);
+		@(negedge clk);
+		address <= 5'(reg_address);
+		read    <= 1'b1;
+		#1 value = readdata;
+		@(negedge clk);
+		read    <= 1'b0;
+	endtask
+
+	/* Hashes length bytes at source through one descriptor and checks the result in memory */
+	task automatic hash_message(input logic [31:0] source, input int length, input logic [15:0] tag);
+		logic [31:0] status;
+		longint started;
+
+		sha1_dpi_init();
+		for(int i = 0; i < length; i++)
+			sha1_dpi_update(memory[(source + i) >> 2][8 * ((source + i) % 4) +: 8]);
+		sha1_dpi_final();
+
+		write_reg(9, source);
+		write_reg(10, length);
+		write_reg(11, RESULT_ADDRESS);
+		started = cycle;
+		write_reg(0, {tag, 16'h1002}); /* DMA, completion interrupt */
+		while(!irq) @(posedge clk);
+		cycles_total += cycle - started;
+		bytes_total  += length;
+
+		read_reg(1, status);
+		if(status[4] || !status[1])
+			begin
+				$display("FAIL length %0d: status %x", length, status);
+				errors++;
+			end
+		write_reg(1, 32'h2);
+
+		for(int i = 0; i < 5; i++)
+			if(memory[(RESULT_ADDRESS >> 2) + i] !== 32'(sha1_dpi_word(i)))
+				begin
+					$display("FAIL length %0d: H%0d %x, expected %x", length, i,
+						memory[(RESULT_ADDRESS >> 2) + i], 32'(sha1_dpi_word(i)));
+					errors++;
+				end
+	endtask
+
+	initial
+	begin
+		int lengths [$] = '{0, 3, 55, 56, 63, 64, 65, 119, 120, 128, 1000};
+		longint small_bytes, small_cycles, busy_start;
+
+		repeat(4) @(posedge clk);
+		reset_n <= 1'b1;
+		repeat(2) @(posedge clk);
+
+		foreach(lengths[n])
+			hash_message(32'h100 + 4 * n, lengths[n], 16'(n));
+		small_bytes  = bytes_total;
+		small_cycles = cycles_total;
+
+		/* Bulk: memory bound or core bound, whichever is slower */
+		bytes_total  = 0;
+		cycles_total = 0;
+		busy_start   = memory_busy;
+		hash_message(32'h0, MAX_LENGTH, 16'hbeef);
+
+		$display("Boundary lengths: %0d bytes in %0d cycles", small_bytes, small_cycles);
+		$display("Bulk %0d bytes: %0.2f bytes/cycle, memory busy %0.0f%% (read latency %0d, wait states %0d)",
+			MAX_LENGTH, real'(bytes_total) / cycles_total, 100.0 * (memory_busy - busy_start) / cycles_total,
+			READ_LATENCY, WAIT_STATES);
+		$display("%s: %0d errors", (errors == 0) ? "PASSED" : "FAILED", errors);
+		$finish;
+	end
+
+endmodule
@@ -0,0 +1,247 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : hmac-sha-1-check.c
+* Author          : Jishnu Murali Thampan
+* Description     : Known-answer check of hmac-sha-1.c. Runs the HMAC-SHA1
+* 		              test cases of RFC 2202 one-shot and streamed, the
+* 		              PBKDF2-HMAC-SHA1 vectors of RFC 6070 up to c = 4096,
+* 		              and a batch of passwords of mixed lengths and output
+* 		              sizes against single derivations of the same keys;
+* 		              the exit status is non-zero on any difference.
+*
+* Build           : cc -O2 -o hmac-sha-1-check hmac-sha-1-check.c \
+* 		              hmac-sha-1.c sha-1-mb.c sha-1.c sha-1-x86.c
+* Usage           : hmac-sha-1-check
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hmac-sha-1.h"
+
+#define CHECK_BATCH_JOBS                                                       \
+  (11) /**< @brief Represents the passwords derived as one batch */
+#define CHECK_BATCH_ITERATIONS                                                 \
+  (1000) /**< @brief Represents the iteration count of the batch */
+#define CHECK_MAX_DERIVED                                                      \
+  (64) /**< @brief Represents the largest derived key checked in bytes */
+
+/**
+ * One HMAC-SHA1 test case of RFC 2202
+ */
+typedef struct hmac_vector {
+  const char *key;    /**< @brief Key, NULL for key_byte repeated */
+  uint8_t key_byte;   /**< @brief Key byte, 0 for 0x01, 0x02, ... */
+  size_t key_length;  /**< @brief Number of key bytes */
+  const char *data;   /**< @brief Message, NULL for data_byte repeated */
+  uint8_t data_byte;  /**< @brief Message byte repeated if data is NULL */
+  size_t data_length; /**< @brief Number of message bytes */
+  const char *mac;    /**< @brief Expected MAC in hex */
+} hmac_vector;
+
+/**
+ * One PBKDF2-HMAC-SHA1 test vector of RFC 6070
+ */
+typedef struct pbkdf2_vector {
+  const char *password;   /**< @brief Password bytes */
+  size_t password_length; /**< @brief Number of bytes in password */
+  const char *salt;       /**< @brief Salt bytes */
+  size_t salt_length;     /**< @brief Number of bytes in salt */
+  uint32_t iterations;    /**< @brief Iteration count c */
+  const char *key;        /**< @brief Expected derived key in hex */
+} pbkdf2_vector;
+
+static const hmac_vector hmac_vectors[] = {
+    {NULL, 0x0b, 20, "Hi There", 0, 8,
+     "b617318655057264e28bc0b6fb378c8ef146be00"},
+    {"Jefe", 0, 4, "what do ya want for nothing?", 0, 28,
+     "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+    {NULL, 0xaa, 20, NULL, 0xdd, 50,
+     "125d7342b9ac11cd91a39af48aa17b4f63f175d3"},
+    {NULL, 0x00, 25, NULL, 0xcd, 50,
+     "4c9007f4026250c6bc8414f9bf50c86c2d7235da"},
+    {NULL, 0x0c, 20, "Test With Truncation", 0, 20,
+     "4c1a03424b55e07fe7f27be1d58bb9324a9a5a04"},
+    {NULL, 0xaa, 80, "Test Using Larger Than Block-Size Key - Hash Key First",
+     0, 54, "aa4ae5e15272d00e95705637ce8a3b55ed402112"},
+    {NULL, 0xaa, 80,
+     "Test Using Larger Than Block-Size Key and Larger Than One Block-Size "
+     "Data",
+     0, 73, "e8e99d0f45237d786d6bbaa7965c7808bbff1a91"},
+};
+
+static const pbkdf2_vector pbkdf2_vectors[] = {
+    {"password", 8, "salt", 4, 1, "0c60c80f961f0e71f3a9b524af6012062fe037a6"},
+    {"password", 8, "salt", 4, 2, "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957"},
+    {"password", 8, "salt", 4, 4096,
+     "4b007901b765489abead49d926f721d065a429c1"},
+    {"passwordPASSWORDpassword", 24, "saltSALTsaltSALTsaltSALTsaltSALTsalt",
+     36, 4096, "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038"},
+    {"pass\0word", 9, "sa\0lt", 5, 4096, "56fa6aa75548099dcc37d7f03425e0c3"},
+};
+
+/**
+ * Compares bytes with a hex string and reports a difference
+ * @param[in] what     Test case checked
+ * @param[in] bytes    Computed bytes
+ * @param[in] length   Number of bytes, half the length of expected
+ * @param[in] expected Expected bytes in hex
+ * @return 0 if equal, 1 otherwise
+ */
+static int compare_hex(const char *what, const uint8_t bytes[], size_t length,
+                       const char *expected) {
+  char hex[2 * CHECK_MAX_DERIVED + 1];
+  for (size_t i = 0; i < length; i++)
+    snprintf(hex + 2 * i, 3, "%02x", bytes[i]);
+  hex[2 * length] = '\0';
+  if (strcmp(hex, expected) == 0)
+    return 0;
+  printf("ERR: %s: got %s, expected %s\n", what, hex, expected);
+  return 1;
+}
+
+/**
+ * Stores a MAC as its big-endian bytes
+ * @param[in]  mac   MAC words
+ * @param[out] bytes MAC bytes
+ */
+static void mac_bytes(const uint32_t mac[], uint8_t bytes[]) {
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    bytes[4 * i] = (uint8_t)(mac[i] >> 24);
+    bytes[4 * i + 1] = (uint8_t)(mac[i] >> 16);
+    bytes[4 * i + 2] = (uint8_t)(mac[i] >> 8);
+    bytes[4 * i + 3] = (uint8_t)mac[i];
+  }
+}
+
+/**
+ * Runs one RFC 2202 case in one piece and byte by byte
+ * @param[in] number      Test case number
+ * @param[in] secret      Key bytes
+ * @param[in] key_length  Number of key bytes
+ * @param[in] data        Message bytes
+ * @param[in] data_length Number of message bytes
+ * @param[in] expected    Expected MAC in hex
+ * @return Number of differences
+ */
+static int check_hmac(int number, const uint8_t secret[], size_t key_length,
+                      const uint8_t data[], size_t data_length,
+                      const char *expected) {
+  hmac_sha1_key key;
+  hmac_sha1_ctx ctx;
+  uint32_t mac[FINAL_HASH_SIZE];
+  uint8_t bytes[4 * FINAL_HASH_SIZE];
+  char what[48];
+  int failed = 0;
+
+  hmac_sha1_set_key(&key, secret, key_length);
+  hmac_sha1(&key, data, data_length, mac);
+  mac_bytes(mac, bytes);
+  snprintf(what, sizeof(what), "RFC 2202 case %d", number);
+  failed += compare_hex(what, bytes, sizeof(bytes), expected);
+
+  hmac_sha1_init(&ctx, &key);
+  for (size_t i = 0; i < data_length; i++)
+    hmac_sha1_update(&ctx, data + i, 1);
+  hmac_sha1_final(&ctx, mac);
+  mac_bytes(mac, bytes);
+  snprintf(what, sizeof(what), "RFC 2202 case %d streamed", number);
+  failed += compare_hex(what, bytes, sizeof(bytes), expected);
+
+  if (hmac_sha1_verify(&key, data, data_length, mac) != 1) {
+    printf("ERR: RFC 2202 case %d: verify rejects its own MAC\n", number);
+    failed++;
+  }
+  return failed;
+}
+
+/**
+ * Derives keys for a batch of passwords of mixed lengths and output sizes,
+ * which packs the lanes differently from one password at a time, and
+ * compares them with single derivations
+ * @return Number of differences
+ */
+static int check_batch(void) {
+  static uint8_t passwords[CHECK_BATCH_JOBS][100];
+  static uint8_t batch[CHECK_BATCH_JOBS][CHECK_MAX_DERIVED];
+  static uint8_t single[CHECK_BATCH_JOBS][CHECK_MAX_DERIVED];
+  static const size_t password_lengths[CHECK_BATCH_JOBS] = {
+      0, 1, 8, 20, 55, 56, 63, 64, 65, 99, 100};
+  static const size_t derived_lengths[CHECK_BATCH_JOBS] = {
+      20, 1, 25, 40, 64, 19, 21, 20, 60, 3, 41};
+  static const char salt[] = "batch salt";
+  pbkdf2_sha1_job jobs[CHECK_BATCH_JOBS];
+  int failed = 0;
+
+  srand(1);
+  for (size_t j = 0; j < CHECK_BATCH_JOBS; j++) {
+    for (size_t i = 0; i < sizeof(passwords[j]); i++)
+      passwords[j][i] = (uint8_t)rand();
+    jobs[j].password = passwords[j];
+    jobs[j].password_length = password_lengths[j];
+    jobs[j].derived_key = batch[j];
+    jobs[j].derived_length = derived_lengths[j];
+  }
+
+  if (pbkdf2_hmac_sha1_batch(jobs, CHECK_BATCH_JOBS, salt, sizeof(salt) - 1,
+                             CHECK_BATCH_ITERATIONS) != 0)
+    return CHECK_BATCH_JOBS;
+  for (size_t j = 0; j < CHECK_BATCH_JOBS; j++) {
+    if (pbkdf2_hmac_sha1(passwords[j], password_lengths[j], salt,
+                         sizeof(salt) - 1, CHECK_BATCH_ITERATIONS, single[j],
+                         derived_lengths[j]) != 0 ||
+        memcmp(batch[j], single[j], derived_lengths[j]) != 0) {
+      printf("ERR: Batch key %zu (password of %zu bytes, %zu bytes out) "
+             "differs from a single derivation\n",
+             j, password_lengths[j], derived_lengths[j]);
+      failed++;
+    }
+  }
+  return failed;
+}
+
+int main(void) {
+  uint8_t secret[80], data[80], derived[CHECK_MAX_DERIVED];
+  char what[48];
+  int failed = 0, checks = 0;
+
+  for (size_t v = 0; v < sizeof(hmac_vectors) / sizeof(hmac_vectors[0]);
+       v++) {
+    const hmac_vector *vector = &hmac_vectors[v];
+    if (vector->key != NULL)
+      memcpy(secret, vector->key, vector->key_length);
+    else
+      for (size_t i = 0; i < vector->key_length; i++)
+        secret[i] = vector->key_byte ? vector->key_byte : (uint8_t)(i + 1);
+    if (vector->data != NULL)
+      memcpy(data, vector->data, vector->data_length);
+    else
+      memset(data, vector->data_byte, vector->data_length);
+    failed += check_hmac((int)v + 1, secret, vector->key_length, data,
+                         vector->data_length, vector->mac);
+    checks += 3;
+  }
+
+  for (size_t v = 0; v < sizeof(pbkdf2_vectors) / sizeof(pbkdf2_vectors[0]);
+       v++) {
+    const pbkdf2_vector *vector = &pbkdf2_vectors[v];
+    size_t length = strlen(vector->key) / 2;
+    snprintf(what, sizeof(what), "RFC 6070 vector %zu (c = %u)", v + 1,
+             (unsigned)vector->iterations);
+    if (pbkdf2_hmac_sha1(vector->password, vector->password_length,
+                         vector->salt, vector->salt_length, vector->iterations,
+                         derived, length) != 0) {
+      printf("ERR: %s: derivation failed\n", what);
+      failed++;
+    } else {
+      failed += compare_hex(what, derived, length, vector->key);
+    }
+    checks++;
+  }
+
+  failed += check_batch();
+  checks += CHECK_BATCH_JOBS;
+
+  printf("%d mismatches over %d checks\n", failed, checks);
+  return (failed == 0) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
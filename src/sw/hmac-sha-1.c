@@ -0,0 +1,404 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : hmac-sha-1.c
+* Author          : Jishnu Murali Thampan
+* Description     : Implementation of HMAC-SHA1 (RFC 2104) and
+* 		              PBKDF2-HMAC-SHA1 (RFC 8018) on top of the SHA-1 block
+* 		              compression. The ipad/opad blocks are compressed once
+* 		              per key, so an HMAC of a short message costs two
+* 		              compressions and a PBKDF2 iteration exactly two.
+* 		              Independent PBKDF2 blocks and candidate passwords run
+* 		              side by side in the multi-buffer SIMD lanes.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hmac-sha-1.h"
+#include "sha-1-internal.h"
+#include "sha-1-mb.h"
+
+#define HMAC_IPAD (0x36) /**< @brief Represents the inner padding byte */
+#define HMAC_OPAD (0x5c) /**< @brief Represents the outer padding byte */
+#define DIGEST_SIZE                                                            \
+  (4 * FINAL_HASH_SIZE) /**< @brief Represents the digest size in bytes */
+
+/**
+ * One PBKDF2 output block T_i being derived in a SIMD lane
+ */
+typedef struct pbkdf2_lane {
+  const hmac_sha1_key *key;    /**< @brief Midstates of the password */
+  uint32_t u[FINAL_HASH_SIZE]; /**< @brief U_j of the current iteration */
+  uint32_t t[FINAL_HASH_SIZE]; /**< @brief U_1 ^ ... ^ U_j */
+  uint8_t *out;                /**< @brief Destination of T_i */
+  size_t out_length;           /**< @brief Bytes of T_i to store (<= 20) */
+} pbkdf2_lane;
+
+/**
+ * Clears memory that held key material in a way the compiler keeps
+ * @param[out] data   Memory to be cleared
+ * @param[in]  length Number of bytes
+ * @return void
+ */
+static void wipe(void *data, size_t length) {
+  volatile uint8_t *bytes = (volatile uint8_t *)data;
+  while (length--)
+    *bytes++ = 0;
+}
+/**
+ * Builds the final block of a hash over (64 byte midstate block || digest):
+ * the digest, '1', zeros and the length of 84 bytes
+ * @param[in]  digest Digest to be hashed
+ * @param[out] block  64 byte block
+ * @return void
+ */
+static void hmac_sha1_digest_block(const uint32_t digest[], uint8_t block[]) {
+  uint8_t tail[DIGEST_SIZE];
+  uint8_t padded[MAX_PADDED_SIZE];
+
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    sha1_store_be32(digest[i], tail + 4 * i);
+  }
+  sha1_pre_processing_stage(tail, DIGEST_SIZE, MESSAGE_SIZE + DIGEST_SIZE,
+                            padded);
+  memcpy(block, padded, MESSAGE_SIZE);
+}
+/**
+ * Prepares a key: compresses (key ^ ipad) and (key ^ opad) once
+ * @param[out] key    Prepared key
+ * @param[in]  secret Key bytes; keys longer than a block are hashed first
+ * @param[in]  length Number of bytes in secret
+ * @return void
+ */
+void hmac_sha1_set_key(hmac_sha1_key *key, const void *secret, size_t length) {
+  uint8_t key_block[MESSAGE_SIZE] = {0};
+  uint8_t pad[MESSAGE_SIZE];
+
+  if (length > MESSAGE_SIZE) {
+    uint32_t digest[FINAL_HASH_SIZE];
+    sha1_hash(secret, length, digest);
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      sha1_store_be32(digest[i], key_block + 4 * i);
+    }
+    wipe(digest, sizeof(digest));
+  } else if (length > 0) {
+    memcpy(key_block, secret, length);
+  }
+
+  const uint32_t initial[FINAL_HASH_SIZE] = {H0, H1, H2, H3, H4};
+  memcpy(key->inner, initial, sizeof(initial));
+  memcpy(key->outer, initial, sizeof(initial));
+
+  for (size_t i = 0; i < MESSAGE_SIZE; i++) {
+    pad[i] = key_block[i] ^ HMAC_IPAD;
+  }
+  sha1_compress_blocks(key->inner, pad, 1);
+  for (size_t i = 0; i < MESSAGE_SIZE; i++) {
+    pad[i] = key_block[i] ^ HMAC_OPAD;
+  }
+  sha1_compress_blocks(key->outer, pad, 1);
+
+  wipe(key_block, sizeof(key_block));
+  wipe(pad, sizeof(pad));
+}
+/**
+ * Starts an HMAC from the inner midstate of a prepared key
+ * @param[out] ctx Context
+ * @param[in]  key Prepared key
+ * @return void
+ */
+void hmac_sha1_init(hmac_sha1_ctx *ctx, const hmac_sha1_key *key) {
+  memcpy(ctx->inner.state, key->inner, sizeof(key->inner));
+  ctx->inner.length = MESSAGE_SIZE; /* the ipad block is already in state */
+  ctx->inner.buffered = 0;
+  memcpy(ctx->outer, key->outer, sizeof(key->outer));
+}
+/**
+ * Feeds the next part of the message into the HMAC
+ * @param[in,out] ctx    Context
+ * @param[in]     data   Message bytes
+ * @param[in]     length Number of bytes in data
+ * @return void
+ */
+void hmac_sha1_update(hmac_sha1_ctx *ctx, const void *data, size_t length) {
+  sha1_update(&ctx->inner, data, length);
+}
+/**
+ * Finishes the inner hash and runs the single outer compression
+ * @param[in,out] ctx Context, must be re-initialized before reuse
+ * @param[out]    mac Message authentication code
+ * @return void
+ */
+void hmac_sha1_final(hmac_sha1_ctx *ctx, uint32_t mac[]) {
+  uint32_t inner_digest[FINAL_HASH_SIZE];
+  uint8_t block[MESSAGE_SIZE];
+
+  sha1_final(&ctx->inner, inner_digest);
+  hmac_sha1_digest_block(inner_digest, block);
+  sha1_compress_blocks(ctx->outer, block, 1);
+  memcpy(mac, ctx->outer, sizeof(ctx->outer));
+}
+/**
+ * Computes the HMAC of a complete message in one call
+ * @param[in]  key    Prepared key
+ * @param[in]  data   Message bytes
+ * @param[in]  length Number of bytes in data
+ * @param[out] mac    Message authentication code
+ * @return void
+ */
+void hmac_sha1(const hmac_sha1_key *key, const void *data, size_t length,
+               uint32_t mac[]) {
+  hmac_sha1_ctx ctx;
+  hmac_sha1_init(&ctx, key);
+  hmac_sha1_update(&ctx, data, length);
+  hmac_sha1_final(&ctx, mac);
+}
+/**
+ * Checks a token in constant time
+ * @param[in] key      Prepared key
+ * @param[in] data     Message bytes
+ * @param[in] length   Number of bytes in data
+ * @param[in] expected MAC to compare against
+ * @return 1 if the MAC matches, 0 otherwise
+ */
+int hmac_sha1_verify(const hmac_sha1_key *key, const void *data,
+                     size_t length, const uint32_t expected[]) {
+  uint32_t mac[FINAL_HASH_SIZE];
+  uint32_t difference = 0;
+
+  hmac_sha1(key, data, length, mac);
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    difference |= mac[i] ^ expected[i];
+  }
+  return (difference == 0) ? (1) : (0);
+}
+/**
+ * Computes U_1 = HMAC(P, S || INT(i)) of a lane and starts T_i with it
+ * @param[in,out] lane        Lane
+ * @param[in]     salt        Salt bytes
+ * @param[in]     salt_length Number of bytes in salt
+ * @param[in]     block_index Index i of the output block, starting at 1
+ * @return void
+ */
+static void pbkdf2_first_iteration(pbkdf2_lane *lane, const void *salt,
+                                   size_t salt_length, uint32_t block_index) {
+  hmac_sha1_ctx ctx;
+  uint8_t index[4];
+
+  sha1_store_be32(block_index, index);
+  hmac_sha1_init(&ctx, lane->key);
+  hmac_sha1_update(&ctx, salt, salt_length);
+  hmac_sha1_update(&ctx, index, sizeof(index));
+  hmac_sha1_final(&ctx, lane->u);
+  memcpy(lane->t, lane->u, sizeof(lane->u));
+}
+/**
+ * Runs iterations 2..c of up to one vector width of output blocks side by
+ * side. Each iteration is one inner and one outer compression per lane,
+ * both started from the key's midstates.
+ * @param[in,out] lane       Lanes, U_1 already computed
+ * @param[in]     count      Number of lanes in use
+ * @param[in]     iterations Iteration count c
+ * @return void
+ */
+static void pbkdf2_run_lanes(pbkdf2_lane lane[], size_t count,
+                             uint32_t iterations) {
+  uint8_t inner_block[SHA1_MB_MAX_LANES][MESSAGE_SIZE] = {{0}};
+  uint8_t outer_block[SHA1_MB_MAX_LANES][MESSAGE_SIZE] = {{0}};
+  const uint8_t *inner_blocks[SHA1_MB_MAX_LANES];
+  const uint8_t *outer_blocks[SHA1_MB_MAX_LANES];
+  uint32_t state[FINAL_HASH_SIZE][SHA1_MB_MAX_LANES];
+  const uint32_t active = (uint32_t)((1ul << count) - 1);
+  size_t width = sha1_mb_max_lanes();
+
+  /* Narrow vectors waste fewer idle lanes on small groups */
+  while (width > 4 && count <= width / 2)
+    width /= 2;
+
+  for (size_t l = 0; l < width; l++) {
+    inner_blocks[l] = inner_block[l];
+    outer_blocks[l] = outer_block[l];
+    if (l < count) {
+      /* Only the 20 digest bytes change between iterations */
+      hmac_sha1_digest_block(lane[l].u, inner_block[l]);
+      hmac_sha1_digest_block(lane[l].u, outer_block[l]);
+    }
+  }
+
+  for (uint32_t j = 1; j < iterations; j++) {
+    for (size_t l = 0; l < count; l++) {
+      for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+        sha1_store_be32(lane[l].u[i], inner_block[l] + 4 * i);
+        state[i][l] = lane[l].key->inner[i];
+      }
+    }
+    sha1_mb_compress(width, state, inner_blocks, active);
+
+    for (size_t l = 0; l < count; l++) {
+      for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+        sha1_store_be32(state[i][l], outer_block[l] + 4 * i);
+        state[i][l] = lane[l].key->outer[i];
+      }
+    }
+    sha1_mb_compress(width, state, outer_blocks, active);
+
+    for (size_t l = 0; l < count; l++) {
+      for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+        lane[l].u[i] = state[i][l];
+        lane[l].t[i] ^= state[i][l];
+      }
+    }
+  }
+
+  /* Intermediate digests are as secret as the key */
+  wipe(inner_block, sizeof(inner_block));
+  wipe(outer_block, sizeof(outer_block));
+  wipe(state, sizeof(state));
+}
+/**
+ * Runs iterations 2..c of a single output block with the scalar kernel,
+ * which beats a mostly idle vector
+ * @param[in,out] lane       Lane, U_1 already computed
+ * @param[in]     iterations Iteration count c
+ * @return void
+ */
+static void pbkdf2_run_single(pbkdf2_lane *lane, uint32_t iterations) {
+  uint8_t block[MESSAGE_SIZE];
+  uint32_t state[FINAL_HASH_SIZE];
+
+  hmac_sha1_digest_block(lane->u, block);
+  for (uint32_t j = 1; j < iterations; j++) {
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      sha1_store_be32(lane->u[i], block + 4 * i);
+    }
+    memcpy(state, lane->key->inner, sizeof(state));
+    sha1_compress_blocks(state, block, 1);
+
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      sha1_store_be32(state[i], block + 4 * i);
+    }
+    memcpy(state, lane->key->outer, sizeof(state));
+    sha1_compress_blocks(state, block, 1);
+
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      lane->u[i] = state[i];
+      lane->t[i] ^= state[i];
+    }
+  }
+
+  wipe(block, sizeof(block));
+  wipe(state, sizeof(state));
+}
+/**
+ * Derives all lanes in groups of one vector width and stores T_i
+ * @param[in,out] lanes       All output blocks of the request
+ * @param[in]     count       Number of lanes
+ * @param[in]     salt        Salt bytes
+ * @param[in]     salt_length Number of bytes in salt
+ * @param[in]     iterations  Iteration count c
+ * @param[in]     first_index Block index of each lane, starting at 1
+ * @return void
+ */
+static void pbkdf2_derive(pbkdf2_lane lanes[], size_t count, const void *salt,
+                          size_t salt_length, uint32_t iterations,
+                          const uint32_t first_index[]) {
+  const size_t lanes_per_group = sha1_mb_max_lanes();
+
+  for (size_t group = 0; group < count; group += lanes_per_group) {
+    size_t in_group = count - group;
+    if (in_group > lanes_per_group)
+      in_group = lanes_per_group;
+
+    for (size_t l = group; l < group + in_group; l++) {
+      pbkdf2_first_iteration(&lanes[l], salt, salt_length, first_index[l]);
+    }
+    if (in_group == 1)
+      pbkdf2_run_single(&lanes[group], iterations);
+    else
+      pbkdf2_run_lanes(&lanes[group], in_group, iterations);
+
+    for (size_t l = group; l < group + in_group; l++) {
+      uint8_t block[DIGEST_SIZE];
+      for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+        sha1_store_be32(lanes[l].t[i], block + 4 * i);
+      }
+      memcpy(lanes[l].out, block, lanes[l].out_length);
+      wipe(block, sizeof(block));
+    }
+  }
+}
+/**
+ * Splits every job into its output blocks and derives them
+ * @param[in] jobs        Passwords and output buffers
+ * @param[in] count       Number of jobs
+ * @param[in] salt        Salt bytes
+ * @param[in] salt_length Number of bytes in salt
+ * @param[in] iterations  Iteration count c, 0 is treated as 1
+ * @return 0 on success, -1 if out of memory: no key was derived then and
+ *         the derived_key buffers must not be used
+ */
+int pbkdf2_hmac_sha1_batch(const pbkdf2_sha1_job jobs[], size_t count,
+                           const void *salt, size_t salt_length,
+                           uint32_t iterations) {
+  size_t total = 0;
+  for (size_t j = 0; j < count; j++) {
+    total += (jobs[j].derived_length + DIGEST_SIZE - 1) / DIGEST_SIZE;
+  }
+  if (total == 0)
+    return 0;
+
+  hmac_sha1_key *keys = malloc(count * sizeof(hmac_sha1_key));
+  pbkdf2_lane *lanes = malloc(total * sizeof(pbkdf2_lane));
+  uint32_t *indices = malloc(total * sizeof(uint32_t));
+  if (keys == NULL || lanes == NULL || indices == NULL) {
+    free(keys);
+    free(lanes);
+    free(indices);
+    printf("ERR: Out of memory for %zu PBKDF2 blocks\n", total);
+    return -1;
+  }
+
+  size_t lane = 0;
+  for (size_t j = 0; j < count; j++) {
+    hmac_sha1_set_key(&keys[j], jobs[j].password, jobs[j].password_length);
+    for (size_t offset = 0; offset < jobs[j].derived_length;
+         offset += DIGEST_SIZE, lane++) {
+      size_t remaining = jobs[j].derived_length - offset;
+      lanes[lane].key = &keys[j];
+      lanes[lane].out = jobs[j].derived_key + offset;
+      lanes[lane].out_length =
+          (remaining < DIGEST_SIZE) ? (remaining) : (DIGEST_SIZE);
+      indices[lane] = (uint32_t)(offset / DIGEST_SIZE + 1);
+    }
+  }
+
+  pbkdf2_derive(lanes, total, salt, salt_length,
+                (iterations > 0) ? (iterations) : (1), indices);
+
+  wipe(keys, count * sizeof(hmac_sha1_key));
+  wipe(lanes, total * sizeof(pbkdf2_lane));
+  free(keys);
+  free(lanes);
+  free(indices);
+  return 0;
+}
+/**
+ * Derives a key with PBKDF2-HMAC-SHA1. The output blocks T_1, T_2, ... are
+ * independent and are derived in parallel lanes.
+ * @param[in]  password        Password bytes
+ * @param[in]  password_length Number of bytes in password
+ * @param[in]  salt            Salt bytes
+ * @param[in]  salt_length     Number of bytes in salt
+ * @param[in]  iterations      Iteration count c, 0 is treated as 1
+ * @param[out] derived_key     Derived key
+ * @param[in]  derived_length  Bytes of key to derive
+ * @return 0 on success, -1 if out of memory: derived_key is not written
+ */
+int pbkdf2_hmac_sha1(const void *password, size_t password_length,
+                     const void *salt, size_t salt_length,
+                     uint32_t iterations, uint8_t derived_key[],
+                     size_t derived_length) {
+  const pbkdf2_sha1_job job = {password, password_length, derived_key,
+                               derived_length};
+  return pbkdf2_hmac_sha1_batch(&job, 1, salt, salt_length, iterations);
+}
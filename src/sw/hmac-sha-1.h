@@ -0,0 +1,58 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : hmac-sha-1.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of HMAC-SHA1 and PBKDF2-HMAC-SHA1. A key is
+* 		            prepared once into its inner and outer midstates and
+* 		            can then be reused for any number of messages.
+****************************************************************************/
+
+#ifndef HMAC_SHA1_HPP
+#define HMAC_SHA1_HPP
+
+#include "sha-1.h"
+
+/**
+ * HMAC key reduced to the chaining states after the ipad and opad blocks
+ */
+typedef struct hmac_sha1_key {
+  uint32_t inner[FINAL_HASH_SIZE]; /**< @brief State after (key ^ ipad) */
+  uint32_t outer[FINAL_HASH_SIZE]; /**< @brief State after (key ^ opad) */
+} hmac_sha1_key;
+
+/**
+ * Streaming HMAC context
+ */
+typedef struct hmac_sha1_ctx {
+  sha1_ctx inner;                  /**< @brief Inner hash, keyed */
+  uint32_t outer[FINAL_HASH_SIZE]; /**< @brief Outer midstate of the key */
+} hmac_sha1_ctx;
+
+/**
+ * One candidate password of a PBKDF2 batch
+ */
+typedef struct pbkdf2_sha1_job {
+  const void *password;   /**< @brief Password bytes */
+  size_t password_length; /**< @brief Number of bytes in password */
+  uint8_t *derived_key;   /**< @brief Output buffer */
+  size_t derived_length;  /**< @brief Bytes of key to derive */
+} pbkdf2_sha1_job;
+
+void hmac_sha1_set_key(hmac_sha1_key *key, const void *secret, size_t length);
+void hmac_sha1_init(hmac_sha1_ctx *ctx, const hmac_sha1_key *key);
+void hmac_sha1_update(hmac_sha1_ctx *ctx, const void *data, size_t length);
+void hmac_sha1_final(hmac_sha1_ctx *ctx, uint32_t mac[]);
+void hmac_sha1(const hmac_sha1_key *key, const void *data, size_t length,
+               uint32_t mac[]);
+int hmac_sha1_verify(const hmac_sha1_key *key, const void *data,
+                     size_t length, const uint32_t expected[]);
+
+int pbkdf2_hmac_sha1(const void *password, size_t password_length,
+                     const void *salt, size_t salt_length,
+                     uint32_t iterations, uint8_t derived_key[],
+                     size_t derived_length);
+int pbkdf2_hmac_sha1_batch(const pbkdf2_sha1_job jobs[], size_t count,
+                           const void *salt, size_t salt_length,
+                           uint32_t iterations);
+
+#endif /* HMAC_SHA1_HPP */
@@ -1,15 +1,20 @@
 /***************************************************************************
 ****************************************************************************
-* Filename        : sha-1.cpp
+* Filename        : main.c
 * Author          : Jishnu Murali Thampan
 * Description     : Driver main for SHA-1 Alogrithm
-* 		    Note: This version does not support message sizes > 512
-*bytes
 ****************************************************************************/
 #include "sha-1.h"
+#include "sha-1-profile.h"
 
 int main(void)
 {
-  generate_sha1_hash();
+  uint32_t final_hash[FINAL_HASH_SIZE] = {0};
+  generate_sha1_hash(final_hash);
+#ifdef SHA1_PROFILE
+  sha1_profile_snapshot snapshot;
+  sha1_profile_snapshot_take(&snapshot);
+  sha1_profile_export(&snapshot, stderr);
+#endif
   return 0;
 }
@@ -0,0 +1,278 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-bench.c
+* Author          : Jishnu Murali Thampan
+* Description     : Benchmark of every SHA-1 implementation available on
+* 		              this machine over message sizes from 0 B to 64 MiB.
+* 		              Reports cycles/byte (rdtsc), hashes/sec and latency
+* 		              percentiles; -o writes the results as CSV.
+*
+* Build           : cc -O2 -o sha-1-bench sha-1-bench.c sha-1.c sha-1-x86.c
+* 		              sha-1-mb.c
+* Usage           : sha-1-bench [-k kernel] [-s max_size] [-t seconds]
+* 		              [-o results.csv]
+****************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L /**< @brief For clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sha-1.h"
+#include "sha-1-mb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_MAX_MESSAGE_SIZE                                                 \
+  (64u << 20) /**< @brief Represents the largest message size: 64 MiB */
+#define BENCH_MIN_SAMPLES                                                      \
+  (16) /**< @brief Represents the minimum samples taken per measurement */
+#define BENCH_MAX_SAMPLES                                                      \
+  (100000) /**< @brief Represents the maximum samples kept per measurement */
+#define BENCH_BATCH_MESSAGES                                                   \
+  (256) /**< @brief Represents the messages per multi-buffer batch */
+#define BENCH_BATCH_MAX_SIZE                                                   \
+  (64u << 10) /**< @brief Represents the largest multi-buffer message size */
+#define BENCH_DEFAULT_MIN_TIME                                                 \
+  (0.2) /**< @brief Represents the default time spent per measurement [s] */
+
+/**
+ * One implementation under test
+ */
+typedef struct bench_impl {
+  const char *name;   /**< @brief Name printed in the report */
+  sha1_kernel kernel; /**< @brief Single-stream kernel */
+  size_t lanes;       /**< @brief Multi-buffer lanes, 0 for single-stream */
+} bench_impl;
+
+/**
+ * Result of one (implementation, message size) measurement
+ */
+typedef struct bench_result {
+  size_t samples;         /**< @brief Number of timed samples */
+  double hashes_per_sec;  /**< @brief Messages hashed per wall-clock second */
+  double cycles_per_byte; /**< @brief Median cycles per message byte */
+  double p50;             /**< @brief Median cycles per message */
+  double p90;             /**< @brief 90th percentile cycles per message */
+  double p99;             /**< @brief 99th percentile cycles per message */
+} bench_result;
+
+static const bench_impl implementations[] = {
+    {"portable", SHA1_KERNEL_PORTABLE, 0}, {"avx2", SHA1_KERNEL_AVX2, 0},
+    {"sha-ni", SHA1_KERNEL_SHANI, 0},      {"mb-x4", SHA1_KERNEL_AUTO, 4},
+    {"mb-x8", SHA1_KERNEL_AUTO, 8},        {"mb-x16", SHA1_KERNEL_AUTO, 16},
+};
+
+static const size_t message_sizes[] = {
+    0,         16,         64,         256,        1u << 10,
+    4u << 10,  16u << 10,  64u << 10,  256u << 10, 1u << 20,
+    4u << 20,  16u << 20,  64u << 20,
+};
+
+/**
+ * Reads the time stamp counter, or nanoseconds where there is none
+ * @param  None
+ * @return Current cycle count
+ */
+static inline uint64_t read_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_lfence(); /* Keep earlier work from leaking past the timestamp */
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+/**
+ * Returns the monotonic wall-clock time in seconds
+ * @param  None
+ * @return Current time
+ */
+static double wall_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+/**
+ * Compares two cycle samples for qsort
+ * @param[in] lhs First sample
+ * @param[in] rhs Second sample
+ * @return <0, 0 or >0
+ */
+static int compare_cycles(const void *lhs, const void *rhs) {
+  const uint64_t a = *(const uint64_t *)lhs;
+  const uint64_t b = *(const uint64_t *)rhs;
+  return (a > b) - (a < b);
+}
+/**
+ * Returns the given percentile of sorted samples
+ * @param[in] sorted   Sorted samples
+ * @param[in] count    Number of samples
+ * @param[in] fraction Percentile as a fraction in [0, 1]
+ * @return Sample at the percentile
+ */
+static double percentile(const uint64_t sorted[], size_t count,
+                         double fraction) {
+  size_t index = (size_t)(fraction * (double)(count - 1) + 0.5);
+  return (double)sorted[index];
+}
+/**
+ * Runs one measurement: hashes messages of the given size until both the
+ * minimum sample count and the minimum time are reached
+ * @param[in]  impl     Implementation under test
+ * @param[in]  message  Message buffer of at least size bytes
+ * @param[in]  size     Message size
+ * @param[in]  min_time Minimum time to spend [s]
+ * @param[in]  samples  Scratch space for BENCH_MAX_SAMPLES samples
+ * @param[out] result   Measurement result
+ * @return void
+ */
+static void run_measurement(const bench_impl *impl, const uint8_t *message,
+                            size_t size, double min_time, uint64_t samples[],
+                            bench_result *result) {
+  static sha1_job jobs[BENCH_BATCH_MESSAGES];
+  const size_t per_sample = (impl->lanes > 0) ? (BENCH_BATCH_MESSAGES) : (1);
+  uint32_t final_hash[FINAL_HASH_SIZE];
+  size_t count = 0;
+
+  for (size_t i = 0; i < per_sample; i++) {
+    jobs[i].data = message;
+    jobs[i].length = size;
+  }
+
+  double start = wall_time(), elapsed = 0;
+  do {
+    uint64_t begin = read_cycles();
+    if (impl->lanes > 0)
+      sha1_hash_batch_lanes(jobs, per_sample, impl->lanes);
+    else
+      sha1_hash(message, size, final_hash);
+    uint64_t end = read_cycles();
+
+    samples[count++] = (end - begin) / per_sample;
+    elapsed = wall_time() - start;
+  } while (count < BENCH_MAX_SAMPLES &&
+           (count < BENCH_MIN_SAMPLES || elapsed < min_time));
+
+  qsort(samples, count, sizeof(samples[0]), compare_cycles);
+  result->samples = count;
+  result->hashes_per_sec = (double)(count * per_sample) / elapsed;
+  result->p50 = percentile(samples, count, 0.50);
+  result->p90 = percentile(samples, count, 0.90);
+  result->p99 = percentile(samples, count, 0.99);
+  result->cycles_per_byte = (size > 0) ? (result->p50 / (double)size) : (0);
+}
+/**
+ * Checks whether an implementation can run here and selects its kernel
+ * @param[in] impl Implementation
+ * @return 1 if it can run, 0 otherwise
+ */
+static int prepare_implementation(const bench_impl *impl) {
+  if (impl->lanes > 0)
+    return (impl->lanes <= sha1_mb_max_lanes()) ? (1) : (0);
+  if (!sha1_kernel_supported(impl->kernel))
+    return 0;
+  return (sha1_set_kernel(impl->kernel) == 0) ? (1) : (0);
+}
+/**
+ * Prints the command line usage
+ * @param[in] program Name of the executable
+ * @return void
+ */
+static void print_usage(const char *program) {
+  printf("Usage: %s [-k kernel] [-s max_size] [-t seconds] [-o file.csv]\n",
+         program);
+  printf("  kernels:");
+  for (size_t i = 0; i < sizeof(implementations) / sizeof(implementations[0]);
+       i++) {
+    printf(" %s", implementations[i].name);
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *only = NULL, *csv_path = NULL;
+  size_t max_size = BENCH_MAX_MESSAGE_SIZE;
+  double min_time = BENCH_DEFAULT_MIN_TIME;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      only = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      max_size = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      min_time = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (max_size > BENCH_MAX_MESSAGE_SIZE)
+    max_size = BENCH_MAX_MESSAGE_SIZE;
+
+  uint8_t *message = malloc(max_size > 0 ? max_size : 1);
+  uint64_t *samples = malloc(BENCH_MAX_SAMPLES * sizeof(uint64_t));
+  if (message == NULL || samples == NULL) {
+    printf("ERR: Out of memory\n");
+    return 1;
+  }
+  for (size_t i = 0; i < max_size; i++) {
+    message[i] = (uint8_t)(i * 131 + 7);
+  }
+
+  FILE *csv = NULL;
+  if (csv_path != NULL) {
+    csv = fopen(csv_path, "w");
+    if (csv == NULL) {
+      printf("ERR: Cannot open %s\n", csv_path);
+      return 1;
+    }
+    fprintf(csv, "kernel,size,samples,hashes_per_sec,cycles_per_byte,"
+                 "p50_cycles,p90_cycles,p99_cycles\n");
+  }
+
+  printf("%-9s %10s %14s %10s %12s %12s %12s\n", "kernel", "size",
+         "hashes/sec", "cyc/byte", "p50 cyc", "p90 cyc", "p99 cyc");
+  for (size_t k = 0; k < sizeof(implementations) / sizeof(implementations[0]);
+       k++) {
+    const bench_impl *impl = &implementations[k];
+    if (only != NULL && strcmp(only, impl->name) != 0)
+      continue;
+    if (!prepare_implementation(impl)) {
+      printf("%-9s not supported on this CPU\n", impl->name);
+      continue;
+    }
+
+    for (size_t s = 0; s < sizeof(message_sizes) / sizeof(message_sizes[0]);
+         s++) {
+      const size_t size = message_sizes[s];
+      if (size > max_size || (impl->lanes > 0 && size > BENCH_BATCH_MAX_SIZE))
+        break;
+
+      bench_result result;
+      run_measurement(impl, message, size, min_time, samples, &result);
+      printf("%-9s %10zu %14.0f %10.2f %12.0f %12.0f %12.0f\n", impl->name,
+             size, result.hashes_per_sec, result.cycles_per_byte, result.p50,
+             result.p90, result.p99);
+      if (csv != NULL) {
+        fprintf(csv, "%s,%zu,%zu,%.1f,%.4f,%.0f,%.0f,%.0f\n", impl->name, size,
+                result.samples, result.hashes_per_sec, result.cycles_per_byte,
+                result.p50, result.p90, result.p99);
+      }
+    }
+  }
+
+  /* Leave the process on the fastest kernel again */
+  sha1_set_kernel(SHA1_KERNEL_AUTO);
+  if (csv != NULL)
+    fclose(csv);
+  free(samples);
+  free(message);
+  return 0;
+}
@@ -0,0 +1,542 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-cache.c
+* Author          : Jishnu Murali Thampan
+* Description     : Persistent cache of file digests. The file starts with
+* 		              a header followed by 64 byte records, each closed by
+* 		              a checksum. Opening maps the records and builds an
+* 		              open addressing index over them; the newest record of
+* 		              a file wins. Slots are only ever filled or replaced,
+* 		              never emptied, and a full index is swapped for one
+* 		              twice its size, so lookups need no lock. A store is a
+* 		              single append of one record: after a crash the file
+* 		              holds every completed record, and a torn one fails its
+* 		              checksum and is skipped. Once most records are stale
+* 		              the log is compacted into a new file which replaces
+* 		              the old one by rename().
+*
+* Concurrency     : Any number of processes may share a cache file. A run
+* 		              that appends while another one compacts may lose its
+* 		              new records, never corrupt the cache.
+****************************************************************************/
+
+#define _XOPEN_SOURCE 700 /**< @brief For st_mtim and mkstemp() */
+#define _DEFAULT_SOURCE   /**< @brief For flock() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha-1-cache.h"
+
+#define SHA1_CACHE_MAGIC "SHA1CACH" /**< @brief Represents the file magic */
+#define SHA1_CACHE_VERSION                                                     \
+  (1) /**< @brief Represents the layout of header and records */
+#define SHA1_CACHE_MIN_SLOTS                                                   \
+  (4096) /**< @brief Represents the smallest index, a power of two */
+#define SHA1_CACHE_RACY_NS                                                     \
+  (2000000000ll) /**< @brief Represents the age a file needs to be cached:   \
+                    a file modified within the same timestamp tick as the    \
+                    hashing could change again without a new mtime */
+#define SHA1_CACHE_COMPACT_RECORDS                                             \
+  (1024) /**< @brief Represents the log size below which it is not compacted \
+          */
+
+/**
+ * Start of the cache file
+ */
+typedef struct sha1_cache_header {
+  char magic[8];        /**< @brief SHA1_CACHE_MAGIC */
+  uint32_t version;     /**< @brief SHA1_CACHE_VERSION, also tells the byte
+                             order */
+  uint32_t record_size; /**< @brief sizeof(sha1_cache_record) */
+  uint8_t reserved[48]; /**< @brief Zero, pads the header to a record */
+} sha1_cache_header;
+
+/**
+ * Digest of one file as stored in the cache file
+ */
+typedef struct sha1_cache_record {
+  uint64_t device;                      /**< @brief st_dev */
+  uint64_t inode;                       /**< @brief st_ino */
+  uint64_t size;                        /**< @brief st_size */
+  int64_t mtime_ns;                     /**< @brief st_mtim in nanoseconds */
+  int64_t ctime_ns;                     /**< @brief st_ctim in nanoseconds */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Digest of the contents */
+  uint32_t check;                       /**< @brief Checksum of the above */
+} sha1_cache_record;
+
+/**
+ * Open addressing index over the records, newest record per file. A full
+ * index is replaced by one twice its size; the old one is kept until the
+ * cache is closed, since lookups may still be reading it.
+ */
+typedef struct sha1_cache_index {
+  struct sha1_cache_index *retired; /**< @brief Index this one replaced */
+  size_t mask;                      /**< @brief Slots - 1 */
+  size_t live;                      /**< @brief Filled slots */
+  const sha1_cache_record *slot[];  /**< @brief Records, NULL if empty */
+} sha1_cache_index;
+
+/**
+ * Open cache
+ */
+struct sha1_cache {
+  char *path;                     /**< @brief Cache file */
+  int fd;                         /**< @brief Opened for appending */
+  int flags;                      /**< @brief SHA1_CACHE_CTIME or 0 */
+  int writable;                   /**< @brief 0 for a read-only cache file */
+  void *map;                      /**< @brief Header and records at open */
+  size_t map_size;                /**< @brief Bytes mapped */
+  sha1_cache_index *index;        /**< @brief Current index */
+  size_t records;                 /**< @brief Records in the log */
+  size_t unindexed;               /**< @brief Valid records not in index */
+  sha1_cache_record **added;      /**< @brief Records stored by this run */
+  size_t added_count;             /**< @brief Entries in added */
+  size_t added_capacity;          /**< @brief Allocated entries of added */
+  pthread_mutex_t lock;           /**< @brief Serializes stores */
+};
+
+/**
+ * Checksum of a record: FNV-1a over everything but the checksum itself
+ * @param[in] record Record
+ * @return Checksum
+ */
+static uint32_t record_check(const sha1_cache_record *record) {
+  const uint8_t *byte = (const uint8_t *)record;
+  uint32_t check = 2166136261u;
+
+  for (size_t i = 0; i < offsetof(sha1_cache_record, check); i++) {
+    check = (check ^ byte[i]) * 16777619u;
+  }
+  return check;
+}
+/**
+ * Spreads a file identity over the index
+ * @param[in] device Device
+ * @param[in] inode  Inode
+ * @return Hash
+ */
+static uint64_t identity_hash(uint64_t device, uint64_t inode) {
+  uint64_t x = inode ^ (device * 0x9E3779B97F4A7C15ull);
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+/**
+ * Converts a timestamp to nanoseconds
+ * @param[in] time Timestamp
+ * @return Nanoseconds since the epoch
+ */
+static int64_t to_ns(const struct timespec *time) {
+  return (int64_t)time->tv_sec * 1000000000ll + time->tv_nsec;
+}
+/**
+ * Allocates an empty index
+ * @param[in] slots Number of slots, a power of two
+ * @return Index, NULL if out of memory
+ */
+static sha1_cache_index *index_create(size_t slots) {
+  sha1_cache_index *index =
+      calloc(1, sizeof(*index) + slots * sizeof(index->slot[0]));
+
+  if (index != NULL)
+    index->mask = slots - 1;
+  return index;
+}
+/**
+ * Finds the record of a file. Lock-free: a slot goes from empty to a
+ * record and then only to newer records of the same file.
+ * @param[in] index  Index
+ * @param[in] device Device
+ * @param[in] inode  Inode
+ * @return Newest record of the file, NULL if there is none
+ */
+static const sha1_cache_record *index_find(const sha1_cache_index *index,
+                                           uint64_t device, uint64_t inode) {
+  size_t i = (size_t)identity_hash(device, inode) & index->mask;
+
+  for (size_t probe = 0; probe <= index->mask; probe++) {
+    const sha1_cache_record *record =
+        __atomic_load_n(&index->slot[i], __ATOMIC_ACQUIRE);
+    if (record == NULL)
+      return NULL;
+    if (record->device == device && record->inode == inode)
+      return record;
+    i = (i + 1) & index->mask;
+  }
+  return NULL;
+}
+/**
+ * Puts a record into the slot of its file, or into a free one. The index
+ * must have a free slot.
+ * @param[in,out] index  Index
+ * @param[in]     record Record
+ * @return void
+ */
+static void index_place(sha1_cache_index *index,
+                        const sha1_cache_record *record) {
+  size_t i = (size_t)identity_hash(record->device, record->inode) & index->mask;
+
+  for (;; i = (i + 1) & index->mask) {
+    const sha1_cache_record *present = index->slot[i];
+    if (present == NULL) {
+      index->live++;
+      break;
+    }
+    if (present->device == record->device && present->inode == record->inode)
+      break;
+  }
+  __atomic_store_n(&index->slot[i], record, __ATOMIC_RELEASE);
+}
+/**
+ * Makes a record the newest of its file. An index that would be more than
+ * three quarters full is first rebuilt at twice the size and published
+ * with a single release store. Callers hold the store lock, or are the
+ * only thread, so only lookups run concurrently.
+ * @param[in,out] cache  Cache
+ * @param[in]     record Record, must stay valid until the cache is closed
+ * @return 0 on success, -1 if a larger index could not be allocated
+ */
+static int index_insert(sha1_cache *cache, const sha1_cache_record *record) {
+  sha1_cache_index *index = cache->index;
+
+  if (4 * (index->live + 1) > 3 * (index->mask + 1)) {
+    sha1_cache_index *grown = index_create(2 * (index->mask + 1));
+    if (grown == NULL)
+      return -1;
+    for (size_t i = 0; i <= index->mask; i++) {
+      if (index->slot[i] != NULL)
+        index_place(grown, index->slot[i]);
+    }
+    grown->retired = index;
+    __atomic_store_n(&cache->index, grown, __ATOMIC_RELEASE);
+    index = grown;
+  }
+  index_place(index, record);
+  return 0;
+}
+/**
+ * Writes all of a buffer, retrying short writes
+ * @param[in] fd     Descriptor
+ * @param[in] data   Bytes
+ * @param[in] length Number of bytes
+ * @return 0 on success, -1 on failure
+ */
+static int write_all(int fd, const void *data, size_t length) {
+  const uint8_t *byte = (const uint8_t *)data;
+
+  while (length > 0) {
+    ssize_t written = write(fd, byte, length);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    byte += written;
+    length -= (size_t)written;
+  }
+  return 0;
+}
+/**
+ * Checks the header of an existing cache file, or writes it to a new one.
+ * Also cuts off a record torn by a crash so that appends stay aligned.
+ * @param[in,out] cache Cache with fd open
+ * @param[out]    size  Size of the file afterwards
+ * @return 0 on success, -1 if it is not a cache file
+ */
+static int prepare_file(sha1_cache *cache, off_t *size) {
+  sha1_cache_header header;
+  struct stat info;
+
+  if (fstat(cache->fd, &info) < 0)
+    return -1;
+  if (info.st_size == 0 && cache->writable) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHA1_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SHA1_CACHE_VERSION;
+    header.record_size = sizeof(sha1_cache_record);
+    if (write_all(cache->fd, &header, sizeof(header)) < 0)
+      return -1;
+    *size = sizeof(header);
+    return 0;
+  }
+
+  if (pread(cache->fd, &header, sizeof(header), 0) != sizeof(header) ||
+      memcmp(header.magic, SHA1_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SHA1_CACHE_VERSION ||
+      header.record_size != sizeof(sha1_cache_record)) {
+    errno = EINVAL;
+    return -1;
+  }
+  *size = info.st_size - (info.st_size - (off_t)sizeof(header)) %
+                             (off_t)sizeof(sha1_cache_record);
+  if (*size != info.st_size && cache->writable &&
+      ftruncate(cache->fd, *size) < 0)
+    return -1;
+  return 0;
+}
+/**
+ * Opens a cache file, creating it if it does not exist. A file that can
+ * only be read serves lookups; stores are then ignored.
+ * @param[in] path  Cache file
+ * @param[in] flags SHA1_CACHE_CTIME or 0
+ * @return Cache, NULL with errno set on failure
+ */
+sha1_cache *sha1_cache_open(const char *path, int flags) {
+  sha1_cache *cache = calloc(1, sizeof(*cache));
+  size_t records, slots = SHA1_CACHE_MIN_SLOTS;
+  off_t size = 0;
+  int error;
+
+  if (cache == NULL)
+    return NULL;
+  cache->flags = flags;
+  cache->writable = 1;
+  cache->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (cache->fd < 0) {
+    cache->writable = 0;
+    cache->fd = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  cache->path = strdup(path);
+  if (cache->fd < 0 || cache->path == NULL)
+    goto fail;
+  pthread_mutex_init(&cache->lock, NULL);
+
+  /* Exclusive while the header is written or a torn tail is cut off */
+  flock(cache->fd, cache->writable ? LOCK_EX : LOCK_SH);
+  error = prepare_file(cache, &size);
+  flock(cache->fd, LOCK_UN);
+  if (error < 0)
+    goto fail;
+
+  cache->map_size = (size_t)size;
+  cache->map = mmap(NULL, cache->map_size, PROT_READ, MAP_SHARED, cache->fd, 0);
+  if (cache->map == MAP_FAILED) {
+    cache->map = NULL;
+    goto fail;
+  }
+  records = (cache->map_size - sizeof(sha1_cache_header)) /
+            sizeof(sha1_cache_record);
+  while (slots < 2 * records)
+    slots *= 2;
+  cache->index = index_create(slots);
+  if (cache->index == NULL)
+    goto fail;
+
+  /* Later records of a file replace earlier ones */
+  const sha1_cache_record *record =
+      (const sha1_cache_record *)((const uint8_t *)cache->map +
+                                  sizeof(sha1_cache_header));
+  for (size_t i = 0; i < records; i++, record++) {
+    if (record->check == record_check(record) &&
+        index_insert(cache, record) < 0)
+      cache->unindexed++;
+  }
+  cache->records = records;
+  return cache;
+
+fail:
+  error = errno;
+  sha1_cache_close(cache);
+  errno = error;
+  return NULL;
+}
+/**
+ * Looks up the digest of a file. Takes no lock.
+ * @param[in]  cache      Cache
+ * @param[in]  info       Status of the file, as from stat() or fstat()
+ * @param[out] final_hash Stored digest, set on a hit only
+ * @return 1 on a hit, 0 if the file is unknown or changed
+ */
+int sha1_cache_lookup(sha1_cache *cache, const struct stat *info,
+                      uint32_t final_hash[]) {
+  const sha1_cache_record *record;
+
+  if (!S_ISREG(info->st_mode))
+    return 0;
+  record = index_find(__atomic_load_n(&cache->index, __ATOMIC_ACQUIRE),
+                      (uint64_t)info->st_dev, (uint64_t)info->st_ino);
+  if (record == NULL || record->size != (uint64_t)info->st_size ||
+      record->mtime_ns != to_ns(&info->st_mtim) ||
+      ((cache->flags & SHA1_CACHE_CTIME) &&
+       record->ctime_ns != to_ns(&info->st_ctim)))
+    return 0;
+  memcpy(final_hash, record->final_hash, sizeof(record->final_hash));
+  return 1;
+}
+/**
+ * Stores the digest of a file. info must describe the file as it was
+ * hashed, i.e. be taken before reading it and found unchanged after.
+ * Files modified in the last two seconds are not stored.
+ * @param[in,out] cache      Cache
+ * @param[in]     info       Status of the file
+ * @param[in]     final_hash Digest of its contents
+ * @return 0 if stored, 1 if the file was too new, -1 on failure
+ */
+int sha1_cache_store(sha1_cache *cache, const struct stat *info,
+                     const uint32_t final_hash[]) {
+  sha1_cache_record *record;
+  struct timespec now;
+  int result = 0;
+
+  if (!cache->writable || !S_ISREG(info->st_mode))
+    return -1;
+  clock_gettime(CLOCK_REALTIME, &now);
+  if (to_ns(&info->st_mtim) > to_ns(&now) - SHA1_CACHE_RACY_NS ||
+      to_ns(&info->st_ctim) > to_ns(&now) - SHA1_CACHE_RACY_NS)
+    return 1;
+
+  record = calloc(1, sizeof(*record));
+  if (record == NULL)
+    return -1;
+  record->device = (uint64_t)info->st_dev;
+  record->inode = (uint64_t)info->st_ino;
+  record->size = (uint64_t)info->st_size;
+  record->mtime_ns = to_ns(&info->st_mtim);
+  record->ctime_ns = to_ns(&info->st_ctim);
+  memcpy(record->final_hash, final_hash, sizeof(record->final_hash));
+  record->check = record_check(record);
+
+  pthread_mutex_lock(&cache->lock);
+  if (cache->added_count == cache->added_capacity) {
+    size_t capacity =
+        (cache->added_capacity > 0) ? (2 * cache->added_capacity) : (256);
+    sha1_cache_record **added =
+        realloc(cache->added, capacity * sizeof(*added));
+    if (added == NULL) {
+      pthread_mutex_unlock(&cache->lock);
+      free(record);
+      return -1;
+    }
+    cache->added = added;
+    cache->added_capacity = capacity;
+  }
+  cache->added[cache->added_count++] = record;
+
+  /* One write() with O_APPEND: whole records even with other processes */
+  flock(cache->fd, LOCK_SH);
+  if (write_all(cache->fd, record, sizeof(*record)) < 0)
+    result = -1;
+  flock(cache->fd, LOCK_UN);
+  if (result == 0) {
+    cache->records++;
+    if (index_insert(cache, record) < 0)
+      cache->unindexed++;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return result;
+}
+/**
+ * Rewrites the cache file with only the newest record of each file. The
+ * new file is synced before it replaces the old one, so a crash leaves
+ * either of them. Skipped while another process is appending, and while
+ * a record is missing from the index, as it would be lost.
+ * @param[in,out] cache Cache
+ * @return 0 on success, -1 on failure or if the file is busy
+ */
+int sha1_cache_compact(sha1_cache *cache) {
+  const size_t length = strlen(cache->path);
+  char *temporary = malloc(length + sizeof(".XXXXXX"));
+  sha1_cache_header header;
+  sha1_cache_index *index;
+  int fd = -1, result = -1;
+
+  if (!cache->writable || temporary == NULL) {
+    free(temporary);
+    return -1;
+  }
+  memcpy(temporary, cache->path, length);
+  memcpy(temporary + length, ".XXXXXX", sizeof(".XXXXXX"));
+
+  pthread_mutex_lock(&cache->lock);
+  index = cache->index;
+  if (cache->unindexed > 0 || flock(cache->fd, LOCK_EX | LOCK_NB) < 0)
+    goto done;
+  fd = mkstemp(temporary);
+  if (fd < 0)
+    goto done;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SHA1_CACHE_MAGIC, sizeof(header.magic));
+  header.version = SHA1_CACHE_VERSION;
+  header.record_size = sizeof(sha1_cache_record);
+  if (write_all(fd, &header, sizeof(header)) < 0)
+    goto done;
+  for (size_t i = 0; i <= index->mask; i++) {
+    if (index->slot[i] != NULL &&
+        write_all(fd, index->slot[i], sizeof(sha1_cache_record)) < 0)
+      goto done;
+  }
+  if (fchmod(fd, 0644) < 0 || fsync(fd) < 0 ||
+      rename(temporary, cache->path) < 0)
+    goto done;
+
+  /* Make the rename durable, then append to the new file */
+  char *slash = strrchr(temporary, '/');
+  if (slash != NULL)
+    slash[1] = '\0';
+  int directory = open((slash != NULL) ? (temporary) : ("."), O_RDONLY);
+  if (directory >= 0) {
+    fsync(directory);
+    close(directory);
+  }
+  int appender = open(cache->path, O_RDWR | O_APPEND | O_CLOEXEC);
+  if (appender >= 0) {
+    close(cache->fd);
+    cache->fd = appender;
+  } else {
+    cache->writable = 0;
+  }
+  cache->records = index->live;
+  result = 0;
+
+done:
+  if (fd >= 0) {
+    close(fd);
+    if (result < 0)
+      unlink(temporary);
+  }
+  if (cache->fd >= 0)
+    flock(cache->fd, LOCK_UN);
+  pthread_mutex_unlock(&cache->lock);
+  free(temporary);
+  return result;
+}
+/**
+ * Closes a cache, compacting it first when most of its records are stale.
+ * No lookup or store may be running.
+ * @param[in] cache Cache, may be NULL
+ * @return void
+ */
+void sha1_cache_close(sha1_cache *cache) {
+  if (cache == NULL)
+    return;
+  if (cache->index != NULL && cache->writable && cache->unindexed == 0 &&
+      cache->records >= SHA1_CACHE_COMPACT_RECORDS &&
+      cache->records > 2 * cache->index->live)
+    sha1_cache_compact(cache);
+
+  if (cache->map != NULL)
+    munmap(cache->map, cache->map_size);
+  if (cache->fd >= 0)
+    close(cache->fd);
+  for (size_t i = 0; i < cache->added_count; i++) {
+    free(cache->added[i]);
+  }
+  free(cache->added);
+  while (cache->index != NULL) {
+    sha1_cache_index *retired = cache->index->retired;
+    free(cache->index);
+    cache->index = retired;
+  }
+  free(cache->path);
+  free(cache);
+}
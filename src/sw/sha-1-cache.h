@@ -0,0 +1,35 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-cache.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of a persistent cache of file digests. A file
+* 		            is identified by device, inode, size and modification
+* 		            time in nanoseconds, optionally also the change time;
+* 		            while all of them match the stored digest is returned
+* 		            and the file need not be read. The cache file is an
+* 		            append-only log of checksummed records, mapped into
+* 		            memory when opened. Lookups take no lock and may run
+* 		            on any number of threads; stores are serialized.
+****************************************************************************/
+
+#ifndef SHA1_CACHE_HPP
+#define SHA1_CACHE_HPP
+
+#include <sys/stat.h>
+#include "sha-1.h"
+
+#define SHA1_CACHE_CTIME                                                       \
+  (1) /**< @brief Flag: the change time must match too, so a file that was  \
+         rewritten with its old modification time is hashed again */
+
+typedef struct sha1_cache sha1_cache;
+
+sha1_cache *sha1_cache_open(const char *path, int flags);
+int sha1_cache_lookup(sha1_cache *cache, const struct stat *info,
+                      uint32_t final_hash[]);
+int sha1_cache_store(sha1_cache *cache, const struct stat *info,
+                     const uint32_t final_hash[]);
+int sha1_cache_compact(sha1_cache *cache);
+void sha1_cache_close(sha1_cache *cache);
+
+#endif /* SHA1_CACHE_HPP */
@@ -0,0 +1,137 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-check.c
+* Author          : Jishnu Murali Thampan
+* Description     : Checks that the unrolled core of -DSHA1_UNROLLED_CORE
+* 		              gives the digests of the loop core. sha-1.c is
+* 		              compiled into this file a second time with the
+* 		              unrolled core, its external names suffixed with
+* 		              _unrolled, and linked next to sha-1.c built with
+* 		              the loop core. Both run the portable kernel over
+* 		              every length from 0 to 130 bytes and over a
+* 		              multi-block message fed in uneven pieces; the exit
+* 		              status is non-zero on any difference.
+*
+* Build           : cc -O2 -o sha-1-check sha-1-check.c sha-1.c sha-1-x86.c
+* 		              (sha-1.c itself without -DSHA1_UNROLLED_CORE)
+* Usage           : sha-1-check
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The second copy of sha-1.c, with the unrolled core and other names */
+#define SHA1_UNROLLED_CORE
+#define generate_sha1_hash generate_sha1_hash_unrolled
+#define print_final_hash print_final_hash_unrolled
+#define sha1_compress_blocks sha1_compress_blocks_unrolled
+#define sha1_final sha1_final_unrolled
+#define sha1_get_kernel sha1_get_kernel_unrolled
+#define sha1_hash sha1_hash_unrolled
+#define sha1_init sha1_init_unrolled
+#define sha1_kernel_name sha1_kernel_name_unrolled
+#define sha1_kernel_supported sha1_kernel_supported_unrolled
+#define sha1_midstate_deserialize sha1_midstate_deserialize_unrolled
+#define sha1_midstate_export sha1_midstate_export_unrolled
+#define sha1_midstate_import sha1_midstate_import_unrolled
+#define sha1_midstate_serialize sha1_midstate_serialize_unrolled
+#define sha1_pre_processing_stage sha1_pre_processing_stage_unrolled
+#define sha1_set_kernel sha1_set_kernel_unrolled
+#define sha1_update sha1_update_unrolled
+#include "sha-1.c"
+#undef SHA1_UNROLLED_CORE
+#undef generate_sha1_hash
+#undef print_final_hash
+#undef sha1_compress_blocks
+#undef sha1_final
+#undef sha1_get_kernel
+#undef sha1_hash
+#undef sha1_init
+#undef sha1_kernel_name
+#undef sha1_kernel_supported
+#undef sha1_midstate_deserialize
+#undef sha1_midstate_export
+#undef sha1_midstate_import
+#undef sha1_midstate_serialize
+#undef sha1_pre_processing_stage
+#undef sha1_set_kernel
+#undef sha1_update
+
+/* The loop core of sha-1.c; sha-1.h was already included under the names
+   above, so its functions used here are declared again */
+int sha1_set_kernel(sha1_kernel kernel);
+void sha1_init(sha1_ctx *ctx);
+void sha1_update(sha1_ctx *ctx, const void *data, size_t length);
+void sha1_final(sha1_ctx *ctx, uint32_t final_hash[]);
+void sha1_hash(const void *data, size_t length, uint32_t final_hash[]);
+
+#define CHECK_MAX_LENGTH                                                       \
+  (130) /**< @brief Represents the longest message checked byte by byte */
+#define CHECK_LONG_LENGTH                                                      \
+  (64 * 1024 + 13) /**< @brief Represents the multi-block message length */
+
+/**
+ * Compares two digests and reports a difference
+ * @param[in] what     Message checked
+ * @param[in] length   Message length
+ * @param[in] loop     Digest of the loop core
+ * @param[in] unrolled Digest of the unrolled core
+ * @return 0 if equal, 1 otherwise
+ */
+static int compare(const char *what, size_t length, const uint32_t loop[],
+                   const uint32_t unrolled[]) {
+  if (memcmp(loop, unrolled, FINAL_HASH_SIZE * sizeof(uint32_t)) == 0)
+    return 0;
+  printf("ERR: %s of %zu bytes: loop ", what, length);
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++)
+    printf("%08x", loop[i]);
+  printf(", unrolled ");
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++)
+    printf("%08x", unrolled[i]);
+  printf("\n");
+  return 1;
+}
+
+int main(void) {
+  static uint8_t message[CHECK_LONG_LENGTH];
+  uint32_t loop[FINAL_HASH_SIZE], unrolled[FINAL_HASH_SIZE];
+  sha1_ctx ctx, ctx_unrolled;
+  int failed = 0;
+
+  /* The SIMD kernels bypass both cores */
+  if (sha1_set_kernel(SHA1_KERNEL_PORTABLE) != 0 ||
+      sha1_set_kernel_unrolled(SHA1_KERNEL_PORTABLE) != 0)
+    return EXIT_FAILURE;
+
+  srand(1);
+  for (size_t i = 0; i < sizeof(message); i++)
+    message[i] = (uint8_t)rand();
+
+  for (size_t length = 0; length <= CHECK_MAX_LENGTH; length++) {
+    sha1_hash(message, length, loop);
+    sha1_hash_unrolled(message, length, unrolled);
+    failed += compare("message", length, loop, unrolled);
+  }
+
+  /* Pieces of 1..97 bytes cross the block boundaries at every offset */
+  sha1_init(&ctx);
+  sha1_init_unrolled(&ctx_unrolled);
+  for (size_t offset = 0, piece = 1; offset < sizeof(message);
+       offset += piece, piece = piece % 97 + 1) {
+    if (piece > sizeof(message) - offset)
+      piece = sizeof(message) - offset;
+    sha1_update(&ctx, message + offset, piece);
+    sha1_update_unrolled(&ctx_unrolled, message + offset, piece);
+  }
+  sha1_final(&ctx, loop);
+  sha1_final_unrolled(&ctx_unrolled, unrolled);
+  failed += compare("streamed message", sizeof(message), loop, unrolled);
+
+  sha1_hash(message, sizeof(message), loop);
+  sha1_hash_unrolled(message, sizeof(message), unrolled);
+  failed += compare("message", sizeof(message), loop, unrolled);
+
+  printf("%d mismatches over %d messages\n", failed, CHECK_MAX_LENGTH + 3);
+  return (failed == 0) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
@@ -0,0 +1,236 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-constexpr.hpp
+* Author          : Jishnu Murali Thampan
+* Description     : Compile-time SHA-1 for C++14 and later. It runs the
+* 		            pre-processing and compression of sha-1.c in constant
+* 		            expressions, so digests of literals and other data
+* 		            known at compile time become constants: expected
+* 		            digests of self-tests, keys of lookup tables. The
+* 		            known-answer tests at the end of this file run in
+* 		            every translation unit that includes it.
+*
+* Usage           : static constexpr sha1::digest expected =
+* 		              sha1::hash("abc");
+* 		            using namespace sha1::literals;
+* 		            static_assert("abc"_sha1[0] == 0xA9993E36, "");
+****************************************************************************/
+
+#ifndef SHA1_CONSTEXPR_HPP
+#define SHA1_CONSTEXPR_HPP
+
+#if __cplusplus < 201402L
+#error "sha-1-constexpr.hpp needs C++14 constexpr functions"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "sha-1-internal.h"
+}
+
+namespace sha1 {
+
+/**
+ * Digest of a message, usable in constant expressions
+ */
+struct digest {
+  uint32_t word[FINAL_HASH_SIZE]; /**< @brief Final hash, H0..H4 */
+
+  /**
+   * Returns one word of the digest
+   * @param[in] i Word index, 0..4
+   * @return Word in host order
+   */
+  constexpr uint32_t operator[](size_t i) const { return word[i]; }
+};
+
+/**
+ * Compares two digests word by word
+ * @param[in] lhs First digest
+ * @param[in] rhs Second digest
+ * @return true if all words are equal
+ */
+constexpr bool operator==(const digest &lhs, const digest &rhs) {
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    if (lhs.word[i] != rhs.word[i])
+      return false;
+  }
+  return true;
+}
+constexpr bool operator!=(const digest &lhs, const digest &rhs) {
+  return !(lhs == rhs);
+}
+
+namespace detail {
+
+/**
+ * Rotates a word left
+ * @param[in] data          Word
+ * @param[in] numberOfBits  Bits to rotate by, 1..31
+ * @return Rotated word
+ */
+constexpr uint32_t rotate_left(uint32_t data, unsigned numberOfBits) {
+  return (data << numberOfBits) | (data >> (32 - numberOfBits));
+}
+/**
+ * Loads a big-endian 32 bit word from bytes of any character type
+ * @param[in] bytes First of the four bytes
+ * @return Word in host order
+ */
+template <typename T> constexpr uint32_t load_be32(const T *bytes) {
+  return (uint32_t(uint8_t(bytes[0])) << 24) |
+         (uint32_t(uint8_t(bytes[1])) << 16) |
+         (uint32_t(uint8_t(bytes[2])) << 8) | uint32_t(uint8_t(bytes[3]));
+}
+/**
+ * Compresses one 64 byte block into the chaining state, the rounds of
+ * perform_sha1_core in sha-1.c
+ * @param[in,out] hash_state Chaining state H0..H4
+ * @param[in]     block      One 64 byte block
+ * @return void
+ */
+template <typename T>
+constexpr void compress(uint32_t hash_state[], const T *block) {
+  uint32_t chunk[TOTAL_NUMBER_OF_ROUNDS] = {};
+
+  for (size_t i = 0; i < PRE_PROC_MSG_SIZE; i++) {
+    chunk[i] = load_be32(block + 4 * i);
+  }
+  for (size_t i = PRE_PROC_MSG_SIZE; i < TOTAL_NUMBER_OF_ROUNDS; i++) {
+    chunk[i] = rotate_left(
+        chunk[i - 3] ^ chunk[i - 8] ^ chunk[i - 14] ^ chunk[i - 16], 1);
+  }
+
+  uint32_t a = hash_state[0];
+  uint32_t b = hash_state[1];
+  uint32_t c = hash_state[2];
+  uint32_t d = hash_state[3];
+  uint32_t e = hash_state[4];
+
+  for (size_t i = 0; i < TOTAL_NUMBER_OF_ROUNDS; i++) {
+    uint32_t operation = 0, constant = 0;
+    switch (i / NUMBER_OF_ROUNDS_PER_STAGE) {
+    case 0:
+      operation = OPERATION_ROUND_1(b, c, d);
+      constant = SHA_1_ROUND_1_CONST;
+      break;
+    case 1:
+      operation = OPERATION_ROUND_2(b, c, d);
+      constant = SHA_1_ROUND_2_CONST;
+      break;
+    case 2:
+      operation = OPERATION_ROUND_3(b, c, d);
+      constant = SHA_1_ROUND_3_CONST;
+      break;
+    default:
+      operation = OPERATION_ROUND_4(b, c, d);
+      constant = SHA_1_ROUND_4_CONST;
+      break;
+    }
+    const uint32_t temp =
+        rotate_left(a, 5) + operation + e + constant + chunk[i];
+    e = d;
+    d = c;
+    c = rotate_left(b, 30);
+    b = a;
+    a = temp;
+  }
+
+  hash_state[0] += a;
+  hash_state[1] += b;
+  hash_state[2] += c;
+  hash_state[3] += d;
+  hash_state[4] += e;
+}
+
+} // namespace detail
+
+/**
+ * Computes the SHA-1 hash of a message in a constant expression
+ * @param[in] data   Message bytes, any character type
+ * @param[in] length Number of bytes in data
+ * @return Digest
+ */
+template <typename T> constexpr digest hash(const T *data, size_t length) {
+  digest result = {{uint32_t(H0), uint32_t(H1), uint32_t(H2), uint32_t(H3),
+                    uint32_t(H4)}};
+  const size_t whole = length - length % MESSAGE_SIZE;
+  const size_t tail = length - whole;
+
+  for (size_t offset = 0; offset < whole; offset += MESSAGE_SIZE) {
+    detail::compress(result.word, data + offset);
+  }
+
+  /* Pre-processing of the tail, as sha1_pre_processing_stage() does it */
+  uint8_t padded[MAX_PADDED_SIZE] = {};
+  const size_t blocks =
+      (tail < MESSAGE_SIZE - LENGTH_FIELD_SIZE) ? (1) : (2);
+  const uint64_t inputSize = uint64_t(length) * 8;
+
+  for (size_t i = 0; i < tail; i++) {
+    padded[i] = uint8_t(data[whole + i]);
+  }
+  padded[tail] = uint8_t(0x8 << 4);
+  for (size_t i = 0; i < LENGTH_FIELD_SIZE; i++) {
+    padded[blocks * MESSAGE_SIZE - 1 - i] = uint8_t(inputSize >> (8 * i));
+  }
+
+  for (size_t b = 0; b < blocks; b++) {
+    detail::compress(result.word, padded + b * MESSAGE_SIZE);
+  }
+  return result;
+}
+/**
+ * Computes the SHA-1 hash of a string literal, without its terminator
+ * @param[in] literal String literal
+ * @return Digest
+ */
+template <size_t N> constexpr digest hash(const char (&literal)[N]) {
+  return hash(literal, N - 1);
+}
+
+namespace literals {
+
+/**
+ * "message"_sha1 is the digest of the literal, without its terminator
+ * @param[in] data   Literal characters
+ * @param[in] length Number of characters
+ * @return Digest
+ */
+constexpr digest operator"" _sha1(const char *data, size_t length) {
+  return hash(data, length);
+}
+
+} // namespace literals
+
+} // namespace sha1
+
+/* Known answers of FIPS 180 and common test vectors, across the padding
+   boundaries: one block, length field in a second block, whole blocks */
+static_assert(sha1::hash("") == sha1::digest{{0xDA39A3EE, 0x5E6B4B0D,
+                                              0x3255BFEF, 0x95601890,
+                                              0xAFD80709}},
+              "SHA-1 of the empty message");
+static_assert(sha1::hash("abc") == sha1::digest{{0xA9993E36, 0x4706816A,
+                                                 0xBA3E2571, 0x7850C26C,
+                                                 0x9CD0D89D}},
+              "SHA-1 of \"abc\"");
+static_assert(sha1::hash("The quick brown fox jumps over the lazy dog") ==
+                  sha1::digest{{0x2FD4E1C6, 0x7A2D28FC, 0xED849EE1,
+                                0xBB76E739, 0x1B93EB12}},
+              "SHA-1 of a 43 byte message");
+static_assert(
+    sha1::hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+        sha1::digest{{0x84983E44, 0x1C3BD26E, 0xBAAE4AA1, 0xF95129E5,
+                      0xE54670F1}},
+    "SHA-1 of a 56 byte message");
+static_assert(
+    sha1::hash("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+               "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu") ==
+        sha1::digest{{0xA49B2446, 0xA02C645B, 0xF419F995, 0xB6709125,
+                      0x3A04A259}},
+    "SHA-1 of a 112 byte message");
+
+#endif /* SHA1_CONSTEXPR_HPP */
@@ -0,0 +1,136 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-internal.h
+* Author          : Jishnu Murali Thampan
+* Description     : Constants and helpers shared by the SHA-1 kernels.
+* 		            Not part of the public interface
+****************************************************************************/
+
+#ifndef SHA1_INTERNAL_HPP
+#define SHA1_INTERNAL_HPP
+
+#include "sha-1.h"
+
+#define PRE_PROC_MSG_SIZE                                                      \
+  (16) /**< @brief Represents the array size of the pre-processed message:     \
+          512(message size)/ 32(bit width)*/
+#define LENGTH_FIELD_SIZE                                                      \
+  (8) /**< @brief Represents the bytes reserved for the message length at the  \
+         end of the last block: 64/8 = 8*/
+
+#define NUMBER_OF_STAGES                                                       \
+  (4) /**< @brief Represents the number of stages of sha-1 */
+#define NUMBER_OF_ROUNDS_PER_STAGE                                             \
+  (20) /**< @brief Represents the number of rounds per stage of sha-1 */
+#define TOTAL_NUMBER_OF_ROUNDS                                                 \
+  (NUMBER_OF_STAGES) *                                                         \
+      (NUMBER_OF_ROUNDS_PER_STAGE) /**< @brief Represents total number of      \
+                                      rounds in sha-1 */
+
+/* SHA1 initialization constants */
+#define H0                                                                     \
+  (0x67452301) /**< @brief Represents SHA1 initialization constant H0 */
+#define H1                                                                     \
+  (0xEFCDAB89) /**< @brief Represents SHA1 initialization constant H1 */
+#define H2                                                                     \
+  (0x98BADCFE) /**< @brief Represents SHA1 initialization constant H2 */
+#define H3                                                                     \
+  (0x10325476) /**< @brief Represents SHA1 initialization constant H3 */
+#define H4                                                                     \
+  (0xC3D2E1F0) /**< @brief Represents SHA1 initialization constant H4 */
+
+#define SHA_1_ROUND_1_CONST                                                    \
+  (0x5A827999) /**< @brief Represents the constant used in SHA-1 Round-1*/
+#define SHA_1_ROUND_2_CONST                                                    \
+  (0x6ED9EBA1) /**< @brief Represents the constant used in SHA-1 Round-2*/
+#define SHA_1_ROUND_3_CONST                                                    \
+  (0x8F1BBCDC) /**< @brief Represents the constant used in SHA-1 Round-3*/
+#define SHA_1_ROUND_4_CONST                                                    \
+  (0xCA62C1D6) /**< @brief Represents the constant used in SHA-1 Round-4*/
+
+#define OPERATION_ROUND_1(b, c, d)                                             \
+  ((b & c) |                                                                   \
+   ((~b) &                                                                     \
+    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-1*/
+#define OPERATION_ROUND_2(b, c, d)                                             \
+  ((b ^ c ^                                                                    \
+    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-2*/
+#define OPERATION_ROUND_3(b, c, d)                                             \
+  ((b & c) | (b & d) |                                                         \
+   (c &                                                                        \
+    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-3*/
+#define OPERATION_ROUND_4(b, c, d)                                             \
+  ((b ^ c ^                                                                    \
+    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-4*/
+
+#define MAX_PADDED_SIZE                                                        \
+  (2 * MESSAGE_SIZE) /**< @brief Represents the largest padded tail: the      \
+                        length field may spill into a second block */
+
+/* Lane-parallel helpers: SHA1_MB_VEC is the vector type of the kernel */
+#define SHA1_MB_ROTATE_LEFT(data, numberOfBits)                                \
+  (((data) << (numberOfBits)) |                                                \
+   ((data) >> (32 - (numberOfBits)))) /**< @brief Rotates every lane left */
+
+#define SHA1_MB_SCHEDULE(chunk, i)                                             \
+  (chunk[(i)&15] = SHA1_MB_ROTATE_LEFT(                                        \
+       chunk[((i)-3) & 15] ^ chunk[((i)-8) & 15] ^ chunk[((i)-14) & 15] ^      \
+           chunk[(i)&15],                                                      \
+       1)) /**< @brief Expands the next schedule word in the 16 word ring */
+
+#define SHA1_MB_ROUND(OPERATION, CONSTANT, word)                               \
+  do {                                                                         \
+    SHA1_MB_VEC temp = SHA1_MB_ROTATE_LEFT(a, 5) + OPERATION(b, c, d) + e +    \
+                       (uint32_t)(CONSTANT) + (word);                          \
+    e = d;                                                                     \
+    d = c;                                                                     \
+    c = SHA1_MB_ROTATE_LEFT(b, 30);                                            \
+    b = a;                                                                     \
+    a = temp;                                                                  \
+  } while (0) /**< @brief Performs one SHA-1 round on every lane */
+
+/**
+ * Loads a big-endian 32 bit word from a possibly unaligned address
+ * @param[in] bytes First of the four bytes
+ * @return Word in host order
+ */
+static inline uint32_t sha1_load_be32(const uint8_t bytes[]) {
+  return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+         ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+/**
+ * Signature shared by the single-stream block compression kernels
+ */
+typedef void (*sha1_compress_fn)(uint32_t hash_state[],
+                                 const uint8_t message[], size_t blocks);
+
+void sha1_compress_blocks(uint32_t hash_state[], const uint8_t message[],
+                          size_t blocks);
+
+#if defined(__x86_64__) || defined(__i386__)
+int sha1_cpu_has_shani(void);
+int sha1_cpu_has_avx2(void);
+void sha1_compress_shani(uint32_t hash_state[], const uint8_t message[],
+                         size_t blocks);
+void sha1_compress_avx2(uint32_t hash_state[], const uint8_t message[],
+                        size_t blocks);
+#endif
+
+/**
+ * Stores a 32 bit word in big-endian order at a possibly unaligned address
+ * @param[in]  word  Word in host order
+ * @param[out] bytes Destination of the four bytes
+ * @return void
+ */
+static inline void sha1_store_be32(const uint32_t word, uint8_t bytes[]) {
+  bytes[0] = (uint8_t)(word >> 24);
+  bytes[1] = (uint8_t)(word >> 16);
+  bytes[2] = (uint8_t)(word >> 8);
+  bytes[3] = (uint8_t)word;
+}
+
+size_t sha1_pre_processing_stage(const uint8_t tail[], size_t tail_length,
+                                 uint64_t input_length, uint8_t padded[]);
+
+#endif /* SHA1_INTERNAL_HPP */
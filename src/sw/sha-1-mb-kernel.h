@@ -0,0 +1,99 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-mb-kernel.h
+* Author          : Jishnu Murali Thampan
+* Description     : Lane-parallel SHA-1 compression kernel. This file is
+* 		            included once per vector width by sha-1-mb.c with
+* 		            the following macros defined:
+* 		            SHA1_MB_LANES  - number of 32 bit lanes per vector
+* 		            SHA1_MB_VEC    - name of the vector type to declare
+* 		            SHA1_MB_KERNEL - name of the kernel function
+* 		            SHA1_MB_TARGET - function attribute selecting the ISA
+****************************************************************************/
+
+typedef uint32_t SHA1_MB_VEC
+    __attribute__((vector_size(SHA1_MB_LANES * sizeof(uint32_t))));
+
+/**
+ * Compresses one block of every lane into the transposed chaining state.
+ * Lane l reads its block from blocks[l]; lanes whose bit is clear in active
+ * run through the rounds but leave their state untouched.
+ * @param[in,out] state  Chaining state, state[word][lane]
+ * @param[in]     blocks One 64 byte block per lane
+ * @param[in]     active Bit mask of the lanes to be updated
+ * @return void
+ */
+SHA1_MB_TARGET static void
+SHA1_MB_KERNEL(uint32_t state[][SHA1_MB_MAX_LANES],
+               const uint8_t *const blocks[], const uint32_t active) {
+  uint32_t lane_words[SHA1_MB_LANES];
+  SHA1_MB_VEC hash_state[FINAL_HASH_SIZE];
+  SHA1_MB_VEC chunk[PRE_PROC_MSG_SIZE];
+  SHA1_MB_VEC mask;
+
+  /* Finished lanes must not accumulate: mask their contribution to zero */
+  for (size_t lane = 0; lane < SHA1_MB_LANES; lane++) {
+    lane_words[lane] = ((active >> lane) & 1) ? (0xFFFFFFFF) : (0);
+  }
+  memcpy(&mask, lane_words, sizeof(mask));
+
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    memcpy(&hash_state[i], state[i], sizeof(hash_state[i]));
+  }
+
+  /* Transpose word i of every lane's block into one vector */
+  for (size_t i = 0; i < PRE_PROC_MSG_SIZE; i++) {
+    for (size_t lane = 0; lane < SHA1_MB_LANES; lane++) {
+      lane_words[lane] = sha1_load_be32(blocks[lane] + 4 * i);
+    }
+    memcpy(&chunk[i], lane_words, sizeof(chunk[i]));
+  }
+
+  SHA1_MB_VEC a = hash_state[0];
+  SHA1_MB_VEC b = hash_state[1];
+  SHA1_MB_VEC c = hash_state[2];
+  SHA1_MB_VEC d = hash_state[3];
+  SHA1_MB_VEC e = hash_state[4];
+
+  size_t i = 0; /* loop variable to count from 0 to TOTAL_NUMBER_OF_ROUNDS */
+
+  /* Round -1 */
+  for (; i < PRE_PROC_MSG_SIZE; i++) {
+    SHA1_MB_ROUND(OPERATION_ROUND_1, SHA_1_ROUND_1_CONST, chunk[i]);
+  }
+  for (; i < NUMBER_OF_ROUNDS_PER_STAGE; i++) {
+    SHA1_MB_ROUND(OPERATION_ROUND_1, SHA_1_ROUND_1_CONST,
+                  SHA1_MB_SCHEDULE(chunk, i));
+  }
+  /* Round -2 */
+  for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 2; i++) {
+    SHA1_MB_ROUND(OPERATION_ROUND_2, SHA_1_ROUND_2_CONST,
+                  SHA1_MB_SCHEDULE(chunk, i));
+  }
+  /* Round -3 */
+  for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 3; i++) {
+    SHA1_MB_ROUND(OPERATION_ROUND_3, SHA_1_ROUND_3_CONST,
+                  SHA1_MB_SCHEDULE(chunk, i));
+  }
+  /* Round -4 */
+  for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 4; i++) {
+    SHA1_MB_ROUND(OPERATION_ROUND_4, SHA_1_ROUND_4_CONST,
+                  SHA1_MB_SCHEDULE(chunk, i));
+  }
+
+  /* Accumulate the intermediate hashes of the active lanes only */
+  hash_state[0] += a & mask;
+  hash_state[1] += b & mask;
+  hash_state[2] += c & mask;
+  hash_state[3] += d & mask;
+  hash_state[4] += e & mask;
+
+  for (size_t j = 0; j < FINAL_HASH_SIZE; j++) {
+    memcpy(state[j], &hash_state[j], sizeof(hash_state[j]));
+  }
+}
+
+#undef SHA1_MB_LANES
+#undef SHA1_MB_VEC
+#undef SHA1_MB_KERNEL
+#undef SHA1_MB_TARGET
@@ -0,0 +1,294 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-mb.c
+* Author          : Jishnu Murali Thampan
+* Description     : Multi-buffer SHA-1 engine. Independent messages are
+* 		              interleaved across the 32 bit lanes of SSE2 (4),
+* 		              AVX2 (8) or AVX-512 (16) vectors. A lane that finishes
+* 		              its message is refilled with the next job; once the
+* 		              batch runs dry, finished lanes are masked out. The
+* 		              lanes can also start from a shared midstate, so a
+* 		              batch of suffixes skips the blocks of the prefix.
+****************************************************************************/
+
+#include <string.h>
+#include "sha-1-mb.h"
+#include "sha-1-internal.h"
+
+/**
+ * Signature shared by the lane-parallel kernels
+ */
+typedef void (*sha1_mb_kernel)(uint32_t state[][SHA1_MB_MAX_LANES],
+                               const uint8_t *const blocks[],
+                               const uint32_t active);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA1_MB_LANES 4
+#define SHA1_MB_VEC sha1_vec4
+#define SHA1_MB_KERNEL sha1_mb_compress_sse2
+#define SHA1_MB_TARGET __attribute__((target("sse2")))
+#include "sha-1-mb-kernel.h"
+
+#define SHA1_MB_LANES 8
+#define SHA1_MB_VEC sha1_vec8
+#define SHA1_MB_KERNEL sha1_mb_compress_avx2
+#define SHA1_MB_TARGET __attribute__((target("avx2")))
+#include "sha-1-mb-kernel.h"
+
+#define SHA1_MB_LANES 16
+#define SHA1_MB_VEC sha1_vec16
+#define SHA1_MB_KERNEL sha1_mb_compress_avx512
+#define SHA1_MB_TARGET __attribute__((target("avx512f")))
+#include "sha-1-mb-kernel.h"
+#else
+/* Generic vectors: the compiler lowers them to whatever the target has */
+#define SHA1_MB_LANES 4
+#define SHA1_MB_VEC sha1_vec4
+#define SHA1_MB_KERNEL sha1_mb_compress_generic
+#define SHA1_MB_TARGET
+#include "sha-1-mb-kernel.h"
+#endif
+
+/**
+ * Per-lane cursor over the blocks of the job currently assigned to it
+ */
+typedef struct sha1_mb_lane {
+  sha1_job *job;                   /**< @brief Job being hashed */
+  const uint8_t *next;             /**< @brief Next whole block of the job */
+  size_t blocks;                   /**< @brief Whole blocks left in job data */
+  uint8_t padded[MAX_PADDED_SIZE]; /**< @brief Pre-processed final blocks */
+  size_t padded_blocks;            /**< @brief Final blocks in padded */
+  size_t padded_consumed;          /**< @brief Final blocks compressed */
+} sha1_mb_lane;
+
+/**
+ * Returns the lane-parallel kernel matching the requested width
+ * @param[in] lanes Requested number of lanes (4, 8 or 16)
+ * @return Kernel or NULL if the CPU cannot run it
+ */
+static sha1_mb_kernel sha1_mb_select_kernel(const size_t lanes) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (lanes == 16 && __builtin_cpu_supports("avx512f"))
+    return sha1_mb_compress_avx512;
+  if (lanes == 8 && __builtin_cpu_supports("avx2"))
+    return sha1_mb_compress_avx2;
+  /* Only SSE2 operations: every x86-64 CPU runs the 4 lane kernel */
+  if (lanes == 4 && __builtin_cpu_supports("sse2"))
+    return sha1_mb_compress_sse2;
+#else
+  if (lanes == 4)
+    return sha1_mb_compress_generic;
+#endif
+  return NULL;
+}
+/**
+ * Returns the widest lane count supported by the CPU. 4 lanes are always
+ * available, lane by lane where no vector kernel runs.
+ * @param  None
+ * @return Number of lanes (16, 8 or 4)
+ */
+size_t sha1_mb_max_lanes(void) {
+  for (size_t lanes = SHA1_MB_MAX_LANES; lanes > 4; lanes /= 2) {
+    if (sha1_mb_select_kernel(lanes) != NULL)
+      return lanes;
+  }
+  return 4;
+}
+/**
+ * Assigns a job to a lane and resets the lane's chaining state
+ * @param[out] lane   Lane cursor
+ * @param[out] state  Transposed chaining state
+ * @param[in]  index  Lane index
+ * @param[in]  job    Job to be hashed
+ * @param[in]  prefix Midstate the job continues, NULL for none
+ * @return void
+ */
+static void sha1_mb_lane_load(sha1_mb_lane *lane,
+                              uint32_t state[][SHA1_MB_MAX_LANES],
+                              const size_t index, sha1_job *job,
+                              const sha1_midstate *prefix) {
+  const uint8_t *message = (const uint8_t *)job->data;
+  size_t blocks = job->length / MESSAGE_SIZE;
+  uint64_t prefix_length = (prefix != NULL) ? (prefix->length) : (0);
+
+  lane->job = job;
+  lane->next = message;
+  lane->blocks = blocks;
+  lane->padded_blocks = sha1_pre_processing_stage(
+      message + blocks * MESSAGE_SIZE, job->length - blocks * MESSAGE_SIZE,
+      prefix_length + job->length, lane->padded);
+  lane->padded_consumed = 0;
+
+  if (prefix != NULL) {
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      state[i][index] = prefix->state[i];
+    }
+    return;
+  }
+  state[0][index] = H0;
+  state[1][index] = H1;
+  state[2][index] = H2;
+  state[3][index] = H3;
+  state[4][index] = H4;
+}
+/**
+ * Returns the lane's next block: whole blocks come straight from the job
+ * data, the final ones from the pre-processed tail
+ * @param[in,out] lane Lane cursor
+ * @return Block to be compressed
+ */
+static const uint8_t *sha1_mb_lane_next_block(sha1_mb_lane *lane) {
+  if (lane->blocks > 0) {
+    const uint8_t *block = lane->next;
+    lane->next += MESSAGE_SIZE;
+    lane->blocks--;
+    return block;
+  }
+  return lane->padded + MESSAGE_SIZE * lane->padded_consumed++;
+}
+/**
+ * Compresses one block per lane, lane by lane with the single-buffer
+ * kernel, for CPUs without a vector kernel of that width
+ * @param[in]     lanes  Lane count
+ * @param[in,out] state  Chaining state, state[word][lane]
+ * @param[in]     blocks One 64 byte block per active lane
+ * @param[in]     active Bit mask of the lanes to be updated
+ * @return void
+ */
+static void sha1_mb_compress_scalar(size_t lanes,
+                                    uint32_t state[][SHA1_MB_MAX_LANES],
+                                    const uint8_t *const blocks[],
+                                    uint32_t active) {
+  for (size_t l = 0; l < lanes && l < SHA1_MB_MAX_LANES; l++) {
+    uint32_t hash_state[FINAL_HASH_SIZE];
+    if (((active >> l) & 1) == 0)
+      continue;
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      hash_state[i] = state[i][l];
+    }
+    sha1_compress_blocks(hash_state, blocks[l], 1);
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      state[i][l] = hash_state[i];
+    }
+  }
+}
+/**
+ * Shared worker of sha1_hash_batch_lanes() and sha1_hash_suffixes().
+ * Keeps every lane busy: a lane starts its job from the initial hash
+ * values, or from prefix when one is given, and takes the next job as
+ * soon as its last padded block is compressed. Lengths in the padding
+ * then count the prefix bytes too.
+ * @param[in,out] jobs   Messages or suffixes; final_hash is filled in
+ * @param[in]     count  Number of jobs
+ * @param[in]     lanes  Lane count to use (4, 8 or 16). Falls back to the
+ *                       widest supported width if the CPU cannot run it.
+ * @param[in]     prefix Midstate every lane starts from, NULL for none
+ * @return void
+ */
+static void sha1_mb_hash_jobs(sha1_job jobs[], size_t count, size_t lanes,
+                              const sha1_midstate *prefix) {
+  static const uint8_t idle_block[MESSAGE_SIZE] = {0};
+  sha1_mb_lane lane[SHA1_MB_MAX_LANES];
+  uint32_t state[FINAL_HASH_SIZE][SHA1_MB_MAX_LANES] = {{0}};
+  const uint8_t *blocks[SHA1_MB_MAX_LANES];
+  sha1_mb_kernel kernel = sha1_mb_select_kernel(lanes);
+  uint32_t active = 0;
+  size_t next_job = 0;
+
+  if (kernel == NULL) {
+    lanes = sha1_mb_max_lanes();
+    kernel = sha1_mb_select_kernel(lanes);
+  }
+
+  for (size_t l = 0; l < lanes; l++) {
+    blocks[l] = idle_block;
+    if (next_job < count) {
+      sha1_mb_lane_load(&lane[l], state, l, &jobs[next_job++], prefix);
+      active |= 1u << l;
+    }
+  }
+
+  while (active != 0) {
+    for (size_t l = 0; l < lanes; l++) {
+      if ((active >> l) & 1)
+        blocks[l] = sha1_mb_lane_next_block(&lane[l]);
+    }
+
+    if (kernel != NULL)
+      kernel(state, blocks, active);
+    else
+      sha1_mb_compress_scalar(lanes, state, blocks, active);
+
+    /* Retire finished lanes and refill them from the remaining jobs */
+    for (size_t l = 0; l < lanes; l++) {
+      if (((active >> l) & 1) == 0 ||
+          lane[l].padded_consumed < lane[l].padded_blocks)
+        continue;
+
+      for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+        lane[l].job->final_hash[i] = state[i][l];
+      }
+      if (next_job < count) {
+        sha1_mb_lane_load(&lane[l], state, l, &jobs[next_job++], prefix);
+      } else {
+        active &= ~(1u << l);
+        blocks[l] = idle_block;
+      }
+    }
+  }
+}
+/**
+ * Hashes a batch of independent messages on an explicit lane count
+ * @param[in,out] jobs  Messages; their final_hash fields are filled in
+ * @param[in]     count Number of jobs
+ * @param[in]     lanes Lane count to use (4, 8 or 16). Falls back to the
+ *                      widest supported width if the CPU cannot run it.
+ * @return void
+ */
+void sha1_hash_batch_lanes(sha1_job jobs[], size_t count, size_t lanes) {
+  sha1_mb_hash_jobs(jobs, count, lanes, NULL);
+}
+/**
+ * Hashes a batch of messages sharing a prefix whose whole blocks were
+ * hashed once into a midstate. Each job holds only what follows those
+ * blocks; bytes of the prefix past its last whole block must start it.
+ * @param[in]     prefix Midstate after the whole blocks of the prefix
+ * @param[in,out] jobs   Suffixes; their final_hash fields receive the
+ *                       digests of prefix || suffix
+ * @param[in]     count  Number of jobs
+ * @return void
+ */
+void sha1_hash_suffixes(const sha1_midstate *prefix, sha1_job jobs[],
+                        size_t count) {
+  sha1_mb_hash_jobs(jobs, count, sha1_mb_max_lanes(), prefix);
+}
+/**
+ * Compresses one block per lane into a transposed chaining state. This is
+ * the building block for callers that manage the lanes themselves, e.g.
+ * keyed hashes starting from a precomputed midstate.
+ * @param[in]     lanes  Lane count (4, 8 or 16); widths the CPU cannot run
+ *                       are compressed lane by lane
+ * @param[in,out] state  Chaining state, state[word][lane]
+ * @param[in]     blocks One 64 byte block per active lane
+ * @param[in]     active Bit mask of the lanes to be updated
+ * @return void
+ */
+void sha1_mb_compress(size_t lanes, uint32_t state[][SHA1_MB_MAX_LANES],
+                      const uint8_t *const blocks[], uint32_t active) {
+  sha1_mb_kernel kernel = sha1_mb_select_kernel(lanes);
+
+  if (kernel != NULL)
+    kernel(state, blocks, active);
+  else
+    sha1_mb_compress_scalar(lanes, state, blocks, active);
+}
+/**
+ * Hashes a batch of independent messages on the widest supported lanes
+ * @param[in,out] jobs  Messages; their final_hash fields are filled in
+ * @param[in]     count Number of jobs
+ * @return void
+ */
+void sha1_hash_batch(sha1_job jobs[], size_t count) {
+  sha1_hash_batch_lanes(jobs, count, sha1_mb_max_lanes());
+}
@@ -0,0 +1,35 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-mb.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of the multi-buffer SHA-1 engine which hashes
+* 		            4/8/16 independent messages in parallel SIMD lanes,
+* 		            optionally all continuing one shared midstate
+****************************************************************************/
+
+#ifndef SHA1_MB_HPP
+#define SHA1_MB_HPP
+
+#include "sha-1.h"
+
+#define SHA1_MB_MAX_LANES                                                      \
+  (16) /**< @brief Represents the widest lane count: 512 bit vectors/32 bit */
+
+/**
+ * One independent message of a batch and the slot for its digest
+ */
+typedef struct sha1_job {
+  const void *data;                     /**< @brief Message bytes */
+  size_t length;                        /**< @brief Number of bytes in data */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Filled in by the engine */
+} sha1_job;
+
+size_t sha1_mb_max_lanes(void);
+void sha1_hash_batch(sha1_job jobs[], size_t count);
+void sha1_hash_batch_lanes(sha1_job jobs[], size_t count, size_t lanes);
+void sha1_hash_suffixes(const sha1_midstate *prefix, sha1_job jobs[],
+                        size_t count);
+void sha1_mb_compress(size_t lanes, uint32_t state[][SHA1_MB_MAX_LANES],
+                      const uint8_t *const blocks[], uint32_t active);
+
+#endif /* SHA1_MB_HPP */
@@ -0,0 +1,185 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-profile.c
+* Author          : Jishnu Murali Thampan
+* Description     : Per-thread stage histograms of the software SHA-1.
+* 		              Each thread gets its histograms on its first sample
+* 		              and links them into a global list, the only step
+* 		              that takes a lock. A snapshot adds up the list; the
+* 		              histograms of threads that exited stay in it.
+*
+* Build           : Add sha-1-profile.c to any program using sha-1.c, and
+* 		              -DSHA1_PROFILE to all of them to enable the counting
+****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "sha-1-profile.h"
+
+#ifdef SHA1_PROFILE
+#include <pthread.h>
+
+/**
+ * Histograms of one thread, linked into the global list
+ */
+typedef struct sha1_profile_thread {
+  sha1_profile_snapshot histograms;  /**< @brief Written by the owner only */
+  struct sha1_profile_thread *next;  /**< @brief Next thread */
+} sha1_profile_thread;
+
+_Thread_local sha1_profile_snapshot *sha1_profile_local = NULL;
+
+static sha1_profile_thread *profile_threads =
+    NULL; /**< @brief Histograms of every thread that recorded a sample */
+static pthread_mutex_t profile_lock =
+    PTHREAD_MUTEX_INITIALIZER; /**< @brief Guards profile_threads */
+
+/**
+ * Allocates the histograms of the calling thread on its first sample
+ * @param  None
+ * @return Histograms, NULL if out of memory
+ */
+sha1_profile_snapshot *sha1_profile_attach(void) {
+  sha1_profile_thread *thread = calloc(1, sizeof(*thread));
+
+  if (thread == NULL)
+    return NULL;
+  pthread_mutex_lock(&profile_lock);
+  thread->next = profile_threads;
+  profile_threads = thread;
+  pthread_mutex_unlock(&profile_lock);
+
+  sha1_profile_local = &thread->histograms;
+  return sha1_profile_local;
+}
+#endif /* SHA1_PROFILE */
+
+/**
+ * Adds up the histograms of all threads. Can be called while other threads
+ * hash; a sample being recorded meanwhile may be counted in part.
+ * @param[out] snapshot Sum over the threads, all zero without SHA1_PROFILE
+ * @return void
+ */
+void sha1_profile_snapshot_take(sha1_profile_snapshot *snapshot) {
+  memset(snapshot, 0, sizeof(*snapshot));
+#ifdef SHA1_PROFILE
+  pthread_mutex_lock(&profile_lock);
+  for (const sha1_profile_thread *thread = profile_threads; thread != NULL;
+       thread = thread->next) {
+    for (int s = 0; s < SHA1_STAGE_COUNT; s++) {
+      const sha1_profile_histogram *from = &thread->histograms.stage[s];
+      sha1_profile_histogram *to = &snapshot->stage[s];
+      const uint64_t count = __atomic_load_n(&from->count, __ATOMIC_RELAXED);
+      const uint64_t min = __atomic_load_n(&from->min, __ATOMIC_RELAXED);
+      const uint64_t max = __atomic_load_n(&from->max, __ATOMIC_RELAXED);
+
+      if (count == 0)
+        continue;
+      if (to->count == 0 || min < to->min)
+        to->min = min;
+      if (max > to->max)
+        to->max = max;
+      to->count += count;
+      to->cycles += __atomic_load_n(&from->cycles, __ATOMIC_RELAXED);
+      for (int b = 0; b < SHA1_PROFILE_BUCKETS; b++) {
+        to->bucket[b] += __atomic_load_n(&from->bucket[b], __ATOMIC_RELAXED);
+      }
+    }
+  }
+  pthread_mutex_unlock(&profile_lock);
+#endif
+}
+/**
+ * Subtracts an earlier snapshot, leaving the samples recorded in between.
+ * min and max cannot be subtracted and are those of the later snapshot.
+ * @param[in]  after  Later snapshot
+ * @param[in]  before Earlier snapshot
+ * @param[out] delta  Samples in between, may alias after
+ * @return void
+ */
+void sha1_profile_snapshot_diff(const sha1_profile_snapshot *after,
+                                const sha1_profile_snapshot *before,
+                                sha1_profile_snapshot *delta) {
+  for (int s = 0; s < SHA1_STAGE_COUNT; s++) {
+    const sha1_profile_histogram *a = &after->stage[s];
+    const sha1_profile_histogram *b = &before->stage[s];
+    sha1_profile_histogram *d = &delta->stage[s];
+
+    d->count = a->count - b->count;
+    d->cycles = a->cycles - b->cycles;
+    d->min = a->min;
+    d->max = a->max;
+    for (int i = 0; i < SHA1_PROFILE_BUCKETS; i++) {
+      d->bucket[i] = a->bucket[i] - b->bucket[i];
+    }
+  }
+}
+/**
+ * Estimates a percentile from the log2 buckets: the upper end of the
+ * bucket it falls in, so within a factor of two
+ * @param[in] histogram  Histogram
+ * @param[in] percentile 0 to 100
+ * @return Cycles, 0 for an empty histogram
+ */
+uint64_t sha1_profile_percentile(const sha1_profile_histogram *histogram,
+                                 double percentile) {
+  const double rank = (double)histogram->count * percentile / 100.0;
+  uint64_t seen = 0;
+
+  for (int b = 0; b < SHA1_PROFILE_BUCKETS; b++) {
+    seen += histogram->bucket[b];
+    if (seen > 0 && (double)seen >= rank) {
+      const uint64_t upper = (b == 0) ? (0) : ((UINT64_C(1) << b) - 1);
+      return (upper < histogram->max) ? (upper) : (histogram->max);
+    }
+  }
+  return histogram->max;
+}
+/**
+ * Returns a printable name of a stage
+ * @param[in] stage Stage
+ * @return Name of the stage
+ */
+const char *sha1_stage_name(sha1_stage stage) {
+  static const char *const names[SHA1_STAGE_COUNT] = {
+      [SHA1_STAGE_INPUT] = "input",
+      [SHA1_STAGE_PRE_PROCESSING] = "pre_processing",
+      [SHA1_STAGE_LOAD] = "load",
+      [SHA1_STAGE_SCHEDULE] = "schedule",
+      [SHA1_STAGE_ROUNDS] = "rounds",
+      [SHA1_STAGE_ACCUMULATE] = "accumulate",
+      [SHA1_STAGE_BLOCK] = "block",
+      [SHA1_STAGE_PRINT] = "print",
+  };
+  return ((unsigned)stage < SHA1_STAGE_COUNT) ? (names[stage]) : ("unknown");
+}
+/**
+ * Writes a snapshot as CSV: one line per stage with the count, the total,
+ * mean, min, p50, p99 and max cycles, then the non-empty buckets as
+ * upper_bound:count pairs
+ * @param[in] snapshot Snapshot
+ * @param[in] out      Destination, e.g. stderr
+ * @return void
+ */
+void sha1_profile_export(const sha1_profile_snapshot *snapshot, FILE *out) {
+  fprintf(out, "stage,count,cycles,mean,min,p50,p99,max,buckets\n");
+  for (int s = 0; s < SHA1_STAGE_COUNT; s++) {
+    const sha1_profile_histogram *h = &snapshot->stage[s];
+
+    fprintf(out, "%s,%llu,%llu,%.1f,%llu,%llu,%llu,%llu,",
+            sha1_stage_name((sha1_stage)s), (unsigned long long)h->count,
+            (unsigned long long)h->cycles,
+            (h->count > 0) ? ((double)h->cycles / h->count) : (0.0),
+            (unsigned long long)h->min,
+            (unsigned long long)sha1_profile_percentile(h, 50),
+            (unsigned long long)sha1_profile_percentile(h, 99),
+            (unsigned long long)h->max);
+    for (int b = 0; b < SHA1_PROFILE_BUCKETS; b++) {
+      if (h->bucket[b] > 0)
+        fprintf(out, " %llu:%llu",
+                (b == 0) ? (0ull) : ((unsigned long long)(1ull << b) - 1),
+                (unsigned long long)h->bucket[b]);
+    }
+    fprintf(out, "\n");
+  }
+}
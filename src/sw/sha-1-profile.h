@@ -0,0 +1,144 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-profile.h
+* Author          : Jishnu Murali Thampan
+* Description     : Optional cycle counting of the stages of the software
+* 		            SHA-1. Building with -DSHA1_PROFILE times every stage
+* 		            of generate_sha1_hash and of each compressed block
+* 		            with the time stamp counter and sorts the durations
+* 		            into log2 histograms kept per thread, so the hot path
+* 		            takes no lock and shares no cache line. Without it the
+* 		            SHA1_PROFILE_* macros expand to nothing; the snapshot
+* 		            functions remain and report no samples.
+* 		            Only the portable kernel is split into load, schedule,
+* 		            rounds and accumulate, so a profiled build selects it
+* 		            for SHA1_KERNEL_AUTO. A SIMD kernel chosen explicitly
+* 		            with sha1_set_kernel() is timed as whole blocks only.
+****************************************************************************/
+
+#ifndef SHA1_PROFILE_HPP
+#define SHA1_PROFILE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SHA1_PROFILE_BUCKETS                                                   \
+  (64) /**< @brief Represents the histogram buckets: bucket i counts the       \
+          samples of 2^(i-1) to 2^i - 1 cycles */
+
+/**
+ * Stages of the software SHA-1 that are timed
+ */
+typedef enum sha1_stage {
+  SHA1_STAGE_INPUT = 0,      /**< @brief getInputString */
+  SHA1_STAGE_PRE_PROCESSING, /**< @brief Padding and length of the tail */
+  SHA1_STAGE_LOAD,           /**< @brief Bytes to big-endian words, per block */
+  SHA1_STAGE_SCHEDULE,       /**< @brief Words 16..79 of the schedule */
+  SHA1_STAGE_ROUNDS,         /**< @brief The 80 rounds, per block */
+  SHA1_STAGE_ACCUMULATE,     /**< @brief Adding into the chaining state */
+  SHA1_STAGE_BLOCK,          /**< @brief One whole block, any kernel */
+  SHA1_STAGE_PRINT,          /**< @brief print_final_hash */
+  SHA1_STAGE_COUNT           /**< @brief Number of entries, not a stage */
+} sha1_stage;
+
+/**
+ * Durations of one stage
+ */
+typedef struct sha1_profile_histogram {
+  uint64_t count;                        /**< @brief Samples */
+  uint64_t cycles;                       /**< @brief Sum of the samples */
+  uint64_t min;                          /**< @brief Shortest sample */
+  uint64_t max;                          /**< @brief Longest sample */
+  uint64_t bucket[SHA1_PROFILE_BUCKETS]; /**< @brief Samples per log2 range */
+} sha1_profile_histogram;
+
+/**
+ * Histograms of all stages, summed over the threads
+ */
+typedef struct sha1_profile_snapshot {
+  sha1_profile_histogram stage[SHA1_STAGE_COUNT]; /**< @brief Per stage */
+} sha1_profile_snapshot;
+
+void sha1_profile_snapshot_take(sha1_profile_snapshot *snapshot);
+void sha1_profile_snapshot_diff(const sha1_profile_snapshot *after,
+                                const sha1_profile_snapshot *before,
+                                sha1_profile_snapshot *delta);
+uint64_t sha1_profile_percentile(const sha1_profile_histogram *histogram,
+                                 double percentile);
+void sha1_profile_export(const sha1_profile_snapshot *snapshot, FILE *out);
+const char *sha1_stage_name(sha1_stage stage);
+
+#ifdef SHA1_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+extern _Thread_local sha1_profile_snapshot
+    *sha1_profile_local; /**< @brief Histograms of the calling thread */
+
+sha1_profile_snapshot *sha1_profile_attach(void);
+
+/**
+ * Reads the time stamp counter, or nanoseconds where there is none. Not
+ * serializing: a stage is short, and a fence would cost more than it.
+ * @param  None
+ * @return Current cycle count
+ */
+static inline uint64_t sha1_profile_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+/**
+ * Adds a sample to a histogram of the calling thread. Only this thread
+ * writes it; the relaxed stores let a snapshot read it at any time.
+ * @param[in] stage Stage timed
+ * @param[in] start sha1_profile_clock() when the stage began
+ * @return void
+ */
+static inline void sha1_profile_record(sha1_stage stage, uint64_t start) {
+  const uint64_t sample = sha1_profile_clock() - start;
+  sha1_profile_snapshot *local = sha1_profile_local;
+  sha1_profile_histogram *h;
+  int bucket;
+
+  if (local == NULL && (local = sha1_profile_attach()) == NULL)
+    return;
+  h = &local->stage[stage];
+  bucket = (sample == 0) ? (0) : (64 - __builtin_clzll(sample));
+  if (bucket >= SHA1_PROFILE_BUCKETS)
+    bucket = SHA1_PROFILE_BUCKETS - 1;
+
+  __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->cycles, h->cycles + sample, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->bucket[bucket], h->bucket[bucket] + 1,
+                   __ATOMIC_RELAXED);
+  if (sample < h->min || h->count == 1)
+    __atomic_store_n(&h->min, sample, __ATOMIC_RELAXED);
+  if (sample > h->max)
+    __atomic_store_n(&h->max, sample, __ATOMIC_RELAXED);
+}
+
+#define SHA1_PROFILE_START(start)                                              \
+  const uint64_t start =                                                       \
+      sha1_profile_clock() /**< @brief Starts timing a stage */
+#define SHA1_PROFILE_STOP(stage, start)                                        \
+  sha1_profile_record((stage), (start)) /**< @brief Stops timing a stage */
+
+#else /* SHA1_PROFILE */
+
+#define SHA1_PROFILE_START(start)                                              \
+  ((void)0) /**< @brief Compiled out */
+#define SHA1_PROFILE_STOP(stage, start)                                        \
+  ((void)0) /**< @brief Compiled out */
+
+#endif /* SHA1_PROFILE */
+
+#endif /* SHA1_PROFILE_HPP */
@@ -0,0 +1,129 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-search-kernel.h
+* Author          : Jishnu Murali Thampan
+* Description     : Lane-parallel nonce search kernel. This file is
+* 		            included once per vector width by sha-1-search.c with
+* 		            the following macros defined:
+* 		            SHA1_MB_LANES      - number of 32 bit lanes per vector
+* 		            SHA1_MB_VEC        - name of the vector type to declare
+* 		            SHA1_SEARCH_KERNEL - name of the kernel function
+* 		            SHA1_MB_TARGET     - function attribute selecting the ISA
+****************************************************************************/
+
+typedef uint32_t SHA1_MB_VEC
+    __attribute__((vector_size(SHA1_MB_LANES * sizeof(uint32_t))));
+
+/**
+ * Evaluates consecutive nonces, one per lane, until one meets the target.
+ * Schedule words the nonce does not reach are broadcast from the plan once
+ * per call, and the first block starts after the rounds the plan already
+ * ran, so only the nonce-dependent part of SHA-1 is computed per batch.
+ * @param[in]  plan    Search plan
+ * @param[in]  nonce   Nonce of lane 0 in the first batch
+ * @param[in]  batches Batches of SHA1_MB_LANES nonces to evaluate
+ * @param[out] found   Smallest matching nonce, UINT64_MAX if none
+ * @return Batches evaluated, up to and including the matching one
+ */
+SHA1_MB_TARGET static size_t
+SHA1_SEARCH_KERNEL(const sha1_search_plan *plan, uint64_t nonce,
+                   const size_t batches, uint64_t *found) {
+  uint32_t lane_words[SHA1_SEARCH_NONCE_WORDS][SHA1_MB_LANES];
+  SHA1_MB_VEC schedule[SHA1_SEARCH_BLOCKS][TOTAL_NUMBER_OF_ROUNDS];
+  SHA1_MB_VEC midstate[FINAL_HASH_SIZE];
+  SHA1_MB_VEC early[FINAL_HASH_SIZE];
+  SHA1_MB_VEC target[FINAL_HASH_SIZE];
+  SHA1_MB_VEC hash_state[FINAL_HASH_SIZE];
+  const SHA1_MB_VEC zero = {0};
+
+  for (size_t b = 0; b < plan->blocks; b++) {
+    for (size_t t = 0; t < TOTAL_NUMBER_OF_ROUNDS; t++) {
+      schedule[b][t] = zero + plan->words[b][t];
+    }
+  }
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    midstate[i] = zero + plan->midstate[i];
+    early[i] = zero + plan->early[i];
+    target[i] = zero + plan->target[i];
+  }
+
+  for (size_t batch = 0; batch < batches; batch++, nonce += SHA1_MB_LANES) {
+    /* Place every lane's nonce over the zeroed nonce bytes of the block */
+    for (size_t lane = 0; lane < SHA1_MB_LANES; lane++) {
+      uint8_t bytes[SHA1_SEARCH_NONCE_WORDS * 4] = {0};
+      const uint64_t value = nonce + lane;
+      sha1_store_be32((uint32_t)(value >> 32), bytes + plan->nonce_shift);
+      sha1_store_be32((uint32_t)value, bytes + plan->nonce_shift + 4);
+      for (size_t j = 0; j < plan->nonce_words; j++) {
+        lane_words[j][lane] = sha1_load_be32(bytes + 4 * j);
+      }
+    }
+    for (size_t j = 0; j < plan->nonce_words; j++) {
+      const size_t k = plan->nonce_word + j;
+      SHA1_MB_VEC word;
+      memcpy(&word, lane_words[j], sizeof(word));
+      schedule[k / PRE_PROC_MSG_SIZE][k % PRE_PROC_MSG_SIZE] =
+          word | plan->words[k / PRE_PROC_MSG_SIZE][k % PRE_PROC_MSG_SIZE];
+    }
+
+    /* Expand only the schedule words that depend on the nonce */
+    for (size_t b = 0; b < plan->blocks; b++) {
+      SHA1_MB_VEC *w = schedule[b];
+      for (size_t n = 0; n < plan->expand_count[b]; n++) {
+        const size_t t = plan->expand[b][n];
+        w[t] = SHA1_MB_ROTATE_LEFT(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16],
+                                   1);
+      }
+    }
+
+    SHA1_MB_VEC a = early[0];
+    SHA1_MB_VEC b = early[1];
+    SHA1_MB_VEC c = early[2];
+    SHA1_MB_VEC d = early[3];
+    SHA1_MB_VEC e = early[4];
+    size_t i = plan->first_round;
+
+    SHA1_SEARCH_ROUNDS(schedule[0]);
+    hash_state[0] = midstate[0] + a;
+    hash_state[1] = midstate[1] + b;
+    hash_state[2] = midstate[2] + c;
+    hash_state[3] = midstate[3] + d;
+    hash_state[4] = midstate[4] + e;
+
+    if (plan->blocks > 1) {
+      a = hash_state[0];
+      b = hash_state[1];
+      c = hash_state[2];
+      d = hash_state[3];
+      e = hash_state[4];
+      i = 0;
+      SHA1_SEARCH_ROUNDS(schedule[1]);
+      hash_state[0] += a;
+      hash_state[1] += b;
+      hash_state[2] += c;
+      hash_state[3] += d;
+      hash_state[4] += e;
+    }
+
+    /* A lane meets the target when none of its masked bits is set */
+    SHA1_MB_VEC miss = zero;
+    for (size_t j = 0; j < plan->target_words; j++) {
+      miss |= hash_state[j] & target[j];
+    }
+    memcpy(lane_words[0], &miss, sizeof(miss));
+    for (size_t lane = 0; lane < SHA1_MB_LANES; lane++) {
+      if (lane_words[0][lane] == 0) {
+        *found = nonce + lane;
+        return batch + 1;
+      }
+    }
+  }
+
+  *found = UINT64_MAX;
+  return batches;
+}
+
+#undef SHA1_MB_LANES
+#undef SHA1_MB_VEC
+#undef SHA1_SEARCH_KERNEL
+#undef SHA1_MB_TARGET
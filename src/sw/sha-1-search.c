@@ -0,0 +1,355 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-search.c
+* Author          : Jishnu Murali Thampan
+* Description     : Proof-of-work nonce search. The whole blocks of the
+* 		              prefix are hashed once into a midstate; what is left
+* 		              of the prefix, the nonce and the padding form one or
+* 		              two final blocks. Only the schedule words the nonce
+* 		              reaches are recomputed per candidate, and the rounds
+* 		              before the first of them run once per search. The
+* 		              candidates are spread over the SIMD lanes of every
+* 		              worker; workers claim chunks of consecutive nonces
+* 		              and stop as soon as a smaller nonce is known to meet
+* 		              the target, so the result is the smallest match.
+****************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L /**< @brief For clock_gettime() */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "sha-1-search.h"
+#include "sha-1-mb.h"
+#include "sha-1-internal.h"
+#include "thread-pool.h"
+
+#define SHA1_SEARCH_BLOCKS                                                     \
+  (2) /**< @brief Represents the most final blocks: tail, nonce, padding */
+#define SHA1_SEARCH_NONCE_WORDS                                                \
+  (3) /**< @brief Represents the most schedule words the nonce touches */
+#define SHA1_SEARCH_CHUNK_BATCHES                                              \
+  (256) /**< @brief Represents the batches a worker claims at a time */
+
+/**
+ * Everything about the final blocks that does not depend on the nonce
+ */
+typedef struct sha1_search_plan {
+  uint32_t midstate[FINAL_HASH_SIZE]; /**< @brief After the prefix blocks */
+  uint32_t early[FINAL_HASH_SIZE];    /**< @brief a..e after first_round */
+  size_t first_round;                 /**< @brief First nonce-dependent word */
+  size_t blocks;                      /**< @brief Final blocks, 1 or 2 */
+  uint32_t words[SHA1_SEARCH_BLOCKS]
+                [TOTAL_NUMBER_OF_ROUNDS]; /**< @brief Schedule, nonce zero */
+  uint8_t expand[SHA1_SEARCH_BLOCKS]
+                [TOTAL_NUMBER_OF_ROUNDS]; /**< @brief Dependent words >= 16 */
+  size_t expand_count[SHA1_SEARCH_BLOCKS]; /**< @brief Entries in expand */
+  size_t nonce_word;  /**< @brief First word the nonce touches, 0..31 */
+  size_t nonce_words; /**< @brief Words the nonce touches, 2 or 3 */
+  size_t nonce_shift; /**< @brief Offset of the nonce in its first word */
+  uint32_t target[FINAL_HASH_SIZE]; /**< @brief Bits that must be zero */
+  size_t target_words;              /**< @brief Digest words to test */
+} sha1_search_plan;
+
+/**
+ * Signature shared by the lane-parallel search kernels
+ */
+typedef size_t (*sha1_search_kernel)(const sha1_search_plan *plan,
+                                     uint64_t nonce, const size_t batches,
+                                     uint64_t *found);
+
+#define SHA1_SEARCH_ROUNDS(w)                                                  \
+  do {                                                                         \
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE; i++) {                              \
+      SHA1_MB_ROUND(OPERATION_ROUND_1, SHA_1_ROUND_1_CONST, (w)[i]);           \
+    }                                                                          \
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 2; i++) {                          \
+      SHA1_MB_ROUND(OPERATION_ROUND_2, SHA_1_ROUND_2_CONST, (w)[i]);           \
+    }                                                                          \
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 3; i++) {                          \
+      SHA1_MB_ROUND(OPERATION_ROUND_3, SHA_1_ROUND_3_CONST, (w)[i]);           \
+    }                                                                          \
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 4; i++) {                          \
+      SHA1_MB_ROUND(OPERATION_ROUND_4, SHA_1_ROUND_4_CONST, (w)[i]);           \
+    }                                                                          \
+  } while (0) /**< @brief Runs the rounds from i on of one block */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA1_MB_LANES 4
+#define SHA1_MB_VEC sha1_vec4
+#define SHA1_SEARCH_KERNEL sha1_search_sse2
+#define SHA1_MB_TARGET __attribute__((target("sse2")))
+#include "sha-1-search-kernel.h"
+
+#define SHA1_MB_LANES 8
+#define SHA1_MB_VEC sha1_vec8
+#define SHA1_SEARCH_KERNEL sha1_search_avx2
+#define SHA1_MB_TARGET __attribute__((target("avx2")))
+#include "sha-1-search-kernel.h"
+
+#define SHA1_MB_LANES 16
+#define SHA1_MB_VEC sha1_vec16
+#define SHA1_SEARCH_KERNEL sha1_search_avx512
+#define SHA1_MB_TARGET __attribute__((target("avx512f")))
+#include "sha-1-search-kernel.h"
+#else
+/* Generic vectors: the compiler lowers them to whatever the target has */
+#define SHA1_MB_LANES 4
+#define SHA1_MB_VEC sha1_vec4
+#define SHA1_SEARCH_KERNEL sha1_search_generic
+#define SHA1_MB_TARGET
+#include "sha-1-search-kernel.h"
+#endif
+
+/**
+ * State shared by the workers of one search
+ */
+typedef struct sha1_search_shared {
+  const sha1_search_plan *plan; /**< @brief Search plan */
+  sha1_search_kernel kernel;    /**< @brief Kernel of the lane count */
+  size_t lanes;                 /**< @brief Nonces per batch */
+  uint64_t end;                 /**< @brief One past the last nonce */
+  uint64_t next;                /**< @brief First nonce of the next chunk */
+  uint64_t best;                /**< @brief Smallest match, or UINT64_MAX */
+  uint64_t hashes;              /**< @brief Candidates evaluated */
+} sha1_search_shared;
+
+/**
+ * Returns the search kernel matching the requested width
+ * @param[in] lanes Requested number of lanes (4, 8 or 16)
+ * @return Kernel or NULL if the CPU cannot run it
+ */
+static sha1_search_kernel sha1_search_select_kernel(const size_t lanes) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (lanes == 16 && __builtin_cpu_supports("avx512f"))
+    return sha1_search_avx512;
+  if (lanes == 8 && __builtin_cpu_supports("avx2"))
+    return sha1_search_avx2;
+  /* Only SSE2 operations: every x86-64 CPU runs the 4 lane kernel */
+  if (lanes == 4 && __builtin_cpu_supports("sse2"))
+    return sha1_search_sse2;
+#else
+  if (lanes == 4)
+    return sha1_search_generic;
+#endif
+  return NULL;
+}
+/**
+ * Hashes the whole blocks of the prefix and lays out the final blocks
+ * with a zero nonce, then works out which schedule words the nonce reaches
+ * and runs the rounds of the first block that precede them
+ * @param[out] plan   Search plan
+ * @param[in]  prefix Prefix bytes
+ * @param[in]  length Number of bytes in prefix
+ * @param[in]  bits   Leading zero bits of the target
+ * @return void
+ */
+static void sha1_search_plan_init(sha1_search_plan *plan, const void *prefix,
+                                  const size_t length, const unsigned bits) {
+  const size_t whole = length - length % MESSAGE_SIZE;
+  const size_t tail = length - whole;
+  uint8_t message[MESSAGE_SIZE + SHA1_SEARCH_NONCE_SIZE] = {0};
+  uint8_t padded[SHA1_SEARCH_BLOCKS * MESSAGE_SIZE];
+  uint8_t dependent[SHA1_SEARCH_BLOCKS][TOTAL_NUMBER_OF_ROUNDS] = {{0}};
+  const uint64_t input_length = (uint64_t)length + SHA1_SEARCH_NONCE_SIZE;
+  sha1_midstate midstate;
+  sha1_ctx ctx;
+
+  sha1_init(&ctx);
+  sha1_update(&ctx, prefix, whole);
+  sha1_midstate_export(&ctx, &midstate);
+  memcpy(plan->midstate, midstate.state, sizeof(plan->midstate));
+
+  /* Tail of the prefix, a zero nonce, then the padding */
+  memcpy(message, (const uint8_t *)prefix + whole, tail);
+  if (tail + SHA1_SEARCH_NONCE_SIZE < MESSAGE_SIZE) {
+    plan->blocks = sha1_pre_processing_stage(
+        message, tail + SHA1_SEARCH_NONCE_SIZE, input_length, padded);
+  } else {
+    memcpy(padded, message, MESSAGE_SIZE);
+    plan->blocks = 1 + sha1_pre_processing_stage(
+                           message + MESSAGE_SIZE,
+                           tail + SHA1_SEARCH_NONCE_SIZE - MESSAGE_SIZE,
+                           input_length, padded + MESSAGE_SIZE);
+  }
+
+  plan->nonce_word = tail / 4;
+  plan->nonce_shift = tail % 4;
+  plan->nonce_words = (plan->nonce_shift + SHA1_SEARCH_NONCE_SIZE + 3) / 4;
+  for (size_t j = 0; j < plan->nonce_words; j++) {
+    const size_t k = plan->nonce_word + j;
+    dependent[k / PRE_PROC_MSG_SIZE][k % PRE_PROC_MSG_SIZE] = 1;
+  }
+
+  /* Expand the schedule and follow the nonce through it */
+  for (size_t b = 0; b < plan->blocks; b++) {
+    uint32_t *w = plan->words[b];
+    uint8_t *d = dependent[b];
+    plan->expand_count[b] = 0;
+    for (size_t t = 0; t < TOTAL_NUMBER_OF_ROUNDS; t++) {
+      if (t < PRE_PROC_MSG_SIZE) {
+        w[t] = sha1_load_be32(padded + b * MESSAGE_SIZE + 4 * t);
+        continue;
+      }
+      w[t] = SHA1_MB_ROTATE_LEFT(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16],
+                                 1);
+      d[t] = d[t - 3] | d[t - 8] | d[t - 14] | d[t - 16];
+      if (d[t])
+        plan->expand[b][plan->expand_count[b]++] = (uint8_t)t;
+    }
+  }
+
+  /* The nonce starts in the first block, so first_round is below 16 */
+  uint32_t a = plan->midstate[0];
+  uint32_t b = plan->midstate[1];
+  uint32_t c = plan->midstate[2];
+  uint32_t d = plan->midstate[3];
+  uint32_t e = plan->midstate[4];
+  plan->first_round = plan->nonce_word;
+  for (size_t i = 0; i < plan->first_round; i++) {
+    const uint32_t temp = SHA1_MB_ROTATE_LEFT(a, 5) +
+                          OPERATION_ROUND_1(b, c, d) + e +
+                          SHA_1_ROUND_1_CONST + plan->words[0][i];
+    e = d;
+    d = c;
+    c = SHA1_MB_ROTATE_LEFT(b, 30);
+    b = a;
+    a = temp;
+  }
+  plan->early[0] = a;
+  plan->early[1] = b;
+  plan->early[2] = c;
+  plan->early[3] = d;
+  plan->early[4] = e;
+
+  plan->target_words = (bits + 31) / 32;
+  for (size_t j = 0; j < FINAL_HASH_SIZE; j++) {
+    const unsigned word_bits =
+        (bits > 32 * j) ? ((bits - 32 * j < 32) ? (bits - 32 * j) : (32))
+                        : (0);
+    plan->target[j] =
+        (word_bits == 0) ? (0) : (0xFFFFFFFFu << (32 - word_bits));
+  }
+}
+/**
+ * Worker of a search: claims chunks of nonces until the range is exhausted
+ * or a match below the next chunk is known
+ * @param[in,out] arg Shared search state
+ * @return void
+ */
+static void sha1_search_worker(void *arg) {
+  sha1_search_shared *shared = (sha1_search_shared *)arg;
+  const uint64_t chunk = shared->lanes * SHA1_SEARCH_CHUNK_BATCHES;
+
+  for (;;) {
+    const uint64_t start =
+        __atomic_fetch_add(&shared->next, chunk, __ATOMIC_RELAXED);
+    uint64_t found, best;
+
+    if (start >= shared->end ||
+        start >= __atomic_load_n(&shared->best, __ATOMIC_RELAXED))
+      return;
+
+    const uint64_t left = shared->end - start;
+    const size_t batches =
+        (left < chunk) ? ((size_t)((left + shared->lanes - 1) / shared->lanes))
+                       : (SHA1_SEARCH_CHUNK_BATCHES);
+    const size_t done = shared->kernel(shared->plan, start, batches, &found);
+    const uint64_t evaluated = (uint64_t)done * shared->lanes;
+
+    /* Lanes past the end of the range do not count, as hashes or matches */
+    __atomic_fetch_add(&shared->hashes,
+                       (evaluated < left) ? (evaluated) : (left),
+                       __ATOMIC_RELAXED);
+    if (found >= shared->end)
+      continue;
+    best = __atomic_load_n(&shared->best, __ATOMIC_RELAXED);
+    while (found < best &&
+           !__atomic_compare_exchange_n(&shared->best, &best, found, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      ;
+  }
+}
+/**
+ * Returns the monotonic time in seconds
+ * @param  None
+ * @return Current time
+ */
+static double sha1_search_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+/**
+ * Searches for the smallest nonce in [start, start + count) for which
+ * SHA-1(prefix || nonce) has the requested number of leading zero bits.
+ * The nonce is appended as SHA1_SEARCH_NONCE_SIZE big-endian bytes.
+ * @param[in]  prefix Prefix bytes
+ * @param[in]  length Number of bytes in prefix
+ * @param[in]  params Target, range and parallelism
+ * @param[out] result Nonce and digest if found, and the work done
+ * @return 0 when the search ran, -1 on bad parameters, no threads or no
+ *         kernel for this CPU
+ */
+int sha1_search(const void *prefix, size_t length,
+                const sha1_search_params *params, sha1_search_result *result) {
+  sha1_search_plan plan;
+  sha1_search_shared shared;
+  thread_pool *pool;
+  const double start = sha1_search_clock();
+
+  if (params->bits > SHA1_SEARCH_MAX_BITS) {
+    printf("ERR: A target of %u bits exceeds the %d bits of a digest\n",
+           params->bits, SHA1_SEARCH_MAX_BITS);
+    return -1;
+  }
+
+  shared.lanes = (params->lanes != 0) ? (params->lanes)
+                                      : (sha1_mb_max_lanes());
+  shared.kernel = sha1_search_select_kernel(shared.lanes);
+  if (shared.kernel == NULL) {
+    shared.lanes = sha1_mb_max_lanes();
+    shared.kernel = sha1_search_select_kernel(shared.lanes);
+  }
+  if (shared.kernel == NULL) {
+    printf("ERR: No SIMD search kernel runs on this CPU\n");
+    return -1;
+  }
+  sha1_search_plan_init(&plan, prefix, length, params->bits);
+  shared.plan = &plan;
+  shared.next = params->start;
+  shared.end = (params->count == 0 ||
+                params->count > UINT64_MAX - params->start)
+                   ? (UINT64_MAX)
+                   : (params->start + params->count);
+  shared.best = UINT64_MAX;
+  shared.hashes = 0;
+
+  pool = thread_pool_create(params->threads);
+  if (pool == NULL)
+    return -1;
+  for (size_t t = 0; t < thread_pool_size(pool); t++) {
+    if (thread_pool_submit(pool, sha1_search_worker, &shared) != 0)
+      break;
+  }
+  thread_pool_wait(pool);
+  thread_pool_destroy(pool);
+
+  result->found = (shared.best != UINT64_MAX);
+  result->nonce = shared.best;
+  result->hashes = shared.hashes;
+  result->seconds = sha1_search_clock() - start;
+  memset(result->final_hash, 0, sizeof(result->final_hash));
+  if (result->found) {
+    uint8_t nonce[SHA1_SEARCH_NONCE_SIZE];
+    sha1_ctx ctx;
+    sha1_store_be32((uint32_t)(shared.best >> 32), nonce);
+    sha1_store_be32((uint32_t)shared.best, nonce + 4);
+    sha1_init(&ctx);
+    sha1_update(&ctx, prefix, length);
+    sha1_update(&ctx, nonce, sizeof(nonce));
+    sha1_final(&ctx, result->final_hash);
+  }
+  return 0;
+}
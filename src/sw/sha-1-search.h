@@ -0,0 +1,47 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-search.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of the proof-of-work nonce search. It finds
+* 		            the smallest nonce whose SHA-1(prefix || nonce) starts
+* 		            with a given number of zero bits. The nonce is the
+* 		            last SHA1_SEARCH_NONCE_SIZE bytes of the message, a
+* 		            big-endian counter.
+****************************************************************************/
+
+#ifndef SHA1_SEARCH_HPP
+#define SHA1_SEARCH_HPP
+
+#include "sha-1.h"
+
+#define SHA1_SEARCH_NONCE_SIZE                                                 \
+  (8) /**< @brief Represents the bytes of the nonce appended to the prefix */
+#define SHA1_SEARCH_MAX_BITS                                                   \
+  (160) /**< @brief Represents the most leading zero bits of a target */
+
+/**
+ * What to search for and with how much parallelism
+ */
+typedef struct sha1_search_params {
+  unsigned bits;  /**< @brief Leading zero bits the digest must have */
+  uint64_t start; /**< @brief First nonce to try */
+  uint64_t count; /**< @brief Nonces to try, 0 for all from start on */
+  size_t threads; /**< @brief Worker threads, 0 for one per CPU */
+  size_t lanes;   /**< @brief Lanes per thread (4, 8, 16), 0 for widest */
+} sha1_search_params;
+
+/**
+ * Outcome of a search
+ */
+typedef struct sha1_search_result {
+  int found;                            /**< @brief 1 if nonce is valid */
+  uint64_t nonce;                       /**< @brief Smallest matching nonce */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Its digest */
+  uint64_t hashes;                      /**< @brief Candidates evaluated */
+  double seconds;                       /**< @brief Wall-clock time */
+} sha1_search_result;
+
+int sha1_search(const void *prefix, size_t length,
+                const sha1_search_params *params, sha1_search_result *result);
+
+#endif /* SHA1_SEARCH_HPP */
@@ -0,0 +1,510 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-stream.c
+* Author          : Jishnu Murali Thampan
+* Description     : Double-buffered streaming of a descriptor into SHA-1.
+* 		              Buffers are filled in ring order and hashed in the
+* 		              same order. With io_uring the reads are submitted
+* 		              before the current buffer is hashed: files and block
+* 		              devices get one read per buffer at its own offset,
+* 		              pipes and sockets one read at a time because their
+* 		              data order is the order the reads run in. Kernels
+* 		              without io_uring, or without IORING_OP_READ, get a
+* 		              thread that read()s ahead instead.
+****************************************************************************/
+
+#define _GNU_SOURCE /**< @brief For syscall() */
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha-1-stream.h"
+
+#define SHA1_STREAM_MAX_BUFFERS                                                \
+  (64) /**< @brief Represents the most buffers a stream can have */
+
+/**
+ * States of a buffer
+ */
+typedef enum stream_state {
+  STREAM_FREE = 0, /**< @brief Can be read into */
+  STREAM_READING,  /**< @brief A read is in flight */
+  STREAM_READY     /**< @brief Holds data to be hashed */
+} stream_state;
+
+/**
+ * One buffer of the ring
+ */
+typedef struct stream_buffer {
+  uint8_t *data;      /**< @brief SHA1_STREAM_ALIGNMENT aligned */
+  uint64_t offset;    /**< @brief File offset of data[0], if seekable */
+  size_t filled;      /**< @brief Bytes read so far */
+  stream_state state; /**< @brief See stream_state */
+  int last;           /**< @brief End of input follows this buffer */
+  int error;          /**< @brief errno of a failed read, or 0 */
+} stream_buffer;
+
+/**
+ * Mapped io_uring submission and completion queues
+ */
+typedef struct stream_ring {
+  int fd;                      /**< @brief From io_uring_setup */
+  unsigned *sq_tail;           /**< @brief Written by us */
+  unsigned *sq_mask;           /**< @brief Entries - 1 */
+  unsigned *sq_array;          /**< @brief Indices into sqes */
+  struct io_uring_sqe *sqes;   /**< @brief Submission entries */
+  unsigned *cq_head;           /**< @brief Written by us */
+  unsigned *cq_tail;           /**< @brief Written by the kernel */
+  unsigned *cq_mask;           /**< @brief Entries - 1 */
+  struct io_uring_cqe *cqes;   /**< @brief Completion entries */
+  void *sq_map;                /**< @brief Submission ring mapping */
+  size_t sq_map_size;          /**< @brief Bytes of sq_map */
+  void *cq_map;                /**< @brief Completion ring, may be sq_map */
+  size_t cq_map_size;          /**< @brief Bytes of cq_map */
+  size_t sqes_size;            /**< @brief Bytes of sqes */
+  unsigned queued;             /**< @brief Entries not yet submitted */
+} stream_ring;
+
+/**
+ * Shared state of the read thread and the hashing thread
+ */
+typedef struct stream_reader {
+  int fd;                  /**< @brief Input */
+  stream_buffer *buffer;   /**< @brief Ring */
+  size_t buffers;          /**< @brief Buffers in the ring */
+  size_t buffer_size;      /**< @brief Bytes per buffer */
+  pthread_mutex_t lock;    /**< @brief Guards the buffer states */
+  pthread_cond_t changed;  /**< @brief Signalled on every state change */
+} stream_reader;
+
+/**
+ * Returns the monotonic wall-clock time in seconds
+ * @param  None
+ * @return Current time
+ */
+static double wall_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+/**
+ * Unmaps the queues and closes the ring
+ * @param[in,out] ring Ring, fd < 0 if not open
+ * @return void
+ */
+static void ring_close(stream_ring *ring) {
+  if (ring->sqes != NULL)
+    munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_map != NULL && ring->cq_map != ring->sq_map)
+    munmap(ring->cq_map, ring->cq_map_size);
+  if (ring->sq_map != NULL)
+    munmap(ring->sq_map, ring->sq_map_size);
+  if (ring->fd >= 0)
+    close(ring->fd);
+}
+/**
+ * Sets up an io_uring without liburing
+ * @param[out] ring    Ring
+ * @param[in]  entries Submission queue entries, a power of two
+ * @return 0 on success, errno on failure (ENOSYS on old kernels)
+ */
+static int ring_open(stream_ring *ring, unsigned entries) {
+  struct io_uring_params params;
+  int error;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return errno;
+
+  ring->sq_map_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_map_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_map_size > ring->sq_map_size)
+      ring->sq_map_size = ring->cq_map_size;
+    ring->cq_map_size = ring->sq_map_size;
+  }
+  ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_map == MAP_FAILED) {
+    ring->sq_map = NULL;
+    goto fail;
+  }
+  ring->cq_map = ring->sq_map;
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    ring->cq_map =
+        mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_map == MAP_FAILED) {
+      ring->cq_map = NULL;
+      goto fail;
+    }
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    goto fail;
+  }
+
+  ring->sq_tail = (unsigned *)((uint8_t *)ring->sq_map + params.sq_off.tail);
+  ring->sq_mask =
+      (unsigned *)((uint8_t *)ring->sq_map + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((uint8_t *)ring->sq_map + params.sq_off.array);
+  ring->cq_head = (unsigned *)((uint8_t *)ring->cq_map + params.cq_off.head);
+  ring->cq_tail = (unsigned *)((uint8_t *)ring->cq_map + params.cq_off.tail);
+  ring->cq_mask =
+      (unsigned *)((uint8_t *)ring->cq_map + params.cq_off.ring_mask);
+  ring->cqes =
+      (struct io_uring_cqe *)((uint8_t *)ring->cq_map + params.cq_off.cqes);
+  return 0;
+
+fail:
+  error = errno;
+  ring_close(ring);
+  return error;
+}
+/**
+ * Queues a read; the caller never has more in flight than the ring holds
+ * @param[in,out] ring   Ring
+ * @param[in]     fd     Input
+ * @param[in]     index  Buffer index, returned in the completion
+ * @param[in]     data   Destination
+ * @param[in]     length Bytes to read
+ * @param[in]     offset File offset, -1 for the current position
+ * @return void
+ */
+static void ring_queue_read(stream_ring *ring, int fd, size_t index,
+                            uint8_t *data, size_t length, uint64_t offset) {
+  const unsigned tail = *ring->sq_tail;
+  const unsigned slot = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[slot];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)data;
+  sqe->len = (uint32_t)length;
+  sqe->off = offset;
+  sqe->user_data = index;
+  ring->sq_array[slot] = slot;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->queued++;
+}
+/**
+ * Submits the queued reads and optionally waits for a completion
+ * @param[in,out] ring Ring
+ * @param[in]     wait 1 to block until a read completed
+ * @return 0 on success, errno on failure
+ */
+static int ring_enter(stream_ring *ring, unsigned wait) {
+  while (ring->queued > 0 || wait > 0) {
+    long submitted =
+        syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait,
+                (wait > 0) ? (IORING_ENTER_GETEVENTS) : (0), NULL, 0);
+    if (submitted < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    ring->queued -= (unsigned)submitted;
+    wait = 0;
+  }
+  return 0;
+}
+/**
+ * Takes the next completion, if there is one
+ * @param[in,out] ring   Ring
+ * @param[out]    index  Buffer index of the read
+ * @param[out]    result Bytes read or -errno
+ * @return 1 if a completion was taken, 0 otherwise
+ */
+static int ring_reap(stream_ring *ring, size_t *index, int *result) {
+  const unsigned head = *ring->cq_head;
+  const struct io_uring_cqe *cqe;
+
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    return 0;
+  cqe = &ring->cqes[head & *ring->cq_mask];
+  *index = (size_t)cqe->user_data;
+  *result = cqe->res;
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+/**
+ * Streams a descriptor through io_uring
+ * @param[in]     fd          Input
+ * @param[in,out] buffer      Ring of free buffers
+ * @param[in]     buffers     Buffers in the ring
+ * @param[in]     buffer_size Bytes per buffer
+ * @param[in,out] ctx         Hash the input is fed into
+ * @param[out]    io_wait     Seconds spent waiting for reads
+ * @return 0 on success, ENOSYS/EINVAL if io_uring cannot read this input
+ *         before anything was consumed, another errno on failure
+ */
+static int stream_io_uring(int fd, stream_buffer buffer[], size_t buffers,
+                           size_t buffer_size, sha1_ctx *ctx,
+                           double *io_wait) {
+  stream_ring ring;
+  struct stat info;
+  unsigned entries = 1;
+  size_t head = 0, tail = 0, in_flight = 0;
+  off_t position = lseek(fd, 0, SEEK_CUR);
+  const int seekable = position >= 0 && fstat(fd, &info) == 0 &&
+                       (S_ISREG(info.st_mode) || S_ISBLK(info.st_mode));
+  const size_t depth = seekable ? (buffers) : (1);
+  uint64_t offset = seekable ? ((uint64_t)position) : (0);
+  int error, end = 0, done = 0, consumed = 0;
+
+  while (entries < buffers)
+    entries *= 2;
+  error = ring_open(&ring, entries);
+  if (error != 0)
+    return error;
+
+  while (!done && error == 0) {
+    /* Keep the reads ahead of the hashing */
+    while (!end && in_flight < depth &&
+           buffer[tail % buffers].state == STREAM_FREE) {
+      stream_buffer *b = &buffer[tail % buffers];
+      b->state = STREAM_READING;
+      b->offset = offset;
+      b->filled = 0;
+      ring_queue_read(&ring, fd, tail % buffers, b->data, buffer_size,
+                      seekable ? (offset) : ((uint64_t)-1));
+      offset += buffer_size;
+      in_flight++;
+      tail++;
+    }
+
+    stream_buffer *next = &buffer[head % buffers];
+    if (next->state == STREAM_READY) {
+      error = ring_enter(&ring, 0);
+      sha1_update(ctx, next->data, next->filled);
+      done = next->last;
+      next->state = STREAM_FREE;
+      head++;
+      continue;
+    }
+
+    const double start = wall_time();
+    error = ring_enter(&ring, 1);
+    *io_wait += wall_time() - start;
+
+    size_t index;
+    int result;
+    while (error == 0 && ring_reap(&ring, &index, &result)) {
+      stream_buffer *b = &buffer[index];
+      if (result == -EINTR || result == -EAGAIN) {
+        ring_queue_read(&ring, fd, index, b->data + b->filled,
+                        buffer_size - b->filled,
+                        seekable ? (b->offset + b->filled) : ((uint64_t)-1));
+        continue;
+      }
+      in_flight--;
+      if (result < 0) {
+        error = -result;
+        if (error == EINVAL && consumed) /* Not a missing opcode */
+          error = EIO;
+      } else if (result == 0) {
+        b->state = STREAM_READY;
+        b->last = 1;
+        end = 1;
+      } else {
+        consumed = 1;
+        b->filled += (size_t)result;
+        if (b->filled < buffer_size && seekable) {
+          /* Short read of a file: fetch the rest to keep the offsets */
+          ring_queue_read(&ring, fd, index, b->data + b->filled,
+                          buffer_size - b->filled, b->offset + b->filled);
+          in_flight++;
+        } else {
+          b->state = STREAM_READY;
+        }
+      }
+    }
+  }
+
+  /* The buffers may not be reused while the kernel still writes them */
+  while (in_flight > 0 && ring_enter(&ring, 1) == 0) {
+    size_t index;
+    int result;
+    while (ring_reap(&ring, &index, &result))
+      in_flight--;
+  }
+  ring_close(&ring);
+  if (error == 0 && seekable)
+    lseek(fd, (off_t)(buffer[(head - 1) % buffers].offset +
+                      buffer[(head - 1) % buffers].filled),
+          SEEK_SET);
+  return error;
+}
+/**
+ * Read thread: fills the buffers in ring order until the end of input
+ * @param[in,out] arg Reader
+ * @return NULL
+ */
+static void *stream_read_ahead(void *arg) {
+  stream_reader *reader = (stream_reader *)arg;
+
+  for (size_t k = 0;; k++) {
+    stream_buffer *b = &reader->buffer[k % reader->buffers];
+    ssize_t got;
+
+    pthread_mutex_lock(&reader->lock);
+    while (b->state != STREAM_FREE)
+      pthread_cond_wait(&reader->changed, &reader->lock);
+    pthread_mutex_unlock(&reader->lock);
+
+    while ((got = read(reader->fd, b->data, reader->buffer_size)) < 0 &&
+           errno == EINTR)
+      ;
+
+    pthread_mutex_lock(&reader->lock);
+    b->filled = (got > 0) ? ((size_t)got) : (0);
+    b->error = (got < 0) ? (errno) : (0);
+    b->last = (got <= 0);
+    b->state = STREAM_READY;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    if (got <= 0)
+      return NULL;
+  }
+}
+/**
+ * Streams a descriptor with read() on a second thread
+ * @param[in]     fd          Input
+ * @param[in,out] buffer      Ring of free buffers
+ * @param[in]     buffers     Buffers in the ring
+ * @param[in]     buffer_size Bytes per buffer
+ * @param[in,out] ctx         Hash the input is fed into
+ * @param[out]    io_wait     Seconds spent waiting for reads
+ * @return 0 on success, errno on failure
+ */
+static int stream_read_thread(int fd, stream_buffer buffer[], size_t buffers,
+                              size_t buffer_size, sha1_ctx *ctx,
+                              double *io_wait) {
+  stream_reader reader = {fd, buffer, buffers, buffer_size,
+                          PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+  pthread_t thread;
+  int error = 0;
+
+  if (pthread_create(&thread, NULL, stream_read_ahead, &reader) != 0)
+    return EAGAIN;
+  for (size_t k = 0;; k++) {
+    stream_buffer *b = &buffer[k % buffers];
+    const double start = wall_time();
+
+    pthread_mutex_lock(&reader.lock);
+    while (b->state != STREAM_READY)
+      pthread_cond_wait(&reader.changed, &reader.lock);
+    pthread_mutex_unlock(&reader.lock);
+    *io_wait += wall_time() - start;
+
+    sha1_update(ctx, b->data, b->filled);
+    error = b->error;
+    if (b->last)
+      break;
+
+    pthread_mutex_lock(&reader.lock);
+    b->state = STREAM_FREE;
+    pthread_cond_broadcast(&reader.changed);
+    pthread_mutex_unlock(&reader.lock);
+  }
+  pthread_join(thread, NULL);
+  return error;
+}
+/**
+ * Hashes everything that can be read from a descriptor, reading ahead
+ * while hashing
+ * @param[in]  fd         Input, read from its current position
+ * @param[in]  config     Tuning, NULL for the defaults
+ * @param[out] final_hash Digest
+ * @param[out] stats      Throughput, may be NULL
+ * @return 0 on success, errno on failure
+ */
+int sha1_hash_fd(int fd, const sha1_stream_config *config,
+                 uint32_t final_hash[], sha1_stream_stats *stats) {
+  static const sha1_stream_config defaults = {
+      SHA1_STREAM_AUTO, SHA1_STREAM_BUFFERS, SHA1_STREAM_BUFFER_SIZE};
+  stream_buffer buffer[SHA1_STREAM_MAX_BUFFERS];
+  sha1_stream_backend backend;
+  size_t buffers, buffer_size;
+  sha1_ctx ctx;
+  double io_wait = 0, start = wall_time();
+  uint8_t *memory = NULL;
+  int error = ENOSYS;
+
+  if (config == NULL)
+    config = &defaults;
+  backend = config->backend;
+  buffers = (config->buffers > 0) ? (config->buffers) : (SHA1_STREAM_BUFFERS);
+  buffer_size = (config->buffer_size > 0) ? (config->buffer_size)
+                                          : (SHA1_STREAM_BUFFER_SIZE);
+  if (buffers > SHA1_STREAM_MAX_BUFFERS)
+    buffers = SHA1_STREAM_MAX_BUFFERS;
+  buffer_size = (buffer_size + SHA1_STREAM_ALIGNMENT - 1) &
+                ~(size_t)(SHA1_STREAM_ALIGNMENT - 1);
+  if (posix_memalign((void **)&memory, SHA1_STREAM_ALIGNMENT,
+                     buffers * buffer_size) != 0)
+    return ENOMEM;
+  memset(buffer, 0, sizeof(buffer));
+  for (size_t i = 0; i < buffers; i++) {
+    buffer[i].data = memory + i * buffer_size;
+  }
+
+  sha1_init(&ctx);
+  if (backend != SHA1_STREAM_READ_THREAD) {
+    error = stream_io_uring(fd, buffer, buffers, buffer_size, &ctx, &io_wait);
+    backend = SHA1_STREAM_IO_URING;
+  }
+  /* Nothing was consumed if io_uring is missing or cannot read this fd */
+  if ((error == ENOSYS || error == EPERM || error == EINVAL) &&
+      config->backend != SHA1_STREAM_IO_URING) {
+    memset(buffer, 0, sizeof(buffer));
+    for (size_t i = 0; i < buffers; i++) {
+      buffer[i].data = memory + i * buffer_size;
+    }
+    sha1_init(&ctx);
+    io_wait = 0;
+    error = stream_read_thread(fd, buffer, buffers, buffer_size, &ctx,
+                               &io_wait);
+    backend = SHA1_STREAM_READ_THREAD;
+  }
+  if (error == 0) {
+    if (stats != NULL) {
+      stats->backend = backend;
+      stats->bytes = ctx.length;
+      stats->io_wait = io_wait;
+      stats->seconds = wall_time() - start;
+    }
+    sha1_final(&ctx, final_hash);
+  }
+  free(memory);
+  return error;
+}
+/**
+ * Returns a printable name of a backend
+ * @param[in] backend Backend
+ * @return Name of the backend
+ */
+const char *sha1_stream_backend_name(sha1_stream_backend backend) {
+  static const char *const names[SHA1_STREAM_BACKEND_COUNT] = {
+      [SHA1_STREAM_AUTO] = "auto",
+      [SHA1_STREAM_IO_URING] = "io_uring",
+      [SHA1_STREAM_READ_THREAD] = "read thread",
+  };
+  return ((unsigned)backend < SHA1_STREAM_BACKEND_COUNT) ? (names[backend])
+                                                         : ("unknown");
+}
@@ -0,0 +1,57 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-stream.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of the streaming front end for inputs that
+* 		            cannot be mapped: pipes, sockets and devices. Several
+* 		            aligned buffers are kept in flight so the next reads
+* 		            proceed while the current buffer is hashed; the input
+* 		            then streams at the pace of the slower of the two.
+****************************************************************************/
+
+#ifndef SHA1_STREAM_HPP
+#define SHA1_STREAM_HPP
+
+#include "sha-1.h"
+
+#define SHA1_STREAM_BUFFERS                                                    \
+  (4) /**< @brief Represents the default number of buffers in flight */
+#define SHA1_STREAM_BUFFER_SIZE                                                \
+  (256 * 1024) /**< @brief Represents the default size of one buffer */
+#define SHA1_STREAM_ALIGNMENT                                                  \
+  (4096) /**< @brief Represents the alignment of the buffers, one page */
+
+/**
+ * How the reads are issued
+ */
+typedef enum sha1_stream_backend {
+  SHA1_STREAM_AUTO = 0,     /**< @brief io_uring, else the read thread */
+  SHA1_STREAM_IO_URING,     /**< @brief io_uring, raw system calls */
+  SHA1_STREAM_READ_THREAD,  /**< @brief read() on a second thread */
+  SHA1_STREAM_BACKEND_COUNT /**< @brief Number of entries, not a backend */
+} sha1_stream_backend;
+
+/**
+ * Tuning of a stream, zero fields take the defaults
+ */
+typedef struct sha1_stream_config {
+  sha1_stream_backend backend; /**< @brief Backend to use */
+  size_t buffers;              /**< @brief Buffers in flight, at most 64 */
+  size_t buffer_size;          /**< @brief Bytes per buffer */
+} sha1_stream_config;
+
+/**
+ * What a stream achieved
+ */
+typedef struct sha1_stream_stats {
+  sha1_stream_backend backend; /**< @brief Backend that ran */
+  uint64_t bytes;              /**< @brief Bytes hashed */
+  double seconds;              /**< @brief Wall-clock time */
+  double io_wait;              /**< @brief Time hashing waited for data */
+} sha1_stream_stats;
+
+int sha1_hash_fd(int fd, const sha1_stream_config *config,
+                 uint32_t final_hash[], sha1_stream_stats *stats);
+const char *sha1_stream_backend_name(sha1_stream_backend backend);
+
+#endif /* SHA1_STREAM_HPP */
@@ -0,0 +1,183 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-tree-check.c
+* Author          : Jishnu Murali Thampan
+* Description     : Checks the tree-hash mode of sha-1-tree.c. Two fixed
+* 		              roots pin the format documented in sha-1-tree.h; a
+* 		              run of random edits, shrinks and growths brought up
+* 		              to date with sha1_tree_invalidate and
+* 		              sha1_tree_rehash must give the root of a fresh
+* 		              sha1_tree_hash of the same input after every step.
+* 		              The exit status is non-zero on any difference.
+*
+* Build           : cc -O2 -pthread -o sha-1-tree-check sha-1-tree-check.c \
+* 		              sha-1-tree.c thread-pool.c sha-1.c sha-1-x86.c
+* Usage           : sha-1-tree-check
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha-1-tree.h"
+
+#define CHECK_MAX_LENGTH                                                       \
+  (96 * 1024 + 37) /**< @brief Represents the longest input edited */
+#define CHECK_STEPS                                                            \
+  (300) /**< @brief Represents the number of random modifications */
+
+/**
+ * One root fixed by the documented format
+ */
+typedef struct tree_vector {
+  size_t length;    /**< @brief Bytes 0x00, 0x01, ..., 0xff, 0x00, ... */
+  size_t leaf_size; /**< @brief Bytes per leaf */
+  size_t fanout;    /**< @brief Children per node */
+  const char *root; /**< @brief Expected root in hex */
+} tree_vector;
+
+/*
+ * The empty input is one empty leaf under one node. 1000 bytes in 64-byte
+ * leaves are 15 full leaves and one of 40 bytes; with a fan-out of 3 the
+ * levels above have 6, 2 and 1 nodes, and the last node of each level is
+ * short.
+ */
+static const tree_vector tree_vectors[] = {
+    {0, 64, 2, "8ec38b0145673ec16847c640f977977c2ffafeed"},
+    {1000, 64, 3, "53f850546977be1e61f73678033e2a033573caee"},
+};
+
+/**
+ * Compares two roots and reports a difference
+ * @param[in] what     Step checked
+ * @param[in] length   Input length
+ * @param[in] root     Root computed
+ * @param[in] expected Expected root
+ * @return 0 if equal, 1 otherwise
+ */
+static int compare(const char *what, uint64_t length, const uint32_t root[],
+                   const uint32_t expected[]) {
+  if (memcmp(root, expected, FINAL_HASH_SIZE * sizeof(uint32_t)) == 0)
+    return 0;
+  printf("ERR: %s of %llu bytes: root ", what, (unsigned long long)length);
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++)
+    printf("%08x", root[i]);
+  printf(", expected ");
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++)
+    printf("%08x", expected[i]);
+  printf("\n");
+  return 1;
+}
+
+/**
+ * Hashes the fixed inputs and compares their roots with the vectors
+ * @return Number of differences, -1 if a tree could not be made
+ */
+static int check_vectors(void) {
+  static uint8_t data[1000];
+  int failed = 0;
+
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)i;
+
+  for (size_t v = 0; v < sizeof(tree_vectors) / sizeof(tree_vectors[0]);
+       v++) {
+    const tree_vector *vector = &tree_vectors[v];
+    sha1_tree_params params = {vector->leaf_size, vector->fanout, 1};
+    uint32_t root[FINAL_HASH_SIZE], expected[FINAL_HASH_SIZE];
+    sha1_tree *tree = sha1_tree_create(&params);
+    if (tree == NULL ||
+        sha1_tree_hash(tree, data, vector->length, root) != 0) {
+      sha1_tree_destroy(tree);
+      return -1;
+    }
+    sha1_tree_destroy(tree);
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++)
+      sscanf(vector->root + 8 * i, "%8x", &expected[i]);
+    failed += compare("fixed vector", vector->length, root, expected);
+  }
+  return failed;
+}
+
+/**
+ * Returns a random number in [0, bound)
+ * @param[in] bound Upper bound, at least 1
+ * @return Random number
+ */
+static size_t random_below(size_t bound) {
+  return (size_t)(((uint64_t)rand() << 16 ^ (uint64_t)rand()) % bound);
+}
+
+int main(void) {
+  static uint8_t data[CHECK_MAX_LENGTH];
+  /* Small leaves and fan-out give several levels on a short input */
+  sha1_tree_params params = {1024, 4, 4};
+  uint32_t root[FINAL_HASH_SIZE], fresh_root[FINAL_HASH_SIZE];
+  int failed = check_vectors();
+  size_t length = CHECK_MAX_LENGTH / 2;
+
+  if (failed < 0)
+    return EXIT_FAILURE;
+
+  sha1_tree *tree = sha1_tree_create(&params);
+  sha1_tree *fresh = sha1_tree_create(&params);
+  if (tree == NULL || fresh == NULL) {
+    sha1_tree_destroy(tree);
+    sha1_tree_destroy(fresh);
+    return EXIT_FAILURE;
+  }
+
+  srand(1);
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)rand();
+  if (sha1_tree_hash(tree, data, length, root) != 0)
+    failed++;
+
+  for (int step = 0; step < CHECK_STEPS; step++) {
+    const char *what;
+    switch (step % 4) {
+    case 0:
+    case 1: {
+      /* Edit a range, which may cross leaves or hit the short last leaf */
+      what = "edit";
+      if (length == 0)
+        break;
+      size_t offset = random_below(length);
+      size_t count = length - offset;
+      if (step % 4 == 1 && count > 64)
+        count = 64;
+      count = 1 + random_below(count);
+      for (size_t i = 0; i < count; i++)
+        data[offset + i] = (uint8_t)rand();
+      sha1_tree_invalidate(tree, offset, count);
+      break;
+    }
+    case 2:
+      /* Shrink, every eighth time to nothing */
+      what = "shrink";
+      length = (step % 32 == 2) ? (0) : (random_below(length + 1));
+      break;
+    default: {
+      /* Grow with new bytes, which are past the old length and so need
+         no invalidation */
+      what = "grow";
+      size_t old = length;
+      length += random_below(sizeof(data) - length + 1);
+      for (size_t i = old; i < length; i++)
+        data[i] = (uint8_t)rand();
+      break;
+    }
+    }
+    if (sha1_tree_rehash(tree, data, length, root) != 0 ||
+        sha1_tree_hash(fresh, data, length, fresh_root) != 0) {
+      failed++;
+      break;
+    }
+    failed += compare(what, length, root, fresh_root);
+  }
+
+  sha1_tree_destroy(tree);
+  sha1_tree_destroy(fresh);
+  printf("%d mismatches over %d trees\n", failed,
+         (int)(sizeof(tree_vectors) / sizeof(tree_vectors[0])) + CHECK_STEPS);
+  return (failed == 0) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
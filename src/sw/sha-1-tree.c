@@ -0,0 +1,329 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-tree.c
+* Author          : Jishnu Murali Thampan
+* Description     : SHA-1 tree-hash mode. Leaves are hashed on the work-
+* 		              stealing pool, each task taking a contiguous run of
+* 		              leaves; the nodes above them cover 20 bytes per leaf
+* 		              and are rebuilt on the calling thread. Leaf digests
+* 		              are kept between calls, so after an edit only the
+* 		              leaves that were invalidated are hashed again.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sha-1-tree.h"
+#include "sha-1-internal.h"
+#include "thread-pool.h"
+
+#define TREE_LEAF_PREFIX (0x00) /**< @brief Represents the leaf domain byte */
+#define TREE_NODE_PREFIX (0x01) /**< @brief Represents the node domain byte */
+#define TREE_TASKS_PER_THREAD                                                  \
+  (4) /**< @brief Represents the tasks queued per worker, for balancing */
+
+/**
+ * Tree state kept between calls
+ */
+struct sha1_tree {
+  size_t leaf_size;                    /**< @brief Bytes per leaf */
+  size_t fanout;                       /**< @brief Children per node */
+  thread_pool *pool;                   /**< @brief Workers hashing leaves */
+  uint32_t (*leaves)[FINAL_HASH_SIZE]; /**< @brief Digest of every leaf */
+  uint32_t (*nodes)[FINAL_HASH_SIZE];  /**< @brief Scratch for node levels */
+  uint8_t *dirty;                      /**< @brief Leaf must be rehashed */
+  size_t leaf_count;                   /**< @brief Leaves of last length */
+  size_t capacity;                     /**< @brief Leaves allocated */
+  uint64_t length;                     /**< @brief Length last hashed */
+  int valid;                           /**< @brief Leaves match length */
+};
+
+/**
+ * A contiguous run of leaves hashed by one pool task
+ */
+typedef struct tree_task {
+  sha1_tree *tree;     /**< @brief Tree being hashed */
+  const uint8_t *data; /**< @brief Whole input */
+  uint64_t length;     /**< @brief Number of bytes in data */
+  size_t first;        /**< @brief First leaf of the run */
+  size_t last;         /**< @brief One past the last leaf of the run */
+} tree_task;
+
+/**
+ * Returns the number of leaves covering an input
+ * @param[in] tree   Tree
+ * @param[in] length Input length in bytes
+ * @return Number of leaves, at least 1
+ */
+static size_t tree_leaves_for(const sha1_tree *tree, uint64_t length) {
+  if (length == 0)
+    return 1;
+  return (size_t)((length + tree->leaf_size - 1) / tree->leaf_size);
+}
+/**
+ * Hashes the dirty leaves of a run
+ * @param[in,out] arg tree_task describing the run
+ * @return void
+ */
+static void tree_hash_leaves(void *arg) {
+  const tree_task *task = (const tree_task *)arg;
+  sha1_tree *tree = task->tree;
+  const uint8_t prefix = TREE_LEAF_PREFIX;
+
+  for (size_t i = task->first; i < task->last; i++) {
+    uint64_t offset = (uint64_t)i * tree->leaf_size;
+    uint64_t remaining = task->length - offset;
+    size_t length = (remaining < tree->leaf_size) ? ((size_t)remaining)
+                                                  : (tree->leaf_size);
+    sha1_ctx ctx;
+
+    if (!tree->dirty[i])
+      continue;
+    sha1_init(&ctx);
+    sha1_update(&ctx, &prefix, 1);
+    sha1_update(&ctx, task->data + offset, length);
+    sha1_final(&ctx, tree->leaves[i]);
+  }
+}
+/**
+ * Hashes one node over a run of child digests
+ * @param[in]  children Child digests
+ * @param[in]  count    Number of children
+ * @param[out] digest   Node digest
+ * @return void
+ */
+static void tree_hash_node(const uint32_t children[][FINAL_HASH_SIZE],
+                           size_t count, uint32_t digest[]) {
+  const uint8_t prefix = TREE_NODE_PREFIX;
+  uint32_t node[FINAL_HASH_SIZE];
+  sha1_ctx ctx;
+
+  sha1_init(&ctx);
+  sha1_update(&ctx, &prefix, 1);
+  for (size_t c = 0; c < count; c++) {
+    uint8_t bytes[4 * FINAL_HASH_SIZE];
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      sha1_store_be32(children[c][i], bytes + 4 * i);
+    }
+    sha1_update(&ctx, bytes, sizeof(bytes));
+  }
+  /* digest may alias the first child, so finish into a local first */
+  sha1_final(&ctx, node);
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    digest[i] = node[i];
+  }
+}
+/**
+ * Builds the node levels above the leaves. The first level is written to
+ * the scratch array and every further level overwrites it in place: node j
+ * only ever lands on a slot whose children have already been read.
+ * @param[in]  tree Tree with up to date leaves
+ * @param[out] root Root digest
+ * @return void
+ */
+static void tree_build_nodes(sha1_tree *tree, uint32_t root[]) {
+  const uint32_t(*level)[FINAL_HASH_SIZE] = tree->leaves;
+  size_t count = tree->leaf_count;
+
+  do {
+    size_t parents = (count + tree->fanout - 1) / tree->fanout;
+    for (size_t j = 0; j < parents; j++) {
+      size_t first = j * tree->fanout;
+      size_t children =
+          (count - first < tree->fanout) ? (count - first) : (tree->fanout);
+      tree_hash_node(level + first, children, tree->nodes[j]);
+    }
+    level = tree->nodes;
+    count = parents;
+  } while (count > 1);
+
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    root[i] = tree->nodes[0][i];
+  }
+}
+/**
+ * Grows the per-leaf arrays to hold a number of leaves
+ * @param[in,out] tree   Tree
+ * @param[in]     leaves Number of leaves needed
+ * @return 0 on success, -1 if out of memory
+ */
+static int tree_reserve(sha1_tree *tree, size_t leaves) {
+  if (leaves <= tree->capacity)
+    return 0;
+
+  void *digests = realloc(tree->leaves, leaves * sizeof(*tree->leaves));
+  if (digests == NULL)
+    return -1;
+  tree->leaves = digests;
+  digests = realloc(tree->nodes, leaves * sizeof(*tree->nodes));
+  if (digests == NULL)
+    return -1;
+  tree->nodes = digests;
+  uint8_t *dirty = realloc(tree->dirty, leaves);
+  if (dirty == NULL)
+    return -1;
+  tree->dirty = dirty;
+  tree->capacity = leaves;
+  return 0;
+}
+/**
+ * Creates a tree hasher and its worker pool
+ * @param[in] params Tree shape and thread count, NULL for the defaults
+ * @return Tree or NULL on failure
+ */
+sha1_tree *sha1_tree_create(const sha1_tree_params *params) {
+  sha1_tree_params shape = {SHA1_TREE_DEFAULT_LEAF_SIZE,
+                            SHA1_TREE_DEFAULT_FANOUT, 0};
+
+  if (params != NULL)
+    shape = *params;
+  if (shape.leaf_size == 0 || shape.leaf_size % MESSAGE_SIZE != 0) {
+    printf("ERR: Leaf size %zu is not a multiple of %d bytes\n",
+           shape.leaf_size, MESSAGE_SIZE);
+    return NULL;
+  }
+  if (shape.fanout < 2) {
+    printf("ERR: Fan-out %zu is below 2\n", shape.fanout);
+    return NULL;
+  }
+
+  sha1_tree *tree = calloc(1, sizeof(sha1_tree));
+  if (tree == NULL)
+    return NULL;
+  tree->leaf_size = shape.leaf_size;
+  tree->fanout = shape.fanout;
+  tree->pool = thread_pool_create(shape.threads);
+  if (tree->pool == NULL) {
+    free(tree);
+    return NULL;
+  }
+  return tree;
+}
+/**
+ * Hashes a whole input from scratch and remembers its leaf digests
+ * @param[in,out] tree   Tree
+ * @param[in]     data   Input bytes
+ * @param[in]     length Number of bytes in data
+ * @param[out]    root   Root digest
+ * @return 0 on success, -1 if out of memory
+ */
+int sha1_tree_hash(sha1_tree *tree, const void *data, uint64_t length,
+                   uint32_t root[]) {
+  tree->valid = 0;
+  return sha1_tree_rehash(tree, data, length, root);
+}
+/**
+ * Marks the leaves overlapping a modified byte range for rehashing. Bytes
+ * past the length last hashed need not be invalidated, a change of length
+ * is picked up by sha1_tree_rehash.
+ * @param[in,out] tree   Tree
+ * @param[in]     offset First modified byte
+ * @param[in]     length Number of modified bytes
+ * @return void
+ */
+void sha1_tree_invalidate(sha1_tree *tree, uint64_t offset, uint64_t length) {
+  if (length == 0 || !tree->valid)
+    return;
+
+  uint64_t first = offset / tree->leaf_size;
+  uint64_t last = (offset + length - 1) / tree->leaf_size;
+  for (uint64_t i = first; i <= last && i < tree->leaf_count; i++) {
+    tree->dirty[i] = 1;
+  }
+}
+/**
+ * Brings the tree up to date with the input: hashes the invalidated leaves
+ * and, if the length changed, the old last leaf and all leaves after it,
+ * then rebuilds the nodes
+ * @param[in,out] tree   Tree
+ * @param[in]     data   Input bytes, as modified since the last call
+ * @param[in]     length Number of bytes in data
+ * @param[out]    root   Root digest
+ * @return 0 on success, -1 if out of memory
+ */
+int sha1_tree_rehash(sha1_tree *tree, const void *data, uint64_t length,
+                     uint32_t root[]) {
+  size_t count = tree_leaves_for(tree, length);
+  size_t dirty = 0;
+
+  if (tree_reserve(tree, count) != 0) {
+    printf("ERR: Out of memory for %zu tree leaves\n", count);
+    return -1;
+  }
+
+  if (!tree->valid) {
+    for (size_t i = 0; i < count; i++) {
+      tree->dirty[i] = 1;
+    }
+  } else if (length != tree->length) {
+    size_t first = (tree->leaf_count < count) ? (tree->leaf_count) : (count);
+    for (size_t i = first - 1; i < count; i++) {
+      tree->dirty[i] = 1;
+    }
+  }
+  tree->leaf_count = count;
+  tree->length = length;
+
+  for (size_t i = 0; i < count; i++) {
+    dirty += tree->dirty[i];
+  }
+
+  /* Split the dirty leaves into runs of about equal work */
+  size_t tasks = thread_pool_size(tree->pool) * TREE_TASKS_PER_THREAD;
+  size_t per_task = (dirty + tasks - 1) / tasks;
+  tree_task *task = malloc(tasks * sizeof(tree_task));
+  if (task == NULL) {
+    printf("ERR: Out of memory for %zu tree leaves\n", count);
+    return -1;
+  }
+
+  size_t submitted = 0;
+  size_t i = 0;
+  while (i < count) {
+    size_t taken = 0;
+    while (i < count && !tree->dirty[i])
+      i++;
+    if (i == count)
+      break;
+    task[submitted].tree = tree;
+    task[submitted].data = (const uint8_t *)data;
+    task[submitted].length = length;
+    task[submitted].first = i;
+    while (i < count && taken < per_task) {
+      taken += tree->dirty[i++];
+    }
+    task[submitted].last = i;
+    if (thread_pool_submit(tree->pool, tree_hash_leaves, &task[submitted]) !=
+        0)
+      tree_hash_leaves(&task[submitted]);
+    submitted++;
+  }
+  thread_pool_wait(tree->pool);
+  free(task);
+
+  for (size_t j = 0; j < count; j++) {
+    tree->dirty[j] = 0;
+  }
+  tree->valid = 1;
+  tree_build_nodes(tree, root);
+  return 0;
+}
+/**
+ * Returns the number of leaves of the input last hashed
+ * @param[in] tree Tree
+ * @return Number of leaves
+ */
+size_t sha1_tree_leaf_count(const sha1_tree *tree) { return tree->leaf_count; }
+/**
+ * Stops the workers and frees the tree
+ * @param[in] tree Tree, may be NULL
+ * @return void
+ */
+void sha1_tree_destroy(sha1_tree *tree) {
+  if (tree == NULL)
+    return;
+  thread_pool_destroy(tree->pool);
+  free(tree->leaves);
+  free(tree->nodes);
+  free(tree->dirty);
+  free(tree);
+}
@@ -0,0 +1,53 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-tree.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of the SHA-1 tree-hash mode, which spreads a
+* 		            single large input over all cores
+*
+* Format          : The input is cut into leaves of leaf_size bytes; the
+* 		            last leaf may be shorter, an empty input is a single
+* 		            empty leaf.
+* 		              leaf digest = SHA-1(0x00 || leaf bytes)
+* 		              node digest = SHA-1(0x01 || child digest || ...)
+* 		            Nodes take up to fanout consecutive digests of the
+* 		            level below (20 bytes each, big-endian words); the
+* 		            last node of a level may have fewer children. Levels
+* 		            are built until one node remains, and that node is the
+* 		            root. A single leaf still gets one node above it, so
+* 		            the root is never a leaf digest. The root depends on
+* 		            leaf_size and fanout; both must be recorded alongside
+* 		            it for the digest to be reproducible.
+****************************************************************************/
+
+#ifndef SHA1_TREE_HPP
+#define SHA1_TREE_HPP
+
+#include "sha-1.h"
+
+#define SHA1_TREE_DEFAULT_LEAF_SIZE                                            \
+  (1024 * 1024) /**< @brief Represents the default leaf size: 1 MiB */
+#define SHA1_TREE_DEFAULT_FANOUT                                               \
+  (16) /**< @brief Represents the default number of children per node */
+
+/**
+ * Shape of the tree and the parallelism used to build it
+ */
+typedef struct sha1_tree_params {
+  size_t leaf_size; /**< @brief Bytes per leaf, a multiple of 64 */
+  size_t fanout;    /**< @brief Children per node, at least 2 */
+  size_t threads;   /**< @brief Worker threads, 0 for one per CPU */
+} sha1_tree_params;
+
+typedef struct sha1_tree sha1_tree;
+
+sha1_tree *sha1_tree_create(const sha1_tree_params *params);
+int sha1_tree_hash(sha1_tree *tree, const void *data, uint64_t length,
+                   uint32_t root[]);
+void sha1_tree_invalidate(sha1_tree *tree, uint64_t offset, uint64_t length);
+int sha1_tree_rehash(sha1_tree *tree, const void *data, uint64_t length,
+                     uint32_t root[]);
+size_t sha1_tree_leaf_count(const sha1_tree *tree);
+void sha1_tree_destroy(sha1_tree *tree);
+
+#endif /* SHA1_TREE_HPP */
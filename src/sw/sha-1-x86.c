@@ -0,0 +1,295 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha-1-x86.c
+* Author          : Jishnu Murali Thampan
+* Description     : x86 specific single-stream SHA-1 compression kernels
+* 		              SHA-NI - sha1rnds4/sha1nexte/sha1msg1/sha1msg2
+* 		              AVX2   - vectorized message schedule, scalar rounds
+* 		              The kernels are selected at runtime by sha-1.c
+****************************************************************************/
+
+#include "sha-1-internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define CPUID_LEAF1_ECX_OSXSAVE                                                \
+  (1u << 27) /**< @brief OS saves the extended register state */
+#define CPUID_LEAF1_ECX_AVX (1u << 28) /**< @brief AVX is available */
+#define CPUID_LEAF7_EBX_AVX2 (1u << 5) /**< @brief AVX2 is available */
+#define CPUID_LEAF7_EBX_BMI2 (1u << 8) /**< @brief BMI2 is available */
+#define CPUID_LEAF7_EBX_SHA (1u << 29) /**< @brief SHA-NI is available */
+#define CPUID_LEAF1_ECX_SSE41 (1u << 19) /**< @brief SSE4.1 is available */
+#define XCR0_SSE_AVX_STATE                                                     \
+  (0x6) /**< @brief XMM and YMM state enabled by the OS */
+
+/**
+ * Reads the CPUID feature words of leaf 1 and leaf 7
+ * @param[out] leaf1_ecx ECX of leaf 1
+ * @param[out] leaf7_ebx EBX of leaf 7, sub-leaf 0
+ * @return void
+ */
+static void read_cpu_features(uint32_t *leaf1_ecx, uint32_t *leaf7_ebx) {
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+  *leaf1_ecx = 0;
+  *leaf7_ebx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    *leaf1_ecx = ecx;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    *leaf7_ebx = ebx;
+}
+/**
+ * Checks whether the CPU implements the SHA extensions
+ * @param  None
+ * @return 1 if the SHA-NI kernel can run, 0 otherwise
+ */
+int sha1_cpu_has_shani(void) {
+  uint32_t leaf1_ecx, leaf7_ebx;
+  read_cpu_features(&leaf1_ecx, &leaf7_ebx);
+  return ((leaf7_ebx & CPUID_LEAF7_EBX_SHA) &&
+          (leaf1_ecx & CPUID_LEAF1_ECX_SSE41))
+             ? (1)
+             : (0);
+}
+/**
+ * Checks whether the CPU and the OS support AVX2 and BMI2
+ * @param  None
+ * @return 1 if the AVX2 kernel can run, 0 otherwise
+ */
+int sha1_cpu_has_avx2(void) {
+  uint32_t leaf1_ecx, leaf7_ebx;
+  read_cpu_features(&leaf1_ecx, &leaf7_ebx);
+
+  if (!(leaf1_ecx & CPUID_LEAF1_ECX_OSXSAVE) ||
+      !(leaf1_ecx & CPUID_LEAF1_ECX_AVX))
+    return 0;
+  /* The OS has to preserve the YMM registers across context switches */
+  unsigned int xcr0_low, xcr0_high;
+  __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  if ((xcr0_low & XCR0_SSE_AVX_STATE) != XCR0_SSE_AVX_STATE)
+    return 0;
+  return ((leaf7_ebx & CPUID_LEAF7_EBX_AVX2) &&
+          (leaf7_ebx & CPUID_LEAF7_EBX_BMI2))
+             ? (1)
+             : (0);
+}
+
+/* ------------------------------------------------------------------------ */
+/* SHA-NI kernel                                                            */
+/* ------------------------------------------------------------------------ */
+
+/*
+ * One step of four rounds. Step k works on the message words W[4k..4k+3]
+ * which live in msg[k % 4]; the two E registers alternate between steps.
+ * Besides the rounds, each step advances the schedule of the three message
+ * vectors still to come:
+ *   W[k+1] = sha1msg2(sha1msg1(W[k-3], W[k-2]) ^ W[k-1], W[k])
+ */
+#define SHA_NI_STEP(k)                                                         \
+  do {                                                                         \
+    e[(k)&1] = _mm_sha1nexte_epu32(e[(k)&1], msg[(k)&3]);                      \
+    e[((k) + 1) & 1] = abcd;                                                   \
+    if ((k) >= 3 && (k) <= 18)                                                 \
+      msg[((k) + 1) & 3] = _mm_sha1msg2_epu32(msg[((k) + 1) & 3], msg[(k)&3]); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e[(k)&1], (k) / 5);                       \
+    if ((k) <= 16)                                                             \
+      msg[((k)-1) & 3] = _mm_sha1msg1_epu32(msg[((k)-1) & 3], msg[(k)&3]);     \
+    if ((k) >= 2 && (k) <= 17)                                                 \
+      msg[((k) + 2) & 3] = _mm_xor_si128(msg[((k) + 2) & 3], msg[(k)&3]);      \
+  } while (0)
+
+/**
+ * Compresses consecutive 64 byte blocks with the SHA extensions
+ * @param[in,out] hash_state Chaining state
+ * @param[in]     message    First byte of the first block, may be unaligned
+ * @param[in]     blocks     Number of blocks to compress
+ * @return void
+ */
+__attribute__((target("sha,sse4.1"))) void
+sha1_compress_shani(uint32_t hash_state[], const uint8_t message[],
+                    size_t blocks) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i msg[4], e[2];
+
+  /* The instructions expect A in the most significant lane */
+  __m128i abcd = _mm_loadu_si128((const __m128i *)hash_state);
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  __m128i e0 = _mm_set_epi32((int)hash_state[4], 0, 0, 0);
+
+  for (; blocks > 0; blocks--, message += MESSAGE_SIZE) {
+    const __m128i abcd_save = abcd;
+    const __m128i e_save = e0;
+
+    for (int i = 0; i < 4; i++) {
+      msg[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128((const __m128i *)(message + 16 * i)), byte_swap);
+    }
+
+    /* Rounds 0-3: E is added directly, there is no previous A to rotate */
+    e[0] = _mm_add_epi32(e0, msg[0]);
+    e[1] = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+
+    /* Rounds 4-79 */
+    SHA_NI_STEP(1);
+    SHA_NI_STEP(2);
+    SHA_NI_STEP(3);
+    SHA_NI_STEP(4);
+    SHA_NI_STEP(5);
+    SHA_NI_STEP(6);
+    SHA_NI_STEP(7);
+    SHA_NI_STEP(8);
+    SHA_NI_STEP(9);
+    SHA_NI_STEP(10);
+    SHA_NI_STEP(11);
+    SHA_NI_STEP(12);
+    SHA_NI_STEP(13);
+    SHA_NI_STEP(14);
+    SHA_NI_STEP(15);
+    SHA_NI_STEP(16);
+    SHA_NI_STEP(17);
+    SHA_NI_STEP(18);
+    SHA_NI_STEP(19);
+
+    /* Accumulate the intermediate hashes */
+    e0 = _mm_sha1nexte_epu32(e[0], e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  _mm_storeu_si128((__m128i *)hash_state, abcd);
+  hash_state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+/* ------------------------------------------------------------------------ */
+/* AVX2 kernel                                                              */
+/* ------------------------------------------------------------------------ */
+
+#define AVX2_ROTATE_LEFT(data, numberOfBits)                                   \
+  _mm_or_si128(_mm_slli_epi32(data, numberOfBits),                             \
+               _mm_srli_epi32(data, 32 - (numberOfBits)))
+
+#define AVX2_ROUND(OPERATION, i)                                               \
+  do {                                                                         \
+    uint32_t temp = rotate_left32(a, 5) + OPERATION(b, c, d) + e + wk[i];      \
+    e = d;                                                                     \
+    d = c;                                                                     \
+    c = rotate_left32(b, 30);                                                  \
+    b = a;                                                                     \
+    a = temp;                                                                  \
+  } while (0)
+
+/**
+ * Rotates a 32 bit word; compiles to rorx with BMI2
+ * @param[in] data          input data
+ * @param[in] numberOfBits  Number of Bits to be rotated
+ * @return shifted value
+ */
+static inline uint32_t rotate_left32(const uint32_t data,
+                                     const unsigned numberOfBits) {
+  return (data << numberOfBits) | (data >> (32 - numberOfBits));
+}
+/**
+ * Expands the 80 word message schedule four words at a time and adds the
+ * round constants, leaving only the rounds themselves to scalar code.
+ * Words 16-31 use the textbook recurrence, where the fourth word of a
+ * vector depends on the first one; from word 32 on the equivalent
+ *   W[i] = (W[i-6] ^ W[i-16] ^ W[i-28] ^ W[i-32]) <<< 2
+ * has no dependency inside a vector.
+ * @param[in]  message Block to be expanded
+ * @param[out] wk      W[i] + K[i] for all rounds
+ * @return void
+ */
+__attribute__((target("avx2"))) static void
+avx2_schedule(const uint8_t message[], uint32_t wk[]) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  const __m128i round_constant[NUMBER_OF_STAGES] = {
+      _mm_set1_epi32((int)SHA_1_ROUND_1_CONST),
+      _mm_set1_epi32((int)SHA_1_ROUND_2_CONST),
+      _mm_set1_epi32((int)SHA_1_ROUND_3_CONST),
+      _mm_set1_epi32((int)SHA_1_ROUND_4_CONST)};
+  uint32_t chunk[TOTAL_NUMBER_OF_ROUNDS];
+  size_t i = 0;
+
+  for (; i < PRE_PROC_MSG_SIZE; i += 4) {
+    __m128i w = _mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i *)(message + 4 * i)), byte_swap);
+    _mm_storeu_si128((__m128i *)&chunk[i], w);
+  }
+  for (; i < 32; i += 4) {
+    /* W[i-3..i-1] and zero: W[i] is not known yet */
+    __m128i w = _mm_srli_si128(_mm_loadu_si128((__m128i *)&chunk[i - 4]), 4);
+    w = _mm_xor_si128(w, _mm_loadu_si128((__m128i *)&chunk[i - 8]));
+    w = _mm_xor_si128(w, _mm_loadu_si128((__m128i *)&chunk[i - 14]));
+    w = _mm_xor_si128(w, _mm_loadu_si128((__m128i *)&chunk[i - 16]));
+    w = AVX2_ROTATE_LEFT(w, 1);
+    /* ...and fold W[i] <<< 1 into the last lane afterwards */
+    __m128i fixup = _mm_slli_si128(w, 12);
+    w = _mm_xor_si128(w, AVX2_ROTATE_LEFT(fixup, 1));
+    _mm_storeu_si128((__m128i *)&chunk[i], w);
+  }
+  for (; i < TOTAL_NUMBER_OF_ROUNDS; i += 4) {
+    __m128i w = _mm_loadu_si128((__m128i *)&chunk[i - 6]);
+    w = _mm_xor_si128(w, _mm_loadu_si128((__m128i *)&chunk[i - 16]));
+    w = _mm_xor_si128(w, _mm_loadu_si128((__m128i *)&chunk[i - 28]));
+    w = _mm_xor_si128(w, _mm_loadu_si128((__m128i *)&chunk[i - 32]));
+    w = AVX2_ROTATE_LEFT(w, 2);
+    _mm_storeu_si128((__m128i *)&chunk[i], w);
+  }
+
+  for (i = 0; i < TOTAL_NUMBER_OF_ROUNDS; i += 4) {
+    __m128i w = _mm_loadu_si128((__m128i *)&chunk[i]);
+    w = _mm_add_epi32(w, round_constant[i / NUMBER_OF_ROUNDS_PER_STAGE]);
+    _mm_storeu_si128((__m128i *)&wk[i], w);
+  }
+}
+/**
+ * Compresses consecutive 64 byte blocks using the vectorized schedule
+ * @param[in,out] hash_state Chaining state
+ * @param[in]     message    First byte of the first block, may be unaligned
+ * @param[in]     blocks     Number of blocks to compress
+ * @return void
+ */
+__attribute__((target("avx2,bmi2"))) void
+sha1_compress_avx2(uint32_t hash_state[], const uint8_t message[],
+                   size_t blocks) {
+  uint32_t wk[TOTAL_NUMBER_OF_ROUNDS];
+
+  for (; blocks > 0; blocks--, message += MESSAGE_SIZE) {
+    avx2_schedule(message, wk);
+
+    uint32_t a = hash_state[0];
+    uint32_t b = hash_state[1];
+    uint32_t c = hash_state[2];
+    uint32_t d = hash_state[3];
+    uint32_t e = hash_state[4];
+    size_t i = 0;
+
+    /* Round -1 */
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE; i++)
+      AVX2_ROUND(OPERATION_ROUND_1, i);
+    /* Round -2 */
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 2; i++)
+      AVX2_ROUND(OPERATION_ROUND_2, i);
+    /* Round -3 */
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 3; i++)
+      AVX2_ROUND(OPERATION_ROUND_3, i);
+    /* Round -4 */
+    for (; i < NUMBER_OF_ROUNDS_PER_STAGE * 4; i++)
+      AVX2_ROUND(OPERATION_ROUND_4, i);
+
+    /* Accumulate the intermediate hashes */
+    hash_state[0] += a;
+    hash_state[1] += b;
+    hash_state[2] += c;
+    hash_state[3] += d;
+    hash_state[4] += e;
+  }
+}
+
+#endif /* __x86_64__ || __i386__ */
@@ -1,75 +1,26 @@
 /***************************************************************************
 ****************************************************************************
-* Filename        : sha-1.cpp
+* Filename        : sha-1.c
 * Author          : Jishnu Murali Thampan
 * Description     : Implementation of SHA-1 Alogrithm
-* 		              Note: This version does not support message sizes > 512 bytes
+* 		              Blocks are compressed straight from the caller's
+* 		              buffer; only a trailing partial block is buffered
 ****************************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include "sha-1.h"
+#include "sha-1-internal.h"
+#include "sha-1-profile.h"
 
 #undef DEBUG_MODE /**< @brief Defining this would enable the debug prints */
+/* Building with -DSHA1_UNROLLED_CORE replaces the four round loops of
+   perform_sha1_core with the fully unrolled kernel; the digests are equal,
+   which sha-1-check.c verifies.
+   Building with -DSHA1_PROFILE times the stages, see sha-1-profile.h */
 
-#define INPUT_MESSAGE_SIZE                                                     \
-  (512) /**< @brief Represents the size of the Input Message */
-#define MESSAGE_SIZE                                                           \
-  (64) /**< @brief Represents the 8bit array size needed to represent the      \
-          input: 512/8 = 64*/
-#define PRE_PROC_MSG_SIZE                                                      \
-  (16) /**< @brief Represents the array size of the pre-processed message:     \
-          512(message size)/ 32(bit width)*/
-#define FINAL_HASH_SIZE                                                        \
-  (                                                                            \
-      5) /**< @brief Represents the array size of Final Hash Message: 160/32   \
-            bits = 5  */
-
-#define NUMBER_OF_STAGES                                                       \
-  (4) /**< @brief Represents the number of stages of sha-1 */
-#define NUMBER_OF_ROUNDS_PER_STAGE                                             \
-  (20) /**< @brief Represents the number of rounds per stage of sha-1 */
-#define TOTAL_NUMBER_OF_ROUNDS                                                 \
-  (NUMBER_OF_STAGES) *                                                         \
-      (NUMBER_OF_ROUNDS_PER_STAGE) /**< @brief Represents total number of      \
-                                      rounds in sha-1 */
 #define MASK_8BIT (0xff)           /**< @brief Represents the 8bit Mask*/
 
-/* SHA1 initialization constants */
-#define H0                                                                     \
-  (0x67452301) /**< @brief Represents SHA1 initialization constant H0 */
-#define H1                                                                     \
-  (0xEFCDAB89) /**< @brief Represents SHA1 initialization constant H1 */
-#define H2                                                                     \
-  (0x98BADCFE) /**< @brief Represents SHA1 initialization constant H2 */
-#define H3                                                                     \
-  (0x10325476) /**< @brief Represents SHA1 initialization constant H3 */
-#define H4                                                                     \
-  (0xC3D2E1F0) /**< @brief Represents SHA1 initialization constant H4 */
-
-#define SHA_1_ROUND_1_CONST                                                    \
-  (0x5A827999) /**< @brief Represents the constant used in SHA-1 Round-1*/
-#define SHA_1_ROUND_2_CONST                                                    \
-  (0x6ED9EBA1) /**< @brief Represents the constant used in SHA-1 Round-2*/
-#define SHA_1_ROUND_3_CONST                                                    \
-  (0x8F1BBCDC) /**< @brief Represents the constant used in SHA-1 Round-3*/
-#define SHA_1_ROUND_4_CONST                                                    \
-  (0xCA62C1D6) /**< @brief Represents the constant used in SHA-1 Round-4*/
-
-#define OPERATION_ROUND_1(b, c, d)                                             \
-  ((b & c) |                                                                   \
-   ((~b) &                                                                     \
-    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-1*/
-#define OPERATION_ROUND_2(b, c, d)                                             \
-  ((b ^ c ^                                                                    \
-    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-2*/
-#define OPERATION_ROUND_3(b, c, d)                                             \
-  ((b & c) | (b & d) |                                                         \
-   (c &                                                                        \
-    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-3*/
-#define OPERATION_ROUND_4(b, c, d)                                             \
-  ((b ^ c ^                                                                    \
-    d)) /**< @brief Represents the cryptographic operation in SHA-1 Round-4*/
-
 #ifdef DEBUG_MODE
 /**
  * Prints the binary equivalent of a 32 bit word by iterating over each memory
@@ -93,32 +44,6 @@ static void print_word(const uint32_t word) {
   printf("\n");
 }
 #endif
-/**
- * Calculates and returns the length of the given input data
- * @param[in] input  Data whose length is to be obtained
- * @return Length of the data
- */
-static size_t getLength(const void *input) {
-  size_t i = 0;
-  uint8_t *data = (uint8_t *)input;
-  while (*((uint8_t *)(data + i)) != 0)
-    i++;
-
-  return (i);
-}
-/**
- * Appends '1' to the input array
- * @param[out] input Input Array to which '1' has to be appended
- * @return void
- */
-static void appendOneToInputArray(uint8_t input[]) {
-  size_t free_pos = getLength(input);
-  if (free_pos == INPUT_MESSAGE_SIZE) {
-    printf("ERR: Input sizes >= 512 is not supported");
-    return;
-  }
-  *(input + free_pos) = (uint8_t)(0x8 << 4);
-}
 /**
  * Converts 8 bit message array to fixed blocks of 32 bit width
  * @param[in]  message      Message to be converted
@@ -138,27 +63,16 @@ static void convert_message_to_fixed_blocks(const uint8_t message[],
 #endif
   }
 }
-/**
- * Fills the input array
- * @param[in]  data  Data to be filled
- * @param[out] input Destination array
- * @return void
- */
-static void fill_input_array(const char *data, uint8_t input[]) {
-  /* Store the message in its ASCII Equivalent */
-  for (size_t i = 0; i < getLength(data); i++) {
-    input[i] = data[i];
-  }
-}
 /**
  * Gets the input string either hardcoded or from the user
- * @param[in] input Input array to store the user input
- * @return void
+ * @param[out] length Length of the input string in bytes
+ * @return Input string
  */
-static void getInputString(uint8_t input[]) {
-  const char *data = "abc";
+static const char *getInputString(size_t *length) {
+  static const char data[] = "abc";
   printf("Input: Message: %s\n", data);
-  fill_input_array(data, input);
+  *length = sizeof(data) - 1;
+  return data;
 }
 /**
  * Rotates the given data by the number of bits specified
@@ -172,6 +86,7 @@ static inline uint32_t rotate_left(const uint32_t data,
       (data << numberOfBits) | (data >> (32 - numberOfBits));
   return shifted_value;
 }
+#ifndef SHA1_UNROLLED_CORE
 /**
  * Converts the fixed blocks to chunks of data
  * @param[in]  fixed_blocks Fixed blocks
@@ -196,21 +111,26 @@ static void convert_fixed_blocks_to_chunks(const uint32_t fixed_blocks[],
 /**
  * Performs the Core-functionality of SHA-1 algorithm
  * @param[in]   fixed_blocks        Fixed blocks
+ * @param[in]   hash_state          Chaining state the block starts from
  * @param[out]  intermediate_hashes To store the intermediate
  *              hashes obtained after computation
  * @return void
  */
 static void perform_sha1_core(const uint32_t fixed_blocks[],
+                              const uint32_t hash_state[],
                               uint32_t intermediate_hashes[]) {
-  uint32_t a = H0;
-  uint32_t b = H1;
-  uint32_t c = H2;
-  uint32_t d = H3;
-  uint32_t e = H4;
+  uint32_t a = hash_state[0];
+  uint32_t b = hash_state[1];
+  uint32_t c = hash_state[2];
+  uint32_t d = hash_state[3];
+  uint32_t e = hash_state[4];
 
   uint32_t chunk[TOTAL_NUMBER_OF_ROUNDS] = {0};
 
+  SHA1_PROFILE_START(schedule);
   convert_fixed_blocks_to_chunks(fixed_blocks, chunk);
+  SHA1_PROFILE_STOP(SHA1_STAGE_SCHEDULE, schedule);
+  SHA1_PROFILE_START(rounds);
 
   uint8_t i =
       0; /* loop variable to count from 0 to NUMBER_OF_ROUNDS_PER_STAGE * 4 */
@@ -255,6 +175,7 @@ static void perform_sha1_core(const uint32_t fixed_blocks[],
     b = a;
     a = temp;
   }
+  SHA1_PROFILE_STOP(SHA1_STAGE_ROUNDS, rounds);
   /* Save the intermediate hashes */
   intermediate_hashes[0] = a;
   intermediate_hashes[1] = b;
@@ -262,93 +183,475 @@ static void perform_sha1_core(const uint32_t fixed_blocks[],
   intermediate_hashes[3] = d;
   intermediate_hashes[4] = e;
 }
+#else /* SHA1_UNROLLED_CORE */
+
+#define OPERATION_CH(b, c, d)                                                  \
+  ((d) ^ ((b) & ((c) ^ (d)))) /**< @brief Round-1 operation (Ch) with one    \
+                                 instruction less than OPERATION_ROUND_1 */
+#define OPERATION_MAJ(b, c, d)                                                 \
+  (((b) & (c)) + ((d) & ((b) ^ (c)))) /**< @brief Round-3 operation (Maj)    \
+                                         with independent terms */
+
+#define SCHEDULE_WORD(i)                                                       \
+  ((i) < PRE_PROC_MSG_SIZE                                                     \
+       ? (chunk[(i)&15])                                                       \
+       : (chunk[(i)&15] = rotate_left(chunk[((i) + 13) & 15] ^                 \
+                                          chunk[((i) + 8) & 15] ^              \
+                                          chunk[((i) + 2) & 15] ^              \
+                                          chunk[(i)&15],                       \
+                                      1))) /**< @brief Word i of the schedule, \
+                                              expanded in a 16 word ring */
+
+#define UNROLLED_ROUND(a, b, c, d, e, OPERATION, CONSTANT, i)                  \
+  do {                                                                         \
+    e += rotate_left(a, 5) + OPERATION(b, c, d) + (CONSTANT) +                 \
+         SCHEDULE_WORD(i);                                                     \
+    b = rotate_left(b, 30);                                                    \
+  } while (0) /**< @brief One round; the caller renames the variables        \
+                 instead of moving the values */
+
+#define FIVE_ROUNDS(OPERATION, CONSTANT, i)                                    \
+  do {                                                                         \
+    UNROLLED_ROUND(a, b, c, d, e, OPERATION, CONSTANT, (i) + 0);               \
+    UNROLLED_ROUND(e, a, b, c, d, OPERATION, CONSTANT, (i) + 1);               \
+    UNROLLED_ROUND(d, e, a, b, c, OPERATION, CONSTANT, (i) + 2);               \
+    UNROLLED_ROUND(c, d, e, a, b, OPERATION, CONSTANT, (i) + 3);               \
+    UNROLLED_ROUND(b, c, d, e, a, OPERATION, CONSTANT, (i) + 4);               \
+  } while (0) /**< @brief Five rounds bring the names back to a..e */
+
 /**
- * Calculates and adds the input length to the fixed blocks at the end
- * @param[in]  input        Input data
- * @param[out] fixed_blocks Fixed blocks after addition of the input length
+ * Performs the Core-functionality of SHA-1 algorithm with all 80 rounds
+ * unrolled. The variables are renamed from round to round instead of
+ * shifted, and only a 16 word window of the schedule is kept so that the
+ * whole state can stay in registers. The schedule is interleaved with the
+ * rounds, so the profile counts both as rounds.
+ * @param[in]   fixed_blocks        Fixed blocks
+ * @param[in]   hash_state          Chaining state the block starts from
+ * @param[out]  intermediate_hashes To store the intermediate
+ *              hashes obtained after computation
  * @return void
  */
-void addInputLength(const uint8_t input[], uint32_t fixed_blocks[]) {
-  uint64_t inputSize = (getLength(input) - 1) * 8;
-  fixed_blocks[PRE_PROC_MSG_SIZE - 1] = (uint32_t)(inputSize);
-  fixed_blocks[PRE_PROC_MSG_SIZE - 2] = (uint32_t)(inputSize >> 32);
-#ifdef DEBUG_MODE
-  print_word(fixed_blocks[PRE_PROC_MSG_SIZE - 1]);
-  print_word(fixed_blocks[PRE_PROC_MSG_SIZE - 2]);
-#endif
+static void perform_sha1_core(const uint32_t fixed_blocks[],
+                              const uint32_t hash_state[],
+                              uint32_t intermediate_hashes[]) {
+  uint32_t a = hash_state[0];
+  uint32_t b = hash_state[1];
+  uint32_t c = hash_state[2];
+  uint32_t d = hash_state[3];
+  uint32_t e = hash_state[4];
+
+  uint32_t chunk[PRE_PROC_MSG_SIZE];
+  SHA1_PROFILE_START(rounds);
+  memcpy(chunk, fixed_blocks, sizeof(chunk));
+
+  /* Round -1 */
+  FIVE_ROUNDS(OPERATION_CH, SHA_1_ROUND_1_CONST, 0);
+  FIVE_ROUNDS(OPERATION_CH, SHA_1_ROUND_1_CONST, 5);
+  FIVE_ROUNDS(OPERATION_CH, SHA_1_ROUND_1_CONST, 10);
+  FIVE_ROUNDS(OPERATION_CH, SHA_1_ROUND_1_CONST, 15);
+  /* Round -2 */
+  FIVE_ROUNDS(OPERATION_ROUND_2, SHA_1_ROUND_2_CONST, 20);
+  FIVE_ROUNDS(OPERATION_ROUND_2, SHA_1_ROUND_2_CONST, 25);
+  FIVE_ROUNDS(OPERATION_ROUND_2, SHA_1_ROUND_2_CONST, 30);
+  FIVE_ROUNDS(OPERATION_ROUND_2, SHA_1_ROUND_2_CONST, 35);
+  /* Round -3 */
+  FIVE_ROUNDS(OPERATION_MAJ, SHA_1_ROUND_3_CONST, 40);
+  FIVE_ROUNDS(OPERATION_MAJ, SHA_1_ROUND_3_CONST, 45);
+  FIVE_ROUNDS(OPERATION_MAJ, SHA_1_ROUND_3_CONST, 50);
+  FIVE_ROUNDS(OPERATION_MAJ, SHA_1_ROUND_3_CONST, 55);
+  /* Round -4 */
+  FIVE_ROUNDS(OPERATION_ROUND_4, SHA_1_ROUND_4_CONST, 60);
+  FIVE_ROUNDS(OPERATION_ROUND_4, SHA_1_ROUND_4_CONST, 65);
+  FIVE_ROUNDS(OPERATION_ROUND_4, SHA_1_ROUND_4_CONST, 70);
+  FIVE_ROUNDS(OPERATION_ROUND_4, SHA_1_ROUND_4_CONST, 75);
+  SHA1_PROFILE_STOP(SHA1_STAGE_ROUNDS, rounds);
+
+  /* Save the intermediate hashes */
+  intermediate_hashes[0] = a;
+  intermediate_hashes[1] = b;
+  intermediate_hashes[2] = c;
+  intermediate_hashes[3] = d;
+  intermediate_hashes[4] = e;
+}
+#endif /* SHA1_UNROLLED_CORE */
+/**
+ * Adds the input length in bits to the end of the final block
+ * @param[in]  inputLength Length of the whole message in bytes
+ * @param[out] block       Final block after addition of the input length
+ * @return void
+ */
+static void addInputLength(const uint64_t inputLength, uint8_t block[]) {
+  uint64_t inputSize = inputLength * 8;
+  for (size_t i = 0; i < LENGTH_FIELD_SIZE; i++) {
+    block[MESSAGE_SIZE - 1 - i] = (uint8_t)(inputSize >> (8 * i));
+  }
 }
 /**
  * Prints the final hash result
  * @param[in] final_hash Final Hash
  * @return void
  */
-static void print_final_hash(const uint32_t final_hash[]) {
+void print_final_hash(const uint32_t final_hash[]) {
   printf("---------------------\n");
   printf("Output: SHA-1 Final Hash:\n");
   printf("========================================\n");
   for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
-    printf("%x", final_hash[i]);
+    printf("%08x", final_hash[i]);
   }
   printf("\n========================================\n");
 }
 /**
- * Accumulates the intermediate hashes
- * @param[in]  intermediate_hashes Intermediate hashes
- * @param[out] result              Accumulated result
+ * Accumulates the intermediate hashes into the chaining state
+ * @param[in]     intermediate_hashes Intermediate hashes
+ * @param[in,out] result              Accumulated result
  * @return void
  */
 static void accumulate_intermediate_hashes(const uint32_t intermediate_hashes[],
                                            uint32_t result[]) {
-  result[0] = intermediate_hashes[0] + H0;
-  result[1] = intermediate_hashes[1] + H1;
-  result[2] = intermediate_hashes[2] + H2;
-  result[3] = intermediate_hashes[3] + H3;
-  result[4] = intermediate_hashes[4] + H4;
+  result[0] += intermediate_hashes[0];
+  result[1] += intermediate_hashes[1];
+  result[2] += intermediate_hashes[2];
+  result[3] += intermediate_hashes[3];
+  result[4] += intermediate_hashes[4];
+}
+/**
+ * Compresses consecutive 64 byte blocks into the chaining state with the
+ * portable C rounds. The blocks are read straight from the given buffer,
+ * which need not be aligned.
+ * @param[in,out] hash_state Chaining state
+ * @param[in]     message    First byte of the first block
+ * @param[in]     blocks     Number of blocks to compress
+ * @return void
+ */
+static void sha1_compress_portable(uint32_t hash_state[],
+                                   const uint8_t message[], size_t blocks) {
+  uint32_t fixed_blocks[PRE_PROC_MSG_SIZE];
+  uint32_t intermediate_hashes[FINAL_HASH_SIZE];
+
+  for (; blocks > 0; blocks--, message += MESSAGE_SIZE) {
+    SHA1_PROFILE_START(load);
+    convert_message_to_fixed_blocks(message, fixed_blocks);
+    SHA1_PROFILE_STOP(SHA1_STAGE_LOAD, load);
+    perform_sha1_core(fixed_blocks, hash_state, intermediate_hashes);
+    SHA1_PROFILE_START(accumulate);
+    accumulate_intermediate_hashes(intermediate_hashes, hash_state);
+    SHA1_PROFILE_STOP(SHA1_STAGE_ACCUMULATE, accumulate);
+  }
+}
+
+static sha1_kernel active_kernel = SHA1_KERNEL_PORTABLE; /**< @brief Selected
+                                                            kernel */
+static sha1_compress_fn active_compress =
+    sha1_compress_portable; /**< @brief Entry point of the selected kernel */
+
+/**
+ * Checks whether a kernel can run on this CPU
+ * @param[in] kernel Kernel to be checked
+ * @return 1 if supported, 0 otherwise
+ */
+int sha1_kernel_supported(sha1_kernel kernel) {
+  switch (kernel) {
+  case SHA1_KERNEL_AUTO:
+  case SHA1_KERNEL_PORTABLE:
+    return 1;
+#if defined(__x86_64__) || defined(__i386__)
+  case SHA1_KERNEL_AVX2:
+    return sha1_cpu_has_avx2();
+  case SHA1_KERNEL_SHANI:
+    return sha1_cpu_has_shani();
+#endif
+  default:
+    return 0;
+  }
+}
+/**
+ * Selects the kernel used by the streaming API. Intended to be called
+ * before hashing starts, e.g. by benchmarks forcing a specific kernel.
+ * @param[in] kernel Kernel to be used, SHA1_KERNEL_AUTO picks the fastest
+ * @return 0 on success, -1 if the kernel is not supported by this CPU
+ */
+int sha1_set_kernel(sha1_kernel kernel) {
+  if (kernel == SHA1_KERNEL_AUTO) {
+    /* Preference order: SHA-NI, AVX2, portable */
+    kernel = SHA1_KERNEL_PORTABLE;
+#ifndef SHA1_PROFILE
+    /* Profiled builds keep the portable kernel, the only one whose load,
+       schedule, rounds and accumulate stages are timed */
+    if (sha1_kernel_supported(SHA1_KERNEL_AVX2))
+      kernel = SHA1_KERNEL_AVX2;
+    if (sha1_kernel_supported(SHA1_KERNEL_SHANI))
+      kernel = SHA1_KERNEL_SHANI;
+#endif
+  }
+  if (!sha1_kernel_supported(kernel)) {
+    printf("ERR: SHA-1 kernel %s is not supported on this CPU\n",
+           sha1_kernel_name(kernel));
+    return -1;
+  }
+
+  switch (kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+  case SHA1_KERNEL_AVX2:
+    active_compress = sha1_compress_avx2;
+    break;
+  case SHA1_KERNEL_SHANI:
+    active_compress = sha1_compress_shani;
+    break;
+#endif
+  default:
+    active_compress = sha1_compress_portable;
+    break;
+  }
+  active_kernel = kernel;
+  return 0;
 }
 /**
- * Performs the pre-processing stage of the sha-1 algorithm
- * @param[in]  input                 Input Message
- * @param[out] pre_processed_message Message after pre-processing
+ * Returns the kernel currently used by the streaming API
+ * @param  None
+ * @return Selected kernel
+ */
+sha1_kernel sha1_get_kernel(void) { return active_kernel; }
+/**
+ * Returns a printable name of a kernel
+ * @param[in] kernel Kernel
+ * @return Name of the kernel
+ */
+const char *sha1_kernel_name(sha1_kernel kernel) {
+  static const char *const names[SHA1_KERNEL_COUNT] = {
+      [SHA1_KERNEL_AUTO] = "auto",
+      [SHA1_KERNEL_PORTABLE] = "portable",
+      [SHA1_KERNEL_AVX2] = "avx2",
+      [SHA1_KERNEL_SHANI] = "sha-ni",
+  };
+  return ((unsigned)kernel < SHA1_KERNEL_COUNT) ? (names[kernel])
+                                                : ("unknown");
+}
+#if defined(__GNUC__)
+/**
+ * Picks the fastest kernel from CPUID once at program startup
+ * @param  None
  * @return void
  */
-static void pre_processing_stage(uint8_t input[],
-                                 uint32_t pre_processed_message[]) {
+__attribute__((constructor)) static void sha1_select_kernel_at_startup(void) {
+  sha1_set_kernel(SHA1_KERNEL_AUTO);
+}
+#endif
+/**
+ * Compresses consecutive 64 byte blocks with the selected kernel
+ * @param[in,out] hash_state Chaining state
+ * @param[in]     message    First byte of the first block, may be unaligned
+ * @param[in]     blocks     Number of blocks to compress
+ * @return void
+ */
+void sha1_compress_blocks(uint32_t hash_state[], const uint8_t message[],
+                          size_t blocks) {
+#ifdef SHA1_PROFILE
+  /* One sample per block, so the percentiles are those of single blocks */
+  for (; blocks > 0; blocks--, message += MESSAGE_SIZE) {
+    SHA1_PROFILE_START(block);
+    active_compress(hash_state, message, 1);
+    SHA1_PROFILE_STOP(SHA1_STAGE_BLOCK, block);
+  }
+#else
+  if (blocks > 0)
+    active_compress(hash_state, message, blocks);
+#endif
+}
+/**
+ * Performs the pre-processing stage of the sha-1 algorithm on the tail of a
+ * message: appends '1', pads with zeros and adds the length
+ * @param[in]  tail         Last (tail_length < 64) bytes of the message
+ * @param[in]  tail_length  Number of bytes in tail
+ * @param[in]  input_length Length of the whole message in bytes
+ * @param[out] padded       MAX_PADDED_SIZE bytes receiving the final blocks
+ * @return Number of final blocks written to padded (1 or 2)
+ */
+size_t sha1_pre_processing_stage(const uint8_t tail[], size_t tail_length,
+                                 uint64_t input_length, uint8_t padded[]) {
+  size_t blocks =
+      (tail_length < MESSAGE_SIZE - LENGTH_FIELD_SIZE) ? (1) : (2);
+
+  memcpy(padded, tail, tail_length);
+
   /* Append-1 to input array */
-  appendOneToInputArray(input);
+  padded[tail_length] = (uint8_t)(0x8 << 4);
 
-  /* Now convert the message to fixed blocks */
-  convert_message_to_fixed_blocks(input, pre_processed_message);
+  /* Fill zeros up to the length field */
+  memset(padded + tail_length + 1, 0,
+         blocks * MESSAGE_SIZE - LENGTH_FIELD_SIZE - tail_length - 1);
 
   /* Finally, add the input length at the end of the array */
-  addInputLength(input, pre_processed_message);
+  addInputLength(input_length, padded + (blocks - 1) * MESSAGE_SIZE);
+  return blocks;
 }
 /**
- * Generates the SHA-1 Hash after a series of steps
- * 1. Get Input and store its ASCII Values
- * 2. Pre-processing stage
- * 3. SHA-1 Core
- * 4. Post-processing stage
- * 5. Prints the Generated Hash
- * @param  None
+ * Initializes a context with the SHA-1 initialization constants
+ * @param[out] ctx Context to be initialized
  * @return void
  */
-void generate_sha1_hash(void) {
-  /* Get Input and store its ASCII Values*/
-  uint8_t input[INPUT_MESSAGE_SIZE] = {0};
-  getInputString(input);
+void sha1_init(sha1_ctx *ctx) {
+  ctx->state[0] = H0;
+  ctx->state[1] = H1;
+  ctx->state[2] = H2;
+  ctx->state[3] = H3;
+  ctx->state[4] = H4;
+  ctx->length = 0;
+  ctx->buffered = 0;
+}
+/**
+ * Feeds the next part of the message into the hash. Whole blocks are
+ * compressed in place from the given buffer; only a trailing partial block
+ * is copied into the context.
+ * @param[in,out] ctx    Context
+ * @param[in]     data   Message bytes, may contain zeros and be unaligned
+ * @param[in]     length Number of bytes in data
+ * @return void
+ */
+void sha1_update(sha1_ctx *ctx, const void *data, size_t length) {
+  const uint8_t *message = (const uint8_t *)data;
+  ctx->length += length;
+
+  /* Complete a partial block left over from the previous call */
+  if (ctx->buffered > 0) {
+    size_t fill = MESSAGE_SIZE - ctx->buffered;
+    if (fill > length)
+      fill = length;
+    memcpy(ctx->buffer + ctx->buffered, message, fill);
+    ctx->buffered += fill;
+    message += fill;
+    length -= fill;
+
+    if (ctx->buffered < MESSAGE_SIZE)
+      return;
+    sha1_compress_blocks(ctx->state, ctx->buffer, 1);
+    ctx->buffered = 0;
+  }
 
+  /* Compress all whole blocks straight from the caller's buffer */
+  size_t blocks = length / MESSAGE_SIZE;
+  sha1_compress_blocks(ctx->state, message, blocks);
+  message += blocks * MESSAGE_SIZE;
+  length -= blocks * MESSAGE_SIZE;
+
+  /* Keep the tail for the next call or for sha1_final() */
+  memcpy(ctx->buffer, message, length);
+  ctx->buffered = length;
+}
+/**
+ * Pads the message, compresses the last block(s) and returns the digest
+ * @param[in,out] ctx        Context, must be re-initialized before reuse
+ * @param[out]    final_hash Final Hash
+ * @return void
+ */
+void sha1_final(sha1_ctx *ctx, uint32_t final_hash[]) {
   /* Pre-processing stage */
-  uint32_t pre_processed_message[PRE_PROC_MSG_SIZE] = {0};
-  pre_processing_stage(input, pre_processed_message);
+  uint8_t padded[MAX_PADDED_SIZE];
+  SHA1_PROFILE_START(pre_processing);
+  size_t blocks = sha1_pre_processing_stage(ctx->buffer, ctx->buffered,
+                                            ctx->length, padded);
+  SHA1_PROFILE_STOP(SHA1_STAGE_PRE_PROCESSING, pre_processing);
 
   /*SHA-1 Core */
-  uint32_t intermediate_hashes[FINAL_HASH_SIZE] = {0};
-  perform_sha1_core(pre_processed_message, intermediate_hashes);
+  sha1_compress_blocks(ctx->state, padded, blocks);
+
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    final_hash[i] = ctx->state[i];
+  }
+}
+/**
+ * Computes the SHA-1 Hash of a complete message in one call
+ * @param[in]  data       Message bytes
+ * @param[in]  length     Number of bytes in data
+ * @param[out] final_hash Final Hash
+ * @return void
+ */
+void sha1_hash(const void *data, size_t length, uint32_t final_hash[]) {
+  sha1_ctx ctx;
+  sha1_init(&ctx);
+  sha1_update(&ctx, data, length);
+  sha1_final(&ctx, final_hash);
+}
+/**
+ * Saves the chaining state of a context. Only possible at a block
+ * boundary, i.e. after a multiple of 64 bytes has been fed in.
+ * @param[in]  ctx      Context
+ * @param[out] midstate Chaining state and byte count
+ * @return 0 on success, -1 if a partial block is buffered
+ */
+int sha1_midstate_export(const sha1_ctx *ctx, sha1_midstate *midstate) {
+  if (ctx->buffered != 0) {
+    printf("ERR: SHA-1 midstate is not at a block boundary\n");
+    return -1;
+  }
+  memcpy(midstate->state, ctx->state, sizeof(midstate->state));
+  midstate->length = ctx->length;
+  return 0;
+}
+/**
+ * Initializes a context to continue from a midstate instead of H0..H4
+ * @param[out] ctx      Context to be initialized
+ * @param[in]  midstate Saved chaining state
+ * @return void
+ */
+void sha1_midstate_import(sha1_ctx *ctx, const sha1_midstate *midstate) {
+  memcpy(ctx->state, midstate->state, sizeof(ctx->state));
+  ctx->length = midstate->length;
+  ctx->buffered = 0;
+}
+/**
+ * Serializes a midstate in a byte order independent form
+ * @param[in]  midstate Midstate
+ * @param[out] bytes    SHA1_MIDSTATE_SIZE bytes
+ * @return void
+ */
+void sha1_midstate_serialize(const sha1_midstate *midstate,
+                             uint8_t bytes[SHA1_MIDSTATE_SIZE]) {
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    sha1_store_be32(midstate->state[i], bytes + 4 * i);
+  }
+  sha1_store_be32((uint32_t)(midstate->length >> 32), bytes + 20);
+  sha1_store_be32((uint32_t)midstate->length, bytes + 24);
+}
+/**
+ * Restores a midstate written by sha1_midstate_serialize()
+ * @param[in]  bytes    SHA1_MIDSTATE_SIZE bytes
+ * @param[out] midstate Midstate
+ * @return 0 on success, -1 if the byte count is not at a block boundary
+ */
+int sha1_midstate_deserialize(const uint8_t bytes[SHA1_MIDSTATE_SIZE],
+                              sha1_midstate *midstate) {
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    midstate->state[i] = sha1_load_be32(bytes + 4 * i);
+  }
+  midstate->length = ((uint64_t)sha1_load_be32(bytes + 20) << 32) |
+                     sha1_load_be32(bytes + 24);
+  if (midstate->length % MESSAGE_SIZE != 0) {
+    printf("ERR: SHA-1 midstate is not at a block boundary\n");
+    return -1;
+  }
+  return 0;
+}
+/**
+ * Generates the SHA-1 Hash after a series of steps
+ * 1. Get Input
+ * 2. Stream it through the SHA-1 Core
+ * 3. Pre-processing and post-processing of the final block
+ * 4. Prints the Generated Hash
+ * @param[out] final_hash Final Hash
+ * @return void
+ */
+void generate_sha1_hash(uint32_t final_hash[]) {
+  /* Get Input */
+  size_t length = 0;
+  SHA1_PROFILE_START(input);
+  const char *data = getInputString(&length);
+  SHA1_PROFILE_STOP(SHA1_STAGE_INPUT, input);
 
-  /* Post-processing stage */
-  uint32_t final_hash[FINAL_HASH_SIZE] = {0};
-  accumulate_intermediate_hashes(intermediate_hashes, final_hash);
+  /* SHA-1 Core, pre-processing and post-processing */
+  sha1_hash(data, length, final_hash);
 
   /* Print the final Hash*/
+  SHA1_PROFILE_START(print);
   print_final_hash(final_hash);
+  SHA1_PROFILE_STOP(SHA1_STAGE_PRINT, print);
 }
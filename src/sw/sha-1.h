@@ -1,18 +1,80 @@
 /***************************************************************************
 ****************************************************************************
-* Filename        : sha-1.cpp
+* Filename        : sha-1.h
 * Author          : Jishnu Murali Thampan
 * Description     : Interface of SHA-1 Alogrithm
-* 		            Note: This version does not support message sizes > 512 bytes
+* 		            Messages of any length are hashed through the
+* 		            streaming sha1_init/sha1_update/sha1_final API.
+* 		            At a block boundary the chaining state can be saved
+* 		            as a midstate and a context resumed from it later
 ****************************************************************************/
 
 #ifndef SHA1_HPP
 #define SHA1_HPP
 
-typedef unsigned char uint8_t;       /**< @brief Represents an empty string */
-typedef unsigned long long uint64_t; /**< @brief Represents an empty string */
-typedef unsigned int uint32_t;       /**< @brief Represents an empty string */
+#include <stddef.h>
+#include <stdint.h>
 
-void generate_sha1_hash();
+#define MESSAGE_SIZE                                                           \
+  (64) /**< @brief Represents the 8bit array size of one input block:          \
+          512/8 = 64*/
+#define FINAL_HASH_SIZE                                                        \
+  (                                                                            \
+      5) /**< @brief Represents the array size of Final Hash Message: 160/32   \
+            bits = 5  */
+#define SHA1_MIDSTATE_SIZE                                                     \
+  (28) /**< @brief Represents the bytes of a serialized midstate: five state \
+          words and the 64 bit byte count, big-endian */
+
+/**
+ * Streaming SHA-1 context. Carries the chaining state between blocks and
+ * buffers at most one partial block between calls to sha1_update().
+ */
+typedef struct sha1_ctx {
+  uint32_t state[FINAL_HASH_SIZE]; /**< @brief Chaining state H0..H4 */
+  uint64_t length;                 /**< @brief Total bytes consumed so far */
+  uint8_t buffer[MESSAGE_SIZE];    /**< @brief Pending partial block */
+  size_t buffered;                 /**< @brief Number of bytes in buffer */
+} sha1_ctx;
+
+/**
+ * Chaining state after a whole number of blocks, enough to continue the
+ * hash of any message starting with those blocks
+ */
+typedef struct sha1_midstate {
+  uint32_t state[FINAL_HASH_SIZE]; /**< @brief Chaining state H0..H4 */
+  uint64_t length;                 /**< @brief Bytes hashed, a multiple of 64 */
+} sha1_midstate;
+
+/**
+ * Block compression kernels the streaming API can run on
+ */
+typedef enum sha1_kernel {
+  SHA1_KERNEL_AUTO = 0, /**< @brief Fastest kernel the CPU supports */
+  SHA1_KERNEL_PORTABLE, /**< @brief perform_sha1_core, runs everywhere */
+  SHA1_KERNEL_AVX2,     /**< @brief Vectorized schedule, scalar rounds */
+  SHA1_KERNEL_SHANI,    /**< @brief x86 SHA extensions */
+  SHA1_KERNEL_COUNT     /**< @brief Number of entries, not a kernel */
+} sha1_kernel;
+
+int sha1_kernel_supported(sha1_kernel kernel);
+int sha1_set_kernel(sha1_kernel kernel);
+sha1_kernel sha1_get_kernel(void);
+const char *sha1_kernel_name(sha1_kernel kernel);
+
+void sha1_init(sha1_ctx *ctx);
+void sha1_update(sha1_ctx *ctx, const void *data, size_t length);
+void sha1_final(sha1_ctx *ctx, uint32_t final_hash[]);
+void sha1_hash(const void *data, size_t length, uint32_t final_hash[]);
+
+int sha1_midstate_export(const sha1_ctx *ctx, sha1_midstate *midstate);
+void sha1_midstate_import(sha1_ctx *ctx, const sha1_midstate *midstate);
+void sha1_midstate_serialize(const sha1_midstate *midstate,
+                             uint8_t bytes[SHA1_MIDSTATE_SIZE]);
+int sha1_midstate_deserialize(const uint8_t bytes[SHA1_MIDSTATE_SIZE],
+                              sha1_midstate *midstate);
+
+void print_final_hash(const uint32_t final_hash[]);
+void generate_sha1_hash(uint32_t final_hash[]);
 
 #endif /* SHA1_HPP */
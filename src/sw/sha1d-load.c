@@ -0,0 +1,298 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha1d-load.c
+* Author          : Jishnu Murali Thampan
+* Description     : Load generator for sha1d. Every connection runs on its
+* 		              own thread and keeps a window of requests in flight;
+* 		              the time from sending a request to its reply is its
+* 		              latency. Reports the p50/p99/p99.9 latency and the
+* 		              aggregate throughput, so the batch size and deadline
+* 		              of the daemon can be traded off against each other.
+*
+* Build           : cc -O2 -pthread -o sha1d-load sha1d-load.c sha-1.c
+* 		              sha-1-x86.c
+* Usage           : sha1d-load [-s socket] [-c connections] [-n requests]
+* 		              [-m bytes] [-w window] [-v]
+****************************************************************************/
+
+#define _GNU_SOURCE /**< @brief For clock_gettime() and CMSG_* */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha1d.h"
+
+#define LOAD_MAX_CONNECTIONS                                                   \
+  (1024) /**< @brief Represents the most connections of one run */
+
+/**
+ * Parameters shared by all connections
+ */
+typedef struct load_config {
+  const char *path; /**< @brief Socket of the daemon */
+  size_t requests;  /**< @brief Requests per connection */
+  size_t length;    /**< @brief Bytes per message */
+  size_t window;    /**< @brief Requests in flight per connection */
+  int verify;       /**< @brief Check every digest */
+} load_config;
+
+/**
+ * One connection and its measurements
+ */
+typedef struct load_connection {
+  const load_config *config; /**< @brief Shared parameters */
+  unsigned seed;             /**< @brief Message contents */
+  uint64_t *latency;         /**< @brief Nanoseconds per request */
+  size_t completed;          /**< @brief Entries in latency */
+  size_t mismatches;         /**< @brief Wrong digests */
+  int error;                 /**< @brief errno of a failure, or 0 */
+} load_connection;
+
+/**
+ * Returns the monotonic time in nanoseconds
+ * @param  None
+ * @return Current time
+ */
+static uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+/**
+ * Connects to the daemon and maps the region it sends
+ * @param[in]  path   Socket of the daemon
+ * @param[out] region Shared slots
+ * @return Socket, -1 with errno set on failure
+ */
+static int load_connect(const char *path, sha1d_slot **region) {
+  union {
+    struct cmsghdr header;
+    char space[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct sockaddr_un address;
+  sha1d_hello hello;
+  struct iovec iov = {&hello, sizeof(hello)};
+  struct msghdr message;
+  int fd, memory = -1;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    goto fail;
+
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.space;
+  message.msg_controllen = sizeof(control.space);
+  if (recvmsg(fd, &message, MSG_CMSG_CLOEXEC) != sizeof(hello) ||
+      CMSG_FIRSTHDR(&message) == NULL ||
+      CMSG_FIRSTHDR(&message)->cmsg_type != SCM_RIGHTS) {
+    errno = EPROTO;
+    goto fail;
+  }
+  memcpy(&memory, CMSG_DATA(CMSG_FIRSTHDR(&message)), sizeof(int));
+  if (hello.slots != SHA1D_SLOTS || hello.slot_size != SHA1D_SLOT_SIZE) {
+    errno = EPROTO;
+    goto fail;
+  }
+  *region = mmap(NULL, SHA1D_SLOTS * sizeof(sha1d_slot),
+                 PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+  if (*region == MAP_FAILED)
+    goto fail;
+  close(memory);
+  return fd;
+
+fail:
+  if (memory >= 0)
+    close(memory);
+  if (fd >= 0)
+    close(fd);
+  return -1;
+}
+/**
+ * Thread of one connection: keeps the window full until all requests of
+ * the connection have been answered
+ * @param[in,out] arg Connection
+ * @return NULL
+ */
+static void *load_run(void *arg) {
+  load_connection *connection = (load_connection *)arg;
+  const load_config *config = connection->config;
+  uint32_t expected[SHA1D_SLOTS][FINAL_HASH_SIZE];
+  uint64_t sent_at[SHA1D_SLOTS];
+  uint32_t free_slot[SHA1D_SLOTS];
+  size_t free_count = 0, sent = 0;
+  sha1d_slot *region;
+  int fd = load_connect(config->path, &region);
+
+  if (fd < 0) {
+    connection->error = errno;
+    return NULL;
+  }
+  for (uint32_t s = 0; s < config->window; s++) {
+    for (size_t i = 0; i < config->length; i++) {
+      region[s].data[i] = (uint8_t)rand_r(&connection->seed);
+    }
+    region[s].length = (uint32_t)config->length;
+    if (config->verify)
+      sha1_hash(region[s].data, config->length, expected[s]);
+    free_slot[free_count++] = s;
+  }
+
+  while (connection->completed < config->requests) {
+    while (free_count > 0 && sent < config->requests) {
+      const sha1d_message request = {free_slot[--free_count], SHA1D_OK};
+      sent_at[request.slot] = now_ns();
+      if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) !=
+          sizeof(request)) {
+        connection->error = errno;
+        goto done;
+      }
+      sent++;
+    }
+
+    sha1d_message reply;
+    if (recv(fd, &reply, sizeof(reply), 0) != sizeof(reply) ||
+        reply.slot >= config->window) {
+      connection->error = (errno != 0) ? (errno) : (EPROTO);
+      goto done;
+    }
+    connection->latency[connection->completed++] =
+        now_ns() - sent_at[reply.slot];
+    if (reply.status != SHA1D_OK ||
+        (config->verify && memcmp(region[reply.slot].final_hash,
+                                  expected[reply.slot],
+                                  sizeof(expected[reply.slot])) != 0))
+      connection->mismatches++;
+    free_slot[free_count++] = reply.slot;
+  }
+
+done:
+  munmap(region, SHA1D_SLOTS * sizeof(sha1d_slot));
+  close(fd);
+  return NULL;
+}
+/**
+ * Orders latencies ascending
+ * @param[in] lhs First latency
+ * @param[in] rhs Second latency
+ * @return <0, 0 or >0
+ */
+static int compare_latency(const void *lhs, const void *rhs) {
+  const uint64_t a = *(const uint64_t *)lhs;
+  const uint64_t b = *(const uint64_t *)rhs;
+  return (a > b) - (a < b);
+}
+/**
+ * Prints the command line usage
+ * @param  None
+ * @return void
+ */
+static void print_usage(void) {
+  fprintf(stderr,
+          "Usage: sha1d-load [-s socket] [-c connections] [-n requests] "
+          "[-m bytes] [-w window] [-v]\n"
+          "  -s PATH  socket of the daemon (default: %s)\n"
+          "  -c N     concurrent connections (default: 16)\n"
+          "  -n N     requests per connection (default: 100000)\n"
+          "  -m N     bytes per message, at most %d (default: 64)\n"
+          "  -w N     requests in flight per connection, at most %d "
+          "(default: 1)\n"
+          "  -v       check every digest\n",
+          SHA1D_SOCKET_PATH, SHA1D_SLOT_SIZE, SHA1D_SLOTS);
+}
+
+int main(int argc, char *argv[]) {
+  load_config config = {SHA1D_SOCKET_PATH, 100000, 64, 1, 0};
+  size_t connections = 16, total = 0, mismatches = 0;
+  static load_connection connection[LOAD_MAX_CONNECTIONS];
+  static pthread_t thread[LOAD_MAX_CONNECTIONS];
+  uint64_t *latency;
+  double seconds;
+  uint64_t start;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      config.path = argv[++i];
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      connections = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      config.requests = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      config.length = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      config.window = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      config.verify = 1;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  if (connections == 0 || connections > LOAD_MAX_CONNECTIONS ||
+      config.length > SHA1D_SLOT_SIZE || config.window == 0 ||
+      config.window > SHA1D_SLOTS) {
+    print_usage();
+    return 1;
+  }
+
+  latency = malloc(connections * config.requests * sizeof(uint64_t));
+  if (latency == NULL) {
+    fprintf(stderr, "sha1d-load: out of memory\n");
+    return 1;
+  }
+  start = now_ns();
+  for (size_t c = 0; c < connections; c++) {
+    connection[c].config = &config;
+    connection[c].seed = (unsigned)c + 1;
+    connection[c].latency = latency + c * config.requests;
+    if (pthread_create(&thread[c], NULL, load_run, &connection[c]) != 0) {
+      fprintf(stderr, "sha1d-load: cannot start thread %zu\n", c);
+      return 1;
+    }
+  }
+  for (size_t c = 0; c < connections; c++) {
+    pthread_join(thread[c], NULL);
+  }
+  seconds = (double)(now_ns() - start) * 1e-9;
+
+  /* Gather the latencies of all connections at the front */
+  for (size_t c = 0; c < connections; c++) {
+    if (connection[c].error != 0)
+      fprintf(stderr, "sha1d-load: connection %zu: %s\n", c,
+              strerror(connection[c].error));
+    memmove(latency + total, connection[c].latency,
+            connection[c].completed * sizeof(uint64_t));
+    total += connection[c].completed;
+    mismatches += connection[c].mismatches;
+  }
+  if (total == 0) {
+    fprintf(stderr, "sha1d-load: no request completed\n");
+    return 1;
+  }
+  qsort(latency, total, sizeof(uint64_t), compare_latency);
+
+  printf("%zu connections x %zu requests of %zu bytes, window %zu\n",
+         connections, config.requests, config.length, config.window);
+  printf("latency: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+         latency[total / 2] * 1e-3, latency[total * 99 / 100] * 1e-3,
+         latency[total * 999 / 1000] * 1e-3, latency[total - 1] * 1e-3);
+  printf("throughput: %.0f requests/s, %.1f MB/s, %zu wrong digests\n",
+         total / seconds, total * (double)config.length / seconds * 1e-6,
+         mismatches);
+  free(latency);
+  return (mismatches == 0 && total == connections * config.requests)
+             ? (EXIT_SUCCESS)
+             : (EXIT_FAILURE);
+}
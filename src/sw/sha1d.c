@@ -0,0 +1,391 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha1d.c
+* Author          : Jishnu Murali Thampan
+* Description     : Local hashing daemon. Requests of all clients are
+* 		              collected into one batch which is hashed on the
+* 		              multi-buffer lanes as soon as it is full, or when the
+* 		              oldest request in it has waited for the deadline.
+* 		              Messages are hashed straight from the shared region
+* 		              of their client; see sha1d.h for the protocol. One
+* 		              thread serves everything through epoll, a timerfd
+* 		              keeps the deadline to the microsecond.
+*
+* Build           : cc -O2 -o sha1d sha1d.c sha-1-mb.c sha-1.c sha-1-x86.c
+* Usage           : sha1d [-s socket] [-l lanes] [-b batch] [-d deadline_us]
+****************************************************************************/
+
+#define _GNU_SOURCE /**< @brief For memfd_create() and accept4() */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha-1-mb.h"
+#include "sha1d.h"
+
+#define SHA1D_DEFAULT_DEADLINE_US                                              \
+  (50) /**< @brief Represents the default wait of the oldest request [us] */
+#define SHA1D_MAX_BATCH                                                        \
+  (256) /**< @brief Represents the largest batch that can be configured */
+#define SHA1D_MAX_EVENTS                                                       \
+  (64) /**< @brief Represents the epoll events handled per wakeup */
+
+/**
+ * Connection of one client
+ */
+typedef struct sha1d_client {
+  int fd;                    /**< @brief Socket, -1 once disconnected */
+  sha1d_slot *region;        /**< @brief Slots shared with the client */
+  size_t pending;            /**< @brief Requests in the current batch */
+  struct sha1d_client *next; /**< @brief Next client to be freed */
+} sha1d_client;
+
+/**
+ * Daemon state
+ */
+typedef struct sha1d_server {
+  int listener;                           /**< @brief Listening socket */
+  int epoll;                              /**< @brief Event loop */
+  int timer;                              /**< @brief Deadline of the batch */
+  size_t lanes;                           /**< @brief Multi-buffer lanes */
+  size_t batch_size;                      /**< @brief Requests per batch */
+  uint64_t deadline_ns;                   /**< @brief Wait of the oldest */
+  sha1_job job[SHA1D_MAX_BATCH];          /**< @brief Current batch */
+  sha1d_client *client[SHA1D_MAX_BATCH];  /**< @brief Owner of each job */
+  uint32_t slot[SHA1D_MAX_BATCH];         /**< @brief Slot of each job */
+  size_t count;                           /**< @brief Jobs in the batch */
+  uint64_t requests;                      /**< @brief Requests hashed */
+  uint64_t batches;                       /**< @brief Batches hashed */
+  uint64_t full;                          /**< @brief Batches that were full */
+  sha1d_client *released;                 /**< @brief Freed after the events */
+} sha1d_server;
+
+static volatile sig_atomic_t stop; /**< @brief Set by SIGINT and SIGTERM */
+
+/**
+ * Signal handler asking the event loop to stop
+ * @param[in] signal_number Unused
+ * @return void
+ */
+static void request_stop(int signal_number) {
+  (void)signal_number;
+  stop = 1;
+}
+/**
+ * Queues a client to be freed once it is disconnected and none of its
+ * slots is still part of the batch. Freeing waits for the end of the
+ * current events, which may still refer to it.
+ * @param[in,out] server Daemon
+ * @param[in,out] client Client
+ * @return void
+ */
+static void client_release(sha1d_server *server, sha1d_client *client) {
+  if (client->fd >= 0 || client->pending > 0)
+    return;
+  client->next = server->released;
+  server->released = client;
+}
+/**
+ * Disconnects a client
+ * @param[in,out] server Daemon
+ * @param[in,out] client Client
+ * @return void
+ */
+static void client_close(sha1d_server *server, sha1d_client *client) {
+  epoll_ctl(server->epoll, EPOLL_CTL_DEL, client->fd, NULL);
+  close(client->fd);
+  client->fd = -1;
+  client_release(server, client);
+}
+/**
+ * Accepts a client and hands it its shared region
+ * @param[in,out] server Daemon
+ * @return void
+ */
+static void client_accept(sha1d_server *server) {
+  const size_t region_size = SHA1D_SLOTS * sizeof(sha1d_slot);
+  const sha1d_hello hello = {SHA1D_SLOTS, SHA1D_SLOT_SIZE};
+  union {
+    struct cmsghdr header;
+    char space[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct iovec iov = {(void *)&hello, sizeof(hello)};
+  struct msghdr message;
+  struct epoll_event event;
+  sha1d_client *client;
+  int fd, memory;
+
+  fd = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0)
+    return;
+  client = calloc(1, sizeof(*client));
+  memory = memfd_create("sha1d", MFD_CLOEXEC);
+  if (client == NULL || memory < 0 || ftruncate(memory, region_size) < 0 ||
+      (client->region = mmap(NULL, region_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, memory, 0)) == MAP_FAILED) {
+    fprintf(stderr, "sha1d: cannot set up a client: %s\n", strerror(errno));
+    goto fail;
+  }
+
+  memset(&message, 0, sizeof(message));
+  memset(&control, 0, sizeof(control));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.space;
+  message.msg_controllen = sizeof(control.space);
+  CMSG_FIRSTHDR(&message)->cmsg_level = SOL_SOCKET;
+  CMSG_FIRSTHDR(&message)->cmsg_type = SCM_RIGHTS;
+  CMSG_FIRSTHDR(&message)->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(CMSG_FIRSTHDR(&message)), &memory, sizeof(int));
+  if (sendmsg(fd, &message, MSG_NOSIGNAL) != sizeof(hello))
+    goto fail;
+  close(memory);
+
+  client->fd = fd;
+  event.events = EPOLLIN;
+  event.data.ptr = client;
+  if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+    client_close(server, client);
+  }
+  return;
+
+fail:
+  if (client != NULL && client->region != NULL &&
+      client->region != MAP_FAILED)
+    munmap(client->region, region_size);
+  if (memory >= 0)
+    close(memory);
+  free(client);
+  close(fd);
+}
+/**
+ * Sends the reply to a request; a client that lets its replies pile up
+ * beyond its window is disconnected
+ * @param[in,out] server Daemon
+ * @param[in,out] client Client
+ * @param[in]     slot   Slot of the request
+ * @param[in]     status SHA1D_OK or SHA1D_INVALID
+ * @return void
+ */
+static void client_reply(sha1d_server *server, sha1d_client *client,
+                         uint32_t slot, uint32_t status) {
+  const sha1d_message reply = {slot, status};
+
+  if (send(client->fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) !=
+      sizeof(reply))
+    client_close(server, client);
+}
+/**
+ * Arms or disarms the deadline timer
+ * @param[in] server  Daemon
+ * @param[in] timeout Nanoseconds from now, 0 to disarm
+ * @return void
+ */
+static void set_deadline(const sha1d_server *server, uint64_t timeout) {
+  struct itimerspec deadline;
+
+  memset(&deadline, 0, sizeof(deadline));
+  deadline.it_value.tv_sec = (time_t)(timeout / 1000000000u);
+  deadline.it_value.tv_nsec = (long)(timeout % 1000000000u);
+  timerfd_settime(server->timer, 0, &deadline, NULL);
+}
+/**
+ * Hashes the batch and replies to every request in it
+ * @param[in,out] server Daemon
+ * @return void
+ */
+static void batch_flush(sha1d_server *server) {
+  if (server->count == 0)
+    return;
+  set_deadline(server, 0);
+  sha1_hash_batch_lanes(server->job, server->count, server->lanes);
+
+  server->requests += server->count;
+  server->batches++;
+  server->full += (server->count == server->batch_size);
+  for (size_t i = 0; i < server->count; i++) {
+    sha1d_client *client = server->client[i];
+    client->pending--;
+    if (client->fd < 0) {
+      client_release(server, client);
+      continue;
+    }
+    memcpy(client->region[server->slot[i]].final_hash,
+           server->job[i].final_hash, sizeof(server->job[i].final_hash));
+    client_reply(server, client, server->slot[i], SHA1D_OK);
+  }
+  server->count = 0;
+}
+/**
+ * Adds a request to the batch, hashing the batch once it is full
+ * @param[in,out] server  Daemon
+ * @param[in,out] client  Client
+ * @param[in]     request Request
+ * @return void
+ */
+static void batch_add(sha1d_server *server, sha1d_client *client,
+                      const sha1d_message *request) {
+  /* The client may rewrite the slot meanwhile: read the length once */
+  const uint32_t length =
+      (request->slot < SHA1D_SLOTS)
+          ? (__atomic_load_n(&client->region[request->slot].length,
+                             __ATOMIC_RELAXED))
+          : (0);
+
+  if (request->slot >= SHA1D_SLOTS || length > SHA1D_SLOT_SIZE) {
+    client_reply(server, client, request->slot, SHA1D_INVALID);
+    return;
+  }
+  if (server->count == 0)
+    set_deadline(server, server->deadline_ns);
+
+  server->job[server->count].data = client->region[request->slot].data;
+  server->job[server->count].length = length;
+  server->client[server->count] = client;
+  server->slot[server->count] = request->slot;
+  server->count++;
+  client->pending++;
+  if (server->count >= server->batch_size)
+    batch_flush(server);
+}
+/**
+ * Reads all requests a client has sent
+ * @param[in,out] server Daemon
+ * @param[in,out] client Client
+ * @return void
+ */
+static void client_receive(sha1d_server *server, sha1d_client *client) {
+  sha1d_message request;
+  ssize_t got;
+
+  while (client->fd >= 0) {
+    got = recv(client->fd, &request, sizeof(request), MSG_DONTWAIT);
+    if (got == sizeof(request)) {
+      batch_add(server, client, &request);
+    } else if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else if (got < 0 && errno == EINTR) {
+      continue;
+    } else {
+      client_close(server, client);
+    }
+  }
+}
+/**
+ * Prints the command line usage
+ * @param  None
+ * @return void
+ */
+static void print_usage(void) {
+  fprintf(stderr,
+          "Usage: sha1d [-s socket] [-l lanes] [-b batch] [-d deadline_us]\n"
+          "  -s PATH  Unix socket to listen on (default: %s)\n"
+          "  -l N     multi-buffer lanes, 4, 8 or 16 (default: widest)\n"
+          "  -b N     requests per batch, at most %d (default: lanes)\n"
+          "  -d US    longest wait of a request for its batch (default: %d)\n",
+          SHA1D_SOCKET_PATH, SHA1D_MAX_BATCH, SHA1D_DEFAULT_DEADLINE_US);
+}
+
+int main(int argc, char *argv[]) {
+  static sha1d_server server;
+  const char *path = SHA1D_SOCKET_PATH;
+  struct sockaddr_un address;
+  struct epoll_event event, events[SHA1D_MAX_EVENTS];
+  struct sigaction action;
+
+  server.lanes = sha1_mb_max_lanes();
+  server.deadline_ns = SHA1D_DEFAULT_DEADLINE_US * 1000u;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      server.lanes = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      server.batch_size = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      server.deadline_ns = strtoull(argv[++i], NULL, 10) * 1000u;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  if (server.batch_size == 0)
+    server.batch_size = server.lanes;
+  if (server.batch_size > SHA1D_MAX_BATCH)
+    server.batch_size = SHA1D_MAX_BATCH;
+  if (server.deadline_ns == 0)
+    server.deadline_ns = 1; /* 0 would disarm the timer */
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "sha1d: socket path too long\n");
+    return 1;
+  }
+  strcpy(address.sun_path, path);
+  unlink(path);
+  server.listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  server.epoll = epoll_create1(EPOLL_CLOEXEC);
+  server.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (server.listener < 0 || server.epoll < 0 || server.timer < 0 ||
+      bind(server.listener, (struct sockaddr *)&address, sizeof(address)) <
+          0 ||
+      listen(server.listener, SOMAXCONN) < 0) {
+    fprintf(stderr, "sha1d: %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  event.events = EPOLLIN;
+  event.data.ptr = &server.listener;
+  epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &event);
+  event.data.ptr = &server.timer;
+  epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.timer, &event);
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  fprintf(stderr, "sha1d: listening on %s, %zu lanes, %zu per batch, %llu us\n",
+          path, server.lanes, server.batch_size,
+          (unsigned long long)(server.deadline_ns / 1000u));
+
+  while (!stop) {
+    int ready = epoll_wait(server.epoll, events, SHA1D_MAX_EVENTS, -1);
+    for (int i = 0; i < ready; i++) {
+      if (events[i].data.ptr == &server.listener) {
+        client_accept(&server);
+      } else if (events[i].data.ptr == &server.timer) {
+        uint64_t expirations;
+        if (read(server.timer, &expirations, sizeof(expirations)) > 0)
+          batch_flush(&server);
+      } else {
+        client_receive(&server, (sha1d_client *)events[i].data.ptr);
+      }
+    }
+    while (server.released != NULL) {
+      sha1d_client *client = server.released;
+      server.released = client->next;
+      munmap(client->region, SHA1D_SLOTS * sizeof(sha1d_slot));
+      free(client);
+    }
+  }
+
+  batch_flush(&server);
+  unlink(path);
+  fprintf(stderr, "sha1d: %llu requests in %llu batches, %.1f per batch, "
+                  "%llu full\n",
+          (unsigned long long)server.requests,
+          (unsigned long long)server.batches,
+          (server.batches > 0) ? ((double)server.requests / server.batches)
+                               : (0.0),
+          (unsigned long long)server.full);
+  return 0;
+}
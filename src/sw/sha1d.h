@@ -0,0 +1,56 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha1d.h
+* Author          : Jishnu Murali Thampan
+* Description     : Protocol of the local hashing daemon. A client connects
+* 		            to a SOCK_SEQPACKET Unix socket and receives a shared
+* 		            memory region of slots with its first message. It
+* 		            writes a message into a free slot and sends the slot
+* 		            number; the daemon hashes the slot in place, puts the
+* 		            digest next to it and sends the slot number back.
+* 		            Payloads never pass through the socket.
+****************************************************************************/
+
+#ifndef SHA1D_HPP
+#define SHA1D_HPP
+
+#include <stdint.h>
+#include "sha-1.h"
+
+#define SHA1D_SOCKET_PATH                                                      \
+  "/tmp/sha1d.sock" /**< @brief Represents the default socket of the daemon */
+#define SHA1D_SLOTS                                                            \
+  (64) /**< @brief Represents the slots of one client, its request window */
+#define SHA1D_SLOT_SIZE                                                        \
+  (64 * 1024) /**< @brief Represents the largest message of one request */
+
+#define SHA1D_OK (0)       /**< @brief Represents a hashed request */
+#define SHA1D_INVALID (1)  /**< @brief Represents a bad slot or length */
+
+/**
+ * One slot of the shared region
+ */
+typedef struct sha1d_slot {
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Written by the daemon */
+  uint32_t length;                      /**< @brief Bytes in data */
+  uint8_t reserved[40];                 /**< @brief Keeps data aligned */
+  uint8_t data[SHA1D_SLOT_SIZE];        /**< @brief Message */
+} sha1d_slot;
+
+/**
+ * First message of the daemon, carries the region descriptor
+ */
+typedef struct sha1d_hello {
+  uint32_t slots;     /**< @brief Slots in the region */
+  uint32_t slot_size; /**< @brief SHA1D_SLOT_SIZE of the daemon */
+} sha1d_hello;
+
+/**
+ * Request of a client, and the reply of the daemon to it
+ */
+typedef struct sha1d_message {
+  uint32_t slot;   /**< @brief Slot the message is in */
+  uint32_t status; /**< @brief SHA1D_OK or SHA1D_INVALID in replies */
+} sha1d_message;
+
+#endif /* SHA1D_HPP */
@@ -0,0 +1,89 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha1search.c
+* Author          : Jishnu Murali Thampan
+* Description     : Searches for a nonce that gives SHA-1(prefix || nonce)
+* 		              the requested number of leading zero bits, e.g.
+* 		                sha1search -b 28 "block 1234:"
+* 		              The nonce and the digest go to stdout, the hash rate
+* 		              to stderr. With a count and an unreachable target the
+* 		              tool measures the raw rate of the search kernels:
+* 		                sha1search -b 160 -n 100000000 "x"
+*
+* Build           : cc -O2 -pthread -o sha1search sha1search.c sha-1-search.c
+* 		              sha-1-mb.c sha-1.c sha-1-x86.c thread-pool.c
+* Usage           : sha1search [-b bits] [-t threads] [-l lanes] [-s start]
+* 		              [-n count] PREFIX
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha-1-search.h"
+
+/**
+ * Prints the command line usage
+ * @param  None
+ * @return void
+ */
+static void print_usage(void) {
+  fprintf(stderr,
+          "Usage: sha1search [-b bits] [-t threads] [-l lanes] [-s start] "
+          "[-n count] PREFIX\n"
+          "  -b N  leading zero bits of the digest, at most %d "
+          "(default: 24)\n"
+          "  -t N  worker threads (default: one per CPU)\n"
+          "  -l N  lanes per thread, 4, 8 or 16 (default: widest)\n"
+          "  -s N  first nonce (default: 0)\n"
+          "  -n N  nonces to try (default: until found)\n"
+          "The nonce is appended to PREFIX as %d big-endian bytes.\n",
+          SHA1_SEARCH_MAX_BITS, SHA1_SEARCH_NONCE_SIZE);
+}
+
+int main(int argc, char *argv[]) {
+  sha1_search_params params = {24, 0, 0, 0, 0};
+  sha1_search_result result;
+  const char *prefix = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      params.bits = (unsigned)strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      params.threads = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      params.lanes = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      params.start = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      params.count = strtoull(argv[++i], NULL, 0);
+    } else if (argv[i][0] != '-' && prefix == NULL) {
+      prefix = argv[i];
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  if (prefix == NULL || params.bits > SHA1_SEARCH_MAX_BITS) {
+    print_usage();
+    return 1;
+  }
+
+  if (sha1_search(prefix, strlen(prefix), &params, &result) != 0) {
+    fprintf(stderr, "sha1search: cannot start the search\n");
+    return 1;
+  }
+  if (result.found) {
+    printf("nonce %016llx  ", (unsigned long long)result.nonce);
+    for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+      printf("%08x", result.final_hash[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+  fprintf(stderr, "%llu hashes in %.3f s, %.2f Mhash/s%s\n",
+          (unsigned long long)result.hashes, result.seconds,
+          (result.seconds > 0) ? (result.hashes / result.seconds * 1e-6)
+                               : (0.0),
+          result.found ? ("") : (", no nonce found"));
+  return result.found ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}
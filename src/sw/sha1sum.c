@@ -0,0 +1,588 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : sha1sum.c
+* Author          : Jishnu Murali Thampan
+* Description     : sha1sum compatible tool hashing many files in parallel.
+* 		              Files are spread over a work-stealing thread pool,
+* 		              largest first, so one huge file does not hold up the
+* 		              run. Large files are mapped into memory, small ones
+* 		              are read into a per-thread buffer, pipes and devices
+* 		              are streamed with reads ahead. Output follows the
+* 		              order of the command line regardless of which file
+* 		              finishes first. With --cache, digests of unchanged
+* 		              regular files come from a persistent cache, so a
+* 		              repeated run only has to stat() them.
+*
+* Build           : cc -O2 -pthread -o sha1sum sha1sum.c thread-pool.c
+* 		              sha-1.c sha-1-x86.c sha-1-profile.c sha-1-cache.c
+* 		              sha-1-stream.c
+* 		              Adding -DSHA1_PROFILE prints the stage histograms of
+* 		              all threads to stderr at exit
+* Usage           : sha1sum [-b|-t] [-r] [-j threads] [--cache CACHE] [FILE]...
+* 		              sha1sum -c [--quiet|--status] [FILE]...
+****************************************************************************/
+
+#define _XOPEN_SOURCE 700 /**< @brief For nftw() and posix_madvise() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sha-1.h"
+#include "sha-1-cache.h"
+#include "sha-1-profile.h"
+#include "sha-1-stream.h"
+#include "thread-pool.h"
+
+#define SMALL_FILE_SIZE                                                        \
+  (64 * 1024) /**< @brief Represents the largest file hashed with read()     \
+                 instead of mmap() */
+#define HEX_DIGEST_SIZE                                                        \
+  (2 * 4 * FINAL_HASH_SIZE) /**< @brief Represents the hex digits of a hash */
+#define NFTW_MAX_OPEN_DIRS                                                     \
+  (64) /**< @brief Represents the directories nftw() may keep open */
+
+/**
+ * One input file and, once hashed, its result
+ */
+typedef struct file_entry {
+  char *path;                           /**< @brief Path as given/found */
+  off_t size;                           /**< @brief Size used for ordering */
+  uint32_t final_hash[FINAL_HASH_SIZE]; /**< @brief Computed digest */
+  uint32_t expected[FINAL_HASH_SIZE];   /**< @brief Digest to verify (-c) */
+  int error;                            /**< @brief errno of a failure, or 0 */
+  int done;                             /**< @brief Set once hashed */
+} file_entry;
+
+/**
+ * Growable list of input files
+ */
+typedef struct file_list {
+  file_entry *entries; /**< @brief Entries in output order */
+  size_t count;        /**< @brief Number of entries */
+  size_t capacity;     /**< @brief Allocated entries */
+} file_list;
+
+static file_list inputs; /**< @brief All files of this run */
+static sha1_cache *cache; /**< @brief Digests of earlier runs, or NULL */
+static pthread_mutex_t done_lock =
+    PTHREAD_MUTEX_INITIALIZER; /**< @brief Protects file_entry::done */
+static pthread_cond_t done_changed =
+    PTHREAD_COND_INITIALIZER; /**< @brief Signalled when a file is hashed */
+
+/**
+ * Appends a file to the input list
+ * @param[in] path Path of the file, copied
+ * @param[in] size Size of the file, or 0 if unknown
+ * @return Entry or NULL if out of memory
+ */
+static file_entry *add_input(const char *path, off_t size) {
+  if (inputs.count == inputs.capacity) {
+    size_t capacity = (inputs.capacity > 0) ? (2 * inputs.capacity) : (256);
+    file_entry *entries =
+        realloc(inputs.entries, capacity * sizeof(file_entry));
+    if (entries == NULL)
+      return NULL;
+    inputs.entries = entries;
+    inputs.capacity = capacity;
+  }
+  file_entry *entry = &inputs.entries[inputs.count];
+  memset(entry, 0, sizeof(*entry));
+  entry->path = strdup(path);
+  if (entry->path == NULL)
+    return NULL;
+  entry->size = size;
+  inputs.count++;
+  return entry;
+}
+/**
+ * nftw() callback collecting the regular files below a directory
+ * @param[in] path   Path of the visited object
+ * @param[in] info   Its status
+ * @param[in] type   Object type
+ * @param[in] ftw    Unused
+ * @return 0 to continue the walk, -1 to abort it
+ */
+static int collect_file(const char *path, const struct stat *info, int type,
+                        struct FTW *ftw) {
+  (void)ftw;
+  if (type == FTW_F && S_ISREG(info->st_mode))
+    return (add_input(path, info->st_size) != NULL) ? (0) : (-1);
+  if (type == FTW_DNR || type == FTW_NS)
+    fprintf(stderr, "sha1sum: %s: cannot read\n", path);
+  return 0;
+}
+/**
+ * Orders entries by path so that recursive walks print deterministically
+ * @param[in] lhs First entry
+ * @param[in] rhs Second entry
+ * @return <0, 0 or >0
+ */
+static int compare_paths(const void *lhs, const void *rhs) {
+  return strcmp(((const file_entry *)lhs)->path,
+                ((const file_entry *)rhs)->path);
+}
+/**
+ * Orders entry pointers by size, largest first
+ * @param[in] lhs First entry pointer
+ * @param[in] rhs Second entry pointer
+ * @return <0, 0 or >0
+ */
+static int compare_sizes(const void *lhs, const void *rhs) {
+  const off_t a = (*(file_entry *const *)lhs)->size;
+  const off_t b = (*(file_entry *const *)rhs)->size;
+  return (a < b) - (a > b);
+}
+/**
+ * Hashes everything that can be read from a descriptor, reading ahead
+ * while hashing
+ * @param[in]  fd         Descriptor
+ * @param[out] final_hash Digest
+ * @return 0 on success, errno on failure
+ */
+static int hash_stream(int fd, uint32_t final_hash[]) {
+  return sha1_hash_fd(fd, NULL, final_hash, NULL);
+}
+static __thread sigjmp_buf *mapping_fault; /**< @brief Return point of a
+                                              SIGBUS in the mapping being
+                                              hashed by this thread */
+
+/**
+ * SIGBUS handler. A file truncated while it is mapped faults on the pages
+ * past its new end; the faulting thread returns to hash_regular_file().
+ * Any other SIGBUS still terminates the process.
+ * @param[in] signal Signal number
+ * @return void
+ */
+static void mapping_fault_handler(int signal) {
+  if (mapping_fault != NULL)
+    siglongjmp(*mapping_fault, 1);
+  sigaction(signal, &(struct sigaction){.sa_handler = SIG_DFL}, NULL);
+  raise(signal);
+}
+/**
+ * Hashes a regular file: small files with a single read(), large ones
+ * straight from a read-only mapping. A mapped file that shrinks meanwhile
+ * is reported as a read error instead of killing the run.
+ * @param[in]  fd         Descriptor of the file
+ * @param[in]  size       Size of the file
+ * @param[out] final_hash Digest
+ * @return 0 on success, errno on failure
+ */
+static int hash_regular_file(int fd, off_t size, uint32_t final_hash[]) {
+  static __thread uint8_t small_file[SMALL_FILE_SIZE + 1];
+
+  if (size <= SMALL_FILE_SIZE) {
+    size_t length = 0;
+    ssize_t got;
+    /* One byte more than expected tells a file that grew meanwhile */
+    while (length < sizeof(small_file) &&
+           (got = read(fd, small_file + length, sizeof(small_file) - length)) !=
+               0) {
+      if (got < 0) {
+        if (errno == EINTR)
+          continue;
+        return errno;
+      }
+      length += (size_t)got;
+    }
+    if (length <= SMALL_FILE_SIZE) {
+      sha1_hash(small_file, length, final_hash);
+      return 0;
+    }
+    if (lseek(fd, 0, SEEK_SET) < 0)
+      return errno;
+    return hash_stream(fd, final_hash);
+  }
+
+  void *mapping = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED)
+    return hash_stream(fd, final_hash);
+  posix_madvise(mapping, (size_t)size, POSIX_MADV_SEQUENTIAL);
+  sigjmp_buf fault;
+  if (sigsetjmp(fault, 1) != 0) {
+    mapping_fault = NULL;
+    munmap(mapping, (size_t)size);
+    return EIO;
+  }
+  mapping_fault = &fault;
+  sha1_hash(mapping, (size_t)size, final_hash);
+  mapping_fault = NULL;
+  munmap(mapping, (size_t)size);
+  return 0;
+}
+/**
+ * Checks that a file was not modified while it was hashed
+ * @param[in] before Status taken before reading it
+ * @param[in] after  Status taken after reading it
+ * @return 1 if unchanged, 0 otherwise
+ */
+static int is_unchanged(const struct stat *before, const struct stat *after) {
+  return before->st_dev == after->st_dev && before->st_ino == after->st_ino &&
+         before->st_size == after->st_size &&
+         before->st_mtim.tv_sec == after->st_mtim.tv_sec &&
+         before->st_mtim.tv_nsec == after->st_mtim.tv_nsec &&
+         before->st_ctim.tv_sec == after->st_ctim.tv_sec &&
+         before->st_ctim.tv_nsec == after->st_ctim.tv_nsec;
+}
+/**
+ * Thread pool task: hashes one input file
+ * @param[in,out] arg File entry
+ * @return void
+ */
+static void hash_file_task(void *arg) {
+  file_entry *entry = (file_entry *)arg;
+  int is_stdin = (strcmp(entry->path, "-") == 0);
+  int fd = -1;
+  struct stat info, after;
+  int error = 0;
+
+  /* A cache hit needs no open() */
+  if (cache != NULL && !is_stdin && stat(entry->path, &info) == 0 &&
+      sha1_cache_lookup(cache, &info, entry->final_hash)) {
+    /* Digest of an unchanged file from an earlier run */
+  } else if ((fd = is_stdin ? STDIN_FILENO : open(entry->path, O_RDONLY)) <
+             0) {
+    error = errno;
+  } else if (fstat(fd, &info) < 0) {
+    error = errno;
+  } else if (S_ISDIR(info.st_mode)) {
+    error = EISDIR;
+  } else if (S_ISREG(info.st_mode)) {
+    error = hash_regular_file(fd, info.st_size, entry->final_hash);
+    if (error == 0 && cache != NULL && fstat(fd, &after) == 0 &&
+        is_unchanged(&info, &after))
+      sha1_cache_store(cache, &info, entry->final_hash);
+  } else {
+    error = hash_stream(fd, entry->final_hash);
+  }
+  if (fd >= 0 && !is_stdin)
+    close(fd);
+
+  pthread_mutex_lock(&done_lock);
+  entry->error = error;
+  entry->done = 1;
+  pthread_cond_broadcast(&done_changed);
+  pthread_mutex_unlock(&done_lock);
+}
+/**
+ * Waits until an entry has been hashed
+ * @param[in] entry Entry
+ * @return void
+ */
+static void wait_for_entry(const file_entry *entry) {
+  pthread_mutex_lock(&done_lock);
+  while (!entry->done)
+    pthread_cond_wait(&done_changed, &done_lock);
+  pthread_mutex_unlock(&done_lock);
+}
+/**
+ * Formats a digest as lower case hex
+ * @param[in]  final_hash Digest
+ * @param[out] hex        HEX_DIGEST_SIZE + 1 characters
+ * @return void
+ */
+static void format_digest(const uint32_t final_hash[], char hex[]) {
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    sprintf(hex + 8 * i, "%08x", final_hash[i]);
+  }
+}
+/**
+ * Parses a hex digest
+ * @param[in]  hex        HEX_DIGEST_SIZE hex digits
+ * @param[out] final_hash Digest
+ * @return 0 on success, -1 if hex is malformed
+ */
+static int parse_digest(const char *hex, uint32_t final_hash[]) {
+  for (size_t i = 0; i < FINAL_HASH_SIZE; i++) {
+    uint32_t word = 0;
+    for (size_t j = 0; j < 8; j++) {
+      char digit = hex[8 * i + j];
+      word <<= 4;
+      if (digit >= '0' && digit <= '9')
+        word |= (uint32_t)(digit - '0');
+      else if (digit >= 'a' && digit <= 'f')
+        word |= (uint32_t)(digit - 'a' + 10);
+      else if (digit >= 'A' && digit <= 'F')
+        word |= (uint32_t)(digit - 'A' + 10);
+      else
+        return -1;
+    }
+    final_hash[i] = word;
+  }
+  return 0;
+}
+/**
+ * Prints a file name, escaping backslashes and newlines like GNU sha1sum
+ * @param[in] path File name
+ * @return void
+ */
+static void print_escaped(const char *path) {
+  for (; *path != '\0'; path++) {
+    if (*path == '\\')
+      fputs("\\\\", stdout);
+    else if (*path == '\n')
+      fputs("\\n", stdout);
+    else
+      putchar(*path);
+  }
+}
+/**
+ * Reverses print_escaped() in place
+ * @param[in,out] path Escaped file name
+ * @return void
+ */
+static void unescape(char *path) {
+  char *out = path;
+  for (; *path != '\0'; path++) {
+    if (*path == '\\' && path[1] == 'n') {
+      *out++ = '\n';
+      path++;
+    } else if (*path == '\\' && path[1] == '\\') {
+      *out++ = '\\';
+      path++;
+    } else {
+      *out++ = *path;
+    }
+  }
+  *out = '\0';
+}
+/**
+ * Reads a checksum list and queues its files for verification
+ * @param[in] list_path Checksum list, "-" for stdin
+ * @return Number of malformed lines, or -1 if the list cannot be read
+ */
+static long read_checksum_list(const char *list_path) {
+  FILE *list = (strcmp(list_path, "-") == 0) ? stdin : fopen(list_path, "r");
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t length;
+  long malformed = 0;
+
+  if (list == NULL) {
+    fprintf(stderr, "sha1sum: %s: %s\n", list_path, strerror(errno));
+    return -1;
+  }
+  while ((length = getline(&line, &line_size, list)) > 0) {
+    if (line[length - 1] == '\n')
+      line[--length] = '\0';
+    int escaped = (line[0] == '\\');
+    char *digest = line + escaped;
+    uint32_t expected[FINAL_HASH_SIZE];
+
+    /* "<digest>  <name>" or "<digest> *<name>" */
+    if (strlen(digest) < HEX_DIGEST_SIZE + 3 ||
+        parse_digest(digest, expected) != 0 ||
+        digest[HEX_DIGEST_SIZE] != ' ' ||
+        (digest[HEX_DIGEST_SIZE + 1] != ' ' &&
+         digest[HEX_DIGEST_SIZE + 1] != '*')) {
+      malformed++;
+      continue;
+    }
+    char *name = digest + HEX_DIGEST_SIZE + 2;
+    if (escaped)
+      unescape(name);
+
+    file_entry *entry = add_input(name, 0);
+    if (entry == NULL)
+      break;
+    memcpy(entry->expected, expected, sizeof(expected));
+  }
+  free(line);
+  if (list != stdin)
+    fclose(list);
+  return malformed;
+}
+/**
+ * Prints the command line usage
+ * @param  None
+ * @return void
+ */
+static void print_usage(void) {
+  fprintf(stderr,
+          "Usage: sha1sum [-b|-t] [-r] [-j threads] [--cache CACHE] "
+          "[FILE]...\n"
+          "       sha1sum -c [--quiet|--status] [-j threads] [FILE]...\n"
+          "  -b, --binary  mark files as read in binary mode\n"
+          "  -t, --text    mark files as read in text mode (default)\n"
+          "  -c, --check   verify the checksums listed in FILE\n"
+          "  -r            hash the regular files below directories\n"
+          "  -j N          use N threads (default: all CPUs)\n"
+          "  --cache CACHE reuse the digests of unchanged files stored in\n"
+          "                CACHE, and store the new ones\n"
+          "  --cache-ctime also require an unchanged ctime for a cache hit\n");
+}
+
+int main(int argc, char *argv[]) {
+  int binary = 0, check = 0, recursive = 0, quiet = 0, status_only = 0;
+  size_t threads = 0;
+  const char *cache_path = NULL;
+  int cache_flags = 0;
+  int files = 0;
+  int exit_status = 0;
+
+  /* Options may follow the files, as with GNU sha1sum; the files are
+     moved to argv[1 .. files] in their order. After "--" every argument
+     is a file, even one starting with '-'. */
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    if (strcmp(option, "--") == 0) {
+      while (++i < argc)
+        argv[1 + files++] = argv[i];
+      break;
+    } else if (strcmp(option, "-b") == 0 || strcmp(option, "--binary") == 0) {
+      binary = 1;
+    } else if (strcmp(option, "-t") == 0 || strcmp(option, "--text") == 0) {
+      binary = 0;
+    } else if (strcmp(option, "-c") == 0 || strcmp(option, "--check") == 0) {
+      check = 1;
+    } else if (strcmp(option, "--quiet") == 0) {
+      quiet = 1;
+    } else if (strcmp(option, "--status") == 0) {
+      status_only = 1;
+    } else if (strcmp(option, "-r") == 0) {
+      recursive = 1;
+    } else if (strcmp(option, "-j") == 0 && i + 1 < argc) {
+      threads = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(option, "--cache") == 0 && i + 1 < argc) {
+      cache_path = argv[++i];
+    } else if (strcmp(option, "--cache-ctime") == 0) {
+      cache_flags |= SHA1_CACHE_CTIME;
+    } else if (option[0] == '-' && option[1] != '\0') {
+      print_usage();
+      return 1;
+    } else {
+      argv[1 + files++] = argv[i];
+    }
+  }
+
+  /* Collect the inputs in output order */
+  long malformed = 0;
+  if (files == 0) {
+    if (check)
+      malformed = read_checksum_list("-");
+    else
+      add_input("-", 0);
+  }
+  for (int i = 1; i <= files; i++) {
+    struct stat info;
+    if (check) {
+      long result = read_checksum_list(argv[i]);
+      if (result < 0)
+        exit_status = 1;
+      else
+        malformed += result;
+    } else if (recursive && stat(argv[i], &info) == 0 &&
+               S_ISDIR(info.st_mode)) {
+      size_t first = inputs.count;
+      if (nftw(argv[i], collect_file, NFTW_MAX_OPEN_DIRS, FTW_PHYS) != 0) {
+        fprintf(stderr, "sha1sum: %s: %s\n", argv[i], strerror(errno));
+        exit_status = 1;
+      }
+      qsort(inputs.entries + first, inputs.count - first, sizeof(file_entry),
+            compare_paths);
+    } else {
+      off_t size = (strcmp(argv[i], "-") != 0 && stat(argv[i], &info) == 0)
+                       ? (info.st_size)
+                       : (0);
+      add_input(argv[i], size);
+    }
+  }
+
+  /* Without a usable cache every file is hashed */
+  if (cache_path != NULL &&
+      (cache = sha1_cache_open(cache_path, cache_flags)) == NULL)
+    fprintf(stderr, "sha1sum: %s: %s\n", cache_path, strerror(errno));
+
+  /* A mapped file truncated by someone else must not end the run */
+  struct sigaction on_fault = {.sa_handler = mapping_fault_handler};
+  sigemptyset(&on_fault.sa_mask);
+  sigaction(SIGBUS, &on_fault, NULL);
+
+  /* Start the largest files first so they do not finish last */
+  file_entry **order = malloc((inputs.count + 1) * sizeof(file_entry *));
+  thread_pool *pool = thread_pool_create(threads);
+  if (order == NULL || pool == NULL) {
+    fprintf(stderr, "sha1sum: cannot start worker threads\n");
+    return 1;
+  }
+  for (size_t i = 0; i < inputs.count; i++) {
+    order[i] = &inputs.entries[i];
+  }
+  qsort(order, inputs.count, sizeof(file_entry *), compare_sizes);
+  for (size_t i = 0; i < inputs.count; i++) {
+    if (thread_pool_submit(pool, hash_file_task, order[i]) != 0)
+      hash_file_task(order[i]);
+  }
+
+  /* Print in input order as soon as each result is available */
+  size_t mismatched = 0, unreadable = 0;
+  char hex[HEX_DIGEST_SIZE + 1];
+  for (size_t i = 0; i < inputs.count; i++) {
+    file_entry *entry = &inputs.entries[i];
+    wait_for_entry(entry);
+
+    if (entry->error != 0) {
+      fprintf(stderr, "sha1sum: %s: %s\n", entry->path,
+              strerror(entry->error));
+      if (check && !status_only)
+        printf("%s: FAILED open or read\n", entry->path);
+      unreadable++;
+      exit_status = 1;
+    } else if (check) {
+      int ok = (memcmp(entry->expected, entry->final_hash,
+                       sizeof(entry->final_hash)) == 0);
+      if (!ok) {
+        mismatched++;
+        exit_status = 1;
+      }
+      if (!status_only && !(ok && quiet))
+        printf("%s: %s\n", entry->path, ok ? "OK" : "FAILED");
+    } else {
+      int escape = (strpbrk(entry->path, "\\\n") != NULL);
+      format_digest(entry->final_hash, hex);
+      printf("%s%s %c", escape ? "\\" : "", hex, binary ? '*' : ' ');
+      if (escape)
+        print_escaped(entry->path);
+      else
+        fputs(entry->path, stdout);
+      putchar('\n');
+    }
+  }
+
+  fflush(stdout);
+  if (check && !status_only) {
+    if (malformed > 0)
+      fprintf(stderr, "sha1sum: WARNING: %ld line%s improperly formatted\n",
+              malformed, (malformed == 1) ? " is" : "s are");
+    if (unreadable > 0)
+      fprintf(stderr, "sha1sum: WARNING: %zu listed file%s could not be read\n",
+              unreadable, (unreadable == 1) ? "" : "s");
+    if (mismatched > 0)
+      fprintf(stderr,
+              "sha1sum: WARNING: %zu computed checksum%s did NOT match\n",
+              mismatched, (mismatched == 1) ? "" : "s");
+  }
+
+  thread_pool_destroy(pool);
+  sha1_cache_close(cache);
+#ifdef SHA1_PROFILE
+  sha1_profile_snapshot snapshot;
+  sha1_profile_snapshot_take(&snapshot);
+  sha1_profile_export(&snapshot, stderr);
+#endif
+  for (size_t i = 0; i < inputs.count; i++) {
+    free(inputs.entries[i].path);
+  }
+  free(inputs.entries);
+  free(order);
+  return exit_status;
+}
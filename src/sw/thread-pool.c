@@ -0,0 +1,304 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : thread-pool.c
+* Author          : Jishnu Murali Thampan
+* Description     : Implementation of the work-stealing thread pool.
+* 		              Tasks submitted from outside the pool are spread
+* 		              round-robin over the worker queues; tasks submitted by
+* 		              a worker go to its own queue. Owners and thieves both
+* 		              take the oldest task, so a caller that submits the
+* 		              largest jobs first gets them started first.
+****************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L /**< @brief For sysconf() */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "thread-pool.h"
+
+#define INITIAL_QUEUE_CAPACITY                                                 \
+  (64) /**< @brief Represents the initial number of task slots per worker */
+
+/**
+ * A queued task
+ */
+typedef struct pool_task {
+  thread_pool_task_fn fn; /**< @brief Entry point */
+  void *arg;              /**< @brief Argument passed to fn */
+} pool_task;
+
+/**
+ * Growable ring buffer of tasks owned by one worker
+ */
+typedef struct pool_queue {
+  pthread_mutex_t lock; /**< @brief Protects the fields below */
+  pool_task *tasks;     /**< @brief Ring buffer */
+  size_t capacity;      /**< @brief Slots in tasks */
+  size_t head;          /**< @brief Index of the oldest task */
+  size_t count;         /**< @brief Number of queued tasks */
+} pool_queue;
+
+struct thread_pool {
+  size_t threads;                /**< @brief Number of workers and queues */
+  size_t started;                /**< @brief Workers actually running */
+  pthread_t *workers;            /**< @brief Worker threads */
+  pool_queue *queues;            /**< @brief One queue per worker */
+  pthread_mutex_t lock;          /**< @brief Protects the fields below */
+  pthread_cond_t work_available; /**< @brief Signalled on submit/shutdown */
+  pthread_cond_t all_done;       /**< @brief Signalled when pending is 0 */
+  size_t queued;                 /**< @brief Tasks waiting in any queue */
+  size_t pending;                /**< @brief Tasks submitted, not finished */
+  size_t next_queue;             /**< @brief Round-robin cursor for submits */
+  int shutdown;                  /**< @brief Set when the pool is destroyed */
+};
+
+/**
+ * Identity of the calling worker, used to keep nested submits local
+ */
+static __thread thread_pool *current_pool = NULL;
+static __thread size_t current_worker = 0;
+
+/**
+ * Appends a task to a queue, growing it if needed
+ * @param[in,out] queue Queue
+ * @param[in]     task  Task to be appended
+ * @return 0 on success, -1 if out of memory
+ */
+static int queue_push(pool_queue *queue, const pool_task task) {
+  pthread_mutex_lock(&queue->lock);
+  if (queue->count == queue->capacity) {
+    size_t capacity =
+        (queue->capacity > 0) ? (2 * queue->capacity) : INITIAL_QUEUE_CAPACITY;
+    pool_task *tasks = malloc(capacity * sizeof(pool_task));
+    if (tasks == NULL) {
+      pthread_mutex_unlock(&queue->lock);
+      return -1;
+    }
+    for (size_t i = 0; i < queue->count; i++) {
+      tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+    }
+    free(queue->tasks);
+    queue->tasks = tasks;
+    queue->capacity = capacity;
+    queue->head = 0;
+  }
+  queue->tasks[(queue->head + queue->count) % queue->capacity] = task;
+  queue->count++;
+  pthread_mutex_unlock(&queue->lock);
+  return 0;
+}
+/**
+ * Removes the oldest task of a queue
+ * @param[in,out] queue Queue
+ * @param[out]    task  Removed task
+ * @return 1 if a task was removed, 0 if the queue was empty
+ */
+static int queue_take(pool_queue *queue, pool_task *task) {
+  int taken = 0;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->count > 0) {
+    *task = queue->tasks[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    taken = 1;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return taken;
+}
+/**
+ * Finds work for a worker: its own queue first, then the other workers'
+ * @param[in,out] pool   Pool
+ * @param[in]     worker Index of the calling worker
+ * @param[out]    task   Task to run
+ * @return 1 if a task was found, 0 otherwise
+ */
+static int find_task(thread_pool *pool, const size_t worker, pool_task *task) {
+  for (size_t i = 0; i < pool->threads; i++) {
+    if (queue_take(&pool->queues[(worker + i) % pool->threads], task)) {
+      pthread_mutex_lock(&pool->lock);
+      pool->queued--;
+      pthread_mutex_unlock(&pool->lock);
+      return 1;
+    }
+  }
+  return 0;
+}
+/**
+ * Argument of a worker thread
+ */
+typedef struct worker_arg {
+  thread_pool *pool; /**< @brief Owning pool */
+  size_t index;      /**< @brief Worker index */
+} worker_arg;
+
+/**
+ * Worker main loop: runs tasks until the pool shuts down
+ * @param[in] arg Heap allocated worker_arg, freed by the worker
+ * @return NULL
+ */
+static void *worker_main(void *arg) {
+  worker_arg self = *(worker_arg *)arg;
+  thread_pool *pool = self.pool;
+  pool_task task;
+  free(arg);
+
+  current_pool = pool;
+  current_worker = self.index;
+
+  for (;;) {
+    if (find_task(pool, self.index, &task)) {
+      task.fn(task.arg);
+
+      pthread_mutex_lock(&pool->lock);
+      if (--pool->pending == 0)
+        pthread_cond_broadcast(&pool->all_done);
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued == 0 && !pool->shutdown)
+      pthread_cond_wait(&pool->work_available, &pool->lock);
+    if (pool->queued == 0 && pool->shutdown) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return NULL;
+}
+/**
+ * Creates a pool and starts its workers
+ * @param[in] threads Number of workers, 0 for one per online CPU
+ * @return Pool or NULL on failure
+ */
+thread_pool *thread_pool_create(size_t threads) {
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0) ? ((size_t)cpus) : (1);
+  }
+
+  thread_pool *pool = calloc(1, sizeof(thread_pool));
+  if (pool == NULL)
+    return NULL;
+  pool->workers = calloc(threads, sizeof(pthread_t));
+  pool->queues = calloc(threads, sizeof(pool_queue));
+  if (pool->workers == NULL || pool->queues == NULL) {
+    free(pool->workers);
+    free(pool->queues);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_available, NULL);
+  pthread_cond_init(&pool->all_done, NULL);
+  for (size_t i = 0; i < threads; i++) {
+    pthread_mutex_init(&pool->queues[i].lock, NULL);
+  }
+
+  /* Queues of workers that fail to start are still drained by stealing */
+  pool->threads = threads;
+  for (; pool->started < threads; pool->started++) {
+    worker_arg *arg = malloc(sizeof(worker_arg));
+    if (arg == NULL)
+      break;
+    arg->pool = pool;
+    arg->index = pool->started;
+    if (pthread_create(&pool->workers[pool->started], NULL, worker_main,
+                       arg) != 0) {
+      free(arg);
+      break;
+    }
+  }
+  if (pool->started == 0) {
+    thread_pool_destroy(pool);
+    return NULL;
+  }
+  return pool;
+}
+/**
+ * Returns the number of workers
+ * @param[in] pool Pool
+ * @return Number of workers
+ */
+size_t thread_pool_size(const thread_pool *pool) { return pool->started; }
+/**
+ * Queues a task. Called from a worker, the task goes to that worker's own
+ * queue; otherwise the queues are filled round-robin.
+ * @param[in,out] pool Pool
+ * @param[in]     fn   Task entry point
+ * @param[in]     arg  Argument passed to fn
+ * @return 0 on success, -1 if out of memory
+ */
+int thread_pool_submit(thread_pool *pool, thread_pool_task_fn fn, void *arg) {
+  const pool_task task = {fn, arg};
+  size_t queue;
+
+  pthread_mutex_lock(&pool->lock);
+  if (current_pool == pool) {
+    queue = current_worker;
+  } else {
+    queue = pool->next_queue;
+    pool->next_queue = (pool->next_queue + 1) % pool->threads;
+  }
+  /* Counted before the push: a worker may take the task, and decrement
+     queued, as soon as it is in the queue */
+  pool->pending++;
+  pool->queued++;
+  pthread_mutex_unlock(&pool->lock);
+
+  if (queue_push(&pool->queues[queue], task) != 0) {
+    pthread_mutex_lock(&pool->lock);
+    pool->queued--;
+    if (--pool->pending == 0)
+      pthread_cond_broadcast(&pool->all_done);
+    pthread_mutex_unlock(&pool->lock);
+    return -1;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_signal(&pool->work_available);
+  pthread_mutex_unlock(&pool->lock);
+  return 0;
+}
+/**
+ * Blocks until every submitted task has finished. Must not be called from
+ * a task running on the same pool.
+ * @param[in,out] pool Pool
+ * @return void
+ */
+void thread_pool_wait(thread_pool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending > 0)
+    pthread_cond_wait(&pool->all_done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+/**
+ * Finishes the queued tasks, stops the workers and frees the pool
+ * @param[in] pool Pool, may be NULL
+ * @return void
+ */
+void thread_pool_destroy(thread_pool *pool) {
+  if (pool == NULL)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->work_available);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->started; i++) {
+    pthread_join(pool->workers[i], NULL);
+  }
+  for (size_t i = 0; i < pool->threads; i++) {
+    pthread_mutex_destroy(&pool->queues[i].lock);
+    free(pool->queues[i].tasks);
+  }
+  pthread_cond_destroy(&pool->all_done);
+  pthread_cond_destroy(&pool->work_available);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->queues);
+  free(pool->workers);
+  free(pool);
+}
@@ -0,0 +1,26 @@
+/***************************************************************************
+****************************************************************************
+* Filename        : thread-pool.h
+* Author          : Jishnu Murali Thampan
+* Description     : Interface of a small work-stealing thread pool. Every
+* 		            worker owns a deque; idle workers steal the oldest
+* 		            task of a busy one so a long task never holds up the
+* 		            rest of the queue.
+****************************************************************************/
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <stddef.h>
+
+typedef void (*thread_pool_task_fn)(void *arg); /**< @brief Task entry point */
+
+typedef struct thread_pool thread_pool;
+
+thread_pool *thread_pool_create(size_t threads);
+size_t thread_pool_size(const thread_pool *pool);
+int thread_pool_submit(thread_pool *pool, thread_pool_task_fn fn, void *arg);
+void thread_pool_wait(thread_pool *pool);
+void thread_pool_destroy(thread_pool *pool);
+
+#endif /* THREAD_POOL_HPP */